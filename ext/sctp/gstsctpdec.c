@@ -29,7 +29,7 @@
 #include "gstsctpdec.h"
 
 #include <gst/sctp/sctpreceivemeta.h>
-#include <gst/base/gstdataqueue.h>
+#include <gst/sctp/sctppacketmeta.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -58,6 +58,12 @@ enum {
 
     PROP_GST_SCTP_ASSOCIATION_ID,
     PROP_LOCAL_SCTP_PORT,
+    PROP_TRACE_INTERVAL,
+    PROP_LATENCY_HISTOGRAMS,
+    PROP_PAD_POOL_SIZE,
+    PROP_DECOMPRESSION,
+    PROP_MAX_QUEUED_BYTES,
+    PROP_STATS,
 
     NUM_PROPERTIES
 };
@@ -66,10 +72,17 @@ static GParamSpec *properties[NUM_PROPERTIES];
 
 #define DEFAULT_GST_SCTP_ASSOCIATION_ID 1
 #define DEFAULT_LOCAL_SCTP_PORT 0
+#define DEFAULT_TRACE_INTERVAL 0
+#define DEFAULT_PAD_POOL_SIZE 16
+#define DEFAULT_DECOMPRESSION FALSE
+#define DEFAULT_MAX_QUEUED_BYTES (4 * 1024 * 1024)
 #define MAX_SCTP_PORT 65535
 #define MAX_GST_SCTP_ASSOCIATION_ID 65535
 #define MAX_STREAM_ID 65535
 
+/* Messages queued for a source pad task without taking a lock */
+#define PACKET_QUEUE_SIZE 256
+
 GType gst_sctp_dec_pad_get_type(void);
 
 #define GST_TYPE_SCTP_DEC_PAD (gst_sctp_dec_pad_get_type())
@@ -84,7 +97,10 @@ typedef GstPadClass GstSctpDecPadClass;
 struct _GstSctpDecPad {
     GstPad parent;
 
-    GstDataQueue *packet_queue;
+    GstSctpRing packet_queue;
+    /* Compressed message delivered in parts, only touched from the receive thread */
+    GByteArray *fragments;
+    gboolean discarding;
 };
 
 G_DEFINE_TYPE(GstSctpDecPad, gst_sctp_dec_pad, GST_TYPE_PAD);
@@ -93,25 +109,12 @@ static void gst_sctp_dec_pad_finalize(GObject *object)
 {
     GstSctpDecPad *self = GST_SCTP_DEC_PAD(object);
 
-    gst_object_unref(self->packet_queue);
+    gst_sctp_ring_clear(&self->packet_queue);
+    g_byte_array_unref(self->fragments);
 
     G_OBJECT_CLASS(gst_sctp_dec_pad_parent_class)->finalize(object);
 }
 
-static gboolean data_queue_check_full_cb(GstDataQueue *queue, guint visible, guint bytes, guint64 time, gpointer user_data)
-{
-    /* FIXME: Are we full at some point and block? */
-    return FALSE;
-}
-
-static void data_queue_empty_cb(GstDataQueue *queue, gpointer user_data)
-{
-}
-
-static void data_queue_full_cb(GstDataQueue *queue, gpointer user_data)
-{
-}
-
 static void gst_sctp_dec_pad_class_init(GstSctpDecPadClass *klass)
 {
     GObjectClass *gobject_class;
@@ -123,10 +126,12 @@ static void gst_sctp_dec_pad_class_init(GstSctpDecPadClass *klass)
 
 static void gst_sctp_dec_pad_init(GstSctpDecPad *self)
 {
-    self->packet_queue = gst_data_queue_new(data_queue_check_full_cb,
-        data_queue_full_cb, data_queue_empty_cb, NULL);
+    gst_sctp_ring_init(&self->packet_queue, PACKET_QUEUE_SIZE);
+    self->fragments = g_byte_array_new();
+    self->discarding = FALSE;
 }
 
+static void gst_sctp_dec_finalize(GObject *object);
 static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GValue *value,
     GParamSpec *pspec);
 static void gst_sctp_dec_get_property(GObject *object, guint prop_id, GValue *value,
@@ -141,13 +146,18 @@ static gboolean configure_association(GstSctpDec *self);
 static void on_gst_sctp_association_stream_reset(GstSctpAssociation *gst_sctp_association, guint16 stream_id,
     GstSctpDec *self);
 static void on_receive(GstSctpAssociation *gst_sctp_association, guint8 *buf, gsize length,
-    guint16 stream_id, guint ppid, gpointer user_data);
+    const GstSctpAssociationReceiveInfo *info, gpointer user_data);
 static void stop_srcpad_task(GstPad *pad);
 static void stop_all_srcpad_tasks(GstSctpDec *self);
 static void sctpdec_cleanup(GstSctpDec *self);
 static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id);
 static void remove_pad(GstElement *element, GstPad *pad);
+static void trim_pad_pool(GstSctpDec *self, guint max_size);
+static void set_max_queued_bytes(const GValue *item, gpointer user_data);
 static void on_reset_stream(GstSctpDec *self, guint stream_id);
+static guint8 *inflate_message(GstSctpDec *self, GstSctpDecPad *sctpdec_pad, guint8 *buf,
+    gsize *length, guint32 *ppid, gboolean last_fragment);
+static GstStructure *create_stats(GstSctpDec *self);
 
 static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
 {
@@ -163,6 +173,7 @@ static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
     gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
     gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_template));
 
+    gobject_class->finalize = gst_sctp_dec_finalize;
     gobject_class->set_property = gst_sctp_dec_set_property;
     gobject_class->get_property = gst_sctp_dec_get_property;
 
@@ -186,6 +197,51 @@ static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
             0, MAX_SCTP_PORT, DEFAULT_LOCAL_SCTP_PORT,
             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_TRACE_INTERVAL] =
+        g_param_spec_uint("trace-interval",
+            "Trace interval",
+            "Trace the latency of one message out of this many (0 = disabled)",
+            0, G_MAXINT, DEFAULT_TRACE_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_LATENCY_HISTOGRAMS] =
+        g_param_spec_boxed("latency-histograms",
+            "Latency histograms",
+            "Per-stream histograms of the traced receive-processing and inbound-queued times",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PAD_POOL_SIZE] =
+        g_param_spec_uint("pad-pool-size",
+            "Pad pool size",
+            "Number of removed source pads kept with their queue and paused task for the next "
+            "stream, so opening and closing streams creates no objects or threads (0 = disabled)",
+            0, 65535, DEFAULT_PAD_POOL_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DECOMPRESSION] =
+        g_param_spec_boolean("decompression",
+            "Decompression",
+            "Inflate the messages that sctpenc compressed and hand them on with their original "
+            "PPID. When disabled they are handed on as they are, with the compressed PPID.",
+            DEFAULT_DECOMPRESSION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_QUEUED_BYTES] =
+        g_param_spec_uint("max-queued-bytes",
+            "Max queued bytes",
+            "Bytes of received messages queued per source pad before sctpdec stops reading "
+            "packets until downstream catches up, which closes the SCTP receive window "
+            "(0 = unlimited)",
+            0, G_MAXINT, DEFAULT_MAX_QUEUED_BYTES,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Decompression statistics of the messages compressed by sctpenc",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 
     signals[SIGNAL_RESET_STREAM] = g_signal_new("reset-stream",
@@ -204,6 +260,10 @@ static void gst_sctp_dec_init(GstSctpDec *self)
 {
     self->sctp_association_id = DEFAULT_GST_SCTP_ASSOCIATION_ID;
     self->local_sctp_port = DEFAULT_LOCAL_SCTP_PORT;
+    self->pad_pool_size = DEFAULT_PAD_POOL_SIZE;
+    self->decompression = DEFAULT_DECOMPRESSION;
+    self->max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES;
+    g_queue_init(&self->pad_pool);
 
     self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
     gst_pad_set_chain_function(self->sink_pad,
@@ -212,6 +272,19 @@ static void gst_sctp_dec_init(GstSctpDec *self)
         GST_DEBUG_FUNCPTR((GstPadEventFunction) gst_sctp_dec_packet_event));
 
     gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
+
+    gst_sctp_trace_init(&self->trace, GST_OBJECT(self));
+}
+
+static void gst_sctp_dec_finalize(GObject *object)
+{
+    GstSctpDec *self = GST_SCTP_DEC(object);
+
+    trim_pad_pool(self, 0);
+    gst_sctp_trace_clear(&self->trace);
+    gst_sctp_inflater_free(self->inflater);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
 }
 
 static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GValue *value,
@@ -226,6 +299,30 @@ static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GVal
     case PROP_LOCAL_SCTP_PORT:
         self->local_sctp_port = g_value_get_uint(value);
         break;
+    case PROP_TRACE_INTERVAL:
+        gst_sctp_trace_set_interval(&self->trace, g_value_get_uint(value));
+        break;
+    case PROP_PAD_POOL_SIZE:
+        GST_OBJECT_LOCK(self);
+        self->pad_pool_size = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(self);
+        trim_pad_pool(self, self->pad_pool_size);
+        break;
+    case PROP_DECOMPRESSION:
+        g_atomic_int_set(&self->decompression, g_value_get_boolean(value));
+        if (self->decompression && !gst_sctp_compression_is_available())
+            GST_WARNING_OBJECT(self, "Built without zlib, compressed messages cannot be inflated");
+        break;
+    case PROP_MAX_QUEUED_BYTES: {
+        GstIterator *it;
+
+        g_atomic_int_set(&self->max_queued_bytes, g_value_get_uint(value));
+        it = gst_element_iterate_src_pads(GST_ELEMENT(self));
+        while (gst_iterator_foreach(it, set_max_queued_bytes, self) == GST_ITERATOR_RESYNC)
+            gst_iterator_resync(it);
+        gst_iterator_free(it);
+        break;
+    }
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -244,6 +341,26 @@ static void gst_sctp_dec_get_property(GObject *object, guint prop_id, GValue *va
     case PROP_LOCAL_SCTP_PORT:
         g_value_set_uint(value, self->local_sctp_port);
         break;
+    case PROP_TRACE_INTERVAL:
+        g_value_set_uint(value, gst_sctp_trace_get_interval(&self->trace));
+        break;
+    case PROP_LATENCY_HISTOGRAMS:
+        g_value_take_boxed(value, gst_sctp_trace_get_histograms(&self->trace));
+        break;
+    case PROP_PAD_POOL_SIZE:
+        GST_OBJECT_LOCK(self);
+        g_value_set_uint(value, self->pad_pool_size);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_DECOMPRESSION:
+        g_value_set_boolean(value, g_atomic_int_get(&self->decompression));
+        break;
+    case PROP_MAX_QUEUED_BYTES:
+        g_value_set_uint(value, g_atomic_int_get(&self->max_queued_bytes));
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, create_stats(self));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -277,6 +394,13 @@ static GstStateChangeReturn gst_sctp_dec_change_state(GstElement *element,
 static GstFlowReturn gst_sctp_dec_packet_chain(GstPad * pad, GstSctpDec *self, GstBuffer * buf)
 {
     GstMapInfo map;
+    GstSctpPacketMeta *packet_meta;
+    guint8 ecn_bits = 0;
+
+    /* Let the SCTP stack see congestion marks if the source reports them */
+    packet_meta = gst_sctp_buffer_get_packet_meta(buf);
+    if (packet_meta)
+        ecn_bits = GST_SCTP_PACKET_META_ECN(packet_meta);
 
     if (!gst_buffer_map(buf, &map, GST_MAP_READ)) {
         GST_WARNING_OBJECT(self, "Could not map GstBuffer");
@@ -284,24 +408,37 @@ static GstFlowReturn gst_sctp_dec_packet_chain(GstPad * pad, GstSctpDec *self, G
         return GST_FLOW_ERROR;
     }
 
+    /* Messages completed by this packet are delivered from within incoming_packet() */
+    self->packet_received_time = gst_sctp_trace_is_enabled(&self->trace) ?
+        g_get_monotonic_time() : 0;
     gst_sctp_association_incoming_packet(self->sctp_association, (guint8 *)map.data,
-        (guint32)map.size);
+        (guint32)map.size, ecn_bits);
+    self->packet_received_time = 0;
     gst_buffer_unmap(buf, &map);
     gst_buffer_unref(buf);
 
     return GST_FLOW_OK;
 }
 
+static void set_max_queued_bytes(const GValue *item, gpointer user_data)
+{
+    GstSctpDecPad *sctpdec_pad = g_value_get_object(item);
+    GstSctpDec *self = user_data;
+
+    gst_sctp_ring_set_max_bytes(&sctpdec_pad->packet_queue,
+        g_atomic_int_get(&self->max_queued_bytes));
+}
+
 static void flush_srcpad(const GValue *item, gpointer user_data)
 {
     GstSctpDecPad *sctpdec_pad = g_value_get_object(item);
     gboolean flush = GPOINTER_TO_INT(user_data);
 
     if (flush) {
-        gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-        gst_data_queue_flush(sctpdec_pad->packet_queue);
+        gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, TRUE);
+        gst_sctp_ring_flush(&sctpdec_pad->packet_queue);
     } else {
-        gst_data_queue_set_flushing(sctpdec_pad->packet_queue, FALSE);
+        gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, FALSE);
         gst_pad_start_task(GST_PAD(sctpdec_pad), (GstTaskFunction)gst_sctp_data_srcpad_loop, sctpdec_pad, NULL);
     }
 }
@@ -347,13 +484,20 @@ static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEven
 static void gst_sctp_data_srcpad_loop(GstPad *pad)
 {
     GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
-    GstDataQueueItem *item;
+    GstSctpRingItem item;
 
-    if (gst_data_queue_pop(sctpdec_pad->packet_queue, &item)) {
+    if (gst_sctp_ring_pop(&sctpdec_pad->packet_queue, &item)) {
         GstFlowReturn flow_ret;
 
-        flow_ret = gst_pad_push(pad, GST_BUFFER(item->object));
-        item->object = NULL;
+        if (G_UNLIKELY(item.traced)) {
+            GstSctpDec *self = GST_SCTP_DEC(GST_PAD_PARENT(pad));
+
+            gst_sctp_trace_record(&self->trace, item.stream_id,
+                GST_SCTP_TRACE_INTERVAL_INBOUND_QUEUED, item.queued_time,
+                g_get_monotonic_time());
+        }
+
+        flow_ret = gst_pad_push(pad, GST_BUFFER(item.object));
         if (G_UNLIKELY(flow_ret == GST_FLOW_FLUSHING || flow_ret == GST_FLOW_NOT_LINKED)) {
             GST_DEBUG_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
         } else if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
@@ -362,12 +506,10 @@ static void gst_sctp_data_srcpad_loop(GstPad *pad)
 
         if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
             GST_DEBUG_OBJECT(pad, "Pausing task because of an error");
-            gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-            gst_data_queue_flush(sctpdec_pad->packet_queue);
+            gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, TRUE);
+            gst_sctp_ring_flush(&sctpdec_pad->packet_queue);
             gst_pad_pause_task(pad);
         }
-
-        item->destroy(item);
     } else {
         GST_DEBUG_OBJECT(pad, "Pausing task because we're flushing");
         gst_pad_pause_task(pad);
@@ -409,7 +551,7 @@ static gboolean gst_sctp_dec_src_event(GstPad *pad, GstSctpDec *self, GstEvent *
             GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
 
             /* Unflush and start task again */
-            gst_data_queue_set_flushing(sctpdec_pad->packet_queue, FALSE);
+            gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, FALSE);
             gst_pad_start_task(pad, (GstTaskFunction)gst_sctp_data_srcpad_loop, pad, NULL);
 
             return gst_pad_event_default(pad, GST_OBJECT(self), event);
@@ -417,8 +559,8 @@ static gboolean gst_sctp_dec_src_event(GstPad *pad, GstSctpDec *self, GstEvent *
         case GST_EVENT_FLUSH_START: {
             GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
 
-            gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-            gst_data_queue_flush(sctpdec_pad->packet_queue);
+            gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, TRUE);
+            gst_sctp_ring_flush(&sctpdec_pad->packet_queue);
 
             return gst_pad_event_default(pad, GST_OBJECT(self), event);
         }
@@ -459,12 +601,25 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
     if (stream_id > MAX_STREAM_ID)
         goto out;
 
-    template = gst_static_pad_template_get(&src_template);
-    new_pad = g_object_new(GST_TYPE_SCTP_DEC_PAD, "name", pad_name,
-        "direction", template->direction, "template", template, NULL);
-    gst_object_unref(template);
+    GST_OBJECT_LOCK(self);
+    new_pad = g_queue_pop_head(&self->pad_pool);
+    GST_OBJECT_UNLOCK(self);
+
+    if (new_pad) {
+        gst_object_set_name(GST_OBJECT(new_pad), pad_name);
+        gst_sctp_ring_set_flushing(&GST_SCTP_DEC_PAD(new_pad)->packet_queue, FALSE);
+        g_byte_array_set_size(GST_SCTP_DEC_PAD(new_pad)->fragments, 0);
+        GST_SCTP_DEC_PAD(new_pad)->discarding = FALSE;
+    } else {
+        template = gst_static_pad_template_get(&src_template);
+        new_pad = g_object_new(GST_TYPE_SCTP_DEC_PAD, "name", pad_name,
+            "direction", template->direction, "template", template, NULL);
+        gst_object_unref(template);
 
-    gst_pad_set_event_function(new_pad, GST_DEBUG_FUNCPTR((GstPadEventFunction) gst_sctp_dec_src_event));
+        gst_pad_set_event_function(new_pad, GST_DEBUG_FUNCPTR((GstPadEventFunction) gst_sctp_dec_src_event));
+    }
+    gst_sctp_ring_set_max_bytes(&GST_SCTP_DEC_PAD(new_pad)->packet_queue,
+        g_atomic_int_get(&self->max_queued_bytes));
 
     if (!gst_pad_set_active(new_pad, TRUE))
         goto error_cleanup_pad;
@@ -477,6 +632,7 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
     if (!gst_element_add_pad(GST_ELEMENT(self), new_pad))
         goto error_cleanup_pad;
 
+    /* Resumes the paused task of a pad from the pool */
     gst_pad_start_task(new_pad, (GstTaskFunction)gst_sctp_data_srcpad_loop, new_pad, NULL);
 
     gst_object_ref(new_pad);
@@ -484,6 +640,7 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
     goto out;
 
 error_cleanup_pad:
+    gst_pad_stop_task(new_pad);
     gst_object_unref(new_pad);
     new_pad = NULL;
 out:
@@ -491,11 +648,50 @@ out:
     return new_pad;
 }
 
+/* Takes the reference passed in */
 static void remove_pad(GstElement *element, GstPad *pad)
 {
-    stop_srcpad_task(pad);
+    GstSctpDec *self = GST_SCTP_DEC(element);
+    GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
+    gboolean pooled = FALSE;
+
+    /* Only paused, so a pad taken from the pool gets its thread back */
+    gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, TRUE);
+    gst_sctp_ring_flush(&sctpdec_pad->packet_queue);
+    gst_pad_pause_task(pad);
     gst_pad_set_active(pad, FALSE);
     gst_element_remove_pad(element, pad);
+
+    /* Only a pad nobody else holds on to can come back under another name */
+    GST_OBJECT_LOCK(self);
+    if (GST_OBJECT_REFCOUNT_VALUE(pad) == 1
+        && g_queue_get_length(&self->pad_pool) < self->pad_pool_size) {
+        g_queue_push_tail(&self->pad_pool, pad);
+        pooled = TRUE;
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    if (!pooled) {
+        gst_pad_stop_task(pad);
+        gst_object_unref(pad);
+    }
+}
+
+static void trim_pad_pool(GstSctpDec *self, guint max_size)
+{
+    GstPad *pad;
+
+    for (;;) {
+        GST_OBJECT_LOCK(self);
+        pad = g_queue_get_length(&self->pad_pool) > max_size ?
+            g_queue_pop_head(&self->pad_pool) : NULL;
+        GST_OBJECT_UNLOCK(self);
+        if (!pad)
+            break;
+
+        gst_pad_stop_task(pad);
+        gst_object_unref(pad);
+    }
 }
 
 static void on_gst_sctp_association_stream_reset(GstSctpAssociation *gst_sctp_association, guint16 stream_id,
@@ -512,51 +708,159 @@ static void on_gst_sctp_association_stream_reset(GstSctpAssociation *gst_sctp_as
         return;
     }
     remove_pad(GST_ELEMENT(self), srcpad);
-    gst_object_unref(srcpad);
-}
-
-static void data_queue_item_free(GstDataQueueItem *item)
-{
-    if (item->object)
-        gst_mini_object_unref(item->object);
-    g_free(item);
 }
 
 static void on_receive(GstSctpAssociation *sctp_association, guint8 *buf, gsize length,
-    guint16 stream_id, guint ppid, gpointer user_data)
+    const GstSctpAssociationReceiveInfo *info, gpointer user_data)
 {
     GstSctpDec *self = user_data;
+    guint16 stream_id = info->stream_id;
     GstSctpDecPad *sctpdec_pad;
     GstPad *src_pad;
-    GstDataQueueItem *item;
+    GstSctpRingItem item = { NULL, };
     GstBuffer *gstbuf;
+    GstSctpReceiveMeta *receive_meta;
+    guint32 ppid = info->ppid;
+    gboolean fragment = info->fragment;
+    gboolean last_fragment = info->last_fragment;
 
     src_pad = get_pad_for_stream_id(self, stream_id);
     g_assert(src_pad);
 
     sctpdec_pad = GST_SCTP_DEC_PAD(src_pad);
+
+    if (ppid == GST_SCTP_COMPRESSED_PPID && g_atomic_int_get(&self->decompression)) {
+        buf = inflate_message(self, sctpdec_pad, buf, &length, &ppid, last_fragment);
+        if (!buf)
+            goto out;
+        fragment = FALSE;
+        last_fragment = TRUE;
+    }
+
     gstbuf = gst_buffer_new_wrapped(buf, length);
-    gst_sctp_buffer_add_receive_meta(gstbuf, ppid);
-
-    item = g_new0(GstDataQueueItem, 1);
-    item->object = GST_MINI_OBJECT(gstbuf);
-    item->size = length;
-    item->visible = TRUE;
-    item->destroy = (GDestroyNotify) data_queue_item_free;
-    if (!gst_data_queue_push(sctpdec_pad->packet_queue, item)) {
-        item->destroy(item);
+    receive_meta = gst_sctp_buffer_add_receive_meta(gstbuf, ppid);
+    receive_meta->stream_id = stream_id;
+    receive_meta->ssn = info->ssn;
+    receive_meta->tsn = info->tsn;
+    receive_meta->unordered = info->unordered;
+    receive_meta->receive_time = info->receive_time * GST_USECOND;
+    receive_meta->fragment = fragment;
+    receive_meta->last_fragment = last_fragment;
+    receive_meta->association_id = self->sctp_association_id;
+
+    if (G_UNLIKELY(self->packet_received_time && gst_sctp_trace_sample(&self->trace))) {
+        item.traced = TRUE;
+        item.stream_id = stream_id;
+        item.queued_time = g_get_monotonic_time();
+        gst_sctp_trace_record(&self->trace, stream_id, GST_SCTP_TRACE_INTERVAL_RECEIVE_PROCESSING,
+            self->packet_received_time, item.queued_time);
+    }
+
+    item.object = GST_MINI_OBJECT(gstbuf);
+    item.size = length;
+    /* Messages are only delivered from the thread that feeds the association its packets. It
+     * waits here while the pad has max-queued-bytes queued, so the receive window closes
+     * instead of the queue growing. */
+    if (!gst_sctp_ring_push(&sctpdec_pad->packet_queue, &item)) {
+        gst_buffer_unref(gstbuf);
         GST_DEBUG_OBJECT(src_pad, "Failed to push item because we're flushing");
     }
 
+out:
     gst_object_unref(src_pad);
 }
 
+/* Takes buf. Returns the inflated message once its last part is in, NULL until then and for
+ * messages that cannot be inflated. */
+static guint8 *inflate_message(GstSctpDec *self, GstSctpDecPad *sctpdec_pad, guint8 *buf,
+    gsize *length, guint32 *ppid, gboolean last_fragment)
+{
+    GstSctpCompressionStats stats = { 0, };
+    GByteArray *fragments = sctpdec_pad->fragments;
+    const guint8 *data = buf;
+    gsize size = *length;
+    guint8 *message = NULL;
+
+    if (!last_fragment || fragments->len || sctpdec_pad->discarding) {
+        if (sctpdec_pad->discarding || fragments->len + size
+            > GST_SCTP_COMPRESSION_HEADER_SIZE + GST_SCTP_COMPRESSION_MAX_MESSAGE_SIZE) {
+            /* Far more than any message sctpenc compresses, drop the rest of it */
+            g_byte_array_set_size(fragments, 0);
+            sctpdec_pad->discarding = !last_fragment;
+            g_free(buf);
+            if (last_fragment)
+                goto error;
+            return NULL;
+        }
+
+        g_byte_array_append(fragments, buf, size);
+        g_free(buf);
+        buf = NULL;
+        if (!last_fragment)
+            return NULL;
+        data = fragments->data;
+        size = fragments->len;
+    }
+
+    if (!self->inflater)
+        self->inflater = gst_sctp_inflater_new();
+
+    if (self->inflater) {
+        message = gst_sctp_inflater_decompress(self->inflater, data, size, ppid, length, &stats);
+    } else {
+        GST_WARNING_OBJECT(self, "Built without zlib, compressed messages cannot be inflated");
+        stats.errors++;
+    }
+
+    g_byte_array_set_size(fragments, 0);
+    g_free(buf);
+
+    if (!message)
+        GST_WARNING_OBJECT(sctpdec_pad, "Dropping a compressed message that could not be inflated");
+
+    GST_OBJECT_LOCK(self);
+    self->compression_stats.messages += stats.messages;
+    self->compression_stats.bytes_in += stats.bytes_in;
+    self->compression_stats.bytes_out += stats.bytes_out;
+    self->compression_stats.cpu_time += stats.cpu_time;
+    self->compression_stats.errors += stats.errors;
+    GST_OBJECT_UNLOCK(self);
+
+    return message;
+
+error:
+    GST_WARNING_OBJECT(sctpdec_pad, "Dropping a compressed message that is too large");
+    GST_OBJECT_LOCK(self);
+    self->compression_stats.errors++;
+    GST_OBJECT_UNLOCK(self);
+    return NULL;
+}
+
+static GstStructure *create_stats(GstSctpDec *self)
+{
+    GstSctpCompressionStats compression;
+
+    GST_OBJECT_LOCK(self);
+    compression = self->compression_stats;
+    GST_OBJECT_UNLOCK(self);
+
+    return gst_structure_new("application/x-sctp-stats",
+        "messages-decompressed", G_TYPE_UINT64, compression.messages,
+        "decompression-bytes-in", G_TYPE_UINT64, compression.bytes_out,
+        "decompression-bytes-out", G_TYPE_UINT64, compression.bytes_in,
+        "compression-ratio", G_TYPE_DOUBLE, compression.bytes_out ?
+            (gdouble) compression.bytes_in / compression.bytes_out : 0.0,
+        "decompression-cpu-time", G_TYPE_UINT64, compression.cpu_time,
+        "decompression-errors", G_TYPE_UINT64, compression.errors,
+        NULL);
+}
+
 static void stop_srcpad_task(GstPad *pad)
 {
     GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
 
-    gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-    gst_data_queue_flush(sctpdec_pad->packet_queue);
+    gst_sctp_ring_set_flushing(&sctpdec_pad->packet_queue, TRUE);
+    gst_sctp_ring_flush(&sctpdec_pad->packet_queue);
     gst_pad_stop_task(pad);
 }
 
@@ -565,7 +869,7 @@ static void remove_pad_it(const GValue *item, gpointer user_data)
     GstPad *pad = g_value_get_object(item);
     GstSctpDec *self = user_data;
 
-    remove_pad(GST_ELEMENT(self), pad);
+    remove_pad(GST_ELEMENT(self), gst_object_ref(pad));
 }
 
 static void stop_all_srcpad_tasks(GstSctpDec *self)
@@ -583,6 +887,7 @@ static void sctpdec_cleanup(GstSctpDec *self)
     if (self->sctp_association) {
         g_signal_handler_disconnect(self->sctp_association, self->signal_handler_stream_reset);
         stop_all_srcpad_tasks(self);
+        trim_pad_pool(self, 0);
         gst_sctp_association_force_close(self->sctp_association);
         g_object_unref(self->sctp_association);
         self->sctp_association = NULL;
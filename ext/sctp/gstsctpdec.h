@@ -29,6 +29,9 @@
 #include <gst/gst.h>
 
 #include "sctpassociation.h"
+#include "gstsctptrace.h"
+#include "gstsctpring.h"
+#include "sctpcompression.h"
 
 G_BEGIN_DECLS
 
@@ -47,9 +50,24 @@ struct _GstSctpDec {
     GstPad *sink_pad;
     guint sctp_association_id;
     guint local_sctp_port;
+    guint pad_pool_size;
+    gboolean decompression;
+    guint max_queued_bytes;
 
     GstSctpAssociation *sctp_association;
     gulong signal_handler_stream_reset;
+
+    /* Removed source pads with their queue and paused task, protected by the object lock */
+    GQueue pad_pool;
+
+    GstSctpTrace trace;
+    /* Set while a packet is handed to the association, for tracing */
+    gint64 packet_received_time;
+
+    /* Only used from the receive thread */
+    GstSctpInflater *inflater;
+    /* Protected by the object lock */
+    GstSctpCompressionStats compression_stats;
 };
 
 struct _GstSctpDecClass {
@@ -29,7 +29,9 @@
 #include "gstsctpenc.h"
 
 #include <gst/sctp/sctpsendmeta.h>
+#include <gst/sctp/sctppacketmeta.h>
 #include <stdio.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_STATIC(gst_sctp_enc_debug_category);
 #define GST_CAT_DEFAULT gst_sctp_enc_debug_category
@@ -46,6 +48,9 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PA
 enum {
     SIGNAL_SCTP_ASSOCIATION_ESTABLISHED,
     SIGNAL_GET_STREAM_BYTES_SENT,
+    SIGNAL_DUMP_CAPTURE,
+    SIGNAL_MESSAGE_ABANDONED,
+    SIGNAL_GET_STREAM_BYTES_ABANDONED,
     NUM_SIGNALS
 };
 
@@ -57,6 +62,41 @@ enum {
     PROP_GST_SCTP_ASSOCIATION_ID,
     PROP_REMOTE_SCTP_PORT,
     PROP_USE_SOCK_STREAM,
+    PROP_BUNDLING_POLICY,
+    PROP_BUNDLING_MAX_DELAY,
+    PROP_SACK_DELAY,
+    PROP_SACK_FREQUENCY,
+    PROP_CONGESTION_CONTROL,
+    PROP_RTCC_STEADY_STEP,
+    PROP_RTCC_USE_ECN,
+    PROP_ECN,
+    PROP_IDLE_TIMEOUT,
+    PROP_IDLE_HEARTBEAT_INTERVAL,
+    PROP_IDLE,
+    PROP_MTU,
+    PROP_STATS,
+    PROP_TRACE_INTERVAL,
+    PROP_LATENCY_HISTOGRAMS,
+    PROP_CAPTURE_PACKETS,
+    PROP_CAPTURE_SNAPLEN,
+    PROP_CAPTURE_SAMPLE_INTERVAL,
+    PROP_PRECONNECT_BUFFER_SIZE,
+    PROP_SETUP_PROFILE,
+    PROP_MAX_INIT_RETRANSMITS,
+    PROP_MAX_RETRANSMITS,
+    PROP_FEEDBACK_INTERVAL,
+    PROP_PACING,
+    PROP_PACING_BURST,
+    PROP_PACING_GAIN,
+    PROP_PAD_POOL_SIZE,
+    PROP_DIRECT_PUSH,
+    PROP_CHECKSUM,
+    PROP_MEMORY_LIMIT,
+    PROP_MEMORY_BUDGET,
+    PROP_COMPRESSION,
+    PROP_COMPRESSION_THRESHOLD,
+    PROP_COMPRESSION_LEVEL,
+    PROP_ENGINE,
 
     NUM_PROPERTIES
 };
@@ -68,9 +108,59 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define DEFAULT_GST_SCTP_ORDERED TRUE
 #define DEFAULT_SCTP_PPID 1
 #define DEFAULT_USE_SOCK_STREAM FALSE
+#define DEFAULT_BUNDLING_POLICY GST_SCTP_ASSOCIATION_BUNDLING_POLICY_LATENCY
+#define DEFAULT_BUNDLING_MAX_DELAY 1000
+#define DEFAULT_SACK_DELAY 200
+#define DEFAULT_SACK_FREQUENCY 2
+#define DEFAULT_CONGESTION_CONTROL GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC2581
+#define DEFAULT_RTCC_STEADY_STEP 20
+#define DEFAULT_RTCC_USE_ECN TRUE
+#define DEFAULT_ECN FALSE
+#define DEFAULT_IDLE_TIMEOUT 0
+#define DEFAULT_IDLE_HEARTBEAT_INTERVAL 300000
+#define DEFAULT_MTU 1200
+#define DEFAULT_TRACE_INTERVAL 0
+#define DEFAULT_CAPTURE_PACKETS 0
+#define DEFAULT_CAPTURE_SNAPLEN 256
+#define DEFAULT_CAPTURE_SAMPLE_INTERVAL 1
+#define DEFAULT_PRECONNECT_BUFFER_SIZE (256 * 1024)
+#define DEFAULT_SETUP_PROFILE GST_SCTP_ASSOCIATION_SETUP_PROFILE_DEFAULT
+#define DEFAULT_MAX_INIT_RETRANSMITS 0
+#define DEFAULT_MAX_RETRANSMITS 0
+#define DEFAULT_FEEDBACK_INTERVAL 0
+#define DEFAULT_PACING FALSE
+#define DEFAULT_PACING_BURST 12000
+#define DEFAULT_PACING_GAIN 125
+#define DEFAULT_PAD_POOL_SIZE 16
+#define DEFAULT_DIRECT_PUSH FALSE
+#define DEFAULT_CHECKSUM GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED
+#define DEFAULT_MEMORY_LIMIT (4 * 1024 * 1024)
+#define DEFAULT_MEMORY_BUDGET 0
+#define DEFAULT_COMPRESSION FALSE
+#define DEFAULT_COMPRESSION_THRESHOLD 256
+#define DEFAULT_COMPRESSION_LEVEL 6
+#define DEFAULT_ENGINE GST_SCTP_ASSOCIATION_ENGINE_USRSCTP
+
+/* How often the pacing rate follows the congestion window */
+#define PACING_RATE_UPDATE_INTERVAL (10 * GST_MSECOND)
 
 #define BUFFER_FULL_SLEEP_TIME 100000
 
+/* Most queued packets pushed downstream as one buffer list */
+#define MAX_PACKETS_PER_LIST 64
+
+/* Packets queued for the source pad task without taking a lock */
+#define OUTBOUND_QUEUE_SIZE 1024
+
+/* Packets the association sends out while a sink pad streaming thread is inside
+ * gst_sctp_association_send_data(), collected for that thread to push */
+typedef struct {
+    GstSctpEnc *self;
+    GstBufferList *packets;
+} GstSctpEncDirectPush;
+
+static GPrivate direct_push_packets = G_PRIVATE_INIT(NULL);
+
 GType gst_sctp_enc_pad_get_type(void);
 
 #define GST_TYPE_SCTP_ENC_PAD (gst_sctp_enc_pad_get_type())
@@ -92,6 +182,16 @@ struct _GstSctpEncPad {
     guint32 reliability_param;
 
     guint64 bytes_sent;
+    guint32 messages_sent;
+    /* Abandoned by the stack, or never sent because the association failed */
+    guint64 bytes_abandoned;
+    /* Priority of the message the pad is blocked on */
+    GstSctpSendMetaPriority pending_priority;
+    /* Only touched from the streaming thread of the pad */
+    gint64 last_feedback_time;
+    gboolean compress;
+    GstSctpDeflater *deflater;
+    gint deflater_level;
 
     GMutex lock;
     GCond cond;
@@ -104,6 +204,7 @@ static void gst_sctp_enc_pad_finalize(GObject *object)
 {
     GstSctpEncPad *self = GST_SCTP_ENC_PAD(object);
 
+    gst_sctp_deflater_free(self->deflater);
     g_cond_clear(&self->cond);
     g_mutex_clear(&self->lock);
 
@@ -138,16 +239,36 @@ static gboolean gst_sctp_enc_sink_event(GstPad *pad, GstObject *parent, GstEvent
 static gboolean gst_sctp_enc_src_event(GstPad *pad, GstObject *parent, GstEvent *event);
 static void on_sctp_association_state_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
     GstSctpEnc *self);
+static void on_sctp_association_idle_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
+    GstSctpEnc *self);
+static void on_sctp_association_send_failed(GstSctpAssociation *sctp_association, guint stream_id,
+    guint ppid, guint length, guint context, gboolean sent, GstSctpEnc *self);
 
 static gboolean configure_association(GstSctpEnc *self);
 static void on_sctp_packet_out(GstSctpAssociation *sctp_association, const guint8 *buf, gsize length,
-    gpointer user_data);
+    guint8 tos, gboolean set_df, gpointer user_data);
+static GstBuffer *take_packet(GstSctpEnc *self, GstSctpRingItem *item);
+static GstStateChangeReturn gst_sctp_enc_change_state(GstElement *element,
+    GstStateChange transition);
 static void stop_srcpad_task(GstPad *pad, GstSctpEnc *self);
 static void sctpenc_cleanup(GstSctpEnc *self);
 static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
     GstSctpAssociationPartialReliability *reliability, guint32 *reliability_param, guint32 *ppid,
-    gboolean *ppid_available);
+    gboolean *ppid_available, gboolean *compress);
 static guint64 on_get_stream_bytes_sent(GstSctpEnc *self, guint stream_id);
+static gboolean on_dump_capture(GstSctpEnc *self, const gchar *location);
+static guint64 on_get_stream_bytes_abandoned(GstSctpEnc *self, guint stream_id);
+static GstStructure *create_stats(GstSctpEnc *self);
+static GstClockTime get_running_time(GstSctpEnc *self);
+static gint compare_pad_priority(GstSctpEncPad *a, GstSctpEncPad *b, gpointer user_data);
+static gboolean higher_priority_pending(GstSctpEnc *self, GstSctpSendMetaPriority priority);
+static void maybe_send_feedback(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, gboolean blocked);
+static void pace_packet(GstSctpEnc *self, gsize size);
+static void push_pending_events(GstSctpEnc *self);
+static GstFlowReturn push_direct(GstSctpEnc *self, GstBufferList *packets);
+static void set_pacing_flushing(GstSctpEnc *self, gboolean flushing);
+static guint8 *compress_message(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, const guint8 *data,
+    gsize length, guint32 ppid, gsize *compressed_length);
 
 static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
 {
@@ -171,6 +292,7 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
 
     element_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_sctp_enc_request_new_pad);
     element_class->release_pad = GST_DEBUG_FUNCPTR(gst_sctp_enc_release_pad);
+    element_class->change_state = GST_DEBUG_FUNCPTR(gst_sctp_enc_change_state);
 
     properties[PROP_GST_SCTP_ASSOCIATION_ID] =
         g_param_spec_uint("sctp-association-id",
@@ -195,6 +317,280 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
             "When TRUE the partial reliability parameters of the channel are ignored.",
             DEFAULT_USE_SOCK_STREAM, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_BUNDLING_POLICY] =
+        g_param_spec_enum("bundling-policy",
+            "Bundling policy",
+            "How small messages are bundled into packets. \"latency\" sends every message at once, "
+            "\"throughput\" delays them while data is in flight (Nagle) and \"adaptive\" holds them "
+            "for at most bundling-max-delay. Messages with the urgent send meta flag are never held.",
+            GST_SCTP_TYPE_ASSOCIATION_BUNDLING_POLICY, DEFAULT_BUNDLING_POLICY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BUNDLING_MAX_DELAY] =
+        g_param_spec_uint("bundling-max-delay",
+            "Bundling max delay",
+            "Maximum time in microseconds a small message is held back in the adaptive bundling policy",
+            0, 1000000, DEFAULT_BUNDLING_MAX_DELAY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_DELAY] =
+        g_param_spec_uint("sack-delay",
+            "SACK delay",
+            "Maximum time in milliseconds the acknowledgement of received data is delayed. "
+            "0 disables delayed acknowledgements.",
+            0, 500, DEFAULT_SACK_DELAY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_FREQUENCY] =
+        g_param_spec_uint("sack-frequency",
+            "SACK frequency",
+            "Number of packets received before an acknowledgement is sent without waiting for "
+            "sack-delay",
+            1, G_MAXUSHORT, DEFAULT_SACK_FREQUENCY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CONGESTION_CONTROL] =
+        g_param_spec_enum("congestion-control",
+            "Congestion control",
+            "The congestion control module used by the association. hstcp and htcp suit bulk "
+            "transfers on paths with a large bandwidth-delay product, rtcc keeps queueing delay low.",
+            GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL, DEFAULT_CONGESTION_CONTROL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTCC_STEADY_STEP] =
+        g_param_spec_uint("rtcc-steady-step",
+            "RTCC steady step",
+            "Number of steady state RTT measurements before the rtcc module probes for more "
+            "bandwidth (0 disables probing)",
+            0, G_MAXUSHORT, DEFAULT_RTCC_STEADY_STEP,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTCC_USE_ECN] =
+        g_param_spec_boolean("rtcc-use-ecn",
+            "RTCC use ECN",
+            "Whether the rtcc module reacts to ECN marks with its delay based response",
+            DEFAULT_RTCC_USE_ECN,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_ECN] =
+        g_param_spec_boolean("ecn",
+            "ECN",
+            "Negotiate Explicit Congestion Notification with the peer. Outgoing packets then "
+            "carry an ECN capable codepoint in their GstSctpPacketMeta, which the network sink "
+            "has to apply for congestion to be signalled before packets are dropped.",
+            DEFAULT_ECN,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE_TIMEOUT] =
+        g_param_spec_uint("idle-timeout",
+            "Idle timeout",
+            "Time in milliseconds without data sent or received before the association goes idle "
+            "and its heartbeats are stretched to idle-heartbeat-interval (0 = never)",
+            0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE_HEARTBEAT_INTERVAL] =
+        g_param_spec_uint("idle-heartbeat-interval",
+            "Idle heartbeat interval",
+            "Heartbeat interval in milliseconds while the association is idle (0 = no heartbeats)",
+            0, G_MAXUINT, DEFAULT_IDLE_HEARTBEAT_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE] =
+        g_param_spec_boolean("idle",
+            "Idle",
+            "Whether the association is idle. It becomes active again on the next send or receive.",
+            FALSE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MTU] =
+        g_param_spec_uint("mtu",
+            "MTU",
+            "Path MTU in bytes of the SCTP packets. Takes effect when the association is started.",
+            508, G_MAXUSHORT, DEFAULT_MTU,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Counters and congestion state of the SCTP association. The retransmission counters "
+            "(stack-*) cover all associations in the process.",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_TRACE_INTERVAL] =
+        g_param_spec_uint("trace-interval",
+            "Trace interval",
+            "Trace the latency of one message out of this many (0 = disabled). Set it before the "
+            "association is started, messages already buffered are not attributed correctly.",
+            0, G_MAXINT, DEFAULT_TRACE_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_LATENCY_HISTOGRAMS] =
+        g_param_spec_boxed("latency-histograms",
+            "Latency histograms",
+            "Per-stream histograms of the traced send-blocked, send-buffered and outbound-queued "
+            "times",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CAPTURE_PACKETS] =
+        g_param_spec_uint("capture-packets",
+            "Capture packets",
+            "Number of inbound and outbound SCTP packets kept in memory for dump-capture "
+            "(0 = capture disabled)",
+            0, 1 << 20, DEFAULT_CAPTURE_PACKETS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CAPTURE_SNAPLEN] =
+        g_param_spec_uint("capture-snaplen",
+            "Capture snaplen",
+            "Bytes of each SCTP packet kept in the capture",
+            12, G_MAXUSHORT, DEFAULT_CAPTURE_SNAPLEN,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CAPTURE_SAMPLE_INTERVAL] =
+        g_param_spec_uint("capture-sample-interval",
+            "Capture sample interval",
+            "Capture one packet out of this many",
+            1, G_MAXUINT, DEFAULT_CAPTURE_SAMPLE_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PRECONNECT_BUFFER_SIZE] =
+        g_param_spec_uint("preconnect-buffer-size",
+            "Pre-connect buffer size",
+            "Bytes of data buffered on pads requested before the association is established. "
+            "The data is sent in one batch as soon as it is (0 = sinks block until then)",
+            0, G_MAXUINT, DEFAULT_PRECONNECT_BUFFER_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SETUP_PROFILE] =
+        g_param_spec_enum("setup-profile",
+            "Setup profile",
+            "RTO and INIT timers of the association. \"fast\" starts with a low RTO and retries "
+            "lost INITs quickly, for lossy mobile networks.",
+            GST_SCTP_TYPE_ASSOCIATION_SETUP_PROFILE, DEFAULT_SETUP_PROFILE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_INIT_RETRANSMITS] =
+        g_param_spec_uint("max-init-retransmits",
+            "Max INIT retransmits",
+            "Number of INIT retransmissions before the setup is given up "
+            "(0 = as in the setup profile)",
+            0, G_MAXUSHORT, DEFAULT_MAX_INIT_RETRANSMITS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_RETRANSMITS] =
+        g_param_spec_uint("max-retransmits",
+            "Max retransmits",
+            "Number of consecutive retransmissions before the association is considered lost "
+            "(0 = engine default, 10 for both engines)",
+            0, G_MAXUSHORT, DEFAULT_MAX_RETRANSMITS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_FEEDBACK_INTERVAL] =
+        g_param_spec_uint("feedback-interval",
+            "Feedback interval",
+            "Minimum time in milliseconds between the application/x-sctp-congestion-feedback "
+            "upstream events sent on each sink pad (0 = disabled)",
+            0, G_MAXINT, DEFAULT_FEEDBACK_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING] =
+        g_param_spec_boolean("pacing",
+            "Pacing",
+            "Spread the outgoing packets over the round trip time instead of pushing a whole "
+            "congestion window back to back. Waits on the pipeline clock.",
+            DEFAULT_PACING,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING_BURST] =
+        g_param_spec_uint("pacing-burst",
+            "Pacing burst",
+            "Bytes that may be pushed back to back when pacing",
+            1, G_MAXINT, DEFAULT_PACING_BURST,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING_GAIN] =
+        g_param_spec_uint("pacing-gain",
+            "Pacing gain",
+            "Pacing rate in percent of cwnd / srtt. Above 100 so the pacer does not keep the "
+            "congestion window from growing.",
+            100, 1000, DEFAULT_PACING_GAIN,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PAD_POOL_SIZE] =
+        g_param_spec_uint("pad-pool-size",
+            "Pad pool size",
+            "Number of released sink pads kept for reuse by the next request, so opening and "
+            "closing streams does not allocate (0 = disabled)",
+            0, 65535, DEFAULT_PAD_POOL_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DIRECT_PUSH] =
+        g_param_spec_boolean("direct-push",
+            "Direct push",
+            "Push the packets sent for a message downstream from the streaming thread of its "
+            "sink pad instead of handing them to the source pad task. Retransmissions, SACKs "
+            "and heartbeats still go through the task. Not used while pacing.",
+            DEFAULT_DIRECT_PUSH,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CHECKSUM] =
+        g_param_spec_enum("checksum",
+            "Checksum",
+            "How the CRC32c of the SCTP packets is computed and verified. \"none\" leaves it "
+            "to DTLS to protect the packets and only works with peers that skip it too.",
+            GST_SCTP_TYPE_ASSOCIATION_CHECKSUM, DEFAULT_CHECKSUM,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MEMORY_LIMIT] =
+        g_param_spec_uint("memory-limit",
+            "Memory limit",
+            "Maximum bytes of send and receive socket buffer for the association. The buffers "
+            "are sized from the measured bandwidth-delay product up to this and memory-budget.",
+            128 * 1024, G_MAXINT, DEFAULT_MEMORY_LIMIT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MEMORY_BUDGET] =
+        g_param_spec_uint64("memory-budget",
+            "Memory budget",
+            "Bytes of socket buffer shared by all SCTP associations in the process (0 = unlimited). "
+            "Under pressure idle associations shrink first, then the ones above their share, and "
+            "new streams are refused last.",
+            0, G_MAXUINT64, DEFAULT_MEMORY_BUDGET,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_COMPRESSION] =
+        g_param_spec_boolean("compression",
+            "Compression",
+            "Deflate messages of streams whose caps do not say otherwise with a \"compress\" "
+            "field. Only for peers that decode with sctpdec with decompression enabled.",
+            DEFAULT_COMPRESSION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_COMPRESSION_THRESHOLD] =
+        g_param_spec_uint("compression-threshold",
+            "Compression threshold",
+            "Smallest message in bytes that is compressed, smaller ones are sent as they are",
+            1, G_MAXINT, DEFAULT_COMPRESSION_THRESHOLD,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_COMPRESSION_LEVEL] =
+        g_param_spec_int("compression-level",
+            "Compression level",
+            "zlib compression level, from 1 (fastest) to 9 (smallest)",
+            1, 9, DEFAULT_COMPRESSION_LEVEL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_ENGINE] =
+        g_param_spec_enum("engine",
+            "Engine",
+            "The SCTP implementation running the association. \"lite\" shares no state with "
+            "other associations and covers what data channels need, without the congestion "
+            "control modules and ECN.",
+            GST_SCTP_TYPE_ASSOCIATION_ENGINE, DEFAULT_ENGINE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 
     signals[SIGNAL_SCTP_ASSOCIATION_ESTABLISHED] = g_signal_new(
@@ -208,7 +604,27 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
         G_STRUCT_OFFSET(GstSctpEncClass, on_get_stream_bytes_sent), NULL, NULL,
         g_cclosure_marshal_generic, G_TYPE_UINT64, 1, G_TYPE_UINT);
 
+    signals[SIGNAL_DUMP_CAPTURE] = g_signal_new("dump-capture",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstSctpEncClass, on_dump_capture), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_BOOLEAN, 1, G_TYPE_STRING);
+
+    /* stream-id, ppid, bytes, the context of the GstSctpSendMeta and whether the data was sent
+     * at least once. Emitted from a streaming thread or a thread of the engine. */
+    signals[SIGNAL_MESSAGE_ABANDONED] = g_signal_new("message-abandoned",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST,
+        G_STRUCT_OFFSET(GstSctpEncClass, on_message_abandoned), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 5, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+        G_TYPE_UINT, G_TYPE_BOOLEAN);
+
+    signals[SIGNAL_GET_STREAM_BYTES_ABANDONED] = g_signal_new("bytes-abandoned",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstSctpEncClass, on_get_stream_bytes_abandoned), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_UINT64, 1, G_TYPE_UINT);
+
     klass->on_get_stream_bytes_sent =  GST_DEBUG_FUNCPTR(on_get_stream_bytes_sent);
+    klass->on_dump_capture = GST_DEBUG_FUNCPTR(on_dump_capture);
+    klass->on_get_stream_bytes_abandoned = GST_DEBUG_FUNCPTR(on_get_stream_bytes_abandoned);
 
     gst_element_class_set_static_metadata(element_class,
         "SCTP Encoder",
@@ -217,20 +633,6 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
         "George Kiagiadakis <george.kiagiadakis@collabora.com>");
 }
 
-static gboolean data_queue_check_full_cb(GstDataQueue *queue, guint visible, guint bytes, guint64 time, gpointer user_data)
-{
-    /* TODO: When are we considered full? */
-    return FALSE;
-}
-
-static void data_queue_empty_cb(GstDataQueue *queue, gpointer user_data)
-{
-}
-
-static void data_queue_full_cb(GstDataQueue *queue, gpointer user_data)
-{
-}
-
 static gboolean
 gst_sctp_enc_src_activate_mode (GstPad * pad, GstObject * parent,
     GstPadMode mode, gboolean active)
@@ -241,8 +643,11 @@ gst_sctp_enc_src_activate_mode (GstPad * pad, GstObject * parent,
   switch (mode) {
     case GST_PAD_MODE_PUSH:
       if (active) {
+        g_mutex_lock(&self->push_lock);
         self->need_segment = self->need_stream_start_caps = TRUE;
-        gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, FALSE);
+        g_mutex_unlock(&self->push_lock);
+        gst_sctp_ring_set_flushing(&self->outbound_sctp_packet_queue, FALSE);
+        set_pacing_flushing(self, FALSE);
         gst_pad_start_task(self->src_pad,
             (GstTaskFunction)gst_sctp_enc_srcpad_loop, self->src_pad, NULL);
         ret = configure_association(self);
@@ -263,10 +668,41 @@ static void gst_sctp_enc_init(GstSctpEnc *self)
 {
     self->sctp_association_id = DEFAULT_GST_SCTP_ASSOCIATION_ID;
     self->remote_sctp_port = DEFAULT_REMOTE_SCTP_PORT;
+    self->bundling_policy = DEFAULT_BUNDLING_POLICY;
+    self->bundling_max_delay = DEFAULT_BUNDLING_MAX_DELAY;
+    self->sack_delay = DEFAULT_SACK_DELAY;
+    self->sack_frequency = DEFAULT_SACK_FREQUENCY;
+    self->congestion_control = DEFAULT_CONGESTION_CONTROL;
+    self->rtcc_steady_step = DEFAULT_RTCC_STEADY_STEP;
+    self->rtcc_use_ecn = DEFAULT_RTCC_USE_ECN;
+    self->ecn = DEFAULT_ECN;
+    self->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+    self->idle_heartbeat_interval = DEFAULT_IDLE_HEARTBEAT_INTERVAL;
+    self->mtu = DEFAULT_MTU;
+    self->capture_packets = DEFAULT_CAPTURE_PACKETS;
+    self->capture_snaplen = DEFAULT_CAPTURE_SNAPLEN;
+    self->capture_sample_interval = DEFAULT_CAPTURE_SAMPLE_INTERVAL;
+    self->preconnect_buffer_size = DEFAULT_PRECONNECT_BUFFER_SIZE;
+    self->setup_profile = DEFAULT_SETUP_PROFILE;
+    self->max_init_retransmits = DEFAULT_MAX_INIT_RETRANSMITS;
+    self->max_retransmits = DEFAULT_MAX_RETRANSMITS;
+    self->feedback_interval = DEFAULT_FEEDBACK_INTERVAL;
+    self->pacing = DEFAULT_PACING;
+    self->pacing_burst = DEFAULT_PACING_BURST;
+    self->pacing_gain = DEFAULT_PACING_GAIN;
+    self->pad_pool_size = DEFAULT_PAD_POOL_SIZE;
+    self->direct_push = DEFAULT_DIRECT_PUSH;
+    self->checksum = DEFAULT_CHECKSUM;
+    self->memory_limit = DEFAULT_MEMORY_LIMIT;
+    self->compression = DEFAULT_COMPRESSION;
+    self->compression_threshold = DEFAULT_COMPRESSION_THRESHOLD;
+    self->compression_level = DEFAULT_COMPRESSION_LEVEL;
+    self->engine = DEFAULT_ENGINE;
+    self->idle = FALSE;
 
     self->sctp_association = NULL;
-    self->outbound_sctp_packet_queue = gst_data_queue_new(data_queue_check_full_cb,
-        data_queue_full_cb, data_queue_empty_cb, NULL);
+    gst_sctp_ring_init(&self->outbound_sctp_packet_queue, OUTBOUND_QUEUE_SIZE);
+    g_mutex_init(&self->outbound_push_lock);
 
     self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
     gst_pad_set_event_function(self->src_pad,
@@ -277,6 +713,12 @@ static void gst_sctp_enc_init(GstSctpEnc *self)
     gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
 
     g_queue_init(&self->pending_pads);
+    g_queue_init(&self->pad_pool);
+    g_mutex_init(&self->push_lock);
+    self->pacing_last_time = GST_CLOCK_TIME_NONE;
+    self->pacing_rate_time = GST_CLOCK_TIME_NONE;
+
+    gst_sctp_trace_init(&self->trace, GST_OBJECT(self));
 }
 
 static void gst_sctp_enc_finalize(GObject *object)
@@ -284,7 +726,11 @@ static void gst_sctp_enc_finalize(GObject *object)
     GstSctpEnc *self = GST_SCTP_ENC(object);
 
     g_queue_clear(&self->pending_pads);
-    gst_object_unref(self->outbound_sctp_packet_queue);
+    g_queue_free_full(&self->pad_pool, gst_object_unref);
+    g_mutex_clear(&self->push_lock);
+    gst_sctp_ring_clear(&self->outbound_sctp_packet_queue);
+    g_mutex_clear(&self->outbound_push_lock);
+    gst_sctp_trace_clear(&self->trace);
 
     G_OBJECT_CLASS(parent_class)->finalize (object);
 }
@@ -304,6 +750,108 @@ static void gst_sctp_enc_set_property(GObject *object, guint prop_id, const GVal
     case PROP_USE_SOCK_STREAM:
         self->use_sock_stream = g_value_get_boolean(value);
         break;
+    case PROP_BUNDLING_POLICY:
+        self->bundling_policy = g_value_get_enum(value);
+        break;
+    case PROP_BUNDLING_MAX_DELAY:
+        self->bundling_max_delay = g_value_get_uint(value);
+        break;
+    case PROP_SACK_DELAY:
+        self->sack_delay = g_value_get_uint(value);
+        break;
+    case PROP_SACK_FREQUENCY:
+        self->sack_frequency = g_value_get_uint(value);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        self->congestion_control = g_value_get_enum(value);
+        break;
+    case PROP_RTCC_STEADY_STEP:
+        self->rtcc_steady_step = g_value_get_uint(value);
+        break;
+    case PROP_RTCC_USE_ECN:
+        self->rtcc_use_ecn = g_value_get_boolean(value);
+        break;
+    case PROP_ECN:
+        self->ecn = g_value_get_boolean(value);
+        break;
+    case PROP_IDLE_TIMEOUT:
+        self->idle_timeout = g_value_get_uint(value);
+        break;
+    case PROP_IDLE_HEARTBEAT_INTERVAL:
+        self->idle_heartbeat_interval = g_value_get_uint(value);
+        break;
+    case PROP_MTU:
+        self->mtu = g_value_get_uint(value);
+        break;
+    case PROP_TRACE_INTERVAL:
+        gst_sctp_trace_set_interval(&self->trace, g_value_get_uint(value));
+        break;
+    case PROP_CAPTURE_PACKETS:
+        self->capture_packets = g_value_get_uint(value);
+        break;
+    case PROP_CAPTURE_SNAPLEN:
+        self->capture_snaplen = g_value_get_uint(value);
+        break;
+    case PROP_CAPTURE_SAMPLE_INTERVAL:
+        self->capture_sample_interval = g_value_get_uint(value);
+        break;
+    case PROP_PRECONNECT_BUFFER_SIZE:
+        self->preconnect_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_SETUP_PROFILE:
+        self->setup_profile = g_value_get_enum(value);
+        break;
+    case PROP_MAX_INIT_RETRANSMITS:
+        self->max_init_retransmits = g_value_get_uint(value);
+        break;
+    case PROP_MAX_RETRANSMITS:
+        self->max_retransmits = g_value_get_uint(value);
+        break;
+    case PROP_FEEDBACK_INTERVAL:
+        g_atomic_int_set(&self->feedback_interval, g_value_get_uint(value));
+        break;
+    case PROP_PACING:
+        g_atomic_int_set(&self->pacing, g_value_get_boolean(value));
+        break;
+    case PROP_PACING_BURST:
+        g_atomic_int_set(&self->pacing_burst, g_value_get_uint(value));
+        break;
+    case PROP_PACING_GAIN:
+        g_atomic_int_set(&self->pacing_gain, g_value_get_uint(value));
+        break;
+    case PROP_PAD_POOL_SIZE:
+        GST_OBJECT_LOCK(self);
+        self->pad_pool_size = g_value_get_uint(value);
+        while (g_queue_get_length(&self->pad_pool) > self->pad_pool_size)
+            gst_object_unref(g_queue_pop_head(&self->pad_pool));
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_DIRECT_PUSH:
+        g_atomic_int_set(&self->direct_push, g_value_get_boolean(value));
+        break;
+    case PROP_CHECKSUM:
+        self->checksum = g_value_get_enum(value);
+        break;
+    case PROP_ENGINE:
+        self->engine = g_value_get_enum(value);
+        break;
+    case PROP_MEMORY_LIMIT:
+        self->memory_limit = g_value_get_uint(value);
+        break;
+    case PROP_MEMORY_BUDGET:
+        gst_sctp_association_set_memory_budget(g_value_get_uint64(value));
+        break;
+    case PROP_COMPRESSION:
+        self->compression = g_value_get_boolean(value);
+        if (self->compression && !gst_sctp_compression_is_available())
+            GST_WARNING_OBJECT(self, "Built without zlib, messages are sent uncompressed");
+        break;
+    case PROP_COMPRESSION_THRESHOLD:
+        g_atomic_int_set(&self->compression_threshold, g_value_get_uint(value));
+        break;
+    case PROP_COMPRESSION_LEVEL:
+        g_atomic_int_set(&self->compression_level, g_value_get_int(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -325,6 +873,115 @@ static void gst_sctp_enc_get_property(GObject *object, guint prop_id, GValue *va
     case PROP_USE_SOCK_STREAM:
         g_value_set_boolean(value, self->use_sock_stream);
         break;
+    case PROP_BUNDLING_POLICY:
+        g_value_set_enum(value, self->bundling_policy);
+        break;
+    case PROP_BUNDLING_MAX_DELAY:
+        g_value_set_uint(value, self->bundling_max_delay);
+        break;
+    case PROP_SACK_DELAY:
+        g_value_set_uint(value, self->sack_delay);
+        break;
+    case PROP_SACK_FREQUENCY:
+        g_value_set_uint(value, self->sack_frequency);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        g_value_set_enum(value, self->congestion_control);
+        break;
+    case PROP_RTCC_STEADY_STEP:
+        g_value_set_uint(value, self->rtcc_steady_step);
+        break;
+    case PROP_RTCC_USE_ECN:
+        g_value_set_boolean(value, self->rtcc_use_ecn);
+        break;
+    case PROP_ECN:
+        g_value_set_boolean(value, self->ecn);
+        break;
+    case PROP_IDLE_TIMEOUT:
+        g_value_set_uint(value, self->idle_timeout);
+        break;
+    case PROP_IDLE_HEARTBEAT_INTERVAL:
+        g_value_set_uint(value, self->idle_heartbeat_interval);
+        break;
+    case PROP_IDLE:
+        GST_OBJECT_LOCK(self);
+        g_value_set_boolean(value, self->idle);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_MTU:
+        g_value_set_uint(value, self->mtu);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, create_stats(self));
+        break;
+    case PROP_TRACE_INTERVAL:
+        g_value_set_uint(value, gst_sctp_trace_get_interval(&self->trace));
+        break;
+    case PROP_LATENCY_HISTOGRAMS:
+        g_value_take_boxed(value, gst_sctp_trace_get_histograms(&self->trace));
+        break;
+    case PROP_CAPTURE_PACKETS:
+        g_value_set_uint(value, self->capture_packets);
+        break;
+    case PROP_CAPTURE_SNAPLEN:
+        g_value_set_uint(value, self->capture_snaplen);
+        break;
+    case PROP_CAPTURE_SAMPLE_INTERVAL:
+        g_value_set_uint(value, self->capture_sample_interval);
+        break;
+    case PROP_PRECONNECT_BUFFER_SIZE:
+        g_value_set_uint(value, self->preconnect_buffer_size);
+        break;
+    case PROP_SETUP_PROFILE:
+        g_value_set_enum(value, self->setup_profile);
+        break;
+    case PROP_MAX_INIT_RETRANSMITS:
+        g_value_set_uint(value, self->max_init_retransmits);
+        break;
+    case PROP_MAX_RETRANSMITS:
+        g_value_set_uint(value, self->max_retransmits);
+        break;
+    case PROP_FEEDBACK_INTERVAL:
+        g_value_set_uint(value, g_atomic_int_get(&self->feedback_interval));
+        break;
+    case PROP_PACING:
+        g_value_set_boolean(value, g_atomic_int_get(&self->pacing));
+        break;
+    case PROP_PACING_BURST:
+        g_value_set_uint(value, g_atomic_int_get(&self->pacing_burst));
+        break;
+    case PROP_PACING_GAIN:
+        g_value_set_uint(value, g_atomic_int_get(&self->pacing_gain));
+        break;
+    case PROP_PAD_POOL_SIZE:
+        GST_OBJECT_LOCK(self);
+        g_value_set_uint(value, self->pad_pool_size);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_DIRECT_PUSH:
+        g_value_set_boolean(value, g_atomic_int_get(&self->direct_push));
+        break;
+    case PROP_CHECKSUM:
+        g_value_set_enum(value, self->checksum);
+        break;
+    case PROP_ENGINE:
+        g_value_set_enum(value, self->engine);
+        break;
+    case PROP_MEMORY_LIMIT:
+        g_value_set_uint(value, self->memory_limit);
+        break;
+    case PROP_MEMORY_BUDGET:
+        g_value_set_uint64(value, gst_sctp_association_get_memory_budget());
+        break;
+    case PROP_COMPRESSION:
+        g_value_set_boolean(value, self->compression);
+        break;
+    case PROP_COMPRESSION_THRESHOLD:
+        g_value_set_uint(value, g_atomic_int_get(&self->compression_threshold));
+        break;
+    case PROP_COMPRESSION_LEVEL:
+        g_value_set_int(value, g_atomic_int_get(&self->compression_level));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -341,11 +998,18 @@ static GstPad * gst_sctp_enc_request_new_pad(GstElement *element, GstPadTemplate
     gint state;
     guint32 new_ppid;
     gboolean is_new_ppid;
+    gboolean compress;
 
     g_object_get(self->sctp_association, "state", &state, NULL);
 
-    if (state != GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
-        g_warning("The SCTP association must be established before a new stream can be created");
+    /* Streams can be set up while connecting, their data is held until the association is up */
+    if (state > GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        g_warning("New streams cannot be created on an SCTP association that is shutting down");
+        goto invalid_state;
+    }
+
+    if (!gst_sctp_association_can_open_stream(self->sctp_association)) {
+        g_warning("New streams cannot be created while the SCTP memory budget is used up");
         goto invalid_state;
     }
 
@@ -363,16 +1027,36 @@ static GstPad * gst_sctp_enc_request_new_pad(GstElement *element, GstPadTemplate
         goto invalid_parameter;
     }
 
-    new_pad = g_object_new (GST_TYPE_SCTP_ENC_PAD, "name", new_pad_name, "direction", template->direction, "template", template, NULL);
+    GST_OBJECT_LOCK(self);
+    new_pad = g_queue_pop_head(&self->pad_pool);
+    GST_OBJECT_UNLOCK(self);
+
+    if (new_pad) {
+        gst_object_set_name(GST_OBJECT(new_pad), new_pad_name);
+        sctpenc_pad = GST_SCTP_ENC_PAD(new_pad);
+        sctpenc_pad->bytes_sent = 0;
+        sctpenc_pad->messages_sent = 0;
+        sctpenc_pad->bytes_abandoned = 0;
+        sctpenc_pad->last_feedback_time = 0;
+    } else {
+        new_pad = g_object_new (GST_TYPE_SCTP_ENC_PAD, "name", new_pad_name, "direction", template->direction, "template", template, NULL);
+    }
     gst_pad_set_chain_function(new_pad, GST_DEBUG_FUNCPTR(gst_sctp_enc_sink_chain));
     gst_pad_set_event_function(new_pad, GST_DEBUG_FUNCPTR(gst_sctp_enc_sink_event));
 
     sctpenc_pad = GST_SCTP_ENC_PAD (new_pad);
     sctpenc_pad->stream_id = stream_id;
+    /* The stream may have been used by an earlier pad, its messages are counted from 0 again */
+    gst_sctp_trace_reset_stream(&self->trace, stream_id);
     sctpenc_pad->ppid = DEFAULT_SCTP_PPID;
 
+    GST_OBJECT_LOCK(self);
+    compress = self->compression;
+    GST_OBJECT_UNLOCK(self);
+
     get_config_from_caps(caps, &sctpenc_pad->ordered, &sctpenc_pad->reliability,
-        &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid);
+        &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid, &compress);
+    sctpenc_pad->compress = compress;
 
     if (is_new_ppid)
         sctpenc_pad->ppid = new_ppid;
@@ -411,41 +1095,58 @@ static void gst_sctp_enc_release_pad(GstElement *element, GstPad *pad)
     if (self->sctp_association)
         gst_sctp_association_reset_stream(self->sctp_association, stream_id);
 
+    gst_object_ref(pad);
     gst_element_remove_pad(element, pad);
+
+    /* Only a pad nobody else holds on to can come back under another name */
+    GST_OBJECT_LOCK(self);
+    if (GST_OBJECT_REFCOUNT_VALUE(pad) == 1
+        && g_queue_get_length(&self->pad_pool) < self->pad_pool_size) {
+        g_queue_push_tail(&self->pad_pool, pad);
+        pad = NULL;
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    if (pad)
+        gst_object_unref(pad);
 }
 
 static void gst_sctp_enc_srcpad_loop(GstPad *pad)
 {
     GstSctpEnc *self = GST_SCTP_ENC(GST_PAD_PARENT(pad));
     GstFlowReturn flow_ret;
-    GstDataQueueItem *item;
+    GstSctpRingItem item;
 
-    if (self->need_stream_start_caps) {
-        gchar s_id[32];
-        GstCaps *caps;
+    g_mutex_lock(&self->push_lock);
+    push_pending_events(self);
+    g_mutex_unlock(&self->push_lock);
 
-        g_snprintf(s_id, sizeof(s_id), "sctpenc-%08x", g_random_int());
-        gst_pad_push_event(self->src_pad, gst_event_new_stream_start(s_id));
-
-        caps = gst_caps_new_empty_simple("application/x-sctp");
-        gst_pad_set_caps(self->src_pad, caps);
-        gst_caps_unref(caps);
+    if (gst_sctp_ring_pop(&self->outbound_sctp_packet_queue, &item)) {
+        gboolean pacing = g_atomic_int_get(&self->pacing);
 
-        self->need_stream_start_caps = FALSE;
-    }
+        if (pacing)
+            pace_packet(self, item.size);
 
-    if (self->need_segment) {
-        GstSegment segment;
+        if (!pacing && !gst_sctp_ring_is_empty(&self->outbound_sctp_packet_queue)) {
+            GstBufferList *list = gst_buffer_list_new();
 
-        gst_segment_init(&segment, GST_FORMAT_BYTES);
-        gst_pad_push_event(self->src_pad, gst_event_new_segment(&segment));
+            /* Packets that piled up go downstream together, so a network sink can send them
+             * with one system call */
+            do {
+                gst_buffer_list_add(list, take_packet(self, &item));
+            } while (gst_buffer_list_length(list) < MAX_PACKETS_PER_LIST
+                && gst_sctp_ring_try_pop(&self->outbound_sctp_packet_queue, &item));
 
-        self->need_segment = FALSE;
-    }
+            g_mutex_lock(&self->push_lock);
+            flow_ret = gst_pad_push_list(self->src_pad, list);
+            g_mutex_unlock(&self->push_lock);
+        } else {
+            GstBuffer *buffer = take_packet(self, &item);
 
-    if (gst_data_queue_pop(self->outbound_sctp_packet_queue, &item)) {
-        flow_ret = gst_pad_push(self->src_pad, GST_BUFFER(item->object));
-        item->object = NULL;
+            g_mutex_lock(&self->push_lock);
+            flow_ret = gst_pad_push(self->src_pad, buffer);
+            g_mutex_unlock(&self->push_lock);
+        }
 
         if (G_UNLIKELY(flow_ret == GST_FLOW_FLUSHING || flow_ret == GST_FLOW_NOT_LINKED)) {
             GST_DEBUG_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
@@ -455,12 +1156,10 @@ static void gst_sctp_enc_srcpad_loop(GstPad *pad)
 
         if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
             GST_DEBUG_OBJECT(pad, "Pausing task because of an error");
-            gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, TRUE);
-            gst_data_queue_flush(self->outbound_sctp_packet_queue);
+            gst_sctp_ring_set_flushing(&self->outbound_sctp_packet_queue, TRUE);
+            gst_sctp_ring_flush(&self->outbound_sctp_packet_queue);
             gst_pad_pause_task(pad);
         }
-
-        item->destroy(item);
     } else {
         GST_DEBUG_OBJECT(pad, "Pausing task because we're flushing");
         gst_pad_pause_task(pad);
@@ -476,10 +1175,29 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
     gboolean ordered;
     GstSctpAssociationPartialReliability pr;
     guint32 pr_param;
+    guint32 context = 0;
+    GstSctpAssociationSendFlags flags = GST_SCTP_ASSOCIATION_SEND_FLAG_NONE;
     gpointer state = NULL;
     GstMeta *meta;
     const GstMetaInfo *meta_info = GST_SCTP_SEND_META_INFO;
     GstFlowReturn flow_ret = GST_FLOW_ERROR;
+    gboolean traced;
+    GstSctpSendMetaPriority priority = GST_SCTP_SEND_META_PRIORITY_LOW;
+    GstClockTime deadline = GST_CLOCK_TIME_NONE;
+    GstClockTime now;
+    gboolean expired = FALSE;
+    GstSctpEncDirectPush direct = { self, NULL };
+    gboolean direct_push;
+    GstFlowReturn push_ret;
+    guint8 *data;
+    gsize size;
+    guint8 *compressed = NULL;
+
+    traced = gst_sctp_trace_sample(&self->trace);
+    if (G_UNLIKELY(traced)) {
+        gst_sctp_trace_message_chained(&self->trace, sctpenc_pad->stream_id,
+            sctpenc_pad->messages_sent, g_get_monotonic_time());
+    }
 
     ppid = sctpenc_pad->ppid;
     ordered = sctpenc_pad->ordered;
@@ -507,34 +1225,101 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
                 pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL;
                 break;
             }
+            if (sctp_send_meta->flags & GST_SCTP_SEND_META_FLAG_URGENT)
+                flags |= GST_SCTP_ASSOCIATION_SEND_FLAG_URGENT;
+            if (sctp_send_meta->flags & GST_SCTP_SEND_META_FLAG_SACK_IMMEDIATELY)
+                flags |= GST_SCTP_ASSOCIATION_SEND_FLAG_SACK_IMMEDIATELY;
+            priority = sctp_send_meta->priority;
+            deadline = sctp_send_meta->deadline;
+            context = sctp_send_meta->context;
             break;
         }
     }
 
+    /* High priority messages are never held back behind bulk traffic for bundling */
+    if (priority >= GST_SCTP_SEND_META_PRIORITY_HIGH)
+        flags |= GST_SCTP_ASSOCIATION_SEND_FLAG_URGENT;
+
+    if (GST_CLOCK_TIME_IS_VALID(deadline)) {
+        now = get_running_time(self);
+        if (GST_CLOCK_TIME_IS_VALID(now)) {
+            if (now >= deadline) {
+                GST_LOG_OBJECT(pad, "Dropping message, its deadline has passed");
+                flow_ret = GST_FLOW_OK;
+                expired = TRUE;
+                goto error;
+            }
+
+            /* Let the stack abandon the message once it is too late as well */
+            if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE) {
+                pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL;
+                pr_param = MAX((deadline - now) / GST_MSECOND, 1);
+            }
+        }
+    }
+
+    maybe_send_feedback(self, sctpenc_pad, FALSE);
+
     if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
         g_warning("Could not map GstBuffer");
         goto error;
     }
 
+    data = map.data;
+    size = map.size;
+    /* Compressed before the send loop, so the association lock is not held meanwhile */
+    if (sctpenc_pad->compress && map.size >= (gsize) g_atomic_int_get(&self->compression_threshold)) {
+        compressed = compress_message(self, sctpenc_pad, map.data, map.size, ppid, &size);
+        if (compressed) {
+            data = compressed;
+            ppid = GST_SCTP_COMPRESSED_PPID;
+        }
+    }
+
+    /* The pacer has to see every packet, so it keeps them all on its task */
+    direct_push = g_atomic_int_get(&self->direct_push) && !g_atomic_int_get(&self->pacing);
+    if (direct_push)
+        g_private_set(&direct_push_packets, &direct);
+
     g_mutex_lock(&sctpenc_pad->lock);
     while (!sctpenc_pad->flushing) {
         gboolean data_sent = FALSE;
 
         g_mutex_unlock(&sctpenc_pad->lock);
 
-        data_sent = gst_sctp_association_send_data(self->sctp_association, map.data,
-                    map.size, sctpenc_pad->stream_id, ppid, ordered, pr, pr_param);
+        /* Leave the free send buffer space to the more important messages that are waiting */
+        if (!higher_priority_pending(self, priority)) {
+            data_sent = gst_sctp_association_send_data(self->sctp_association, data,
+                        size, sctpenc_pad->stream_id, ppid, ordered, pr, pr_param, flags,
+                        context);
+        }
 
         g_mutex_lock(&sctpenc_pad->lock);
         if (data_sent) {
+            if (G_UNLIKELY(traced)) {
+                gst_sctp_trace_message_accepted(&self->trace, sctpenc_pad->stream_id,
+                    sctpenc_pad->messages_sent, size, g_get_monotonic_time());
+            }
             sctpenc_pad->bytes_sent += map.size;
+            sctpenc_pad->messages_sent++;
             break;
         } else if (!sctpenc_pad->flushing) {
             gint64 end_time = g_get_monotonic_time() + BUFFER_FULL_SLEEP_TIME;
 
+            if (GST_CLOCK_TIME_IS_VALID(deadline)) {
+                now = get_running_time(self);
+                if (GST_CLOCK_TIME_IS_VALID(now) && now >= deadline) {
+                    GST_LOG_OBJECT(pad, "Dropping message, its deadline passed while blocked");
+                    expired = TRUE;
+                    break;
+                }
+            }
+
             /* The buffer was probably full. Retry in a while */
             GST_OBJECT_LOCK(self);
-            g_queue_push_tail(&self->pending_pads, sctpenc_pad);
+            sctpenc_pad->pending_priority = priority;
+            g_queue_insert_sorted(&self->pending_pads, sctpenc_pad,
+                (GCompareDataFunc) compare_pad_priority, NULL);
             GST_OBJECT_UNLOCK(self);
 
             g_cond_wait_until(&sctpenc_pad->cond, &sctpenc_pad->lock, end_time);
@@ -542,13 +1327,38 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
             GST_OBJECT_LOCK(self);
             g_queue_remove(&self->pending_pads, sctpenc_pad);
             GST_OBJECT_UNLOCK(self);
+
+            g_mutex_unlock(&sctpenc_pad->lock);
+            maybe_send_feedback(self, sctpenc_pad, TRUE);
+            g_mutex_lock(&sctpenc_pad->lock);
         }
     }
     flow_ret = sctpenc_pad->flushing ? GST_FLOW_FLUSHING : GST_FLOW_OK;
     g_mutex_unlock(&sctpenc_pad->lock);
 
     gst_buffer_unmap(buffer, &map);
+    g_free(compressed);
+
+    if (direct_push) {
+        g_private_set(&direct_push_packets, NULL);
+
+        /* The association lock is released again, so downstream may take its time */
+        if (direct.packets) {
+            push_ret = push_direct(self, direct.packets);
+            if (G_UNLIKELY(push_ret != GST_FLOW_OK)) {
+                GST_DEBUG_OBJECT(pad, "Direct push failed on packet source pad. Error: %s",
+                    gst_flow_get_name(push_ret));
+                if (flow_ret == GST_FLOW_OK && push_ret != GST_FLOW_NOT_LINKED)
+                    flow_ret = push_ret;
+            }
+        }
+    }
 error:
+    if (expired) {
+        GST_OBJECT_LOCK(self);
+        self->messages_expired++;
+        GST_OBJECT_UNLOCK(self);
+    }
     gst_buffer_unref(buffer);
     return flow_ret;
 }
@@ -558,16 +1368,19 @@ static gboolean gst_sctp_enc_sink_event(GstPad *pad, GstObject *parent, GstEvent
     GstSctpEncPad *sctpenc_pad = GST_SCTP_ENC_PAD(pad);
     gboolean ret, is_new_ppid;
     guint32 new_ppid;
+    gboolean compress;
 
     switch (GST_EVENT_TYPE(event)) {
     case GST_EVENT_CAPS: {
         GstCaps * caps;
 
         gst_event_parse_caps(event, &caps);
+        compress = sctpenc_pad->compress;
         get_config_from_caps(caps, &sctpenc_pad->ordered, &sctpenc_pad->reliability,
-            &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid);
+            &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid, &compress);
         if (is_new_ppid)
             sctpenc_pad->ppid = new_ppid;
+        sctpenc_pad->compress = compress;
         gst_event_unref(event);
         ret = TRUE;
         break;
@@ -626,8 +1439,9 @@ static gboolean gst_sctp_enc_src_event(GstPad *pad, GstObject *parent, GstEvent
     case GST_EVENT_FLUSH_START: {
         GstIterator *it;
 
-        gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, TRUE);
-        gst_data_queue_flush(self->outbound_sctp_packet_queue);
+        gst_sctp_ring_set_flushing(&self->outbound_sctp_packet_queue, TRUE);
+        gst_sctp_ring_flush(&self->outbound_sctp_packet_queue);
+        set_pacing_flushing(self, TRUE);
 
         it = gst_element_iterate_sink_pads(GST_ELEMENT(self));
         while (gst_iterator_foreach(it, flush_sinkpad, GINT_TO_POINTER(TRUE)) == GST_ITERATOR_RESYNC)
@@ -646,8 +1460,11 @@ static gboolean gst_sctp_enc_src_event(GstPad *pad, GstObject *parent, GstEvent
             gst_iterator_resync(it);
         gst_iterator_free(it);
 
-        gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, FALSE);
+        gst_sctp_ring_set_flushing(&self->outbound_sctp_packet_queue, FALSE);
+        set_pacing_flushing(self, FALSE);
+        g_mutex_lock(&self->push_lock);
         self->need_segment = TRUE;
+        g_mutex_unlock(&self->push_lock);
         gst_pad_start_task(self->src_pad, (GstTaskFunction)gst_sctp_enc_srcpad_loop, self->src_pad,
             NULL);
 
@@ -665,14 +1482,18 @@ static gboolean configure_association(GstSctpEnc *self)
 {
     gint state;
 
+    GST_OBJECT_LOCK(self);
     self->sctp_association = gst_sctp_association_get(self->sctp_association_id);
+    GST_OBJECT_UNLOCK(self);
 
     g_object_get(self->sctp_association, "state", &state, NULL);
 
     if (state != GST_SCTP_ASSOCIATION_STATE_NEW) {
         GST_WARNING_OBJECT(self, "Could not configure SCTP association. Association already in use!");
+        GST_OBJECT_LOCK(self);
         g_object_unref(self->sctp_association);
         self->sctp_association = NULL;
+        GST_OBJECT_UNLOCK(self);
         return FALSE;
     }
 
@@ -685,6 +1506,66 @@ static gboolean configure_association(GstSctpEnc *self)
     g_object_bind_property(self, "use-sock-stream", self->sctp_association, "use-sock-stream",
         G_BINDING_SYNC_CREATE);
 
+    g_object_bind_property(self, "bundling-policy", self->sctp_association, "bundling-policy",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "bundling-max-delay", self->sctp_association, "bundling-max-delay",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "sack-delay", self->sctp_association, "sack-delay",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "sack-frequency", self->sctp_association, "sack-frequency",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "congestion-control", self->sctp_association,
+        "congestion-control", G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "rtcc-steady-step", self->sctp_association, "rtcc-steady-step",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "rtcc-use-ecn", self->sctp_association, "rtcc-use-ecn",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "ecn", self->sctp_association, "ecn", G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "idle-timeout", self->sctp_association, "idle-timeout",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "idle-heartbeat-interval", self->sctp_association,
+        "idle-heartbeat-interval", G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "mtu", self->sctp_association, "mtu", G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "capture-packets", self->sctp_association, "capture-packets",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "capture-snaplen", self->sctp_association, "capture-snaplen",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "capture-sample-interval", self->sctp_association,
+        "capture-sample-interval", G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "preconnect-buffer-size", self->sctp_association,
+        "preconnect-buffer-size", G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "setup-profile", self->sctp_association, "setup-profile",
+        G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "max-init-retransmits", self->sctp_association,
+        "max-init-retransmits", G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "max-retransmits", self->sctp_association, "max-retransmits",
+        G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "checksum", self->sctp_association, "checksum",
+        G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "engine", self->sctp_association, "engine",
+        G_BINDING_SYNC_CREATE);
+    g_object_bind_property(self, "memory-limit", self->sctp_association, "memory-limit",
+        G_BINDING_SYNC_CREATE);
+
+    self->signal_handler_idle_changed = g_signal_connect_object(self->sctp_association,
+        "notify::idle", G_CALLBACK(on_sctp_association_idle_changed), self, 0);
+
+    self->signal_handler_send_failed = g_signal_connect_object(self->sctp_association,
+        "send-failed", G_CALLBACK(on_sctp_association_send_failed), self, 0);
+
     gst_sctp_association_set_on_packet_out(self->sctp_association, on_sctp_packet_out, self);
 
     return TRUE;
@@ -708,49 +1589,120 @@ static void on_sctp_association_state_changed(GstSctpAssociation *sctp_associati
         g_signal_emit_by_name(self, "sctp-association-established", TRUE);
         break;
     case GST_SCTP_ASSOCIATION_STATE_DISCONNECTING:
-        g_signal_emit(self, signals[SIGNAL_SCTP_ASSOCIATION_ESTABLISHED], 0, FALSE);
-        break;
     case GST_SCTP_ASSOCIATION_STATE_DISCONNECTED:
+        g_signal_emit(self, signals[SIGNAL_SCTP_ASSOCIATION_ESTABLISHED], 0, FALSE);
         break;
     case GST_SCTP_ASSOCIATION_STATE_ERROR:
         break;
     }
 }
 
-static void data_queue_item_free(GstDataQueueItem *item)
+static void on_sctp_association_idle_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
+    GstSctpEnc *self)
+{
+    gboolean idle;
+
+    g_object_get(sctp_association, "idle", &idle, NULL);
+    GST_DEBUG_OBJECT(self, "SCTP association is %s", idle ? "idle" : "active");
+
+    GST_OBJECT_LOCK(self);
+    self->idle = idle;
+    GST_OBJECT_UNLOCK(self);
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_IDLE]);
+}
+
+static void on_sctp_association_send_failed(GstSctpAssociation *sctp_association, guint stream_id,
+    guint ppid, guint length, guint context, gboolean sent, GstSctpEnc *self)
 {
-    if (item->object)
-        gst_mini_object_unref(item->object);
-    g_free(item);
+    gchar *pad_name;
+    GstPad *pad;
+    GstSctpEncPad *sctpenc_pad;
+
+    GST_LOG_OBJECT(self, "%u bytes with ppid %u abandoned on stream %u", length, ppid, stream_id);
+
+    if (!sent && G_UNLIKELY(gst_sctp_trace_is_enabled(&self->trace)))
+        gst_sctp_trace_message_dropped(&self->trace, stream_id);
+
+    pad_name = g_strdup_printf("sink_%u", stream_id);
+    pad = gst_element_get_static_pad(GST_ELEMENT(self), pad_name);
+    g_free(pad_name);
+
+    /* The stream may be gone already, the message is reported all the same */
+    if (pad) {
+        sctpenc_pad = GST_SCTP_ENC_PAD(pad);
+        g_mutex_lock(&sctpenc_pad->lock);
+        sctpenc_pad->bytes_abandoned += length;
+        g_mutex_unlock(&sctpenc_pad->lock);
+        gst_object_unref(pad);
+    }
+
+    g_signal_emit(self, signals[SIGNAL_MESSAGE_ABANDONED], 0, stream_id, ppid, length, context,
+        sent);
 }
 
 static void on_sctp_packet_out(GstSctpAssociation *_association, const guint8 *buf, gsize length,
-    gpointer user_data)
+    guint8 tos, gboolean set_df, gpointer user_data)
 {
     GstSctpEnc *self = user_data;
     GstBuffer *gstbuf;
-    GstDataQueueItem *item;
+    GstSctpRingItem item = { NULL, };
+    gboolean queued;
     GList *pending_pads, *l;
     GstSctpEncPad *sctpenc_pad;
+    GstSctpEncDirectPush *direct;
 
     gstbuf = gst_buffer_new_wrapped(g_memdup(buf, length), length);
+    gst_sctp_buffer_add_packet_meta(gstbuf, tos, set_df);
+
+    /* Sent for a message of a sink pad in direct push mode, the pad pushes it itself once
+     * the send returned. Such packets never wait in the queue, so they only feed the tracer
+     * its TSNs. */
+    direct = g_private_get(&direct_push_packets);
+    if (direct && direct->self == self) {
+        if (G_UNLIKELY(gst_sctp_trace_is_enabled(&self->trace))) {
+            guint16 stream_id;
+
+            gst_sctp_trace_packet_emitted(&self->trace, buf, length, g_get_monotonic_time(),
+                &stream_id);
+        }
+        if (!direct->packets)
+            direct->packets = gst_buffer_list_new();
+        gst_buffer_list_add(direct->packets, gstbuf);
+        goto wake_pending_pads;
+    }
 
-    item = g_new0(GstDataQueueItem, 1);
-    item->object = GST_MINI_OBJECT(gstbuf);
-    item->size = length;
-    item->visible = TRUE;
-    item->destroy = (GDestroyNotify) data_queue_item_free;
-
-    if (!gst_data_queue_push(self->outbound_sctp_packet_queue, item)) {
-        item->destroy(item);
+    if (G_UNLIKELY(gst_sctp_trace_is_enabled(&self->trace))) {
+        item.queued_time = g_get_monotonic_time();
+        item.traced = gst_sctp_trace_packet_emitted(&self->trace, buf, length,
+            item.queued_time, &item.stream_id);
+    }
+    item.object = GST_MINI_OBJECT(gstbuf);
+    item.size = length;
+
+    /* The stack sends from the streaming threads and from its timer thread, the ring only
+     * takes one producer at a time */
+    g_mutex_lock(&self->outbound_push_lock);
+    queued = gst_sctp_ring_push(&self->outbound_sctp_packet_queue, &item);
+    g_mutex_unlock(&self->outbound_push_lock);
+    if (!queued) {
+        gst_buffer_unref(gstbuf);
         GST_DEBUG_OBJECT(self, "Failed to push item because we're flushing");
     }
 
-    /* Wake up pads in the order they waited, oldest pad first */
+wake_pending_pads:
+    /* Wake up the pads of the highest waiting priority in the order they waited. The others
+     * wait for the next packet so they do not take the space first. */
     GST_OBJECT_LOCK(self);
     pending_pads = NULL;
-    while ((sctpenc_pad = g_queue_pop_tail(&self->pending_pads))) {
-        pending_pads = g_list_prepend(pending_pads, sctpenc_pad);
+    sctpenc_pad = g_queue_peek_head(&self->pending_pads);
+    if (sctpenc_pad) {
+        GstSctpSendMetaPriority priority = sctpenc_pad->pending_priority;
+
+        while ((sctpenc_pad = g_queue_peek_head(&self->pending_pads))
+            && sctpenc_pad->pending_priority == priority) {
+            pending_pads = g_list_prepend(pending_pads, g_queue_pop_head(&self->pending_pads));
+        }
+        pending_pads = g_list_reverse(pending_pads);
     }
     GST_OBJECT_UNLOCK(self);
 
@@ -763,10 +1715,57 @@ static void on_sctp_packet_out(GstSctpAssociation *_association, const guint8 *b
     g_list_free(pending_pads);
 }
 
+/* Takes the packet out of a popped queue item */
+static GstBuffer *take_packet(GstSctpEnc *self, GstSctpRingItem *item)
+{
+    GstBuffer *buffer = GST_BUFFER(item->object);
+
+    if (G_UNLIKELY(item->traced)) {
+        gst_sctp_trace_record(&self->trace, item->stream_id,
+            GST_SCTP_TRACE_INTERVAL_OUTBOUND_QUEUED, item->queued_time,
+            g_get_monotonic_time());
+    }
+    item->object = NULL;
+
+    return buffer;
+}
+
+/* Ends the association while the source pad still carries the ABORT or SHUTDOWN, the peer would
+ * otherwise only notice once its heartbeats fail */
+static void close_association(GstSctpEnc *self)
+{
+    GstSctpEncDirectPush direct = { self, NULL };
+
+    g_private_set(&direct_push_packets, &direct);
+    gst_sctp_association_force_close(self->sctp_association);
+    g_private_set(&direct_push_packets, NULL);
+
+    if (direct.packets)
+        push_direct(self, direct.packets);
+}
+
+static GstStateChangeReturn gst_sctp_enc_change_state(GstElement *element,
+    GstStateChange transition)
+{
+    GstSctpEnc *self = GST_SCTP_ENC(element);
+
+    switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        if (self->sctp_association)
+            close_association(self);
+        break;
+    default:
+        break;
+    }
+
+    return GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+}
+
 static void stop_srcpad_task(GstPad *pad, GstSctpEnc *self)
 {
-    gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, TRUE);
-    gst_data_queue_flush(self->outbound_sctp_packet_queue);
+    gst_sctp_ring_set_flushing(&self->outbound_sctp_packet_queue, TRUE);
+    gst_sctp_ring_flush(&self->outbound_sctp_packet_queue);
+    set_pacing_flushing(self, TRUE);
     gst_pad_stop_task(pad);
 }
 
@@ -783,10 +1782,14 @@ static void sctpenc_cleanup(GstSctpEnc *self)
     GstIterator *it;
 
     g_signal_handler_disconnect(self->sctp_association, self->signal_handler_state_changed);
+    g_signal_handler_disconnect(self->sctp_association, self->signal_handler_idle_changed);
+    g_signal_handler_disconnect(self->sctp_association, self->signal_handler_send_failed);
     stop_srcpad_task(self->src_pad, self);
     gst_sctp_association_force_close(self->sctp_association);
+    GST_OBJECT_LOCK(self);
     g_object_unref(self->sctp_association);
     self->sctp_association = NULL;
+    GST_OBJECT_UNLOCK(self);
 
     it = gst_element_iterate_sink_pads(GST_ELEMENT(self));
     while (gst_iterator_foreach(it, remove_sinkpad, self) == GST_ITERATOR_RESYNC)
@@ -797,7 +1800,7 @@ static void sctpenc_cleanup(GstSctpEnc *self)
 
 static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
     GstSctpAssociationPartialReliability *reliability, guint32 *reliability_param, guint32 *ppid,
-    gboolean *ppid_available)
+    gboolean *ppid_available, gboolean *compress)
 {
     GstStructure *s;
     guint i, n;
@@ -839,6 +1842,10 @@ static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
             *ppid = g_value_get_uint(v);
             *ppid_available = TRUE;
         }
+        if (gst_structure_has_field(s, "compress")) {
+            const GValue *v = gst_structure_get_value(s, "compress");
+            *compress = g_value_get_boolean(v);
+        }
     }
 }
 
@@ -868,3 +1875,382 @@ static guint64 on_get_stream_bytes_sent(GstSctpEnc *self, guint stream_id)
 
     return bytes_sent;
 }
+
+static guint64 on_get_stream_bytes_abandoned(GstSctpEnc *self, guint stream_id)
+{
+    gchar *pad_name;
+    GstPad *pad;
+    GstSctpEncPad *sctpenc_pad;
+    guint64 bytes_abandoned;
+
+    pad_name = g_strdup_printf("sink_%u", stream_id);
+    pad = gst_element_get_static_pad(GST_ELEMENT(self), pad_name);
+    g_free(pad_name);
+
+    if (!pad) {
+        GST_DEBUG_OBJECT(self, "Abandoned bytes requested on a stream that does not exist!");
+        return 0;
+    }
+
+    sctpenc_pad = GST_SCTP_ENC_PAD(pad);
+
+    g_mutex_lock(&sctpenc_pad->lock);
+    bytes_abandoned = sctpenc_pad->bytes_abandoned;
+    g_mutex_unlock(&sctpenc_pad->lock);
+
+    gst_object_unref(sctpenc_pad);
+
+    return bytes_abandoned;
+}
+
+/* Called from the streaming thread of the pad, which owns its deflater */
+static guint8 *compress_message(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, const guint8 *data,
+    gsize length, guint32 ppid, gsize *compressed_length)
+{
+    GstSctpCompressionStats stats = { 0, };
+    gint level = g_atomic_int_get(&self->compression_level);
+    guint8 *compressed;
+
+    if (sctpenc_pad->deflater && sctpenc_pad->deflater_level != level) {
+        gst_sctp_deflater_free(sctpenc_pad->deflater);
+        sctpenc_pad->deflater = NULL;
+    }
+    if (!sctpenc_pad->deflater) {
+        sctpenc_pad->deflater = gst_sctp_deflater_new(level);
+        sctpenc_pad->deflater_level = level;
+        if (!sctpenc_pad->deflater)
+            return NULL;
+    }
+
+    compressed = gst_sctp_deflater_compress(sctpenc_pad->deflater, data, length, ppid,
+        compressed_length, &stats);
+    if (!compressed)
+        GST_LOG_OBJECT(sctpenc_pad, "Message of %" G_GSIZE_FORMAT " bytes does not compress", length);
+
+    GST_OBJECT_LOCK(self);
+    self->compression_stats.messages += stats.messages;
+    self->compression_stats.bytes_in += stats.bytes_in;
+    self->compression_stats.bytes_out += stats.bytes_out;
+    self->compression_stats.cpu_time += stats.cpu_time;
+    GST_OBJECT_UNLOCK(self);
+
+    return compressed;
+}
+
+static GstStructure *create_stats(GstSctpEnc *self)
+{
+    GstSctpAssociation *association = NULL;
+    GstSctpAssociationStats stats;
+    guint64 messages_expired;
+    guint64 pacing_rate;
+    guint64 packets_paced;
+    GstSctpCompressionStats compression;
+
+    GST_OBJECT_LOCK(self);
+    if (self->sctp_association)
+        association = g_object_ref(self->sctp_association);
+    GST_OBJECT_UNLOCK(self);
+
+    memset(&stats, 0, sizeof(GstSctpAssociationStats));
+    if (association) {
+        gst_sctp_association_get_stats(association, &stats);
+        g_object_unref(association);
+    }
+
+    GST_OBJECT_LOCK(self);
+    messages_expired = self->messages_expired;
+    pacing_rate = self->pacing_rate;
+    packets_paced = self->packets_paced;
+    compression = self->compression_stats;
+    GST_OBJECT_UNLOCK(self);
+
+    return gst_structure_new("application/x-sctp-stats",
+        "messages-sent", G_TYPE_UINT64, stats.messages_sent,
+        "messages-expired", G_TYPE_UINT64, messages_expired,
+        "bytes-sent", G_TYPE_UINT64, stats.bytes_sent,
+        "messages-received", G_TYPE_UINT64, stats.messages_received,
+        "bytes-received", G_TYPE_UINT64, stats.bytes_received,
+        "packets-sent", G_TYPE_UINT64, stats.packets_sent,
+        "packets-received", G_TYPE_UINT64, stats.packets_received,
+        "checksum-errors", G_TYPE_UINT64, stats.checksum_errors,
+        "messages-abandoned", G_TYPE_UINT64, stats.messages_abandoned,
+        "bytes-abandoned", G_TYPE_UINT64, stats.bytes_abandoned,
+        "srtt", G_TYPE_UINT, stats.srtt,
+        "rto", G_TYPE_UINT, stats.rto,
+        "cwnd", G_TYPE_UINT, stats.cwnd,
+        "peer-rwnd", G_TYPE_UINT, stats.peer_rwnd,
+        "unacked-chunks", G_TYPE_UINT, stats.unacked_chunks,
+        "pending-chunks", G_TYPE_UINT, stats.pending_chunks,
+        "buffered-amount", G_TYPE_UINT64, stats.buffered_amount,
+        "receive-buffered-amount", G_TYPE_UINT64, stats.receive_buffered_amount,
+        "send-buffer-size", G_TYPE_UINT, stats.send_buffer_size,
+        "receive-buffer-size", G_TYPE_UINT, stats.receive_buffer_size,
+        "memory-committed", G_TYPE_UINT64, stats.memory_committed,
+        "memory-budget", G_TYPE_UINT64, stats.memory_budget,
+        "pacing-rate", G_TYPE_UINT64, pacing_rate * 8,
+        "packets-paced", G_TYPE_UINT64, packets_paced,
+        "messages-compressed", G_TYPE_UINT64, compression.messages,
+        "compression-bytes-in", G_TYPE_UINT64, compression.bytes_in,
+        "compression-bytes-out", G_TYPE_UINT64, compression.bytes_out,
+        "compression-ratio", G_TYPE_DOUBLE, compression.bytes_out ?
+            (gdouble) compression.bytes_in / compression.bytes_out : 0.0,
+        "compression-cpu-time", G_TYPE_UINT64, compression.cpu_time,
+        "time-to-connected", G_TYPE_UINT64, stats.time_to_connected,
+        "stack-data-chunks-sent", G_TYPE_UINT64, stats.stack_data_chunks_sent,
+        "stack-data-chunks-retransmitted", G_TYPE_UINT64, stats.stack_data_chunks_retransmitted,
+        "stack-fast-retransmits", G_TYPE_UINT64, stats.stack_fast_retransmits,
+        "stack-t3-timeouts", G_TYPE_UINT64, stats.stack_t3_timeouts,
+        "stack-init-timeouts", G_TYPE_UINT64, stats.stack_init_timeouts,
+        NULL);
+}
+
+static gboolean on_dump_capture(GstSctpEnc *self, const gchar *location)
+{
+    GstSctpAssociation *association = NULL;
+    GBytes *capture;
+    GError *error = NULL;
+    gconstpointer data;
+    gsize size;
+    gboolean ret;
+
+    GST_OBJECT_LOCK(self);
+    if (self->sctp_association)
+        association = g_object_ref(self->sctp_association);
+    GST_OBJECT_UNLOCK(self);
+
+    if (!association) {
+        GST_WARNING_OBJECT(self, "No SCTP association to dump the capture of");
+        return FALSE;
+    }
+
+    capture = gst_sctp_association_get_capture(association);
+    g_object_unref(association);
+
+    data = g_bytes_get_data(capture, &size);
+    ret = g_file_set_contents(location, data, size, &error);
+    if (!ret) {
+        GST_WARNING_OBJECT(self, "Could not write the capture to %s: %s", location,
+            error->message);
+        g_error_free(error);
+    }
+    g_bytes_unref(capture);
+
+    return ret;
+}
+
+static GstClockTime get_running_time(GstSctpEnc *self)
+{
+    GstClock *clock;
+    GstClockTime now;
+
+    clock = gst_element_get_clock(GST_ELEMENT(self));
+    if (!clock)
+        return GST_CLOCK_TIME_NONE;
+
+    now = gst_clock_get_time(clock) - gst_element_get_base_time(GST_ELEMENT(self));
+    gst_object_unref(clock);
+
+    return now;
+}
+
+/* Keeps pending_pads sorted by priority, pads of the same priority in the order they waited */
+static gint compare_pad_priority(GstSctpEncPad *a, GstSctpEncPad *b, gpointer user_data)
+{
+    return a->pending_priority >= b->pending_priority ? -1 : 1;
+}
+
+static gboolean higher_priority_pending(GstSctpEnc *self, GstSctpSendMetaPriority priority)
+{
+    GstSctpEncPad *head;
+    gboolean ret;
+
+    GST_OBJECT_LOCK(self);
+    head = g_queue_peek_head(&self->pending_pads);
+    ret = head && head->pending_priority > priority;
+    GST_OBJECT_UNLOCK(self);
+
+    return ret;
+}
+
+/* Called from the streaming thread of the pad, without its lock */
+static void maybe_send_feedback(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, gboolean blocked)
+{
+    GstSctpAssociationStats stats;
+    GstStructure *feedback;
+    guint interval;
+    guint blocked_pads;
+    guint64 messages_expired;
+    guint64 available_rate;
+    gint64 now;
+
+    interval = g_atomic_int_get(&self->feedback_interval);
+    if (G_LIKELY(!interval))
+        return;
+
+    now = g_get_monotonic_time();
+    if (now - sctpenc_pad->last_feedback_time < (gint64) interval * G_TIME_SPAN_MILLISECOND)
+        return;
+    sctpenc_pad->last_feedback_time = now;
+
+    gst_sctp_association_get_stats(self->sctp_association, &stats);
+
+    GST_OBJECT_LOCK(self);
+    messages_expired = self->messages_expired;
+    blocked_pads = g_queue_get_length(&self->pending_pads);
+    GST_OBJECT_UNLOCK(self);
+
+    /* The congestion window can be sent once per round trip */
+    available_rate = stats.srtt ? (guint64) stats.cwnd * 8 * 1000 / stats.srtt : 0;
+
+    feedback = gst_structure_new("application/x-sctp-congestion-feedback",
+        "stream-id", G_TYPE_UINT, (guint) sctpenc_pad->stream_id,
+        "available-rate", G_TYPE_UINT64, available_rate,
+        "srtt", G_TYPE_UINT, stats.srtt,
+        "cwnd", G_TYPE_UINT, stats.cwnd,
+        "buffered-amount", G_TYPE_UINT64, stats.buffered_amount,
+        "messages-expired", G_TYPE_UINT64, messages_expired,
+        "blocked-pads", G_TYPE_UINT, blocked_pads,
+        "blocked", G_TYPE_BOOLEAN, blocked,
+        NULL);
+
+    GST_LOG_OBJECT(sctpenc_pad, "Sending congestion feedback %" GST_PTR_FORMAT, feedback);
+    gst_pad_push_event(GST_PAD(sctpenc_pad), gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM,
+        feedback));
+}
+
+/* Sends stream-start, caps and segment ahead of the first packet, from whichever thread pushes
+ * it. Called with the push lock. */
+static void push_pending_events(GstSctpEnc *self)
+{
+    if (self->need_stream_start_caps) {
+        gchar s_id[32];
+        GstCaps *caps;
+
+        g_snprintf(s_id, sizeof(s_id), "sctpenc-%08x", g_random_int());
+        gst_pad_push_event(self->src_pad, gst_event_new_stream_start(s_id));
+
+        caps = gst_caps_new_empty_simple("application/x-sctp");
+        gst_pad_set_caps(self->src_pad, caps);
+        gst_caps_unref(caps);
+
+        self->need_stream_start_caps = FALSE;
+    }
+
+    if (self->need_segment) {
+        GstSegment segment;
+
+        gst_segment_init(&segment, GST_FORMAT_BYTES);
+        gst_pad_push_event(self->src_pad, gst_event_new_segment(&segment));
+
+        self->need_segment = FALSE;
+    }
+}
+
+/* Takes the list */
+static GstFlowReturn push_direct(GstSctpEnc *self, GstBufferList *packets)
+{
+    GstFlowReturn flow_ret;
+
+    g_mutex_lock(&self->push_lock);
+    push_pending_events(self);
+    if (gst_buffer_list_length(packets) == 1) {
+        flow_ret = gst_pad_push(self->src_pad, gst_buffer_ref(gst_buffer_list_get(packets, 0)));
+        gst_buffer_list_unref(packets);
+    } else {
+        flow_ret = gst_pad_push_list(self->src_pad, packets);
+    }
+    g_mutex_unlock(&self->push_lock);
+
+    return flow_ret;
+}
+
+/* Unblocks the source pad task when it waits for the pacer */
+static void set_pacing_flushing(GstSctpEnc *self, gboolean flushing)
+{
+    GST_OBJECT_LOCK(self);
+    self->pacing_flushing = flushing;
+    if (flushing && self->pacing_clock_id)
+        gst_clock_id_unschedule(self->pacing_clock_id);
+    /* The task is not running when it is restarted, start with a full bucket */
+    if (!flushing) {
+        self->pacing_last_time = GST_CLOCK_TIME_NONE;
+        self->pacing_rate_time = GST_CLOCK_TIME_NONE;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+/* Token bucket in bytes, refilled at the pacing rate and capped at pacing-burst. Called from the
+ * source pad task only, so the bucket itself needs no locking. */
+static void pace_packet(GstSctpEnc *self, gsize size)
+{
+    GstClock *clock;
+    GstClockTime now, wait;
+    GstClockID clock_id;
+    guint32 cwnd, srtt;
+    gint64 burst;
+
+    clock = gst_element_get_clock(GST_ELEMENT(self));
+    if (!clock)
+        return;
+    now = gst_clock_get_time(clock);
+
+    if (!GST_CLOCK_TIME_IS_VALID(self->pacing_rate_time)
+        || now - self->pacing_rate_time >= PACING_RATE_UPDATE_INTERVAL) {
+        guint64 rate = 0;
+
+        /* No pacing before the first round trip has been measured */
+        if (gst_sctp_association_get_congestion_window(self->sctp_association, &cwnd, &srtt)
+            && srtt) {
+            rate = (guint64) cwnd * 1000 / srtt * g_atomic_int_get(&self->pacing_gain) / 100;
+        }
+
+        GST_OBJECT_LOCK(self);
+        self->pacing_rate = rate;
+        GST_OBJECT_UNLOCK(self);
+        self->pacing_rate_time = now;
+    }
+
+    if (!self->pacing_rate)
+        goto done;
+
+    burst = g_atomic_int_get(&self->pacing_burst);
+    if (GST_CLOCK_TIME_IS_VALID(self->pacing_last_time)) {
+        self->pacing_tokens += gst_util_uint64_scale(now - self->pacing_last_time,
+            self->pacing_rate, GST_SECOND);
+        self->pacing_tokens = MIN(self->pacing_tokens, burst);
+    } else {
+        self->pacing_tokens = burst;
+    }
+    self->pacing_last_time = now;
+
+    if (self->pacing_tokens < (gint64) size) {
+        wait = gst_util_uint64_scale_ceil(size - self->pacing_tokens, GST_SECOND,
+            self->pacing_rate);
+        clock_id = gst_clock_new_single_shot_id(clock, now + wait);
+
+        GST_OBJECT_LOCK(self);
+        if (self->pacing_flushing) {
+            GST_OBJECT_UNLOCK(self);
+            gst_clock_id_unref(clock_id);
+            goto done;
+        }
+        self->pacing_clock_id = clock_id;
+        self->packets_paced++;
+        GST_OBJECT_UNLOCK(self);
+
+        gst_clock_id_wait(clock_id, NULL);
+
+        GST_OBJECT_LOCK(self);
+        self->pacing_clock_id = NULL;
+        GST_OBJECT_UNLOCK(self);
+        gst_clock_id_unref(clock_id);
+
+        /* The wait earned exactly the missing tokens */
+        self->pacing_tokens = size;
+        self->pacing_last_time = now + wait;
+    }
+    self->pacing_tokens -= size;
+
+done:
+    gst_object_unref(clock);
+}
@@ -27,8 +27,10 @@
 #define gstsctpenc_h
 
 #include <gst/gst.h>
-#include <gst/base/base.h>
 #include "sctpassociation.h"
+#include "gstsctptrace.h"
+#include "gstsctpring.h"
+#include "sctpcompression.h"
 
 G_BEGIN_DECLS
 
@@ -46,17 +48,71 @@ struct _GstSctpEnc {
     GstElement element;
 
     GstPad *src_pad;
+    /* Serializes pushes on the source pad between its task and the direct pushes, also
+     * protects need_stream_start_caps and need_segment */
+    GMutex push_lock;
     gboolean need_stream_start_caps, need_segment;
     guint32 sctp_association_id;
     guint16 remote_sctp_port;
     gboolean use_sock_stream;
+    GstSctpAssociationBundlingPolicy bundling_policy;
+    guint bundling_max_delay;
+    guint sack_delay;
+    guint sack_frequency;
+    GstSctpAssociationCongestionControl congestion_control;
+    guint rtcc_steady_step;
+    gboolean rtcc_use_ecn;
+    gboolean ecn;
+    guint idle_timeout;
+    guint idle_heartbeat_interval;
+    gboolean idle;
+    guint mtu;
+    guint capture_packets;
+    guint capture_snaplen;
+    guint capture_sample_interval;
+    guint preconnect_buffer_size;
+    GstSctpAssociationSetupProfile setup_profile;
+    guint max_init_retransmits;
+    guint max_retransmits;
+    gint feedback_interval;
+    gint pacing;
+    gint pacing_burst;
+    gint pacing_gain;
+    guint pad_pool_size;
+    gint direct_push;
+    GstSctpAssociationChecksum checksum;
+    guint memory_limit;
+    gboolean compression;
+    gint compression_threshold;
+    gint compression_level;
+    GstSctpAssociationEngine engine;
 
     GstSctpAssociation *sctp_association;
-    GstDataQueue *outbound_sctp_packet_queue;
+    GstSctpRing outbound_sctp_packet_queue;
+    GMutex outbound_push_lock;
 
+    /* Pads waiting for send buffer space, highest priority first */
     GQueue pending_pads;
+    guint64 messages_expired;
+    GstSctpCompressionStats compression_stats;
+    /* Released sink pads kept for reuse, protected by the object lock */
+    GQueue pad_pool;
+
+    /* Pacer state, owned by the source pad task. The rate, the counter, the clock id and the
+     * flushing flag are shared and protected by the object lock. */
+    guint64 pacing_rate;
+    gint64 pacing_tokens;
+    GstClockTime pacing_last_time;
+    GstClockTime pacing_rate_time;
+    GstClockID pacing_clock_id;
+    gboolean pacing_flushing;
+    guint64 packets_paced;
 
     gulong signal_handler_state_changed;
+    gulong signal_handler_idle_changed;
+    gulong signal_handler_send_failed;
+
+    GstSctpTrace trace;
 };
 
 struct _GstSctpEncClass {
@@ -64,6 +120,10 @@ struct _GstSctpEncClass {
 
     void (*on_sctp_association_is_established)(GstSctpEnc *sctp_enc, gboolean established);
     guint64 (*on_get_stream_bytes_sent)(GstSctpEnc *sctp_enc, guint stream_id);
+    gboolean (*on_dump_capture)(GstSctpEnc *sctp_enc, const gchar *location);
+    void (*on_message_abandoned)(GstSctpEnc *sctp_enc, guint stream_id, guint ppid, guint length,
+        guint context, gboolean sent);
+    guint64 (*on_get_stream_bytes_abandoned)(GstSctpEnc *sctp_enc, guint stream_id);
 
 };
 
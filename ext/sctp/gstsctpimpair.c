@@ -0,0 +1,665 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * sctpimpair sits between sctpenc and sctpdec and emulates a network path, so SCTP behaviour can
+ * be measured without network access:
+ *
+ *   sctpenc ! sctpimpair rate=2000000 delay=40 jitter=5 good-to-bad=0.01 ! sctpdec
+ *
+ * Loss follows a Gilbert-Elliott model with a good and a bad state, the bandwidth is capped by a
+ * token bucket with a drop-tail queue, and packets can be delayed, jittered, reordered and
+ * duplicated. All random decisions are drawn from one generator seeded by the seed property, so
+ * the same input gives the same output.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpimpair.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_sctp_impair_debug_category);
+#define GST_CAT_DEFAULT gst_sctp_impair_debug_category
+
+#define gst_sctp_impair_parent_class parent_class
+G_DEFINE_TYPE(GstSctpImpair, gst_sctp_impair, GST_TYPE_ELEMENT);
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+enum {
+    PROP_0,
+
+    PROP_SEED,
+    PROP_GOOD_TO_BAD,
+    PROP_BAD_TO_GOOD,
+    PROP_LOSS_GOOD,
+    PROP_LOSS_BAD,
+    PROP_RATE,
+    PROP_BURST,
+    PROP_MAX_QUEUE_BYTES,
+    PROP_DELAY,
+    PROP_JITTER,
+    PROP_REORDER,
+    PROP_DUPLICATE,
+    PROP_STATS,
+
+    NUM_PROPERTIES
+};
+
+static GParamSpec *properties[NUM_PROPERTIES];
+
+#define DEFAULT_SEED 0
+#define DEFAULT_GOOD_TO_BAD 0.0
+#define DEFAULT_BAD_TO_GOOD 1.0
+#define DEFAULT_LOSS_GOOD 0.0
+#define DEFAULT_LOSS_BAD 1.0
+#define DEFAULT_RATE 0
+#define DEFAULT_BURST 15000
+#define DEFAULT_MAX_QUEUE_BYTES 262144
+#define DEFAULT_DELAY 0
+#define DEFAULT_JITTER 0
+#define DEFAULT_REORDER 0.0
+#define DEFAULT_DUPLICATE 0.0
+
+typedef struct {
+    GstMiniObject *object;
+    gint64 release_time;
+} ImpairItem;
+
+static void gst_sctp_impair_finalize(GObject *object);
+static void gst_sctp_impair_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec);
+static void gst_sctp_impair_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec);
+static gboolean gst_sctp_impair_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active);
+static GstFlowReturn gst_sctp_impair_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static gboolean gst_sctp_impair_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
+static void gst_sctp_impair_srcpad_loop(GstPad *pad);
+
+static void reset_path(GstSctpImpair *self);
+static void enqueue(GstSctpImpair *self, GstMiniObject *object, gint64 release_time);
+static void flush_queue(GstSctpImpair *self);
+static GstStructure *create_stats(GstSctpImpair *self);
+
+static void gst_sctp_impair_class_init(GstSctpImpairClass *klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *element_class;
+
+    gobject_class = (GObjectClass *) klass;
+    element_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT(gst_sctp_impair_debug_category,
+        "sctpimpair", 0, "debug category for sctpimpair element");
+
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&src_template));
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&sink_template));
+
+    gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_sctp_impair_finalize);
+    gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_sctp_impair_set_property);
+    gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_sctp_impair_get_property);
+
+    properties[PROP_SEED] =
+        g_param_spec_uint("seed",
+            "Seed",
+            "Seed of the random generator. The same seed and input give the same output.",
+            0, G_MAXUINT, DEFAULT_SEED,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_GOOD_TO_BAD] =
+        g_param_spec_double("good-to-bad",
+            "Good to bad",
+            "Probability per packet that the loss model moves from the good to the bad state",
+            0.0, 1.0, DEFAULT_GOOD_TO_BAD,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BAD_TO_GOOD] =
+        g_param_spec_double("bad-to-good",
+            "Bad to good",
+            "Probability per packet that the loss model moves from the bad to the good state",
+            0.0, 1.0, DEFAULT_BAD_TO_GOOD,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_LOSS_GOOD] =
+        g_param_spec_double("loss-good",
+            "Loss in good state",
+            "Probability that a packet is lost in the good state",
+            0.0, 1.0, DEFAULT_LOSS_GOOD,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_LOSS_BAD] =
+        g_param_spec_double("loss-bad",
+            "Loss in bad state",
+            "Probability that a packet is lost in the bad state",
+            0.0, 1.0, DEFAULT_LOSS_BAD,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RATE] =
+        g_param_spec_uint64("rate",
+            "Rate",
+            "Bandwidth of the path in bits per second (0 = unlimited)",
+            0, G_MAXUINT64, DEFAULT_RATE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BURST] =
+        g_param_spec_uint("burst",
+            "Burst",
+            "Size of the token bucket in bytes, sent at once after the path was idle",
+            0, G_MAXUINT, DEFAULT_BURST,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_QUEUE_BYTES] =
+        g_param_spec_uint("max-queue-bytes",
+            "Max queue bytes",
+            "Bytes waiting for the rate limit before packets are dropped (0 = unlimited)",
+            0, G_MAXUINT, DEFAULT_MAX_QUEUE_BYTES,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DELAY] =
+        g_param_spec_uint("delay",
+            "Delay",
+            "One-way delay in milliseconds",
+            0, G_MAXUINT, DEFAULT_DELAY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_JITTER] =
+        g_param_spec_uint("jitter",
+            "Jitter",
+            "Maximum random variation of the delay in milliseconds. Jitter alone does not "
+            "reorder packets.",
+            0, G_MAXUINT, DEFAULT_JITTER,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_REORDER] =
+        g_param_spec_double("reorder",
+            "Reorder",
+            "Probability that a packet skips the delay and overtakes the packets before it",
+            0.0, 1.0, DEFAULT_REORDER,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DUPLICATE] =
+        g_param_spec_double("duplicate",
+            "Duplicate",
+            "Probability that a packet is delivered twice",
+            0.0, 1.0, DEFAULT_DUPLICATE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Counters of the packets passed, dropped, duplicated and reordered",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+
+    gst_element_class_set_static_metadata(element_class,
+        "SCTP path impairment",
+        "Filter/Network/SCTP",
+        "Emulates loss, delay, jitter, reordering, duplication and a bandwidth cap",
+        "OpenWebRTC GStreamer plugins");
+}
+
+static void gst_sctp_impair_init(GstSctpImpair *self)
+{
+    g_mutex_init(&self->lock);
+    g_cond_init(&self->cond);
+
+    self->seed = DEFAULT_SEED;
+    self->good_to_bad = DEFAULT_GOOD_TO_BAD;
+    self->bad_to_good = DEFAULT_BAD_TO_GOOD;
+    self->loss_good = DEFAULT_LOSS_GOOD;
+    self->loss_bad = DEFAULT_LOSS_BAD;
+    self->rate = DEFAULT_RATE;
+    self->burst = DEFAULT_BURST;
+    self->max_queue_bytes = DEFAULT_MAX_QUEUE_BYTES;
+    self->delay = DEFAULT_DELAY;
+    self->jitter = DEFAULT_JITTER;
+    self->reorder = DEFAULT_REORDER;
+    self->duplicate = DEFAULT_DUPLICATE;
+
+    self->rand = g_rand_new_with_seed(self->seed);
+    g_queue_init(&self->queue);
+    self->flushing = TRUE;
+    self->last_flow = GST_FLOW_OK;
+    reset_path(self);
+
+    self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
+    gst_pad_set_chain_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_sctp_impair_sink_chain));
+    gst_pad_set_event_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_sctp_impair_sink_event));
+    GST_PAD_SET_PROXY_CAPS(self->sink_pad);
+    gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
+
+    self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
+    gst_pad_set_activatemode_function(self->src_pad,
+        GST_DEBUG_FUNCPTR(gst_sctp_impair_src_activate_mode));
+    GST_PAD_SET_PROXY_CAPS(self->src_pad);
+    gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
+}
+
+static void gst_sctp_impair_finalize(GObject *object)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(object);
+
+    flush_queue(self);
+    g_rand_free(self->rand);
+    g_cond_clear(&self->cond);
+    g_mutex_clear(&self->lock);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_sctp_impair_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(object);
+
+    g_mutex_lock(&self->lock);
+    switch (prop_id) {
+    case PROP_SEED:
+        self->seed = g_value_get_uint(value);
+        g_rand_set_seed(self->rand, self->seed);
+        break;
+    case PROP_GOOD_TO_BAD:
+        self->good_to_bad = g_value_get_double(value);
+        break;
+    case PROP_BAD_TO_GOOD:
+        self->bad_to_good = g_value_get_double(value);
+        break;
+    case PROP_LOSS_GOOD:
+        self->loss_good = g_value_get_double(value);
+        break;
+    case PROP_LOSS_BAD:
+        self->loss_bad = g_value_get_double(value);
+        break;
+    case PROP_RATE:
+        self->rate = g_value_get_uint64(value);
+        break;
+    case PROP_BURST:
+        self->burst = g_value_get_uint(value);
+        break;
+    case PROP_MAX_QUEUE_BYTES:
+        self->max_queue_bytes = g_value_get_uint(value);
+        break;
+    case PROP_DELAY:
+        self->delay = g_value_get_uint(value);
+        break;
+    case PROP_JITTER:
+        self->jitter = g_value_get_uint(value);
+        break;
+    case PROP_REORDER:
+        self->reorder = g_value_get_double(value);
+        break;
+    case PROP_DUPLICATE:
+        self->duplicate = g_value_get_double(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    g_mutex_unlock(&self->lock);
+}
+
+static void gst_sctp_impair_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(object);
+
+    g_mutex_lock(&self->lock);
+    switch (prop_id) {
+    case PROP_SEED:
+        g_value_set_uint(value, self->seed);
+        break;
+    case PROP_GOOD_TO_BAD:
+        g_value_set_double(value, self->good_to_bad);
+        break;
+    case PROP_BAD_TO_GOOD:
+        g_value_set_double(value, self->bad_to_good);
+        break;
+    case PROP_LOSS_GOOD:
+        g_value_set_double(value, self->loss_good);
+        break;
+    case PROP_LOSS_BAD:
+        g_value_set_double(value, self->loss_bad);
+        break;
+    case PROP_RATE:
+        g_value_set_uint64(value, self->rate);
+        break;
+    case PROP_BURST:
+        g_value_set_uint(value, self->burst);
+        break;
+    case PROP_MAX_QUEUE_BYTES:
+        g_value_set_uint(value, self->max_queue_bytes);
+        break;
+    case PROP_DELAY:
+        g_value_set_uint(value, self->delay);
+        break;
+    case PROP_JITTER:
+        g_value_set_uint(value, self->jitter);
+        break;
+    case PROP_REORDER:
+        g_value_set_double(value, self->reorder);
+        break;
+    case PROP_DUPLICATE:
+        g_value_set_double(value, self->duplicate);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, create_stats(self));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    g_mutex_unlock(&self->lock);
+}
+
+static gboolean gst_sctp_impair_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(parent);
+    gboolean ret = FALSE;
+
+    switch (mode) {
+    case GST_PAD_MODE_PUSH:
+        if (active) {
+            g_mutex_lock(&self->lock);
+            /* Start every run from the same state so runs are reproducible */
+            g_rand_set_seed(self->rand, self->seed);
+            reset_path(self);
+            self->flushing = FALSE;
+            self->last_flow = GST_FLOW_OK;
+            g_mutex_unlock(&self->lock);
+            ret = gst_pad_start_task(pad, (GstTaskFunction) gst_sctp_impair_srcpad_loop, pad, NULL);
+        } else {
+            g_mutex_lock(&self->lock);
+            self->flushing = TRUE;
+            g_cond_signal(&self->cond);
+            g_mutex_unlock(&self->lock);
+            ret = gst_pad_stop_task(pad);
+            g_mutex_lock(&self->lock);
+            flush_queue(self);
+            g_mutex_unlock(&self->lock);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+/* Must be called with the lock held */
+static gboolean gilbert_elliott_drop(GstSctpImpair *self)
+{
+    gdouble loss;
+
+    if (self->bad_state) {
+        if (g_rand_double(self->rand) < self->bad_to_good)
+            self->bad_state = FALSE;
+    } else if (self->good_to_bad > 0.0 && g_rand_double(self->rand) < self->good_to_bad) {
+        self->bad_state = TRUE;
+    }
+
+    loss = self->bad_state ? self->loss_bad : self->loss_good;
+    return loss > 0.0 && g_rand_double(self->rand) < loss;
+}
+
+static GstFlowReturn gst_sctp_impair_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(parent);
+    GstFlowReturn ret = GST_FLOW_OK;
+    gint64 now, send_time, release_time;
+    gsize size;
+
+    g_mutex_lock(&self->lock);
+    if (self->flushing) {
+        ret = GST_FLOW_FLUSHING;
+        goto drop;
+    }
+    if (self->last_flow != GST_FLOW_OK) {
+        ret = self->last_flow;
+        goto drop;
+    }
+
+    self->packets_in++;
+    if (gilbert_elliott_drop(self)) {
+        self->dropped_loss++;
+        goto drop;
+    }
+
+    now = g_get_monotonic_time();
+    send_time = now;
+    size = gst_buffer_get_size(buffer);
+    if (self->rate > 0) {
+        self->tokens = MIN((gdouble) self->burst,
+            self->tokens + (now - self->tokens_updated) * (self->rate / 8.0) / G_TIME_SPAN_SECOND);
+        self->tokens_updated = now;
+
+        /* Negative tokens are the bytes queued in front of this packet */
+        if (self->max_queue_bytes > 0 && -self->tokens + size > self->max_queue_bytes) {
+            self->dropped_queue++;
+            goto drop;
+        }
+        self->tokens -= size;
+        if (self->tokens < 0)
+            send_time = now + (gint64) (-self->tokens * 8.0 * G_TIME_SPAN_SECOND / self->rate);
+    }
+
+    release_time = send_time + (gint64) self->delay * G_TIME_SPAN_MILLISECOND;
+    if (self->jitter > 0) {
+        release_time += g_rand_int_range(self->rand, -(gint32) self->jitter * 1000,
+            (gint32) self->jitter * 1000 + 1);
+    }
+
+    if (self->reorder > 0.0 && g_rand_double(self->rand) < self->reorder) {
+        /* Overtakes the delayed packets, but never the events queued before it */
+        release_time = MAX(send_time, self->last_serialized);
+        self->reordered++;
+    } else {
+        release_time = MAX(release_time, self->last_release);
+        self->last_release = release_time;
+    }
+
+    if (self->duplicate > 0.0 && g_rand_double(self->rand) < self->duplicate) {
+        enqueue(self, GST_MINI_OBJECT(gst_buffer_ref(buffer)), release_time);
+        self->duplicated++;
+    }
+    enqueue(self, GST_MINI_OBJECT(buffer), release_time);
+    g_mutex_unlock(&self->lock);
+
+    return GST_FLOW_OK;
+
+drop:
+    g_mutex_unlock(&self->lock);
+    gst_buffer_unref(buffer);
+    return ret;
+}
+
+static gboolean gst_sctp_impair_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(parent);
+    gboolean ret;
+
+    switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_FLUSH_START:
+        g_mutex_lock(&self->lock);
+        self->flushing = TRUE;
+        g_cond_signal(&self->cond);
+        g_mutex_unlock(&self->lock);
+
+        ret = gst_pad_push_event(self->src_pad, event);
+        gst_pad_pause_task(self->src_pad);
+        break;
+    case GST_EVENT_FLUSH_STOP:
+        g_mutex_lock(&self->lock);
+        flush_queue(self);
+        reset_path(self);
+        self->flushing = FALSE;
+        self->last_flow = GST_FLOW_OK;
+        g_mutex_unlock(&self->lock);
+
+        ret = gst_pad_push_event(self->src_pad, event);
+        gst_pad_start_task(self->src_pad, (GstTaskFunction) gst_sctp_impair_srcpad_loop,
+            self->src_pad, NULL);
+        break;
+    default:
+        if (!GST_EVENT_IS_SERIALIZED(event)) {
+            ret = gst_pad_event_default(pad, parent, event);
+            break;
+        }
+
+        /* Serialized events keep their place between the packets */
+        g_mutex_lock(&self->lock);
+        if (self->flushing) {
+            g_mutex_unlock(&self->lock);
+            gst_event_unref(event);
+            ret = FALSE;
+            break;
+        }
+        self->last_serialized = MAX(self->last_release, g_get_monotonic_time());
+        self->last_release = self->last_serialized;
+        enqueue(self, GST_MINI_OBJECT(event), self->last_serialized);
+        g_mutex_unlock(&self->lock);
+        ret = TRUE;
+        break;
+    }
+
+    return ret;
+}
+
+static void gst_sctp_impair_srcpad_loop(GstPad *pad)
+{
+    GstSctpImpair *self = GST_SCTP_IMPAIR(GST_PAD_PARENT(pad));
+    ImpairItem *item;
+    GstMiniObject *object;
+    GstFlowReturn flow_ret;
+
+    g_mutex_lock(&self->lock);
+    while (!self->flushing) {
+        item = g_queue_peek_head(&self->queue);
+        if (item && item->release_time <= g_get_monotonic_time())
+            break;
+
+        if (item)
+            g_cond_wait_until(&self->cond, &self->lock, item->release_time);
+        else
+            g_cond_wait(&self->cond, &self->lock);
+    }
+
+    if (self->flushing) {
+        g_mutex_unlock(&self->lock);
+        gst_pad_pause_task(pad);
+        return;
+    }
+
+    item = g_queue_pop_head(&self->queue);
+    object = item->object;
+    g_slice_free(ImpairItem, item);
+    if (GST_IS_BUFFER(object)) {
+        self->packets_out++;
+        self->bytes_out += gst_buffer_get_size(GST_BUFFER(object));
+    }
+    g_mutex_unlock(&self->lock);
+
+    if (GST_IS_BUFFER(object)) {
+        flow_ret = gst_pad_push(pad, GST_BUFFER(object));
+        if (flow_ret != GST_FLOW_OK) {
+            GST_DEBUG_OBJECT(self, "Push returned %s, pausing", gst_flow_get_name(flow_ret));
+            g_mutex_lock(&self->lock);
+            self->last_flow = flow_ret;
+            g_mutex_unlock(&self->lock);
+            if (flow_ret != GST_FLOW_FLUSHING && flow_ret != GST_FLOW_EOS)
+                GST_ELEMENT_ERROR(self, STREAM, FAILED, ("Internal data stream error."),
+                    ("streaming stopped, reason %s", gst_flow_get_name(flow_ret)));
+            gst_pad_pause_task(pad);
+        }
+    } else {
+        gst_pad_push_event(pad, GST_EVENT(object));
+    }
+}
+
+/* Must be called with the lock held */
+static void reset_path(GstSctpImpair *self)
+{
+    self->bad_state = FALSE;
+    self->tokens = self->burst;
+    self->tokens_updated = g_get_monotonic_time();
+    self->last_release = 0;
+    self->last_serialized = 0;
+}
+
+/* Must be called with the lock held. Keeps the queue sorted by release time, items with the same
+ * release time stay in the order they were queued. */
+static void enqueue(GstSctpImpair *self, GstMiniObject *object, gint64 release_time)
+{
+    ImpairItem *item = g_slice_new(ImpairItem);
+    GList *l;
+
+    item->object = object;
+    item->release_time = release_time;
+
+    for (l = self->queue.tail; l; l = l->prev) {
+        if (((ImpairItem *) l->data)->release_time <= release_time)
+            break;
+    }
+    if (l)
+        g_queue_insert_after(&self->queue, l, item);
+    else
+        g_queue_push_head(&self->queue, item);
+
+    g_cond_signal(&self->cond);
+}
+
+/* Must be called with the lock held */
+static void flush_queue(GstSctpImpair *self)
+{
+    ImpairItem *item;
+
+    while ((item = g_queue_pop_head(&self->queue))) {
+        gst_mini_object_unref(item->object);
+        g_slice_free(ImpairItem, item);
+    }
+}
+
+/* Must be called with the lock held */
+static GstStructure *create_stats(GstSctpImpair *self)
+{
+    return gst_structure_new("application/x-sctp-impair-stats",
+        "packets-in", G_TYPE_UINT64, self->packets_in,
+        "packets-out", G_TYPE_UINT64, self->packets_out,
+        "bytes-out", G_TYPE_UINT64, self->bytes_out,
+        "dropped-loss", G_TYPE_UINT64, self->dropped_loss,
+        "dropped-queue", G_TYPE_UINT64, self->dropped_queue,
+        "duplicated", G_TYPE_UINT64, self->duplicated,
+        "reordered", G_TYPE_UINT64, self->reordered,
+        NULL);
+}
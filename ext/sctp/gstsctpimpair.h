@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctpimpair_h
+#define gstsctpimpair_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SCTP_IMPAIR (gst_sctp_impair_get_type())
+#define GST_SCTP_IMPAIR(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SCTP_IMPAIR, GstSctpImpair))
+#define GST_SCTP_IMPAIR_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SCTP_IMPAIR, GstSctpImpairClass))
+#define GST_IS_SCTP_IMPAIR(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SCTP_IMPAIR))
+#define GST_IS_SCTP_IMPAIR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SCTP_IMPAIR))
+
+typedef struct _GstSctpImpair GstSctpImpair;
+typedef struct _GstSctpImpairClass GstSctpImpairClass;
+
+struct _GstSctpImpair {
+    GstElement element;
+
+    GstPad *sink_pad;
+    GstPad *src_pad;
+
+    /* Everything below is protected by lock */
+    GMutex lock;
+    GCond cond;
+
+    guint seed;
+    gdouble good_to_bad;
+    gdouble bad_to_good;
+    gdouble loss_good;
+    gdouble loss_bad;
+    guint64 rate;
+    guint burst;
+    guint max_queue_bytes;
+    guint delay;
+    guint jitter;
+    gdouble reorder;
+    gdouble duplicate;
+
+    GRand *rand;
+    gboolean bad_state;
+    gdouble tokens;
+    gint64 tokens_updated;
+    gint64 last_release;
+    gint64 last_serialized;
+
+    GQueue queue;
+    gboolean flushing;
+    GstFlowReturn last_flow;
+
+    guint64 packets_in;
+    guint64 packets_out;
+    guint64 bytes_out;
+    guint64 dropped_loss;
+    guint64 dropped_queue;
+    guint64 duplicated;
+    guint64 reordered;
+};
+
+struct _GstSctpImpairClass {
+    GstElementClass parent_class;
+};
+
+GType gst_sctp_impair_get_type(void);
+
+G_END_DECLS
+
+#endif /* gstsctpimpair_h */
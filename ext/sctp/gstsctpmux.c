@@ -0,0 +1,723 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * sctpmux hosts many SCTP associations in one element, for servers that terminate a data channel
+ * per peer:
+ *
+ *   udpsrc ! sctpmux.sink_1   sctpmux.src_1 ! udpsink
+ *   udpsrc ! sctpmux.sink_2   sctpmux.src_2 ! udpsink
+ *   sctpmux.src ! appsink
+ *
+ * sink_%u takes the packets received for association %u and src_%u gives the packets it sends.
+ * The messages of all associations leave on the src pad with a GstSctpReceiveMeta carrying their
+ * association id, and are sent with the "send-message" action signal. All outgoing packets and
+ * messages go through one queue served by a single thread instead of a thread per association.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpmux.h"
+
+#include <gst/sctp/sctpreceivemeta.h>
+#include <gst/sctp/sctpsendmeta.h>
+#include <gst/sctp/sctppacketmeta.h>
+#include <stdio.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_sctp_mux_debug_category);
+#define GST_CAT_DEFAULT gst_sctp_mux_debug_category
+
+#define gst_sctp_mux_parent_class parent_class
+G_DEFINE_TYPE(GstSctpMux, gst_sctp_mux, GST_TYPE_ELEMENT);
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink_%u", GST_PAD_SINK,
+    GST_PAD_REQUEST, GST_STATIC_CAPS("application/x-sctp"));
+
+static GstStaticPadTemplate packet_src_template = GST_STATIC_PAD_TEMPLATE("src_%u", GST_PAD_SRC,
+    GST_PAD_REQUEST, GST_STATIC_CAPS("application/x-sctp"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+enum {
+    SIGNAL_ASSOCIATION_ESTABLISHED,
+    SIGNAL_SEND_MESSAGE,
+    NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS];
+
+enum {
+    PROP_0,
+
+    PROP_LOCAL_SCTP_PORT,
+    PROP_REMOTE_SCTP_PORT,
+    PROP_MAX_QUEUED_BYTES,
+
+    NUM_PROPERTIES
+};
+
+static GParamSpec *properties[NUM_PROPERTIES];
+
+#define DEFAULT_LOCAL_SCTP_PORT 5000
+#define DEFAULT_REMOTE_SCTP_PORT 5000
+#define DEFAULT_MAX_QUEUED_BYTES (4 * 1024 * 1024)
+
+/* One association and its pair of packet pads, freed once both pads are released */
+typedef struct {
+    GstSctpMux *mux;
+    guint32 association_id;
+    GstSctpAssociation *association;
+    gulong signal_handler_state_changed;
+    GstPad *sink_pad;
+    GstPad *src_pad;
+} GstSctpMuxAssociation;
+
+typedef struct {
+    GstDataQueueItem item;
+    GstPad *pad;
+    /* Set for received messages, which count against max-queued-bytes until freed */
+    GstSctpMux *mux;
+} GstSctpMuxQueueItem;
+
+static void gst_sctp_mux_finalize(GObject *object);
+static void gst_sctp_mux_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec);
+static void gst_sctp_mux_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec);
+static GstPad *gst_sctp_mux_request_new_pad(GstElement *element, GstPadTemplate *template,
+    const gchar *name, const GstCaps *caps);
+static void gst_sctp_mux_release_pad(GstElement *element, GstPad *pad);
+static gboolean gst_sctp_mux_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active);
+static GstFlowReturn gst_sctp_mux_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static gboolean gst_sctp_mux_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
+static void gst_sctp_mux_srcpad_loop(GstPad *pad);
+
+static GstSctpMuxAssociation *create_association(GstSctpMux *self, guint32 association_id);
+static void destroy_association(GstSctpMuxAssociation *entry);
+static void on_sctp_association_state_changed(GstSctpAssociation *sctp_association,
+    GParamSpec *pspec, GstSctpMuxAssociation *entry);
+static void on_sctp_packet_out(GstSctpAssociation *sctp_association, const guint8 *buf,
+    gsize length, guint8 tos, gboolean set_df, gpointer user_data);
+static void on_receive(GstSctpAssociation *sctp_association, guint8 *buf, gsize length,
+    const GstSctpAssociationReceiveInfo *info, gpointer user_data);
+static void enqueue(GstSctpMux *self, GstPad *pad, GstBuffer *buffer, gboolean message);
+static gboolean on_send_message(GstSctpMux *self, guint association_id, guint stream_id,
+    guint ppid, gboolean ordered, GstBuffer *buffer);
+
+static void gst_sctp_mux_class_init(GstSctpMuxClass *klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *element_class;
+
+    gobject_class = (GObjectClass *) klass;
+    element_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT(gst_sctp_mux_debug_category,
+        "sctpmux", 0, "debug category for sctpmux element");
+
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&src_template));
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&packet_src_template));
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&sink_template));
+
+    gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_sctp_mux_finalize);
+    gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_sctp_mux_set_property);
+    gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_sctp_mux_get_property);
+
+    element_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_sctp_mux_request_new_pad);
+    element_class->release_pad = GST_DEBUG_FUNCPTR(gst_sctp_mux_release_pad);
+
+    properties[PROP_LOCAL_SCTP_PORT] =
+        g_param_spec_uint("local-sctp-port",
+            "Local SCTP port",
+            "Local sctp port of the associations created after this is set",
+            0, G_MAXUSHORT, DEFAULT_LOCAL_SCTP_PORT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_REMOTE_SCTP_PORT] =
+        g_param_spec_uint("remote-sctp-port",
+            "Remote SCTP port",
+            "Remote sctp port of the associations created after this is set",
+            0, G_MAXUSHORT, DEFAULT_REMOTE_SCTP_PORT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_QUEUED_BYTES] =
+        g_param_spec_uint("max-queued-bytes",
+            "Max queued bytes",
+            "Bytes of received messages queued for the src pad before sctpmux stops reading "
+            "packets until downstream catches up, which closes the SCTP receive windows "
+            "(0 = unlimited)",
+            0, G_MAXINT, DEFAULT_MAX_QUEUED_BYTES,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+
+    signals[SIGNAL_ASSOCIATION_ESTABLISHED] = g_signal_new("association-established",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST,
+        G_STRUCT_OFFSET(GstSctpMuxClass, on_sctp_association_is_established), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_BOOLEAN);
+
+    signals[SIGNAL_SEND_MESSAGE] = g_signal_new("send-message",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstSctpMuxClass, on_send_message), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_BOOLEAN, 5, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+        G_TYPE_BOOLEAN, GST_TYPE_BUFFER);
+
+    klass->on_send_message = GST_DEBUG_FUNCPTR(on_send_message);
+
+    gst_element_class_set_static_metadata(element_class,
+        "SCTP Multiplexer",
+        "Muxer/Demuxer/Network/SCTP",
+        "Runs many SCTP associations with one shared output thread",
+        "George Kiagiadakis <george.kiagiadakis@collabora.com>");
+}
+
+static gboolean data_queue_check_full_cb(GstDataQueue *queue, guint visible, guint bytes,
+    guint64 time, gpointer user_data)
+{
+    /* Packets are bounded by the send buffers of the associations, received messages by
+     * max-queued-bytes in on_receive(). Blocking here could stall a send holding its association
+     * lock. */
+    return FALSE;
+}
+
+static void gst_sctp_mux_init(GstSctpMux *self)
+{
+    self->local_sctp_port = DEFAULT_LOCAL_SCTP_PORT;
+    self->remote_sctp_port = DEFAULT_REMOTE_SCTP_PORT;
+    self->associations = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->outbound_queue = gst_data_queue_new(data_queue_check_full_cb, NULL, NULL, NULL);
+    self->max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES;
+    g_mutex_init(&self->receive_lock);
+    g_cond_init(&self->receive_cond);
+    self->queued_bytes = 0;
+    self->receive_flushing = TRUE;
+
+    self->msg_src_pad = gst_pad_new_from_static_template(&src_template, "src");
+    gst_pad_set_activatemode_function(self->msg_src_pad,
+        GST_DEBUG_FUNCPTR(gst_sctp_mux_src_activate_mode));
+    gst_element_add_pad(GST_ELEMENT(self), self->msg_src_pad);
+}
+
+static void gst_sctp_mux_finalize(GObject *object)
+{
+    GstSctpMux *self = GST_SCTP_MUX(object);
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, self->associations);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_hash_table_iter_steal(&iter);
+        destroy_association(value);
+    }
+    g_hash_table_unref(self->associations);
+    gst_object_unref(self->outbound_queue);
+    g_mutex_clear(&self->receive_lock);
+    g_cond_clear(&self->receive_cond);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_sctp_mux_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpMux *self = GST_SCTP_MUX(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_LOCAL_SCTP_PORT:
+        self->local_sctp_port = g_value_get_uint(value);
+        break;
+    case PROP_REMOTE_SCTP_PORT:
+        self->remote_sctp_port = g_value_get_uint(value);
+        break;
+    case PROP_MAX_QUEUED_BYTES:
+        g_mutex_lock(&self->receive_lock);
+        self->max_queued_bytes = g_value_get_uint(value);
+        g_cond_broadcast(&self->receive_cond);
+        g_mutex_unlock(&self->receive_lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_sctp_mux_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpMux *self = GST_SCTP_MUX(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_LOCAL_SCTP_PORT:
+        g_value_set_uint(value, self->local_sctp_port);
+        break;
+    case PROP_REMOTE_SCTP_PORT:
+        g_value_set_uint(value, self->remote_sctp_port);
+        break;
+    case PROP_MAX_QUEUED_BYTES:
+        g_mutex_lock(&self->receive_lock);
+        g_value_set_uint(value, self->max_queued_bytes);
+        g_mutex_unlock(&self->receive_lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static GstPad *gst_sctp_mux_request_new_pad(GstElement *element, GstPadTemplate *template,
+    const gchar *name, const GstCaps *caps)
+{
+    GstSctpMux *self = GST_SCTP_MUX(element);
+    GstSctpMuxAssociation *entry;
+    GstPad *new_pad;
+    GstPad **entry_pad;
+    guint32 association_id;
+    gboolean created = FALSE;
+
+    if (!template || !name)
+        return NULL;
+
+    if (template->direction == GST_PAD_SINK) {
+        if (sscanf(name, "sink_%u", &association_id) != 1)
+            return NULL;
+    } else if (sscanf(name, "src_%u", &association_id) != 1) {
+        return NULL;
+    }
+
+    new_pad = gst_pad_new_from_template(template, name);
+    if (template->direction == GST_PAD_SINK) {
+        gst_pad_set_chain_function(new_pad, GST_DEBUG_FUNCPTR(gst_sctp_mux_sink_chain));
+        gst_pad_set_event_function(new_pad, GST_DEBUG_FUNCPTR(gst_sctp_mux_sink_event));
+    }
+
+    GST_OBJECT_LOCK(self);
+    entry = g_hash_table_lookup(self->associations, GUINT_TO_POINTER(association_id));
+    if (!entry) {
+        entry = create_association(self, association_id);
+        if (!entry) {
+            GST_OBJECT_UNLOCK(self);
+            goto error_cleanup;
+        }
+        g_hash_table_insert(self->associations, GUINT_TO_POINTER(association_id), entry);
+        created = TRUE;
+    }
+
+    entry_pad = template->direction == GST_PAD_SINK ? &entry->sink_pad : &entry->src_pad;
+    if (*entry_pad) {
+        GST_OBJECT_UNLOCK(self);
+        GST_WARNING_OBJECT(self, "Pad %s already exists", name);
+        goto error_cleanup;
+    }
+    *entry_pad = new_pad;
+    gst_pad_set_element_private(new_pad, entry);
+    GST_OBJECT_UNLOCK(self);
+
+    /* The association becomes ready, and is started, once both callbacks are set */
+    if (created)
+        gst_sctp_association_set_on_packet_received(entry->association, on_receive, entry);
+    if (template->direction == GST_PAD_SRC)
+        gst_sctp_association_set_on_packet_out(entry->association, on_sctp_packet_out, entry);
+
+    gst_pad_set_active(new_pad, TRUE);
+    gst_element_add_pad(element, new_pad);
+
+    return new_pad;
+error_cleanup:
+    gst_object_unref(new_pad);
+    return NULL;
+}
+
+static void gst_sctp_mux_release_pad(GstElement *element, GstPad *pad)
+{
+    GstSctpMux *self = GST_SCTP_MUX(element);
+    GstSctpMuxAssociation *entry = gst_pad_get_element_private(pad);
+
+    /* Waits for a chain call in progress on the sink pad */
+    gst_pad_set_active(pad, FALSE);
+
+    GST_OBJECT_LOCK(self);
+    if (entry->sink_pad == pad)
+        entry->sink_pad = NULL;
+    else
+        entry->src_pad = NULL;
+
+    if (!entry->sink_pad && !entry->src_pad)
+        g_hash_table_remove(self->associations, GUINT_TO_POINTER(entry->association_id));
+    else
+        entry = NULL;
+    GST_OBJECT_UNLOCK(self);
+
+    if (entry)
+        destroy_association(entry);
+
+    gst_element_remove_pad(element, pad);
+}
+
+static gboolean gst_sctp_mux_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active)
+{
+    GstSctpMux *self = GST_SCTP_MUX(parent);
+
+    if (mode != GST_PAD_MODE_PUSH)
+        return FALSE;
+
+    g_mutex_lock(&self->receive_lock);
+    self->receive_flushing = !active;
+    g_cond_broadcast(&self->receive_cond);
+    g_mutex_unlock(&self->receive_lock);
+
+    if (active) {
+        gst_data_queue_set_flushing(self->outbound_queue, FALSE);
+        return gst_pad_start_task(pad, (GstTaskFunction)gst_sctp_mux_srcpad_loop, pad, NULL);
+    }
+
+    gst_data_queue_set_flushing(self->outbound_queue, TRUE);
+    gst_data_queue_flush(self->outbound_queue);
+    return gst_pad_stop_task(pad);
+}
+
+static GstFlowReturn gst_sctp_mux_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
+{
+    GstSctpMuxAssociation *entry = gst_pad_get_element_private(pad);
+    GstSctpPacketMeta *packet_meta;
+    guint8 ecn_bits = 0;
+    GstMapInfo map;
+
+    packet_meta = gst_sctp_buffer_get_packet_meta(buffer);
+    if (packet_meta)
+        ecn_bits = GST_SCTP_PACKET_META_ECN(packet_meta);
+
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        GST_WARNING_OBJECT(pad, "Could not map GstBuffer");
+        gst_buffer_unref(buffer);
+        return GST_FLOW_ERROR;
+    }
+
+    gst_sctp_association_incoming_packet(entry->association, (guint8 *)map.data,
+        (guint32)map.size, ecn_bits);
+    gst_buffer_unmap(buffer, &map);
+    gst_buffer_unref(buffer);
+
+    return GST_FLOW_OK;
+}
+
+static gboolean gst_sctp_mux_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+    /* The packets of one association end there, their events mean nothing downstream */
+    gst_event_unref(event);
+    return TRUE;
+}
+
+static void data_queue_item_free(GstSctpMuxQueueItem *queue_item)
+{
+    GstSctpMux *self = queue_item->mux;
+
+    if (self) {
+        g_mutex_lock(&self->receive_lock);
+        self->queued_bytes -= queue_item->item.size;
+        g_cond_broadcast(&self->receive_cond);
+        g_mutex_unlock(&self->receive_lock);
+    }
+
+    if (queue_item->item.object)
+        gst_mini_object_unref(queue_item->item.object);
+    gst_object_unref(queue_item->pad);
+    g_free(queue_item);
+}
+
+static void push_stream_start(GstSctpMux *self, GstPad *pad)
+{
+    GstSegment segment;
+    gchar s_id[48];
+    GstCaps *caps;
+
+    g_snprintf(s_id, sizeof(s_id), "sctpmux-%08x-%s", g_random_int(), GST_PAD_NAME(pad));
+    gst_pad_push_event(pad, gst_event_new_stream_start(s_id));
+
+    if (pad != self->msg_src_pad) {
+        caps = gst_caps_new_empty_simple("application/x-sctp");
+        gst_pad_set_caps(pad, caps);
+        gst_caps_unref(caps);
+    }
+
+    gst_segment_init(&segment, GST_FORMAT_BYTES);
+    gst_pad_push_event(pad, gst_event_new_segment(&segment));
+}
+
+static void gst_sctp_mux_srcpad_loop(GstPad *pad)
+{
+    GstSctpMux *self = GST_SCTP_MUX(GST_PAD_PARENT(pad));
+    GstSctpMuxQueueItem *queue_item;
+    GstDataQueueItem *item;
+    GstEvent *stream_start;
+    GstFlowReturn flow_ret;
+
+    if (!gst_data_queue_pop(self->outbound_queue, &item)) {
+        GST_DEBUG_OBJECT(pad, "Pausing task because we're flushing");
+        gst_pad_pause_task(pad);
+        return;
+    }
+    queue_item = (GstSctpMuxQueueItem *) item;
+
+    stream_start = gst_pad_get_sticky_event(queue_item->pad, GST_EVENT_STREAM_START, 0);
+    if (stream_start)
+        gst_event_unref(stream_start);
+    else
+        push_stream_start(self, queue_item->pad);
+
+    flow_ret = gst_pad_push(queue_item->pad, GST_BUFFER(item->object));
+    item->object = NULL;
+
+    /* One association that is gone or unlinked must not stall the others, so the task goes on */
+    if (G_UNLIKELY(flow_ret == GST_FLOW_FLUSHING || flow_ret == GST_FLOW_NOT_LINKED)) {
+        GST_DEBUG_OBJECT(queue_item->pad, "Push failed. Error: %s", gst_flow_get_name(flow_ret));
+    } else if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
+        GST_ERROR_OBJECT(queue_item->pad, "Push failed. Error: %s", gst_flow_get_name(flow_ret));
+    }
+
+    item->destroy(item);
+}
+
+/* Called with the object lock held */
+static GstSctpMuxAssociation *create_association(GstSctpMux *self, guint32 association_id)
+{
+    GstSctpMuxAssociation *entry;
+    GstSctpAssociation *association;
+    gint state;
+
+    association = gst_sctp_association_get(association_id);
+    g_object_get(association, "state", &state, NULL);
+    if (state != GST_SCTP_ASSOCIATION_STATE_NEW) {
+        GST_WARNING_OBJECT(self, "SCTP association %u already in use", association_id);
+        g_object_unref(association);
+        return NULL;
+    }
+
+    entry = g_new0(GstSctpMuxAssociation, 1);
+    entry->mux = self;
+    entry->association_id = association_id;
+    entry->association = association;
+
+    g_object_set(association, "local-port", self->local_sctp_port, "remote-port",
+        self->remote_sctp_port, NULL);
+    entry->signal_handler_state_changed = g_signal_connect(association, "notify::state",
+        G_CALLBACK(on_sctp_association_state_changed), entry);
+
+    return entry;
+}
+
+static void destroy_association(GstSctpMuxAssociation *entry)
+{
+    g_signal_handler_disconnect(entry->association, entry->signal_handler_state_changed);
+    gst_sctp_association_force_close(entry->association);
+    /* The association may outlive entry, which its callbacks get as user_data */
+    gst_sctp_association_set_on_packet_received(entry->association, NULL, NULL);
+    gst_sctp_association_set_on_packet_out(entry->association, NULL, NULL);
+    g_object_unref(entry->association);
+    g_free(entry);
+}
+
+static void on_sctp_association_state_changed(GstSctpAssociation *sctp_association,
+    GParamSpec *pspec, GstSctpMuxAssociation *entry)
+{
+    gint state;
+
+    g_object_get(sctp_association, "state", &state, NULL);
+    switch (state) {
+    case GST_SCTP_ASSOCIATION_STATE_READY:
+        gst_sctp_association_start(sctp_association);
+        break;
+    case GST_SCTP_ASSOCIATION_STATE_CONNECTED:
+        g_signal_emit(entry->mux, signals[SIGNAL_ASSOCIATION_ESTABLISHED], 0,
+            entry->association_id, TRUE);
+        break;
+    case GST_SCTP_ASSOCIATION_STATE_DISCONNECTING:
+    case GST_SCTP_ASSOCIATION_STATE_DISCONNECTED:
+        g_signal_emit(entry->mux, signals[SIGNAL_ASSOCIATION_ESTABLISHED], 0,
+            entry->association_id, FALSE);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Takes pad and buffer. A message counts against max-queued-bytes, which the caller has
+ * reserved room for, until its item is freed. */
+static void enqueue(GstSctpMux *self, GstPad *pad, GstBuffer *buffer, gboolean message)
+{
+    GstSctpMuxQueueItem *queue_item;
+    GstDataQueueItem *item;
+
+    queue_item = g_new0(GstSctpMuxQueueItem, 1);
+    queue_item->pad = pad;
+    queue_item->mux = message ? self : NULL;
+
+    item = &queue_item->item;
+    item->object = GST_MINI_OBJECT(buffer);
+    item->size = gst_buffer_get_size(buffer);
+    item->visible = TRUE;
+    item->destroy = (GDestroyNotify) data_queue_item_free;
+
+    if (!gst_data_queue_push(self->outbound_queue, item)) {
+        item->destroy(item);
+        GST_DEBUG_OBJECT(self, "Failed to push item because we're flushing");
+    }
+}
+
+static void on_sctp_packet_out(GstSctpAssociation *sctp_association, const guint8 *buf,
+    gsize length, guint8 tos, gboolean set_df, gpointer user_data)
+{
+    GstSctpMuxAssociation *entry = user_data;
+    GstSctpMux *self = entry->mux;
+    GstBuffer *gstbuf;
+    GstPad *src_pad;
+
+    GST_OBJECT_LOCK(self);
+    src_pad = entry->src_pad ? gst_object_ref(entry->src_pad) : NULL;
+    GST_OBJECT_UNLOCK(self);
+
+    if (!src_pad) {
+        GST_LOG_OBJECT(self, "Dropping packet of association %u, its pad is released",
+            entry->association_id);
+        return;
+    }
+
+    gstbuf = gst_buffer_new_wrapped(g_memdup(buf, length), length);
+    gst_sctp_buffer_add_packet_meta(gstbuf, tos, set_df);
+    enqueue(self, src_pad, gstbuf, FALSE);
+}
+
+static void on_receive(GstSctpAssociation *sctp_association, guint8 *buf, gsize length,
+    const GstSctpAssociationReceiveInfo *info, gpointer user_data)
+{
+    GstSctpMuxAssociation *entry = user_data;
+    GstSctpMux *self = entry->mux;
+    GstSctpReceiveMeta *receive_meta;
+    GstBuffer *gstbuf;
+
+    /* Messages are only delivered from the thread that feeds the association its packets. It
+     * waits here while the src pad has max-queued-bytes queued, so the receive window closes
+     * instead of the queue growing. */
+    g_mutex_lock(&self->receive_lock);
+    while (self->max_queued_bytes && self->queued_bytes >= self->max_queued_bytes
+        && !self->receive_flushing)
+        g_cond_wait(&self->receive_cond, &self->receive_lock);
+    if (self->receive_flushing) {
+        g_mutex_unlock(&self->receive_lock);
+        GST_DEBUG_OBJECT(self, "Dropping message because we're flushing");
+        g_free(buf);
+        return;
+    }
+    self->queued_bytes += length;
+    g_mutex_unlock(&self->receive_lock);
+
+    gstbuf = gst_buffer_new_wrapped(buf, length);
+    receive_meta = gst_sctp_buffer_add_receive_meta(gstbuf, info->ppid);
+    receive_meta->stream_id = info->stream_id;
+    receive_meta->ssn = info->ssn;
+    receive_meta->tsn = info->tsn;
+    receive_meta->unordered = info->unordered;
+    receive_meta->receive_time = info->receive_time * GST_USECOND;
+    receive_meta->fragment = info->fragment;
+    receive_meta->last_fragment = info->last_fragment;
+    receive_meta->association_id = entry->association_id;
+
+    enqueue(self, gst_object_ref(self->msg_src_pad), gstbuf, TRUE);
+}
+
+static gboolean on_send_message(GstSctpMux *self, guint association_id, guint stream_id,
+    guint ppid, gboolean ordered, GstBuffer *buffer)
+{
+    GstSctpMuxAssociation *entry;
+    GstSctpAssociation *association = NULL;
+    GstSctpAssociationPartialReliability pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE;
+    GstSctpAssociationSendFlags flags = GST_SCTP_ASSOCIATION_SEND_FLAG_NONE;
+    guint32 pr_param = 0;
+    guint32 context = 0;
+    GstSctpSendMeta *send_meta;
+    GstMapInfo map;
+    gboolean ret;
+
+    GST_OBJECT_LOCK(self);
+    entry = g_hash_table_lookup(self->associations, GUINT_TO_POINTER(association_id));
+    if (entry)
+        association = g_object_ref(entry->association);
+    GST_OBJECT_UNLOCK(self);
+
+    if (!association) {
+        GST_WARNING_OBJECT(self, "No SCTP association %u", association_id);
+        return FALSE;
+    }
+
+    send_meta = (GstSctpSendMeta *) gst_buffer_get_meta(buffer, GST_SCTP_SEND_META_API_TYPE);
+    if (send_meta) {
+        switch (send_meta->pr) {
+        case GST_SCTP_SEND_META_PARTIAL_RELIABILITY_NONE:
+            pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE;
+            break;
+        case GST_SCTP_SEND_META_PARTIAL_RELIABILITY_RTX:
+            pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX;
+            break;
+        case GST_SCTP_SEND_META_PARTIAL_RELIABILITY_BUF:
+            pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_BUF;
+            break;
+        case GST_SCTP_SEND_META_PARTIAL_RELIABILITY_TTL:
+            pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL;
+            break;
+        }
+        pr_param = send_meta->pr_param;
+        if (send_meta->flags & GST_SCTP_SEND_META_FLAG_URGENT
+            || send_meta->priority >= GST_SCTP_SEND_META_PRIORITY_HIGH)
+            flags |= GST_SCTP_ASSOCIATION_SEND_FLAG_URGENT;
+        if (send_meta->flags & GST_SCTP_SEND_META_FLAG_SACK_IMMEDIATELY)
+            flags |= GST_SCTP_ASSOCIATION_SEND_FLAG_SACK_IMMEDIATELY;
+        context = send_meta->context;
+    }
+
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        GST_WARNING_OBJECT(self, "Could not map GstBuffer");
+        g_object_unref(association);
+        return FALSE;
+    }
+
+    /* Does not block, FALSE tells the caller the send buffer is full and to retry later */
+    ret = gst_sctp_association_send_data(association, map.data, map.size, stream_id, ppid,
+        ordered, pr, pr_param, flags, context);
+
+    gst_buffer_unmap(buffer, &map);
+    g_object_unref(association);
+
+    return ret;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctpmux_h
+#define gstsctpmux_h
+
+#include <gst/gst.h>
+#include <gst/base/base.h>
+#include "sctpassociation.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SCTP_MUX (gst_sctp_mux_get_type())
+#define GST_SCTP_MUX(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SCTP_MUX, GstSctpMux))
+#define GST_SCTP_MUX_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SCTP_MUX, GstSctpMuxClass))
+#define GST_IS_SCTP_MUX(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SCTP_MUX))
+#define GST_IS_SCTP_MUX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SCTP_MUX))
+
+typedef struct _GstSctpMux GstSctpMux;
+typedef struct _GstSctpMuxClass GstSctpMuxClass;
+
+struct _GstSctpMux {
+    GstElement element;
+
+    GstPad *msg_src_pad;
+    gboolean need_stream_start;
+    guint16 local_sctp_port;
+    guint16 remote_sctp_port;
+
+    /* Packets of every association and the received messages, pushed by the task of msg_src */
+    GstDataQueue *outbound_queue;
+
+    /* Bytes of received messages in outbound_queue, protected by receive_lock */
+    guint max_queued_bytes;
+    GMutex receive_lock;
+    GCond receive_cond;
+    guint64 queued_bytes;
+    gboolean receive_flushing;
+
+    /* association id -> GstSctpMuxAssociation, protected by the object lock */
+    GHashTable *associations;
+};
+
+struct _GstSctpMuxClass {
+    GstElementClass parent_class;
+
+    void (*on_sctp_association_is_established)(GstSctpMux *sctp_mux, guint association_id,
+        gboolean established);
+    gboolean (*on_send_message)(GstSctpMux *sctp_mux, guint association_id, guint stream_id,
+        guint ppid, gboolean ordered, GstBuffer *buffer);
+};
+
+GType gst_sctp_mux_get_type(void);
+
+G_END_DECLS
+
+#endif /* gstsctpmux_h */
@@ -29,13 +29,21 @@
 
 #include "gstsctpdec.h"
 #include "gstsctpenc.h"
+#include "gstsctpimpair.h"
+#include "gstsctpmux.h"
+#include "gstsctpudpsink.h"
+#include "gstsctpudpsrc.h"
 
 #include <gst/gst.h>
 
 static gboolean plugin_init(GstPlugin *plugin)
 {
     return gst_element_register(plugin, "sctpenc", GST_RANK_NONE, GST_TYPE_SCTP_ENC)
-        && gst_element_register(plugin, "sctpdec", GST_RANK_NONE, GST_TYPE_SCTP_DEC);
+        && gst_element_register(plugin, "sctpdec", GST_RANK_NONE, GST_TYPE_SCTP_DEC)
+        && gst_element_register(plugin, "sctpimpair", GST_RANK_NONE, GST_TYPE_SCTP_IMPAIR)
+        && gst_element_register(plugin, "sctpmux", GST_RANK_NONE, GST_TYPE_SCTP_MUX)
+        && gst_element_register(plugin, "sctpudpsink", GST_RANK_NONE, GST_TYPE_SCTP_UDP_SINK)
+        && gst_element_register(plugin, "sctpudpsrc", GST_RANK_NONE, GST_TYPE_SCTP_UDP_SRC);
 }
 
 GST_PLUGIN_DEFINE(
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpring.h"
+
+#define RING_ITEM(ring, pos) (&(ring)->items[(guint) (pos) & (ring)->mask])
+
+static gboolean take_item(GstSctpRing *ring, GstSctpRingItem *item);
+static void drop_overflow(GstSctpRing *ring);
+static gboolean wait_for_room(GstSctpRing *ring);
+static void release_bytes(GstSctpRing *ring, gsize size);
+
+void gst_sctp_ring_init(GstSctpRing *ring, guint capacity)
+{
+    guint size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    ring->items = g_new0(GstSctpRingItem, size);
+    ring->mask = size - 1;
+    ring->head = ring->tail = ring->discard = 0;
+    ring->discarding = FALSE;
+    ring->flushing = FALSE;
+    ring->queued_bytes = 0;
+    ring->max_queued_bytes = 0;
+
+    g_mutex_init(&ring->lock);
+    g_cond_init(&ring->cond);
+    ring->consumer_waiting = 0;
+    ring->producer_waiting = 0;
+    g_queue_init(&ring->overflow);
+    ring->overflowed = 0;
+}
+
+/* Neither the producer nor the consumer may use the ring any more */
+void gst_sctp_ring_clear(GstSctpRing *ring)
+{
+    guint pos;
+
+    for (pos = ring->tail; pos != (guint) ring->head; pos++) {
+        GstSctpRingItem *item = RING_ITEM(ring, pos);
+
+        if (item->object)
+            gst_mini_object_unref(item->object);
+    }
+    g_free(ring->items);
+    ring->items = NULL;
+    drop_overflow(ring);
+
+    g_mutex_clear(&ring->lock);
+    g_cond_clear(&ring->cond);
+}
+
+/* Limits the bytes queued before the producer has to wait (0 = unlimited). May be called from
+ * any thread. */
+void gst_sctp_ring_set_max_bytes(GstSctpRing *ring, guint max_bytes)
+{
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->max_queued_bytes, MIN(max_bytes, G_MAXINT));
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+}
+
+/* Producer side. Takes the object of the item unless the ring is flushing. Waits while the
+ * byte limit is reached. */
+gboolean gst_sctp_ring_push(GstSctpRing *ring, const GstSctpRingItem *item)
+{
+    guint head = ring->head;
+    gint max_bytes;
+
+    if (g_atomic_int_get(&ring->flushing))
+        return FALSE;
+
+    max_bytes = g_atomic_int_get(&ring->max_queued_bytes);
+    if (G_UNLIKELY(max_bytes && g_atomic_int_get(&ring->queued_bytes) >= max_bytes)
+        && !wait_for_room(ring))
+        return FALSE;
+    g_atomic_int_add(&ring->queued_bytes, (gint) MIN(item->size, G_MAXINT));
+
+    if (G_UNLIKELY(g_atomic_int_get(&ring->overflowed)
+        || head - (guint) g_atomic_int_get(&ring->tail) > ring->mask)) {
+        g_mutex_lock(&ring->lock);
+        if (g_atomic_int_get(&ring->flushing)) {
+            g_mutex_unlock(&ring->lock);
+            release_bytes(ring, item->size);
+            return FALSE;
+        }
+        g_queue_push_tail(&ring->overflow, g_slice_dup(GstSctpRingItem, item));
+        g_atomic_int_set(&ring->overflowed, 1);
+        g_cond_broadcast(&ring->cond);
+        g_mutex_unlock(&ring->lock);
+
+        return TRUE;
+    }
+
+    *RING_ITEM(ring, head) = *item;
+    g_atomic_int_set(&ring->head, head + 1);
+
+    /* The consumer sets its flag before checking the head again under the lock, and the
+     * head is updated before the flag is read here, so a wake up is never lost */
+    if (g_atomic_int_get(&ring->consumer_waiting)) {
+        g_mutex_lock(&ring->lock);
+        g_cond_broadcast(&ring->cond);
+        g_mutex_unlock(&ring->lock);
+    }
+
+    return TRUE;
+}
+
+/* Consumer side. Waits for an item, returns FALSE when flushing. */
+gboolean gst_sctp_ring_pop(GstSctpRing *ring, GstSctpRingItem *item)
+{
+    for (;;) {
+        if (g_atomic_int_get(&ring->flushing))
+            return FALSE;
+        if (take_item(ring, item))
+            return TRUE;
+
+        g_mutex_lock(&ring->lock);
+        g_atomic_int_set(&ring->consumer_waiting, 1);
+        while (gst_sctp_ring_is_empty(ring) && !g_atomic_int_get(&ring->flushing))
+            g_cond_wait(&ring->cond, &ring->lock);
+        g_atomic_int_set(&ring->consumer_waiting, 0);
+        g_mutex_unlock(&ring->lock);
+    }
+}
+
+/* Consumer side, never waits */
+gboolean gst_sctp_ring_try_pop(GstSctpRing *ring, GstSctpRingItem *item)
+{
+    if (g_atomic_int_get(&ring->flushing))
+        return FALSE;
+
+    return take_item(ring, item);
+}
+
+/* Consumer side */
+gboolean gst_sctp_ring_is_empty(GstSctpRing *ring)
+{
+    return (guint) g_atomic_int_get(&ring->head) == (guint) ring->tail
+        && !g_atomic_int_get(&ring->overflowed);
+}
+
+void gst_sctp_ring_set_flushing(GstSctpRing *ring, gboolean flushing)
+{
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->flushing, flushing);
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+}
+
+/* Only the consumer moves the tail, so the items in the ring are left for it to drop */
+void gst_sctp_ring_flush(GstSctpRing *ring)
+{
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->discard, g_atomic_int_get(&ring->head));
+    g_atomic_int_set(&ring->discarding, TRUE);
+    drop_overflow(ring);
+    g_mutex_unlock(&ring->lock);
+}
+
+static gboolean take_item(GstSctpRing *ring, GstSctpRingItem *item)
+{
+    guint tail = ring->tail;
+    guint head = g_atomic_int_get(&ring->head);
+    GstSctpRingItem *slot, *overflow_item = NULL;
+
+    /* Left over from before the last flush */
+    if (G_UNLIKELY(g_atomic_int_get(&ring->discarding))) {
+        guint discard = g_atomic_int_get(&ring->discard);
+
+        while (tail != head && tail != discard) {
+            slot = RING_ITEM(ring, tail);
+            gst_mini_object_unref(slot->object);
+            slot->object = NULL;
+            release_bytes(ring, slot->size);
+            tail++;
+        }
+
+        /* A flush in the meantime moved the position further */
+        g_mutex_lock(&ring->lock);
+        if (tail == (guint) g_atomic_int_get(&ring->discard))
+            g_atomic_int_set(&ring->discarding, FALSE);
+        g_mutex_unlock(&ring->lock);
+    }
+
+    if (tail == head && g_atomic_int_get(&ring->overflowed)) {
+        g_mutex_lock(&ring->lock);
+        /* Nothing goes into the ring while it overflowed, but the items pushed into it
+         * before have to come first */
+        head = g_atomic_int_get(&ring->head);
+        if (tail == head) {
+            overflow_item = g_queue_pop_head(&ring->overflow);
+            if (g_queue_is_empty(&ring->overflow))
+                g_atomic_int_set(&ring->overflowed, 0);
+        }
+        g_mutex_unlock(&ring->lock);
+    }
+
+    if (tail == head) {
+        g_atomic_int_set(&ring->tail, tail);
+        if (!overflow_item)
+            return FALSE;
+
+        *item = *overflow_item;
+        g_slice_free(GstSctpRingItem, overflow_item);
+        release_bytes(ring, item->size);
+        return TRUE;
+    }
+
+    slot = RING_ITEM(ring, tail);
+    *item = *slot;
+    slot->object = NULL;
+    g_atomic_int_set(&ring->tail, tail + 1);
+    release_bytes(ring, item->size);
+
+    return TRUE;
+}
+
+/* Producer side. Returns FALSE when the ring started flushing while waiting. */
+static gboolean wait_for_room(GstSctpRing *ring)
+{
+    gboolean ret;
+
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->producer_waiting, 1);
+    while (!g_atomic_int_get(&ring->flushing) && g_atomic_int_get(&ring->max_queued_bytes)
+        && g_atomic_int_get(&ring->queued_bytes) >= g_atomic_int_get(&ring->max_queued_bytes))
+        g_cond_wait(&ring->cond, &ring->lock);
+    g_atomic_int_set(&ring->producer_waiting, 0);
+    ret = !g_atomic_int_get(&ring->flushing);
+    g_mutex_unlock(&ring->lock);
+
+    return ret;
+}
+
+/* The producer sets its flag before checking the bytes again under the lock, like the
+ * consumer does for the head */
+static void release_bytes(GstSctpRing *ring, gsize size)
+{
+    g_atomic_int_add(&ring->queued_bytes, -(gint) MIN(size, G_MAXINT));
+
+    if (g_atomic_int_get(&ring->producer_waiting)) {
+        g_mutex_lock(&ring->lock);
+        g_cond_broadcast(&ring->cond);
+        g_mutex_unlock(&ring->lock);
+    }
+}
+
+/* Called with the lock */
+static void drop_overflow(GstSctpRing *ring)
+{
+    GstSctpRingItem *item;
+
+    while ((item = g_queue_pop_head(&ring->overflow))) {
+        gst_mini_object_unref(item->object);
+        g_atomic_int_add(&ring->queued_bytes, -(gint) MIN(item->size, G_MAXINT));
+        g_slice_free(GstSctpRingItem, item);
+    }
+    g_atomic_int_set(&ring->overflowed, 0);
+    g_cond_broadcast(&ring->cond);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctpring_h
+#define gstsctpring_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Single-producer/single-consumer queue between an association callback and a pad task.
+ *
+ * Pushing and popping only touch a fixed array of slots and two atomic counters. The mutex
+ * is only taken when the consumer sleeps on an empty ring and to wake it up, and when the
+ * producer finds the ring full. The items that do not fit then go to an overflow list that
+ * the producer keeps using until the consumer emptied it, so the order is kept.
+ *
+ * With a byte limit set the producer waits while the items queued add up to it, so a slow
+ * consumer holds back the producer instead of growing the queue. Without one the queue is as
+ * unbounded as a GstDataQueue that is never full, for producers that are bounded elsewhere.
+ *
+ * Flushing makes both sides return FALSE. The consumer drops what was queued in the ring
+ * before the flush on its next pop, so gst_sctp_ring_flush() may be called from any thread.
+ */
+
+typedef struct {
+    GstMiniObject *object;
+    gsize size;
+    /* Set when the object is traced, for the time spent queued */
+    gboolean traced;
+    guint16 stream_id;
+    gint64 queued_time;
+} GstSctpRingItem;
+
+typedef struct {
+    GstSctpRingItem *items;
+    guint mask;
+
+    /* Free running, written by the producer and the consumer respectively */
+    gint head;
+    gint tail;
+    /* While discarding, the consumer drops the items in the ring before this position. It stops
+     * once it reached it, so the position is never compared to one far away. */
+    gint discard;
+    gint discarding;
+    gint flushing;
+
+    /* Sizes of the items in the ring and the overflow list, and the limit (0 = none) */
+    gint queued_bytes;
+    gint max_queued_bytes;
+
+    GMutex lock;
+    GCond cond;
+    gint consumer_waiting;
+    gint producer_waiting;
+    /* Protected by the lock. overflowed is only set by the producer and only cleared once
+     * the overflow list is empty. */
+    GQueue overflow;
+    gint overflowed;
+} GstSctpRing;
+
+void gst_sctp_ring_init(GstSctpRing *ring, guint capacity);
+void gst_sctp_ring_clear(GstSctpRing *ring);
+void gst_sctp_ring_set_max_bytes(GstSctpRing *ring, guint max_bytes);
+gboolean gst_sctp_ring_push(GstSctpRing *ring, const GstSctpRingItem *item);
+gboolean gst_sctp_ring_pop(GstSctpRing *ring, GstSctpRingItem *item);
+gboolean gst_sctp_ring_try_pop(GstSctpRing *ring, GstSctpRingItem *item);
+gboolean gst_sctp_ring_is_empty(GstSctpRing *ring);
+void gst_sctp_ring_set_flushing(GstSctpRing *ring, gboolean flushing);
+void gst_sctp_ring_flush(GstSctpRing *ring);
+
+G_END_DECLS
+
+#endif /* gstsctpring_h */
@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctptrace.h"
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_sctp_trace_debug_category);
+#define GST_CAT_DEFAULT gst_sctp_trace_debug_category
+
+#define SCTP_COMMON_HEADER_SIZE 12
+#define SCTP_CHUNK_HEADER_SIZE 4
+#define SCTP_DATA_CHUNK_HEADER_SIZE 16
+#define SCTP_CHUNK_TYPE_DATA 0
+#define SCTP_DATA_FLAG_FIRST_FRAGMENT 0x02
+#define SCTP_DATA_FLAG_LAST_FRAGMENT 0x01
+
+static const gchar *interval_names[GST_SCTP_TRACE_N_INTERVALS] = {
+    "send-blocked",
+    "send-buffered",
+    "outbound-queued",
+    "receive-processing",
+    "inbound-queued"
+};
+
+typedef struct {
+    guint32 index;
+    /* As sent, known once accepted */
+    guint32 length;
+    gint64 chained_time;
+    gint64 accepted_time;
+    gint64 emitted_time;
+    /* The first fragment when it was emitted before the message was accepted */
+    guint32 fragment_length;
+    gboolean last_fragment;
+} PendingMessage;
+
+typedef struct {
+    GstSctpTraceHistogram histograms[GST_SCTP_TRACE_N_INTERVALS];
+    /* First transmissions of messages seen in outgoing packets and messages dropped unsent */
+    guint32 messages_emitted;
+    /* PendingMessage sorted by index */
+    GQueue pending;
+} TraceStream;
+
+static void clear_pending(TraceStream *stream)
+{
+    PendingMessage *msg;
+
+    while ((msg = g_queue_pop_head(&stream->pending)))
+        g_slice_free(PendingMessage, msg);
+}
+
+static void trace_stream_free(TraceStream *stream)
+{
+    clear_pending(stream);
+    g_slice_free(TraceStream, stream);
+}
+
+/* Must be called with the lock held */
+static TraceStream *get_stream(GstSctpTrace *trace, guint16 stream_id)
+{
+    TraceStream *stream;
+
+    stream = g_hash_table_lookup(trace->streams, GUINT_TO_POINTER(stream_id));
+    if (!stream) {
+        stream = g_slice_new0(TraceStream);
+        g_queue_init(&stream->pending);
+        g_hash_table_insert(trace->streams, GUINT_TO_POINTER(stream_id), stream);
+    }
+    return stream;
+}
+
+/* Must be called with the lock held */
+static void add_sample(GstSctpTrace *trace, TraceStream *stream, guint16 stream_id,
+    GstSctpTraceInterval interval, gint64 start, gint64 end)
+{
+    GstSctpTraceHistogram *histogram = &stream->histograms[interval];
+    guint64 duration = end > start ? (guint64) (end - start) : 0;
+
+    histogram->buckets[MIN(g_bit_storage(duration), GST_SCTP_TRACE_HISTOGRAM_BUCKETS - 1)]++;
+    histogram->count++;
+    histogram->sum += duration;
+    histogram->max = MAX(histogram->max, duration);
+
+    GST_CAT_TRACE_OBJECT(GST_CAT_DEFAULT, trace->owner,
+        "sctp-latency, stream=(uint)%u, interval=(string)%s, start=(gint64)%" G_GINT64_FORMAT
+        ", duration-us=(guint64)%" G_GUINT64_FORMAT ";", stream_id, interval_names[interval], start,
+        duration);
+}
+
+void gst_sctp_trace_init(GstSctpTrace *trace, GstObject *owner)
+{
+    static gsize debug_initialized = 0;
+
+    if (g_once_init_enter(&debug_initialized)) {
+        GST_DEBUG_CATEGORY_INIT(gst_sctp_trace_debug_category, "sctptrace", 0,
+            "sampled latency of sctpenc and sctpdec");
+        g_once_init_leave(&debug_initialized, 1);
+    }
+
+    memset(trace, 0, sizeof(GstSctpTrace));
+    trace->owner = owner;
+    g_mutex_init(&trace->lock);
+    trace->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+        (GDestroyNotify) trace_stream_free);
+}
+
+void gst_sctp_trace_clear(GstSctpTrace *trace)
+{
+    g_hash_table_destroy(trace->streams);
+    g_mutex_clear(&trace->lock);
+}
+
+void gst_sctp_trace_set_interval(GstSctpTrace *trace, guint interval)
+{
+    g_atomic_int_set(&trace->interval, (gint) MIN(interval, G_MAXINT));
+}
+
+guint gst_sctp_trace_get_interval(GstSctpTrace *trace)
+{
+    return (guint) g_atomic_int_get(&trace->interval);
+}
+
+gboolean gst_sctp_trace_sample(GstSctpTrace *trace)
+{
+    gint interval = g_atomic_int_get(&trace->interval);
+
+    if (interval == 0)
+        return FALSE;
+    return (guint) g_atomic_int_add(&trace->counter, 1) % (guint) interval == 0;
+}
+
+void gst_sctp_trace_record(GstSctpTrace *trace, guint16 stream_id, GstSctpTraceInterval interval,
+    gint64 start, gint64 end)
+{
+    g_mutex_lock(&trace->lock);
+    add_sample(trace, get_stream(trace, stream_id), stream_id, interval, start, end);
+    g_mutex_unlock(&trace->lock);
+}
+
+/* The messages of a stream are counted from 0 again, as for a newly requested pad */
+void gst_sctp_trace_reset_stream(GstSctpTrace *trace, guint16 stream_id)
+{
+    TraceStream *stream;
+
+    g_mutex_lock(&trace->lock);
+    stream = g_hash_table_lookup(trace->streams, GUINT_TO_POINTER(stream_id));
+    if (stream) {
+        clear_pending(stream);
+        stream->messages_emitted = 0;
+    }
+    g_mutex_unlock(&trace->lock);
+}
+
+/* index counts the messages sent on the stream, starting at 0. A message that is chained again
+ * after it failed to send replaces the earlier attempt. */
+void gst_sctp_trace_message_chained(GstSctpTrace *trace, guint16 stream_id, guint32 index,
+    gint64 time)
+{
+    TraceStream *stream;
+    PendingMessage *msg;
+
+    g_mutex_lock(&trace->lock);
+    stream = get_stream(trace, stream_id);
+    msg = g_queue_peek_tail(&stream->pending);
+    if (!msg || msg->index != index) {
+        msg = g_slice_new0(PendingMessage);
+        msg->index = index;
+        g_queue_push_tail(&stream->pending, msg);
+    }
+    msg->chained_time = time;
+    msg->accepted_time = 0;
+    msg->emitted_time = 0;
+    g_mutex_unlock(&trace->lock);
+}
+
+/* The counts drift apart over a lost or mismatched message, this keeps a wrong message from being
+ * taken for the traced one */
+static gboolean fragment_matches(PendingMessage *msg, guint32 fragment_length, gboolean last)
+{
+    return last ? fragment_length == msg->length : fragment_length < msg->length;
+}
+
+void gst_sctp_trace_message_accepted(GstSctpTrace *trace, guint16 stream_id, guint32 index,
+    guint32 length, gint64 time)
+{
+    TraceStream *stream;
+    PendingMessage *msg;
+    GList *l;
+
+    g_mutex_lock(&trace->lock);
+    stream = get_stream(trace, stream_id);
+    for (l = stream->pending.tail; l; l = l->prev) {
+        msg = l->data;
+        if (msg->index != index)
+            continue;
+
+        msg->accepted_time = time;
+        msg->length = length;
+        add_sample(trace, stream, stream_id, GST_SCTP_TRACE_INTERVAL_SEND_BLOCKED,
+            msg->chained_time, time);
+        /* Already sent from within the send call */
+        if (msg->emitted_time) {
+            if (fragment_matches(msg, msg->fragment_length, msg->last_fragment)) {
+                add_sample(trace, stream, stream_id, GST_SCTP_TRACE_INTERVAL_SEND_BUFFERED, time,
+                    time);
+            }
+            g_queue_delete_link(&stream->pending, l);
+            g_slice_free(PendingMessage, msg);
+        }
+        break;
+    }
+    g_mutex_unlock(&trace->lock);
+}
+
+/* A message the stack dropped before it got a TSN never shows up in a packet, it is counted here
+ * instead. usrsctp may report every fragment of such a message, the count then runs ahead and the
+ * traced messages in between are skipped rather than matched with the wrong one. */
+void gst_sctp_trace_message_dropped(GstSctpTrace *trace, guint16 stream_id)
+{
+    g_mutex_lock(&trace->lock);
+    get_stream(trace, stream_id)->messages_emitted++;
+    g_mutex_unlock(&trace->lock);
+}
+
+/* Must be called with the lock held. Returns TRUE if the chunk started a traced message. */
+static gboolean handle_first_fragment(GstSctpTrace *trace, guint16 stream_id,
+    guint32 fragment_length, gboolean last, gint64 time)
+{
+    TraceStream *stream = get_stream(trace, stream_id);
+    guint32 index = stream->messages_emitted++;
+    PendingMessage *msg;
+    gboolean matched;
+
+    /* Messages that never showed up were abandoned or flushed before they were sent */
+    while ((msg = g_queue_peek_head(&stream->pending)) && msg->index < index) {
+        g_queue_pop_head(&stream->pending);
+        g_slice_free(PendingMessage, msg);
+    }
+
+    if (!msg || msg->index != index)
+        return FALSE;
+
+    if (!msg->accepted_time) {
+        /* Sent from within the send call, checked once it returns with the length */
+        msg->emitted_time = time;
+        msg->fragment_length = fragment_length;
+        msg->last_fragment = last;
+        return TRUE;
+    }
+
+    matched = fragment_matches(msg, fragment_length, last);
+    if (matched) {
+        add_sample(trace, stream, stream_id, GST_SCTP_TRACE_INTERVAL_SEND_BUFFERED,
+            msg->accepted_time, time);
+    }
+    g_queue_pop_head(&stream->pending);
+    g_slice_free(PendingMessage, msg);
+    return matched;
+}
+
+/* Matches the first transmission of each message in an outgoing SCTP packet against the
+ * traced messages. Returns TRUE and the stream of the traced message if the packet carries one. */
+gboolean gst_sctp_trace_packet_emitted(GstSctpTrace *trace, const guint8 *data, gsize length,
+    gint64 time, guint16 *stream_id)
+{
+    gboolean traced = FALSE;
+    gsize offset = SCTP_COMMON_HEADER_SIZE;
+
+    g_mutex_lock(&trace->lock);
+    while (offset + SCTP_CHUNK_HEADER_SIZE <= length) {
+        guint8 type = data[offset];
+        guint8 flags = data[offset + 1];
+        guint16 chunk_length = GST_READ_UINT16_BE(data + offset + 2);
+
+        if (chunk_length < SCTP_CHUNK_HEADER_SIZE)
+            break;
+
+        if (type == SCTP_CHUNK_TYPE_DATA && offset + SCTP_DATA_CHUNK_HEADER_SIZE <= length) {
+            guint32 tsn = GST_READ_UINT32_BE(data + offset + 4);
+            guint16 sid = GST_READ_UINT16_BE(data + offset + 8);
+
+            /* Retransmissions reuse their TSN and are not counted again */
+            if (!trace->have_tsn || (gint32) (tsn - trace->highest_tsn) > 0) {
+                trace->highest_tsn = tsn;
+                trace->have_tsn = TRUE;
+                if ((flags & SCTP_DATA_FLAG_FIRST_FRAGMENT)
+                    && handle_first_fragment(trace, sid,
+                        chunk_length - SCTP_DATA_CHUNK_HEADER_SIZE,
+                        flags & SCTP_DATA_FLAG_LAST_FRAGMENT, time) && !traced) {
+                    traced = TRUE;
+                    *stream_id = sid;
+                }
+            }
+        }
+
+        offset += (chunk_length + 3) & ~3;
+    }
+    g_mutex_unlock(&trace->lock);
+
+    return traced;
+}
+
+static GstStructure *histogram_to_structure(const GstSctpTraceHistogram *histogram)
+{
+    GstStructure *s;
+    GValue buckets = G_VALUE_INIT;
+    GValue value = G_VALUE_INIT;
+    guint i;
+
+    g_value_init(&buckets, GST_TYPE_ARRAY);
+    g_value_init(&value, G_TYPE_UINT64);
+    for (i = 0; i < GST_SCTP_TRACE_HISTOGRAM_BUCKETS; i++) {
+        g_value_set_uint64(&value, histogram->buckets[i]);
+        gst_value_array_append_value(&buckets, &value);
+    }
+    g_value_unset(&value);
+
+    s = gst_structure_new("histogram",
+        "count", G_TYPE_UINT64, histogram->count,
+        "mean-us", G_TYPE_UINT64, histogram->count ? histogram->sum / histogram->count : 0,
+        "max-us", G_TYPE_UINT64, histogram->max,
+        NULL);
+    gst_structure_take_value(s, "buckets", &buckets);
+
+    return s;
+}
+
+/* One structure per stream, with a histogram per interval. Bucket 0 counts durations below
+ * 1 us, bucket n durations from 2^(n-1) us up to 2^n us. */
+GstStructure *gst_sctp_trace_get_histograms(GstSctpTrace *trace)
+{
+    GstStructure *result, *stream_structure, *histogram;
+    GHashTableIter iter;
+    gpointer key, value;
+    gchar *name;
+    guint i;
+
+    result = gst_structure_new_empty("application/x-sctp-latency");
+
+    g_mutex_lock(&trace->lock);
+    g_hash_table_iter_init(&iter, trace->streams);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        TraceStream *stream = value;
+
+        name = g_strdup_printf("stream-%u", GPOINTER_TO_UINT(key));
+        stream_structure = gst_structure_new_empty(name);
+        for (i = 0; i < GST_SCTP_TRACE_N_INTERVALS; i++) {
+            if (!stream->histograms[i].count)
+                continue;
+            histogram = histogram_to_structure(&stream->histograms[i]);
+            gst_structure_set(stream_structure, interval_names[i], GST_TYPE_STRUCTURE, histogram,
+                NULL);
+            gst_structure_free(histogram);
+        }
+        gst_structure_set(result, name, GST_TYPE_STRUCTURE, stream_structure, NULL);
+        gst_structure_free(stream_structure);
+        g_free(name);
+    }
+    g_mutex_unlock(&trace->lock);
+
+    return result;
+}
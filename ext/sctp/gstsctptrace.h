@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctptrace_h
+#define gstsctptrace_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Sampled per-message latency tracing for sctpenc and sctpdec.
+ *
+ * A traced message is timestamped at each stage it passes:
+ *
+ *   sctpenc: chain entry -> send accepted -> packet emitted -> packet pushed
+ *   sctpdec: packet received -> message delivered -> pad pushed
+ *
+ * and the time between two stages is added to a per-stream histogram. Every record is also
+ * logged on the sctptrace debug category at TRACE level in the GstTracer log format.
+ */
+
+typedef enum {
+    /* Chain entry to send accepted: blocked in sctpenc's retry loop */
+    GST_SCTP_TRACE_INTERVAL_SEND_BLOCKED,
+    /* Send accepted to the first packet carrying the message: in the association's send buffer */
+    GST_SCTP_TRACE_INTERVAL_SEND_BUFFERED,
+    /* Packet emitted to pushed on sctpenc's src pad: in outbound_sctp_packet_queue */
+    GST_SCTP_TRACE_INTERVAL_OUTBOUND_QUEUED,
+    /* Packet received to the message being delivered by the association */
+    GST_SCTP_TRACE_INTERVAL_RECEIVE_PROCESSING,
+    /* Message delivered to pushed on sctpdec's src pad: in the pad's packet queue */
+    GST_SCTP_TRACE_INTERVAL_INBOUND_QUEUED,
+
+    GST_SCTP_TRACE_N_INTERVALS
+} GstSctpTraceInterval;
+
+/* Log2 buckets in microseconds, the last one collects everything above 2^22 us */
+#define GST_SCTP_TRACE_HISTOGRAM_BUCKETS 24
+
+typedef struct {
+    guint64 buckets[GST_SCTP_TRACE_HISTOGRAM_BUCKETS];
+    guint64 count;
+    guint64 sum;
+    guint64 max;
+} GstSctpTraceHistogram;
+
+typedef struct {
+    GstObject *owner;
+    /* Trace one message out of interval, 0 disables tracing */
+    gint interval;
+    gint counter;
+
+    /* Protects streams and highest_tsn */
+    GMutex lock;
+    GHashTable *streams;
+    guint32 highest_tsn;
+    gboolean have_tsn;
+} GstSctpTrace;
+
+#define gst_sctp_trace_is_enabled(trace) (g_atomic_int_get(&(trace)->interval) != 0)
+
+void gst_sctp_trace_init(GstSctpTrace *trace, GstObject *owner);
+void gst_sctp_trace_clear(GstSctpTrace *trace);
+void gst_sctp_trace_set_interval(GstSctpTrace *trace, guint interval);
+guint gst_sctp_trace_get_interval(GstSctpTrace *trace);
+gboolean gst_sctp_trace_sample(GstSctpTrace *trace);
+void gst_sctp_trace_record(GstSctpTrace *trace, guint16 stream_id, GstSctpTraceInterval interval,
+    gint64 start, gint64 end);
+void gst_sctp_trace_reset_stream(GstSctpTrace *trace, guint16 stream_id);
+void gst_sctp_trace_message_chained(GstSctpTrace *trace, guint16 stream_id, guint32 index,
+    gint64 time);
+void gst_sctp_trace_message_accepted(GstSctpTrace *trace, guint16 stream_id, guint32 index,
+    guint32 length, gint64 time);
+void gst_sctp_trace_message_dropped(GstSctpTrace *trace, guint16 stream_id);
+gboolean gst_sctp_trace_packet_emitted(GstSctpTrace *trace, const guint8 *data, gsize length,
+    gint64 time, guint16 *stream_id);
+GstStructure *gst_sctp_trace_get_histograms(GstSctpTrace *trace);
+
+G_END_DECLS
+
+#endif /* gstsctptrace_h */
@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * sctpudpsink sends the packets of sctpenc or sctpmux as UDP datagrams (RFC 6951), for links that
+ * need no DTLS or ICE, e.g. between servers of a cluster:
+ *
+ *   sctpenc ! sctpudpsink host=10.0.0.2 port=9899
+ *
+ * Buffer lists are sent with as few sendmmsg() calls as batch-size allows. Runs of packets of
+ * equal size are handed to the kernel as one UDP GSO send where it is supported. The tos byte of
+ * the GstSctpPacketMeta is set on every datagram, so DSCP and ECN marks reach the network.
+ */
+
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpudpsink.h"
+
+#include <gst/sctp/sctppacketmeta.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_sctp_udp_sink_debug_category);
+#define GST_CAT_DEFAULT gst_sctp_udp_sink_debug_category
+
+#define gst_sctp_udp_sink_parent_class parent_class
+G_DEFINE_TYPE(GstSctpUdpSink, gst_sctp_udp_sink, GST_TYPE_ELEMENT);
+
+#ifndef HAVE_SENDMMSG
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-sctp"));
+
+enum {
+    PROP_0,
+
+    PROP_HOST,
+    PROP_PORT,
+    PROP_BIND_PORT,
+    PROP_BUFFER_SIZE,
+    PROP_BATCH_SIZE,
+    PROP_GSO,
+    PROP_STATS,
+
+    NUM_PROPERTIES
+};
+
+static GParamSpec *properties[NUM_PROPERTIES];
+
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT 9899
+#define DEFAULT_BIND_PORT 0
+#define DEFAULT_BUFFER_SIZE 0
+#define DEFAULT_BATCH_SIZE 64
+#define DEFAULT_GSO TRUE
+
+/* Limits of one UDP GSO send in the Linux kernel */
+#define GSO_MAX_SEGMENTS 64
+#define GSO_MAX_BYTES 65000
+/* Room for a tos or traffic class and a GSO segment size */
+#define CONTROL_SIZE (CMSG_SPACE(sizeof(gint)) + CMSG_SPACE(sizeof(guint16)))
+
+static void gst_sctp_udp_sink_finalize(GObject *object);
+static void gst_sctp_udp_sink_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec);
+static void gst_sctp_udp_sink_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec);
+static GstStateChangeReturn gst_sctp_udp_sink_change_state(GstElement *element,
+    GstStateChange transition);
+static GstFlowReturn gst_sctp_udp_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static GstFlowReturn gst_sctp_udp_sink_chain_list(GstPad *pad, GstObject *parent,
+    GstBufferList *list);
+
+static gboolean open_socket(GstSctpUdpSink *self);
+static gboolean probe_gso(GstSctpUdpSink *self);
+static void close_socket(GstSctpUdpSink *self);
+static void send_packets(GstSctpUdpSink *self, GstBuffer **buffers, guint n_buffers);
+static guint send_batch(GstSctpUdpSink *self, GstBuffer **buffers, guint n_buffers);
+static GstStructure *create_stats(GstSctpUdpSink *self);
+
+static void gst_sctp_udp_sink_class_init(GstSctpUdpSinkClass *klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *element_class;
+
+    gobject_class = (GObjectClass *) klass;
+    element_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT(gst_sctp_udp_sink_debug_category,
+        "sctpudpsink", 0, "debug category for sctpudpsink element");
+
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&sink_template));
+
+    gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_finalize);
+    gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_set_property);
+    gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_get_property);
+
+    element_class->change_state = GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_change_state);
+
+    properties[PROP_HOST] =
+        g_param_spec_string("host",
+            "Host",
+            "Address or name of the peer",
+            DEFAULT_HOST,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PORT] =
+        g_param_spec_uint("port",
+            "Port",
+            "UDP port of the peer. 9899 is the port registered for SCTP over UDP.",
+            1, G_MAXUSHORT, DEFAULT_PORT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BIND_PORT] =
+        g_param_spec_uint("bind-port",
+            "Bind port",
+            "Local UDP port the packets are sent from (0 = any)",
+            0, G_MAXUSHORT, DEFAULT_BIND_PORT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BUFFER_SIZE] =
+        g_param_spec_uint("buffer-size",
+            "Buffer size",
+            "Size of the kernel send buffer in bytes (0 = system default)",
+            0, G_MAXINT, DEFAULT_BUFFER_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BATCH_SIZE] =
+        g_param_spec_uint("batch-size",
+            "Batch size",
+            "Maximum number of datagrams handed to the kernel in one system call",
+            1, 1024, DEFAULT_BATCH_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_GSO] =
+        g_param_spec_boolean("gso",
+            "GSO",
+            "Send runs of equally sized packets with UDP generic segmentation offload where the "
+            "kernel supports it",
+            DEFAULT_GSO,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Counters of the packets and system calls",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+
+    gst_element_class_set_static_metadata(element_class,
+        "SCTP over UDP sink",
+        "Sink/Network/SCTP",
+        "Sends SCTP packets encapsulated in UDP (RFC 6951)",
+        "OpenWebRTC GStreamer plugins");
+}
+
+static void gst_sctp_udp_sink_init(GstSctpUdpSink *self)
+{
+    self->host = g_strdup(DEFAULT_HOST);
+    self->port = DEFAULT_PORT;
+    self->bind_port = DEFAULT_BIND_PORT;
+    self->buffer_size = DEFAULT_BUFFER_SIZE;
+    self->batch_size = DEFAULT_BATCH_SIZE;
+    self->gso = DEFAULT_GSO;
+    self->fd = -1;
+
+    self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
+    gst_pad_set_chain_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_chain));
+    gst_pad_set_chain_list_function(self->sink_pad,
+        GST_DEBUG_FUNCPTR(gst_sctp_udp_sink_chain_list));
+    gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
+
+    GST_OBJECT_FLAG_SET(self, GST_ELEMENT_FLAG_SINK);
+}
+
+static void gst_sctp_udp_sink_finalize(GObject *object)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(object);
+
+    close_socket(self);
+    g_free(self->host);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_sctp_udp_sink_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_HOST:
+        g_free(self->host);
+        self->host = g_value_dup_string(value);
+        break;
+    case PROP_PORT:
+        self->port = g_value_get_uint(value);
+        break;
+    case PROP_BIND_PORT:
+        self->bind_port = g_value_get_uint(value);
+        break;
+    case PROP_BUFFER_SIZE:
+        self->buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_BATCH_SIZE:
+        self->batch_size = g_value_get_uint(value);
+        break;
+    case PROP_GSO:
+        self->gso = g_value_get_boolean(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_sctp_udp_sink_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_HOST:
+        g_value_set_string(value, self->host);
+        break;
+    case PROP_PORT:
+        g_value_set_uint(value, self->port);
+        break;
+    case PROP_BIND_PORT:
+        g_value_set_uint(value, self->bind_port);
+        break;
+    case PROP_BUFFER_SIZE:
+        g_value_set_uint(value, self->buffer_size);
+        break;
+    case PROP_BATCH_SIZE:
+        g_value_set_uint(value, self->batch_size);
+        break;
+    case PROP_GSO:
+        g_value_set_boolean(value, self->gso);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, create_stats(self));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static GstStateChangeReturn gst_sctp_udp_sink_change_state(GstElement *element,
+    GstStateChange transition)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(element);
+    GstStateChangeReturn ret;
+
+    if (transition == GST_STATE_CHANGE_READY_TO_PAUSED && !open_socket(self))
+        return GST_STATE_CHANGE_FAILURE;
+
+    ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+
+    if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+        close_socket(self);
+
+    return ret;
+}
+
+static GstFlowReturn gst_sctp_udp_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(parent);
+
+    send_packets(self, &buffer, 1);
+    gst_buffer_unref(buffer);
+
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn gst_sctp_udp_sink_chain_list(GstPad *pad, GstObject *parent,
+    GstBufferList *list)
+{
+    GstSctpUdpSink *self = GST_SCTP_UDP_SINK(parent);
+    GstBuffer **buffers;
+    guint i, length;
+
+    length = gst_buffer_list_length(list);
+    buffers = g_new(GstBuffer *, length);
+    for (i = 0; i < length; i++)
+        buffers[i] = gst_buffer_list_get(list, i);
+    send_packets(self, buffers, length);
+    g_free(buffers);
+    gst_buffer_list_unref(list);
+
+    return GST_FLOW_OK;
+}
+
+static gboolean open_socket(GstSctpUdpSink *self)
+{
+    struct addrinfo hints, *result = NULL;
+    struct sockaddr_storage bind_addr;
+    gchar port[8];
+    gchar *host;
+    guint bind_port, buffer_size, batch_size;
+    gboolean gso;
+    gint err, value;
+
+    GST_OBJECT_LOCK(self);
+    host = g_strdup(self->host);
+    g_snprintf(port, sizeof(port), "%u", self->port);
+    bind_port = self->bind_port;
+    buffer_size = self->buffer_size;
+    batch_size = self->batch_size;
+    gso = self->gso;
+    self->packets_sent = self->bytes_sent = self->send_calls = 0;
+    self->gso_sends = self->send_errors = 0;
+    GST_OBJECT_UNLOCK(self);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    err = getaddrinfo(host, port, &hints, &result);
+    if (err != 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, (NULL),
+            ("Could not resolve %s: %s", host, gai_strerror(err)));
+        goto error;
+    }
+
+    self->family = result->ai_family;
+    memcpy(&self->addr, result->ai_addr, result->ai_addrlen);
+    self->addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+
+#ifdef SOCK_CLOEXEC
+    self->fd = socket(self->family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+#else
+    self->fd = socket(self->family, SOCK_DGRAM, IPPROTO_UDP);
+    if (self->fd >= 0)
+        fcntl(self->fd, F_SETFD, FD_CLOEXEC);
+#endif
+    if (self->fd < 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, OPEN_WRITE, (NULL),
+            ("Could not create socket: %s", g_strerror(errno)));
+        goto error;
+    }
+
+    if (bind_port) {
+        memset(&bind_addr, 0, sizeof(bind_addr));
+        bind_addr.ss_family = self->family;
+        if (self->family == AF_INET)
+            ((struct sockaddr_in *) &bind_addr)->sin_port = htons(bind_port);
+        else
+            ((struct sockaddr_in6 *) &bind_addr)->sin6_port = htons(bind_port);
+        if (bind(self->fd, (struct sockaddr *) &bind_addr, self->addr_len) < 0) {
+            GST_ELEMENT_ERROR(self, RESOURCE, OPEN_WRITE, (NULL),
+                ("Could not bind to port %u: %s", bind_port, g_strerror(errno)));
+            goto error;
+        }
+    }
+
+    if (buffer_size) {
+        value = buffer_size;
+        if (setsockopt(self->fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)) < 0)
+            GST_WARNING_OBJECT(self, "Could not set the send buffer size: %s", g_strerror(errno));
+    }
+
+#ifdef IP_PMTUDISC_PROBE
+    /* SCTP discovers the path MTU itself, the kernel must neither fragment nor clamp packets */
+    value = IP_PMTUDISC_PROBE;
+    if (self->family == AF_INET)
+        setsockopt(self->fd, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value));
+    else
+        setsockopt(self->fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &value, sizeof(value));
+#endif
+
+    self->gso_enabled = gso && probe_gso(self);
+
+    self->max_msgs = batch_size;
+    self->msgs = g_new0(struct mmsghdr, batch_size);
+    self->iovs = g_new0(struct iovec, batch_size);
+    self->maps = g_new0(GstMapInfo, batch_size);
+    self->mapped = g_new0(GstBuffer *, batch_size);
+    self->control = g_malloc0(batch_size * CONTROL_SIZE);
+
+    g_free(host);
+    return TRUE;
+error:
+    close_socket(self);
+    g_free(host);
+    return FALSE;
+}
+
+static void close_socket(GstSctpUdpSink *self)
+{
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    g_free(self->msgs);
+    self->msgs = NULL;
+    g_free(self->iovs);
+    self->iovs = NULL;
+    g_free(self->maps);
+    self->maps = NULL;
+    g_free(self->mapped);
+    self->mapped = NULL;
+    g_free(self->control);
+    self->control = NULL;
+}
+
+/* Kernels before 4.18 ignore the UDP_SEGMENT cmsg and would send a run of packets as one
+ * datagram, so packets are only coalesced if the socket option is known */
+static gboolean probe_gso(GstSctpUdpSink *self)
+{
+#ifdef UDP_SEGMENT
+    gint value = 0;
+    socklen_t len = sizeof(value);
+
+    if (setsockopt(self->fd, SOL_UDP, UDP_SEGMENT, &value, sizeof(value)) < 0
+        || getsockopt(self->fd, SOL_UDP, UDP_SEGMENT, &value, &len) < 0) {
+        GST_INFO_OBJECT(self, "UDP GSO is not supported: %s", g_strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+#else
+    GST_INFO_OBJECT(self, "UDP GSO is not supported on this platform");
+    return FALSE;
+#endif
+}
+
+static guint8 get_tos(GstBuffer *buffer)
+{
+    GstSctpPacketMeta *packet_meta = gst_sctp_buffer_get_packet_meta(buffer);
+
+    return packet_meta ? packet_meta->tos : 0;
+}
+
+/* Fills in the ancillary data of one datagram, or one GSO send of several */
+static void set_control(GstSctpUdpSink *self, struct msghdr *msg, guint8 *control, guint8 tos,
+    guint16 segment_size)
+{
+    struct cmsghdr *cmsg;
+    gsize control_len = 0;
+    gint tclass = tos;
+
+    msg->msg_control = control;
+    msg->msg_controllen = CONTROL_SIZE;
+    cmsg = CMSG_FIRSTHDR(msg);
+
+    if (tos) {
+        cmsg->cmsg_level = self->family == AF_INET ? IPPROTO_IP : IPPROTO_IPV6;
+        cmsg->cmsg_type = self->family == AF_INET ? IP_TOS : IPV6_TCLASS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(gint));
+        memcpy(CMSG_DATA(cmsg), &tclass, sizeof(gint));
+        control_len += CMSG_SPACE(sizeof(gint));
+        cmsg = CMSG_NXTHDR(msg, cmsg);
+    }
+
+#ifdef UDP_SEGMENT
+    if (segment_size) {
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(guint16));
+        memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(guint16));
+        control_len += CMSG_SPACE(sizeof(guint16));
+    }
+#endif
+
+    msg->msg_controllen = control_len;
+    if (!control_len)
+        msg->msg_control = NULL;
+}
+
+static void send_packets(GstSctpUdpSink *self, GstBuffer **buffers, guint n_buffers)
+{
+    guint done = 0;
+
+    if (G_UNLIKELY(self->fd < 0))
+        return;
+
+    while (done < n_buffers)
+        done += send_batch(self, buffers + done, n_buffers - done);
+}
+
+/* Sends up to max_msgs of the packets with one system call, returns how many it consumed */
+static guint send_batch(GstSctpUdpSink *self, GstBuffer **buffers, guint n_buffers)
+{
+    guint n_msgs = 0, n_iovs = 0, n_maps = 0, n_gso = 0;
+    guint64 bytes = 0;
+    guint errors = 0, calls = 0;
+    guint i = 0, sent;
+    gint ret;
+
+    while (i < n_buffers && n_iovs < self->max_msgs) {
+        struct msghdr *msg = &self->msgs[n_msgs].msg_hdr;
+        guint8 tos = get_tos(buffers[i]);
+        gsize segment_size, total;
+        guint first_iov = n_iovs;
+
+        if (!gst_buffer_map(buffers[i], &self->maps[n_maps], GST_MAP_READ)) {
+            GST_WARNING_OBJECT(self, "Could not map GstBuffer");
+            i++;
+            continue;
+        }
+        self->mapped[n_maps] = buffers[i];
+        segment_size = total = self->maps[n_maps].size;
+        self->iovs[n_iovs].iov_base = self->maps[n_maps].data;
+        self->iovs[n_iovs].iov_len = segment_size;
+        n_iovs++;
+        n_maps++;
+        i++;
+
+#ifdef UDP_SEGMENT
+        /* Packets of the same size and tos, optionally ending with a shorter one, go as one
+         * GSO send that the kernel or the NIC splits again */
+        while (self->gso_enabled && i < n_buffers && n_iovs < self->max_msgs
+            && n_iovs - first_iov < GSO_MAX_SEGMENTS && get_tos(buffers[i]) == tos
+            && self->iovs[n_iovs - 1].iov_len == segment_size) {
+            gsize size = gst_buffer_get_size(buffers[i]);
+
+            if (size > segment_size || total + size > GSO_MAX_BYTES)
+                break;
+            if (!gst_buffer_map(buffers[i], &self->maps[n_maps], GST_MAP_READ))
+                break;
+            self->mapped[n_maps] = buffers[i];
+            self->iovs[n_iovs].iov_base = self->maps[n_maps].data;
+            self->iovs[n_iovs].iov_len = size;
+            total += size;
+            n_iovs++;
+            n_maps++;
+            i++;
+        }
+#endif
+
+        memset(msg, 0, sizeof(*msg));
+        msg->msg_name = &self->addr;
+        msg->msg_namelen = self->addr_len;
+        msg->msg_iov = &self->iovs[first_iov];
+        msg->msg_iovlen = n_iovs - first_iov;
+        set_control(self, msg, self->control + n_msgs * CONTROL_SIZE, tos,
+            msg->msg_iovlen > 1 ? segment_size : 0);
+        if (msg->msg_iovlen > 1)
+            n_gso++;
+        bytes += total;
+        n_msgs++;
+    }
+
+    for (sent = 0; sent < n_msgs;) {
+#ifdef HAVE_SENDMMSG
+        ret = sendmmsg(self->fd, &self->msgs[sent], n_msgs - sent, 0);
+#else
+        ret = sendmsg(self->fd, &self->msgs[sent].msg_hdr, 0) >= 0 ? 1 : -1;
+#endif
+        calls++;
+        if (ret > 0) {
+            sent += ret;
+        } else if (ret < 0 && errno == EINTR) {
+            continue;
+        } else {
+            /* A datagram the kernel refuses is lost like on the wire, SCTP retransmits it */
+            if (self->msgs[sent].msg_hdr.msg_iovlen > 1 && (errno == EIO || errno == EINVAL)) {
+                GST_INFO_OBJECT(self, "UDP GSO failed (%s), disabling it", g_strerror(errno));
+                self->gso_enabled = FALSE;
+            } else {
+                GST_DEBUG_OBJECT(self, "Could not send packet: %s", g_strerror(errno));
+            }
+            errors++;
+            sent++;
+        }
+    }
+
+    while (n_maps) {
+        n_maps--;
+        gst_buffer_unmap(self->mapped[n_maps], &self->maps[n_maps]);
+    }
+
+    GST_OBJECT_LOCK(self);
+    self->packets_sent += n_iovs;
+    self->send_calls += calls;
+    self->bytes_sent += bytes;
+    self->gso_sends += n_gso;
+    self->send_errors += errors;
+    GST_OBJECT_UNLOCK(self);
+
+    return i;
+}
+
+/* Called with the object lock held */
+static GstStructure *create_stats(GstSctpUdpSink *self)
+{
+    return gst_structure_new("application/x-sctp-udp-sink-stats",
+        "packets-sent", G_TYPE_UINT64, self->packets_sent,
+        "bytes-sent", G_TYPE_UINT64, self->bytes_sent,
+        "send-calls", G_TYPE_UINT64, self->send_calls,
+        "gso-sends", G_TYPE_UINT64, self->gso_sends,
+        "send-errors", G_TYPE_UINT64, self->send_errors,
+        NULL);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctpudpsink_h
+#define gstsctpudpsink_h
+
+#include <gst/gst.h>
+#include <sys/socket.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SCTP_UDP_SINK (gst_sctp_udp_sink_get_type())
+#define GST_SCTP_UDP_SINK(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SCTP_UDP_SINK, GstSctpUdpSink))
+#define GST_SCTP_UDP_SINK_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SCTP_UDP_SINK, GstSctpUdpSinkClass))
+#define GST_IS_SCTP_UDP_SINK(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SCTP_UDP_SINK))
+#define GST_IS_SCTP_UDP_SINK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SCTP_UDP_SINK))
+
+typedef struct _GstSctpUdpSink GstSctpUdpSink;
+typedef struct _GstSctpUdpSinkClass GstSctpUdpSinkClass;
+
+struct _GstSctpUdpSink {
+    GstElement element;
+
+    GstPad *sink_pad;
+
+    gchar *host;
+    guint port;
+    guint bind_port;
+    guint buffer_size;
+    guint batch_size;
+    gboolean gso;
+
+    /* Set up when going to PAUSED, only used from the streaming thread after that */
+    gint fd;
+    gint family;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    gboolean gso_enabled;
+    /* Datagrams per system call, batch-size when the socket was opened */
+    guint max_msgs;
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    guint8 *control;
+    GstMapInfo *maps;
+    GstBuffer **mapped;
+
+    /* Protected by the object lock */
+    guint64 packets_sent;
+    guint64 bytes_sent;
+    guint64 send_calls;
+    guint64 gso_sends;
+    guint64 send_errors;
+};
+
+struct _GstSctpUdpSinkClass {
+    GstElementClass parent_class;
+};
+
+GType gst_sctp_udp_sink_get_type(void);
+
+G_END_DECLS
+
+#endif /* gstsctpudpsink_h */
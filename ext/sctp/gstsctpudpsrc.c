@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * sctpudpsrc receives SCTP packets encapsulated in UDP datagrams (RFC 6951) for sctpdec or
+ * sctpmux:
+ *
+ *   sctpudpsrc port=9899 ! sctpdec
+ *
+ * Datagrams are read with as few recvmmsg() calls as batch-size allows and pushed downstream as
+ * one buffer list per call. The tos byte of every datagram is attached as a GstSctpPacketMeta,
+ * so ECN marks set by the network reach the SCTP stack.
+ */
+
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpudpsrc.h"
+
+#include <gst/sctp/sctppacketmeta.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_sctp_udp_src_debug_category);
+#define GST_CAT_DEFAULT gst_sctp_udp_src_debug_category
+
+#define gst_sctp_udp_src_parent_class parent_class
+G_DEFINE_TYPE(GstSctpUdpSrc, gst_sctp_udp_src, GST_TYPE_ELEMENT);
+
+#ifndef HAVE_RECVMMSG
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-sctp"));
+
+enum {
+    PROP_0,
+
+    PROP_ADDRESS,
+    PROP_PORT,
+    PROP_BUFFER_SIZE,
+    PROP_BATCH_SIZE,
+    PROP_MAX_PACKET_SIZE,
+    PROP_STATS,
+
+    NUM_PROPERTIES
+};
+
+static GParamSpec *properties[NUM_PROPERTIES];
+
+#define DEFAULT_ADDRESS "0.0.0.0"
+#define DEFAULT_PORT 9899
+#define DEFAULT_BUFFER_SIZE 0
+#define DEFAULT_BATCH_SIZE 64
+#define DEFAULT_MAX_PACKET_SIZE 2048
+
+#define CONTROL_SIZE CMSG_SPACE(sizeof(gint))
+
+static void gst_sctp_udp_src_finalize(GObject *object);
+static void gst_sctp_udp_src_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec);
+static void gst_sctp_udp_src_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec);
+static GstStateChangeReturn gst_sctp_udp_src_change_state(GstElement *element,
+    GstStateChange transition);
+static gboolean gst_sctp_udp_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active);
+static void gst_sctp_udp_src_srcpad_loop(GstPad *pad);
+
+static gboolean open_socket(GstSctpUdpSrc *self);
+static void close_socket(GstSctpUdpSrc *self);
+static GstStructure *create_stats(GstSctpUdpSrc *self);
+
+static void gst_sctp_udp_src_class_init(GstSctpUdpSrcClass *klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *element_class;
+
+    gobject_class = (GObjectClass *) klass;
+    element_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT(gst_sctp_udp_src_debug_category,
+        "sctpudpsrc", 0, "debug category for sctpudpsrc element");
+
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&src_template));
+
+    gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_sctp_udp_src_finalize);
+    gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_sctp_udp_src_set_property);
+    gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_sctp_udp_src_get_property);
+
+    element_class->change_state = GST_DEBUG_FUNCPTR(gst_sctp_udp_src_change_state);
+
+    properties[PROP_ADDRESS] =
+        g_param_spec_string("address",
+            "Address",
+            "Local address to receive on",
+            DEFAULT_ADDRESS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PORT] =
+        g_param_spec_uint("port",
+            "Port",
+            "Local UDP port to receive on. 0 picks a free port, which can be read back once the "
+            "element is PAUSED.",
+            0, G_MAXUSHORT, DEFAULT_PORT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BUFFER_SIZE] =
+        g_param_spec_uint("buffer-size",
+            "Buffer size",
+            "Size of the kernel receive buffer in bytes (0 = system default)",
+            0, G_MAXINT, DEFAULT_BUFFER_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_BATCH_SIZE] =
+        g_param_spec_uint("batch-size",
+            "Batch size",
+            "Maximum number of datagrams read in one system call",
+            1, 1024, DEFAULT_BATCH_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_PACKET_SIZE] =
+        g_param_spec_uint("max-packet-size",
+            "Max packet size",
+            "Size of the buffer of every datagram. Longer datagrams are dropped, it has to be at "
+            "least the MTU of the peer's SCTP association.",
+            508, G_MAXUSHORT, DEFAULT_MAX_PACKET_SIZE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Counters of the packets and system calls",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+
+    gst_element_class_set_static_metadata(element_class,
+        "SCTP over UDP source",
+        "Source/Network/SCTP",
+        "Receives SCTP packets encapsulated in UDP (RFC 6951)",
+        "OpenWebRTC GStreamer plugins");
+}
+
+static void gst_sctp_udp_src_init(GstSctpUdpSrc *self)
+{
+    self->address = g_strdup(DEFAULT_ADDRESS);
+    self->port = DEFAULT_PORT;
+    self->buffer_size = DEFAULT_BUFFER_SIZE;
+    self->batch_size = DEFAULT_BATCH_SIZE;
+    self->max_packet_size = DEFAULT_MAX_PACKET_SIZE;
+    self->fd = -1;
+    self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+
+    self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
+    gst_pad_set_activatemode_function(self->src_pad,
+        GST_DEBUG_FUNCPTR(gst_sctp_udp_src_activate_mode));
+    gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
+
+    GST_OBJECT_FLAG_SET(self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static void gst_sctp_udp_src_finalize(GObject *object)
+{
+    GstSctpUdpSrc *self = GST_SCTP_UDP_SRC(object);
+
+    close_socket(self);
+    g_free(self->address);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_sctp_udp_src_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpUdpSrc *self = GST_SCTP_UDP_SRC(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_ADDRESS:
+        g_free(self->address);
+        self->address = g_value_dup_string(value);
+        break;
+    case PROP_PORT:
+        self->port = g_value_get_uint(value);
+        break;
+    case PROP_BUFFER_SIZE:
+        self->buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_BATCH_SIZE:
+        self->batch_size = g_value_get_uint(value);
+        break;
+    case PROP_MAX_PACKET_SIZE:
+        self->max_packet_size = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_sctp_udp_src_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpUdpSrc *self = GST_SCTP_UDP_SRC(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_ADDRESS:
+        g_value_set_string(value, self->address);
+        break;
+    case PROP_PORT:
+        g_value_set_uint(value, self->port);
+        break;
+    case PROP_BUFFER_SIZE:
+        g_value_set_uint(value, self->buffer_size);
+        break;
+    case PROP_BATCH_SIZE:
+        g_value_set_uint(value, self->batch_size);
+        break;
+    case PROP_MAX_PACKET_SIZE:
+        g_value_set_uint(value, self->max_packet_size);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, create_stats(self));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static GstStateChangeReturn gst_sctp_udp_src_change_state(GstElement *element,
+    GstStateChange transition)
+{
+    GstStateChangeReturn ret;
+
+    ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+    if (ret == GST_STATE_CHANGE_FAILURE)
+        return ret;
+
+    /* Packets arrive in real time, there is nothing to preroll */
+    switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+        ret = GST_STATE_CHANGE_NO_PREROLL;
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static gboolean gst_sctp_udp_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode,
+    gboolean active)
+{
+    GstSctpUdpSrc *self = GST_SCTP_UDP_SRC(parent);
+    gboolean ret = FALSE;
+
+    switch (mode) {
+    case GST_PAD_MODE_PUSH:
+        if (active) {
+            if (!open_socket(self))
+                break;
+            self->need_stream_start = TRUE;
+            ret = gst_pad_start_task(pad, (GstTaskFunction) gst_sctp_udp_src_srcpad_loop, pad,
+                NULL);
+        } else {
+            if (self->wakeup_fds[1] >= 0 && write(self->wakeup_fds[1], "", 1) < 0)
+                GST_WARNING_OBJECT(self, "Could not wake up the task: %s", g_strerror(errno));
+            ret = gst_pad_stop_task(pad);
+            close_socket(self);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static void gst_sctp_udp_src_srcpad_loop(GstPad *pad)
+{
+    GstSctpUdpSrc *self = GST_SCTP_UDP_SRC(GST_PAD_PARENT(pad));
+    struct pollfd fds[2];
+    GstBufferList *list;
+    GstFlowReturn flow_ret;
+    guint64 bytes = 0;
+    guint truncated = 0;
+    guint i;
+    gint n;
+
+    fds[0].fd = self->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = self->wakeup_fds[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR)
+            GST_WARNING_OBJECT(self, "poll() failed: %s", g_strerror(errno));
+        return;
+    }
+    if (fds[1].revents) {
+        GST_DEBUG_OBJECT(pad, "Pausing task because we're flushing");
+        gst_pad_pause_task(pad);
+        return;
+    }
+
+    /* Buffers not filled by the previous call are reused */
+    for (i = 0; i < self->max_msgs; i++) {
+        struct msghdr *msg = &self->msgs[i].msg_hdr;
+
+        if (!self->buffers[i])
+            self->buffers[i] = gst_buffer_new_allocate(NULL, self->packet_size, NULL);
+        if (!gst_buffer_map(self->buffers[i], &self->maps[i], GST_MAP_WRITE)) {
+            while (i--)
+                gst_buffer_unmap(self->buffers[i], &self->maps[i]);
+            GST_ELEMENT_ERROR(self, RESOURCE, FAILED, (NULL),
+                ("Could not map a buffer to receive into"));
+            gst_pad_pause_task(pad);
+            return;
+        }
+        self->iovs[i].iov_base = self->maps[i].data;
+        self->iovs[i].iov_len = self->maps[i].size;
+
+        memset(msg, 0, sizeof(*msg));
+        msg->msg_iov = &self->iovs[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = self->control + i * CONTROL_SIZE;
+        msg->msg_controllen = CONTROL_SIZE;
+    }
+
+#ifdef HAVE_RECVMMSG
+    n = recvmmsg(self->fd, self->msgs, self->max_msgs, MSG_DONTWAIT, NULL);
+#else
+    n = recvmsg(self->fd, &self->msgs[0].msg_hdr, MSG_DONTWAIT);
+    if (n >= 0) {
+        self->msgs[0].msg_len = n;
+        n = 1;
+    }
+#endif
+
+    for (i = 0; i < self->max_msgs; i++)
+        gst_buffer_unmap(self->buffers[i], &self->maps[i]);
+
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            GST_WARNING_OBJECT(self, "Could not receive packets: %s", g_strerror(errno));
+        return;
+    }
+
+    list = gst_buffer_list_new_sized(n);
+    for (i = 0; i < (guint) n; i++) {
+        struct msghdr *msg = &self->msgs[i].msg_hdr;
+        struct cmsghdr *cmsg;
+        GstBuffer *buffer;
+
+        if (msg->msg_flags & MSG_TRUNC) {
+            truncated++;
+            continue;
+        }
+
+        buffer = self->buffers[i];
+        self->buffers[i] = NULL;
+        gst_buffer_resize(buffer, 0, self->msgs[i].msg_len);
+        bytes += self->msgs[i].msg_len;
+
+        for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS) {
+                gst_sctp_buffer_add_packet_meta(buffer, *(guint8 *) CMSG_DATA(cmsg), FALSE);
+            } else if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS) {
+                gint tclass;
+
+                memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+                gst_sctp_buffer_add_packet_meta(buffer, tclass, FALSE);
+            }
+        }
+
+        gst_buffer_list_add(list, buffer);
+    }
+
+    GST_OBJECT_LOCK(self);
+    self->receive_calls++;
+    self->packets_received += n - truncated;
+    self->bytes_received += bytes;
+    self->packets_truncated += truncated;
+    GST_OBJECT_UNLOCK(self);
+
+    if (truncated)
+        GST_WARNING_OBJECT(self, "Dropped %u datagrams longer than max-packet-size", truncated);
+
+    if (self->need_stream_start) {
+        GstSegment segment;
+        gchar s_id[32];
+        GstCaps *caps;
+
+        g_snprintf(s_id, sizeof(s_id), "sctpudpsrc-%08x", g_random_int());
+        gst_pad_push_event(pad, gst_event_new_stream_start(s_id));
+
+        caps = gst_caps_new_empty_simple("application/x-sctp");
+        gst_pad_set_caps(pad, caps);
+        gst_caps_unref(caps);
+
+        gst_segment_init(&segment, GST_FORMAT_BYTES);
+        gst_pad_push_event(pad, gst_event_new_segment(&segment));
+
+        self->need_stream_start = FALSE;
+    }
+
+    if (!gst_buffer_list_length(list)) {
+        gst_buffer_list_unref(list);
+        return;
+    }
+
+    flow_ret = gst_pad_push_list(pad, list);
+    if (flow_ret != GST_FLOW_OK) {
+        GST_DEBUG_OBJECT(self, "Push returned %s, pausing", gst_flow_get_name(flow_ret));
+        if (flow_ret != GST_FLOW_FLUSHING && flow_ret != GST_FLOW_EOS)
+            GST_ELEMENT_ERROR(self, STREAM, FAILED, ("Internal data stream error."),
+                ("streaming stopped, reason %s", gst_flow_get_name(flow_ret)));
+        gst_pad_pause_task(pad);
+    }
+}
+
+static gboolean open_socket(GstSctpUdpSrc *self)
+{
+    struct addrinfo hints, *result = NULL;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    gchar port[8];
+    gchar *address;
+    guint buffer_size, bound_port;
+    gboolean port_changed;
+    gint err, value = 1;
+
+    GST_OBJECT_LOCK(self);
+    address = g_strdup(self->address);
+    g_snprintf(port, sizeof(port), "%u", self->port);
+    buffer_size = self->buffer_size;
+    self->max_msgs = self->batch_size;
+    self->packet_size = self->max_packet_size;
+    self->packets_received = self->bytes_received = 0;
+    self->receive_calls = self->packets_truncated = 0;
+    GST_OBJECT_UNLOCK(self);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    err = getaddrinfo(address, port, &hints, &result);
+    if (err != 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, (NULL),
+            ("Could not resolve %s: %s", address, gai_strerror(err)));
+        goto error;
+    }
+
+#ifdef SOCK_CLOEXEC
+    self->fd = socket(result->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+#else
+    self->fd = socket(result->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (self->fd >= 0)
+        fcntl(self->fd, F_SETFD, FD_CLOEXEC);
+#endif
+    if (self->fd < 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, (NULL),
+            ("Could not create socket: %s", g_strerror(errno)));
+        goto error;
+    }
+
+    if (result->ai_family == AF_INET)
+        setsockopt(self->fd, IPPROTO_IP, IP_RECVTOS, &value, sizeof(value));
+    else
+        setsockopt(self->fd, IPPROTO_IPV6, IPV6_RECVTCLASS, &value, sizeof(value));
+
+    if (buffer_size) {
+        value = buffer_size;
+        if (setsockopt(self->fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) < 0)
+            GST_WARNING_OBJECT(self, "Could not set the receive buffer size: %s",
+                g_strerror(errno));
+    }
+
+    if (bind(self->fd, result->ai_addr, result->ai_addrlen) < 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, (NULL),
+            ("Could not bind to %s:%s: %s", address, port, g_strerror(errno)));
+        goto error;
+    }
+
+    addr_len = sizeof(addr);
+    if (getsockname(self->fd, (struct sockaddr *) &addr, &addr_len) == 0) {
+        bound_port = ntohs(addr.ss_family == AF_INET ? ((struct sockaddr_in *) &addr)->sin_port
+            : ((struct sockaddr_in6 *) &addr)->sin6_port);
+        GST_OBJECT_LOCK(self);
+        port_changed = self->port != bound_port;
+        self->port = bound_port;
+        GST_OBJECT_UNLOCK(self);
+        if (port_changed)
+            g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_PORT]);
+    }
+
+    if (pipe(self->wakeup_fds) < 0) {
+        GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, (NULL),
+            ("Could not create pipe: %s", g_strerror(errno)));
+        goto error;
+    }
+
+    self->msgs = g_new0(struct mmsghdr, self->max_msgs);
+    self->iovs = g_new0(struct iovec, self->max_msgs);
+    self->maps = g_new0(GstMapInfo, self->max_msgs);
+    self->buffers = g_new0(GstBuffer *, self->max_msgs);
+    self->control = g_malloc0(self->max_msgs * CONTROL_SIZE);
+
+    freeaddrinfo(result);
+    g_free(address);
+    return TRUE;
+error:
+    if (result)
+        freeaddrinfo(result);
+    close_socket(self);
+    g_free(address);
+    return FALSE;
+}
+
+static void close_socket(GstSctpUdpSrc *self)
+{
+    guint i;
+
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    for (i = 0; i < 2; i++) {
+        if (self->wakeup_fds[i] >= 0) {
+            close(self->wakeup_fds[i]);
+            self->wakeup_fds[i] = -1;
+        }
+    }
+
+    if (self->buffers) {
+        for (i = 0; i < self->max_msgs; i++) {
+            if (self->buffers[i])
+                gst_buffer_unref(self->buffers[i]);
+        }
+    }
+    g_free(self->buffers);
+    self->buffers = NULL;
+    g_free(self->msgs);
+    self->msgs = NULL;
+    g_free(self->iovs);
+    self->iovs = NULL;
+    g_free(self->maps);
+    self->maps = NULL;
+    g_free(self->control);
+    self->control = NULL;
+}
+
+/* Called with the object lock held */
+static GstStructure *create_stats(GstSctpUdpSrc *self)
+{
+    return gst_structure_new("application/x-sctp-udp-src-stats",
+        "packets-received", G_TYPE_UINT64, self->packets_received,
+        "bytes-received", G_TYPE_UINT64, self->bytes_received,
+        "receive-calls", G_TYPE_UINT64, self->receive_calls,
+        "packets-truncated", G_TYPE_UINT64, self->packets_truncated,
+        NULL);
+}
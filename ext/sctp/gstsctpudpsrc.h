@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef gstsctpudpsrc_h
+#define gstsctpudpsrc_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SCTP_UDP_SRC (gst_sctp_udp_src_get_type())
+#define GST_SCTP_UDP_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SCTP_UDP_SRC, GstSctpUdpSrc))
+#define GST_SCTP_UDP_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SCTP_UDP_SRC, GstSctpUdpSrcClass))
+#define GST_IS_SCTP_UDP_SRC(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SCTP_UDP_SRC))
+#define GST_IS_SCTP_UDP_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SCTP_UDP_SRC))
+
+typedef struct _GstSctpUdpSrc GstSctpUdpSrc;
+typedef struct _GstSctpUdpSrcClass GstSctpUdpSrcClass;
+
+struct _GstSctpUdpSrc {
+    GstElement element;
+
+    GstPad *src_pad;
+
+    gchar *address;
+    guint port;
+    guint buffer_size;
+    guint batch_size;
+    guint max_packet_size;
+
+    /* Set up when the source pad is activated, only used from its task after that */
+    gint fd;
+    /* Written to on deactivation to wake up the task from poll() */
+    gint wakeup_fds[2];
+    gboolean need_stream_start;
+    guint max_msgs;
+    guint packet_size;
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    guint8 *control;
+    GstBuffer **buffers;
+    GstMapInfo *maps;
+
+    /* Protected by the object lock */
+    guint64 packets_received;
+    guint64 bytes_received;
+    guint64 receive_calls;
+    guint64 packets_truncated;
+};
+
+struct _GstSctpUdpSrcClass {
+    GstElementClass parent_class;
+};
+
+GType gst_sctp_udp_src_get_type(void);
+
+G_END_DECLS
+
+#endif /* gstsctpudpsrc_h */
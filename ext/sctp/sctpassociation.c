@@ -28,6 +28,8 @@
 #endif
 
 #include "sctpassociation.h"
+#include "sctpchecksum.h"
+#include "sctpengine.h"
 
 #include <string.h>
 #include <errno.h>
@@ -57,11 +59,106 @@ static GType gst_sctp_association_state_get_type(void)
     return id;
 }
 
+GType gst_sctp_association_bundling_policy_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_BUNDLING_POLICY_LATENCY, "Send every message immediately", "latency"},
+        {GST_SCTP_ASSOCIATION_BUNDLING_POLICY_THROUGHPUT, "Delay small messages while data is in flight (Nagle)", "throughput"},
+        {GST_SCTP_ASSOCIATION_BUNDLING_POLICY_ADAPTIVE, "Hold small messages for at most bundling-max-delay", "adaptive"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationBundlingPolicy", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
+GType gst_sctp_association_congestion_control_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC2581, "Standard SCTP congestion control (RFC 4960)", "rfc2581"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP, "HighSpeed TCP (RFC 3649)", "hstcp"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP, "H-TCP", "htcp"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC, "Real-time, keeps queueing delay low", "rtcc"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationCongestionControl", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
+GType gst_sctp_association_setup_profile_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_SETUP_PROFILE_DEFAULT, "The default timers of RFC 4960", "default"},
+        {GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST, "Low initial RTO and quick INIT retransmissions", "fast"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationSetupProfile", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
+GType gst_sctp_association_checksum_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_CHECKSUM_SOFTWARE, "CRC32c computed and verified with tables", "software"},
+        {GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED, "CRC32c computed and verified with CPU instructions where available", "accelerated"},
+        {GST_SCTP_ASSOCIATION_CHECKSUM_NONE, "No CRC32c, for transports that protect the integrity themselves", "none"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationChecksum", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
+GType gst_sctp_association_engine_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_ENGINE_USRSCTP, "The usrsctp stack", "usrsctp"},
+        {GST_SCTP_ASSOCIATION_ENGINE_LITE, "Lightweight engine for data channels, without global state", "lite"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationEngine", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
 G_DEFINE_TYPE(GstSctpAssociation, gst_sctp_association, G_TYPE_OBJECT);
 
 enum
 {
   SIGNAL_STREAM_RESET,
+  SIGNAL_SEND_FAILED,
   LAST_SIGNAL
 };
 
@@ -74,6 +171,28 @@ enum {
     PROP_REMOTE_PORT,
     PROP_STATE,
     PROP_USE_SOCK_STREAM,
+    PROP_BUNDLING_POLICY,
+    PROP_BUNDLING_MAX_DELAY,
+    PROP_SACK_DELAY,
+    PROP_SACK_FREQUENCY,
+    PROP_CONGESTION_CONTROL,
+    PROP_RTCC_STEADY_STEP,
+    PROP_RTCC_USE_ECN,
+    PROP_ECN,
+    PROP_IDLE_TIMEOUT,
+    PROP_IDLE_HEARTBEAT_INTERVAL,
+    PROP_IDLE,
+    PROP_MTU,
+    PROP_CAPTURE_PACKETS,
+    PROP_CAPTURE_SNAPLEN,
+    PROP_CAPTURE_SAMPLE_INTERVAL,
+    PROP_PRECONNECT_BUFFER_SIZE,
+    PROP_SETUP_PROFILE,
+    PROP_MAX_INIT_RETRANSMITS,
+    PROP_MAX_RETRANSMITS,
+    PROP_CHECKSUM,
+    PROP_MEMORY_LIMIT,
+    PROP_ENGINE,
 
     NUM_PROPERTIES
 };
@@ -81,13 +200,96 @@ enum {
 static guint signals[LAST_SIGNAL] = { 0 };
 static GParamSpec *properties[NUM_PROPERTIES];
 
-#define DEFAULT_NUMBER_OF_SCTP_STREAMS 10
 #define DEFAULT_LOCAL_SCTP_PORT 0
 #define DEFAULT_REMOTE_SCTP_PORT 0
+#define DEFAULT_BUNDLING_POLICY GST_SCTP_ASSOCIATION_BUNDLING_POLICY_LATENCY
+#define DEFAULT_BUNDLING_MAX_DELAY 1000
+#define MAX_BUNDLING_MAX_DELAY 1000000
+/* usrsctp defaults, RFC 4960 section 6.2 allows at most 500 ms */
+#define DEFAULT_SACK_DELAY 200
+#define MAX_SACK_DELAY 500
+#define DEFAULT_SACK_FREQUENCY 2
+#define DEFAULT_CONGESTION_CONTROL GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC2581
+/* usrsctp defaults for the RTCC module */
+#define DEFAULT_RTCC_STEADY_STEP 20
+#define DEFAULT_RTCC_USE_ECN TRUE
+#define DEFAULT_ECN FALSE
+#define DEFAULT_IDLE_TIMEOUT 0
+#define DEFAULT_IDLE_HEARTBEAT_INTERVAL 300000
+#define DEFAULT_CAPTURE_PACKETS 0
+#define DEFAULT_CAPTURE_SNAPLEN 256
+#define DEFAULT_CAPTURE_SAMPLE_INTERVAL 1
+#define MAX_CAPTURE_PACKETS (1 << 20)
+#define DEFAULT_PRECONNECT_BUFFER_SIZE (256 * 1024)
+#define DEFAULT_SETUP_PROFILE GST_SCTP_ASSOCIATION_SETUP_PROFILE_DEFAULT
+#define DEFAULT_MAX_INIT_RETRANSMITS 0
+#define DEFAULT_MAX_RETRANSMITS 0
+#define DEFAULT_CHECKSUM GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED
+#define DEFAULT_MEMORY_LIMIT (4 * 1024 * 1024)
+#define DEFAULT_ENGINE GST_SCTP_ASSOCIATION_ENGINE_USRSCTP
+/* Socket buffer sizes per direction in bytes. The minimum is kept whatever the pressure on the
+ * memory budget, below it the association would stall on every message. */
+#define MIN_SOCKET_BUFFER_SIZE (64 * 1024)
+#define INITIAL_SOCKET_BUFFER_SIZE (256 * 1024)
+/* Milliseconds between two measurements of the bandwidth-delay product */
+#define BUFFER_TUNING_INTERVAL 1000
+
+// draft-ietf-rtcweb-data-channel-13 section 5: max initial MTU IPV4 1200, IPV6 1280
+#define DEFAULT_PATH_MTU 1200 // safe for either
+#define MIN_PATH_MTU 508
+#define SCTP_COMMON_HEADER_SIZE 12
+#define SCTP_DATA_CHUNK_HEADER_SIZE 16
+#define DATA_CHUNK_SIZE(length) ((SCTP_DATA_CHUNK_HEADER_SIZE + (length) + 3) & ~3)
+/* Room left for DATA chunks in a single packet, used to decide when held messages fill a packet */
+#define BUNDLING_PACKET_CAPACITY(self) ((self)->mtu - SCTP_COMMON_HEADER_SIZE)
+
+/* Captured packets are dumped as raw IPv4 with a UDP header, port 9899 is SCTP over UDP */
+#define CAPTURE_UDP_PORT 9899
+#define CAPTURE_IP_HEADER_SIZE 20
+#define CAPTURE_UDP_HEADER_SIZE 8
+#define CAPTURE_IPPROTO_UDP 17
+#define CAPTURE_HEADERS_SIZE (CAPTURE_IP_HEADER_SIZE + CAPTURE_UDP_HEADER_SIZE)
+#define PCAPNG_LINKTYPE_RAW 101
+
+typedef struct _GstSctpCapturedPacket {
+    gint64 time;
+    guint32 length;
+    guint32 captured;
+    gboolean outbound;
+} GstSctpCapturedPacket;
+
+typedef struct {
+    guint8 *data;
+    guint32 length;
+    guint16 stream_id;
+    guint32 ppid;
+    gboolean ordered;
+    GstSctpAssociationPartialReliability pr;
+    guint32 reliability_param;
+    GstSctpAssociationSendFlags flags;
+    guint32 context;
+} HeldMessage;
+
+typedef struct {
+    guint16 stream_id;
+    guint32 ppid;
+    guint32 length;
+    guint32 context;
+    gboolean sent;
+} AbandonedReport;
 
 static GHashTable *associations = NULL;
 G_LOCK_DEFINE_STATIC(associations_lock);
-static guint32 number_of_associations = 0;
+
+/* All associations share one thread running their timers */
+static GMainContext *timer_context = NULL;
+
+/* Socket buffer memory granted to the associations out of the budget they share (0 = unlimited).
+ * memory_lock may be taken with an association mutex held, never the other way round. */
+G_LOCK_DEFINE_STATIC(memory_lock);
+static guint64 memory_budget = 0;
+static guint64 memory_committed = 0;
+static guint memory_holders = 0;
 
 /* Interface implementations */
 static void gst_sctp_association_finalize(GObject *object);
@@ -96,26 +298,36 @@ static void gst_sctp_association_set_property(GObject *object, guint prop_id, co
 static void gst_sctp_association_get_property(GObject *object, guint prop_id, GValue *value,
     GParamSpec *pspec);
 
-static struct socket * create_sctp_socket(GstSctpAssociation *gst_sctp_association);
-static struct sockaddr_conn get_sctp_socket_address(GstSctpAssociation *gst_sctp_association,
-    guint16 port);
 static gpointer connection_thread_func(GstSctpAssociation *self);
-static gboolean client_role_connect(GstSctpAssociation *self);
-static int sctp_packet_out(void *addr, void* buffer, size_t length, guint8 tos, guint8 set_df);
-static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
-    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info);
-static void handle_notification(GstSctpAssociation *self, const union sctp_notification *notification,
-    size_t length);
-static void handle_association_changed(GstSctpAssociation *self, const struct sctp_assoc_change *sac);
-static void handle_stream_reset_event(GstSctpAssociation *self,
-    const struct sctp_stream_reset_event *ssr);
-static void handle_message(GstSctpAssociation *self, guint8 *data, guint32 datalen, guint16 stream_id,
-    guint32 ppid);
 
+static void unlock_association(GstSctpAssociation *self);
+static void emit_abandoned_reports(GstSctpAssociation *self);
 static void maybe_set_state_to_ready(GstSctpAssociation *self);
 static void gst_sctp_association_change_state(GstSctpAssociation *self, GstSctpAssociationState new_state,
     gboolean notify);
 
+static gboolean on_bundling_timeout(gpointer user_data);
+static gboolean on_idle_timeout(gpointer user_data);
+static gboolean note_activity(GstSctpAssociation *self);
+static gboolean update_idle_timer(GstSctpAssociation *self);
+static gboolean send_message(GstSctpAssociation *self, guint8 *buf, guint32 length, guint16 stream_id,
+    guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr, guint32 reliability_param,
+    GstSctpAssociationSendFlags flags, guint32 context);
+static void hold_message(GstSctpAssociation *self, guint8 *buf, guint32 length, guint16 stream_id,
+    guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr, guint32 reliability_param,
+    GstSctpAssociationSendFlags flags, guint32 context);
+static gboolean flush_held_messages(GstSctpAssociation *self, gboolean more_follows);
+static void drop_held_messages(GstSctpAssociation *self);
+static void apply_bundling_policy(GstSctpAssociation *self);
+static void capture_packet(GstSctpAssociation *self, gboolean outbound, const guint8 *data,
+    gsize length);
+static void resize_capture(GstSctpAssociation *self, guint packets, guint snaplen);
+static gboolean on_buffer_tuning_timeout(gpointer user_data);
+static void restart_buffer_tuning(GstSctpAssociation *self);
+static gboolean apply_socket_buffers(GstSctpAssociation *self, guint send_size,
+    guint receive_size);
+static void release_socket_buffers(GstSctpAssociation *self);
+
 static void gst_sctp_association_class_init (GstSctpAssociationClass *klass)
 {
     GObjectClass *gobject_class;
@@ -126,10 +338,19 @@ static void gst_sctp_association_class_init (GstSctpAssociationClass *klass)
     gobject_class->set_property = gst_sctp_association_set_property;
     gobject_class->get_property = gst_sctp_association_get_property;
 
+    gst_sctp_checksum_init();
+
     signals[SIGNAL_STREAM_RESET] = g_signal_new ("stream-reset", G_OBJECT_CLASS_TYPE(klass),
           G_SIGNAL_RUN_FIRST, G_STRUCT_OFFSET(GstSctpAssociationClass, on_sctp_stream_reset), NULL, NULL,
           g_cclosure_marshal_generic, G_TYPE_NONE, 1, G_TYPE_UINT);
 
+    /* Emitted by whichever thread releases the association lock after the stack reported the
+     * failure, never with that lock held */
+    signals[SIGNAL_SEND_FAILED] = g_signal_new("send-failed", G_OBJECT_CLASS_TYPE(klass),
+          G_SIGNAL_RUN_FIRST, G_STRUCT_OFFSET(GstSctpAssociationClass, on_sctp_send_failed), NULL, NULL,
+          g_cclosure_marshal_generic, G_TYPE_NONE, 5, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+          G_TYPE_UINT, G_TYPE_BOOLEAN);
+
     properties[PROP_ASSOCIATION_ID] = g_param_spec_uint("association-id",
         "The SCTP association-id", "The SCTP association-id.", 0, G_MAXUSHORT,
         DEFAULT_LOCAL_SCTP_PORT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
@@ -151,27 +372,127 @@ static void gst_sctp_association_class_init (GstSctpAssociationClass *klass)
         "When TRUE the partial reliability parameters of the channel is ignored.",
         FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
-}
+    properties[PROP_BUNDLING_POLICY] = g_param_spec_enum("bundling-policy", "Bundling policy",
+        "How small messages are bundled into packets. \"latency\" sends every message at once, "
+        "\"throughput\" lets the stack delay them while data is in flight and \"adaptive\" holds "
+        "them for at most bundling-max-delay so they can share packets.",
+        GST_SCTP_TYPE_ASSOCIATION_BUNDLING_POLICY, DEFAULT_BUNDLING_POLICY,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-static void gst_sctp_association_init (GstSctpAssociation *self)
-{
-    /* No need to lock mutex here as long as the function is only called from gst_sctp_association_get */
-    if (number_of_associations == 0) {
-        usrsctp_init(0, sctp_packet_out, g_print);
+    properties[PROP_BUNDLING_MAX_DELAY] = g_param_spec_uint("bundling-max-delay", "Bundling max delay",
+        "Maximum time in microseconds a small message is held back in the adaptive bundling policy",
+        0, MAX_BUNDLING_MAX_DELAY, DEFAULT_BUNDLING_MAX_DELAY,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_DELAY] = g_param_spec_uint("sack-delay", "SACK delay",
+        "Maximum time in milliseconds the acknowledgement of received data is delayed. "
+        "0 disables delayed acknowledgements.", 0, MAX_SACK_DELAY, DEFAULT_SACK_DELAY,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-        usrsctp_sysctl_set_sctp_blackhole(2);
+    properties[PROP_SACK_FREQUENCY] = g_param_spec_uint("sack-frequency", "SACK frequency",
+        "Number of packets received before an acknowledgement is sent without waiting for sack-delay",
+        1, G_MAXUSHORT, DEFAULT_SACK_FREQUENCY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-        /* Explicit Congestion Notification */
-        usrsctp_sysctl_set_sctp_ecn_enable(0);
+    properties[PROP_CONGESTION_CONTROL] = g_param_spec_enum("congestion-control",
+        "Congestion control", "The congestion control module used by the association",
+        GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL, DEFAULT_CONGESTION_CONTROL,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-        usrsctp_sysctl_set_sctp_nr_outgoing_streams_default(DEFAULT_NUMBER_OF_SCTP_STREAMS);
-    }
-    number_of_associations++;
+    properties[PROP_RTCC_STEADY_STEP] = g_param_spec_uint("rtcc-steady-step", "RTCC steady step",
+        "Number of steady state RTT measurements before the rtcc module probes for more bandwidth "
+        "(0 disables probing)", 0, G_MAXUSHORT, DEFAULT_RTCC_STEADY_STEP,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTCC_USE_ECN] = g_param_spec_boolean("rtcc-use-ecn", "RTCC use ECN",
+        "Whether the rtcc module reacts to ECN marks with its delay based response",
+        DEFAULT_RTCC_USE_ECN, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_ECN] = g_param_spec_boolean("ecn", "ECN",
+        "Negotiate Explicit Congestion Notification with the peer. Takes effect when the "
+        "association is started.", DEFAULT_ECN, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE_TIMEOUT] = g_param_spec_uint("idle-timeout", "Idle timeout",
+        "Time in milliseconds without data sent or received before the association goes idle "
+        "(0 = never)", 0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE_HEARTBEAT_INTERVAL] = g_param_spec_uint("idle-heartbeat-interval",
+        "Idle heartbeat interval",
+        "Heartbeat interval in milliseconds while the association is idle (0 = no heartbeats)",
+        0, G_MAXUINT, DEFAULT_IDLE_HEARTBEAT_INTERVAL,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_IDLE] = g_param_spec_boolean("idle", "Idle",
+        "Whether the association is idle", FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MTU] = g_param_spec_uint("mtu", "MTU",
+        "Path MTU in bytes used for the association. Takes effect when the association is started.",
+        MIN_PATH_MTU, G_MAXUSHORT, DEFAULT_PATH_MTU, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CAPTURE_PACKETS] = g_param_spec_uint("capture-packets", "Capture packets",
+        "Number of packets kept in the capture ring (0 = capture disabled). Changing it clears "
+        "the ring.", 0, MAX_CAPTURE_PACKETS, DEFAULT_CAPTURE_PACKETS,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_CAPTURE_SNAPLEN] = g_param_spec_uint("capture-snaplen", "Capture snaplen",
+        "Bytes of each SCTP packet kept in the capture ring. Changing it clears the ring.",
+        SCTP_COMMON_HEADER_SIZE, G_MAXUSHORT, DEFAULT_CAPTURE_SNAPLEN,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CAPTURE_SAMPLE_INTERVAL] = g_param_spec_uint("capture-sample-interval",
+        "Capture sample interval", "Capture one packet out of this many", 1, G_MAXUINT,
+        DEFAULT_CAPTURE_SAMPLE_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PRECONNECT_BUFFER_SIZE] = g_param_spec_uint("preconnect-buffer-size",
+        "Pre-connect buffer size", "Bytes of messages held while the association is being set up. "
+        "They are sent in one batch as soon as it is established (0 = refuse to send before that)",
+        0, G_MAXUINT, DEFAULT_PRECONNECT_BUFFER_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SETUP_PROFILE] = g_param_spec_enum("setup-profile", "Setup profile",
+        "RTO and INIT timers used by the association. Applied when the association is started.",
+        GST_SCTP_TYPE_ASSOCIATION_SETUP_PROFILE, DEFAULT_SETUP_PROFILE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_INIT_RETRANSMITS] = g_param_spec_uint("max-init-retransmits",
+        "Max INIT retransmits", "Number of INIT retransmissions before the setup is given up "
+        "(0 = as in the setup profile). Applied when the association is started.",
+        0, G_MAXUSHORT, DEFAULT_MAX_INIT_RETRANSMITS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_RETRANSMITS] = g_param_spec_uint("max-retransmits", "Max retransmits",
+        "Number of consecutive retransmissions before the association is considered lost "
+        "(0 = engine default, 10 for both engines). Applied when the association is started.",
+        0, G_MAXUSHORT, DEFAULT_MAX_RETRANSMITS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CHECKSUM] = g_param_spec_enum("checksum", "Checksum",
+        "How the CRC32c of the packets is computed and verified. \"none\" sends packets without "
+        "one and accepts any, only for peers that do the same. The usrsctp engine needs a "
+        "usrsctp with CRC32c offload, otherwise the stack always uses its own software "
+        "implementation.",
+        GST_SCTP_TYPE_ASSOCIATION_CHECKSUM, DEFAULT_CHECKSUM,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MEMORY_LIMIT] = g_param_spec_uint("memory-limit", "Memory limit",
+        "Maximum bytes of send and receive socket buffer for the association. The buffers are "
+        "sized from the measured bandwidth-delay product up to this and the global memory budget.",
+        2 * MIN_SOCKET_BUFFER_SIZE, G_MAXINT, DEFAULT_MEMORY_LIMIT,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_ENGINE] = g_param_spec_enum("engine", "Engine",
+        "The SCTP implementation running the association. \"lite\" keeps all its state in the "
+        "association and covers what data channels need, without the congestion control "
+        "modules and ECN. Takes effect when the association is started.",
+        GST_SCTP_TYPE_ASSOCIATION_ENGINE, DEFAULT_ENGINE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+}
+
+static void gst_sctp_association_init (GstSctpAssociation *self)
+{
     self->local_port = DEFAULT_LOCAL_SCTP_PORT;
     self->remote_port = DEFAULT_REMOTE_SCTP_PORT;
-    self->sctp_ass_sock = NULL;
+    self->engine_type = DEFAULT_ENGINE;
+    self->engine = NULL;
 
     self->connection_thread = NULL;
     g_mutex_init(&self->association_mutex);
@@ -179,8 +500,54 @@ static void gst_sctp_association_init (GstSctpAssociation *self)
     self->state = GST_SCTP_ASSOCIATION_STATE_NEW;
 
     self->use_sock_stream = FALSE;
-
-    usrsctp_register_address((void *) self);
+    self->mtu = DEFAULT_PATH_MTU;
+    self->sack_delay = DEFAULT_SACK_DELAY;
+    self->sack_frequency = DEFAULT_SACK_FREQUENCY;
+    self->congestion_control = DEFAULT_CONGESTION_CONTROL;
+    self->rtcc_steady_step = DEFAULT_RTCC_STEADY_STEP;
+    self->rtcc_use_ecn = DEFAULT_RTCC_USE_ECN;
+    self->ecn = DEFAULT_ECN;
+
+    self->bundling_policy = DEFAULT_BUNDLING_POLICY;
+    self->bundling_max_delay = DEFAULT_BUNDLING_MAX_DELAY;
+    g_queue_init(&self->held_messages);
+    self->preconnect_buffer_size = DEFAULT_PRECONNECT_BUFFER_SIZE;
+    self->setup_profile = DEFAULT_SETUP_PROFILE;
+    self->max_init_retransmits = DEFAULT_MAX_INIT_RETRANSMITS;
+    self->max_retransmits = DEFAULT_MAX_RETRANSMITS;
+    self->checksum = DEFAULT_CHECKSUM;
+    self->start_time = 0;
+    self->held_bytes = 0;
+    self->bundling_timer = gst_sctp_association_create_timer_source(self, on_bundling_timeout);
+
+    self->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+    self->idle_heartbeat_interval = DEFAULT_IDLE_HEARTBEAT_INTERVAL;
+    self->idle = FALSE;
+    self->last_activity = 0;
+    self->idle_timer = gst_sctp_association_create_timer_source(self, on_idle_timeout);
+
+    self->memory_limit = DEFAULT_MEMORY_LIMIT;
+    self->send_buffer_size = 0;
+    self->receive_buffer_size = 0;
+    self->tuning_bytes_sent = 0;
+    self->tuning_bytes_received = 0;
+    self->tuning_time = 0;
+    self->buffer_timer = gst_sctp_association_create_timer_source(self, on_buffer_tuning_timeout);
+
+    g_mutex_init(&self->stats_mutex);
+    memset(&self->stats, 0, sizeof(GstSctpAssociationStats));
+    g_queue_init(&self->abandoned_reports);
+    self->abandoned_pending = 0;
+
+    g_mutex_init(&self->capture_mutex);
+    self->capture_packets = DEFAULT_CAPTURE_PACKETS;
+    self->capture_snaplen = DEFAULT_CAPTURE_SNAPLEN;
+    self->capture_sample_interval = DEFAULT_CAPTURE_SAMPLE_INTERVAL;
+    self->capture_counter = 0;
+    self->capture_ring = NULL;
+    self->capture_data = NULL;
+    self->capture_next = 0;
+    self->capture_count = 0;
 }
 
 static void gst_sctp_association_finalize(GObject *object)
@@ -190,16 +557,26 @@ static void gst_sctp_association_finalize(GObject *object)
     G_LOCK(associations_lock);
 
     g_hash_table_remove(associations, GUINT_TO_POINTER(self->association_id));
-
-    usrsctp_deregister_address((void *) self);
-    number_of_associations--;
-    if (number_of_associations == 0) {
-        usrsctp_finish();
-    }
     G_UNLOCK(associations_lock);
 
     g_thread_join(self->connection_thread);
 
+    g_source_destroy(self->bundling_timer);
+    g_source_unref(self->bundling_timer);
+    g_source_destroy(self->idle_timer);
+    g_source_unref(self->idle_timer);
+    g_source_destroy(self->buffer_timer);
+    g_source_unref(self->buffer_timer);
+    if (self->engine)
+        self->engine->funcs->free(self->engine);
+    release_socket_buffers(self);
+    drop_held_messages(self);
+    g_queue_free_full(&self->abandoned_reports, g_free);
+    g_mutex_clear(&self->stats_mutex);
+    g_free(self->capture_ring);
+    g_free(self->capture_data);
+    g_mutex_clear(&self->capture_mutex);
+
     G_OBJECT_CLASS(gst_sctp_association_parent_class)->finalize(object);
 }
 
@@ -207,6 +584,7 @@ static void gst_sctp_association_set_property(GObject *object, guint prop_id, co
     GParamSpec *pspec)
 {
     GstSctpAssociation *self = GST_SCTP_ASSOCIATION(object);
+    gboolean notify_idle = FALSE;
 
     g_mutex_lock(&self->association_mutex);
     if (self->state != GST_SCTP_ASSOCIATION_STATE_NEW) {
@@ -234,19 +612,132 @@ static void gst_sctp_association_set_property(GObject *object, guint prop_id, co
     case PROP_USE_SOCK_STREAM:
         self->use_sock_stream = g_value_get_boolean(value);
         break;
+    case PROP_BUNDLING_POLICY:
+        self->bundling_policy = g_value_get_enum(value);
+        apply_bundling_policy(self);
+        break;
+    case PROP_BUNDLING_MAX_DELAY:
+        self->bundling_max_delay = g_value_get_uint(value);
+        break;
+    case PROP_SACK_DELAY:
+        self->sack_delay = g_value_get_uint(value);
+        if (self->engine && self->engine->funcs->apply_delayed_sack)
+            self->engine->funcs->apply_delayed_sack(self->engine);
+        break;
+    case PROP_SACK_FREQUENCY:
+        self->sack_frequency = g_value_get_uint(value);
+        if (self->engine && self->engine->funcs->apply_delayed_sack)
+            self->engine->funcs->apply_delayed_sack(self->engine);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        self->congestion_control = g_value_get_enum(value);
+        if (self->engine && self->engine->funcs->apply_congestion_control) {
+            self->engine->funcs->apply_congestion_control(self->engine);
+            if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+                self->engine->funcs->apply_congestion_control_options(self->engine);
+        }
+        break;
+    case PROP_RTCC_STEADY_STEP:
+        self->rtcc_steady_step = g_value_get_uint(value);
+        if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED
+            && self->engine->funcs->apply_congestion_control_options)
+            self->engine->funcs->apply_congestion_control_options(self->engine);
+        break;
+    case PROP_RTCC_USE_ECN:
+        self->rtcc_use_ecn = g_value_get_boolean(value);
+        if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED
+            && self->engine->funcs->apply_congestion_control_options)
+            self->engine->funcs->apply_congestion_control_options(self->engine);
+        break;
+    case PROP_ECN:
+        self->ecn = g_value_get_boolean(value);
+        break;
+    case PROP_IDLE_TIMEOUT:
+        self->idle_timeout = g_value_get_uint(value);
+        notify_idle = update_idle_timer(self);
+        break;
+    case PROP_IDLE_HEARTBEAT_INTERVAL:
+        self->idle_heartbeat_interval = g_value_get_uint(value);
+        if (self->idle)
+            self->engine->funcs->set_heartbeat_interval(self->engine, self->idle_heartbeat_interval);
+        break;
+    case PROP_MTU:
+        self->mtu = g_value_get_uint(value);
+        break;
+    case PROP_CAPTURE_PACKETS:
+        resize_capture(self, g_value_get_uint(value), self->capture_snaplen);
+        break;
+    case PROP_CAPTURE_SNAPLEN:
+        resize_capture(self, self->capture_packets, g_value_get_uint(value));
+        break;
+    case PROP_CAPTURE_SAMPLE_INTERVAL:
+        g_mutex_lock(&self->capture_mutex);
+        self->capture_sample_interval = g_value_get_uint(value);
+        g_mutex_unlock(&self->capture_mutex);
+        break;
+    case PROP_PRECONNECT_BUFFER_SIZE:
+        self->preconnect_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_SETUP_PROFILE:
+        self->setup_profile = g_value_get_enum(value);
+        break;
+    case PROP_MAX_INIT_RETRANSMITS:
+        self->max_init_retransmits = g_value_get_uint(value);
+        break;
+    case PROP_MAX_RETRANSMITS:
+        self->max_retransmits = g_value_get_uint(value);
+        break;
+    case PROP_CHECKSUM:
+        self->checksum = g_value_get_enum(value);
+        break;
+    case PROP_MEMORY_LIMIT:
+        /* Applied by the next measurement */
+        self->memory_limit = g_value_get_uint(value);
+        break;
+    case PROP_ENGINE:
+        self->engine_type = g_value_get_enum(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
     }
 
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
     if (prop_id == PROP_LOCAL_PORT || prop_id == PROP_REMOTE_PORT)
         maybe_set_state_to_ready(self);
+    if (notify_idle)
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_IDLE]);
 
     return;
 
 error:
+    unlock_association(self);
+}
+
+/* Releases the association_mutex and signals the messages abandoned while it was held */
+static void unlock_association(GstSctpAssociation *self)
+{
     g_mutex_unlock(&self->association_mutex);
+    if (g_atomic_int_get(&self->abandoned_pending))
+        emit_abandoned_reports(self);
+}
+
+static void emit_abandoned_reports(GstSctpAssociation *self)
+{
+    GQueue reports;
+    AbandonedReport *report;
+
+    g_mutex_lock(&self->stats_mutex);
+    reports = self->abandoned_reports;
+    g_queue_init(&self->abandoned_reports);
+    g_atomic_int_set(&self->abandoned_pending, 0);
+    g_mutex_unlock(&self->stats_mutex);
+
+    while ((report = g_queue_pop_head(&reports))) {
+        g_signal_emit(self, signals[SIGNAL_SEND_FAILED], 0, (guint) report->stream_id,
+            report->ppid, report->length, report->context, report->sent);
+        g_free(report);
+    }
 }
 
 static void maybe_set_state_to_ready(GstSctpAssociation *self)
@@ -260,7 +751,7 @@ static void maybe_set_state_to_ready(GstSctpAssociation *self)
         signal_ready_state = TRUE;
         gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_READY, FALSE);
     }
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
 
     /* The reason the state is changed twice is that we do not want to change state with
      * notification while the association_mutex is locked. If someone listens
@@ -291,6 +782,72 @@ static void gst_sctp_association_get_property(GObject *object, guint prop_id, GV
     case PROP_USE_SOCK_STREAM:
         g_value_set_boolean(value, self->use_sock_stream);
         break;
+    case PROP_BUNDLING_POLICY:
+        g_value_set_enum(value, self->bundling_policy);
+        break;
+    case PROP_BUNDLING_MAX_DELAY:
+        g_value_set_uint(value, self->bundling_max_delay);
+        break;
+    case PROP_SACK_DELAY:
+        g_value_set_uint(value, self->sack_delay);
+        break;
+    case PROP_SACK_FREQUENCY:
+        g_value_set_uint(value, self->sack_frequency);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        g_value_set_enum(value, self->congestion_control);
+        break;
+    case PROP_RTCC_STEADY_STEP:
+        g_value_set_uint(value, self->rtcc_steady_step);
+        break;
+    case PROP_RTCC_USE_ECN:
+        g_value_set_boolean(value, self->rtcc_use_ecn);
+        break;
+    case PROP_ECN:
+        g_value_set_boolean(value, self->ecn);
+        break;
+    case PROP_IDLE_TIMEOUT:
+        g_value_set_uint(value, self->idle_timeout);
+        break;
+    case PROP_IDLE_HEARTBEAT_INTERVAL:
+        g_value_set_uint(value, self->idle_heartbeat_interval);
+        break;
+    case PROP_IDLE:
+        g_value_set_boolean(value, self->idle);
+        break;
+    case PROP_MTU:
+        g_value_set_uint(value, self->mtu);
+        break;
+    case PROP_CAPTURE_PACKETS:
+        g_value_set_uint(value, self->capture_packets);
+        break;
+    case PROP_CAPTURE_SNAPLEN:
+        g_value_set_uint(value, self->capture_snaplen);
+        break;
+    case PROP_CAPTURE_SAMPLE_INTERVAL:
+        g_value_set_uint(value, self->capture_sample_interval);
+        break;
+    case PROP_PRECONNECT_BUFFER_SIZE:
+        g_value_set_uint(value, self->preconnect_buffer_size);
+        break;
+    case PROP_SETUP_PROFILE:
+        g_value_set_enum(value, self->setup_profile);
+        break;
+    case PROP_MAX_INIT_RETRANSMITS:
+        g_value_set_uint(value, self->max_init_retransmits);
+        break;
+    case PROP_MAX_RETRANSMITS:
+        g_value_set_uint(value, self->max_retransmits);
+        break;
+    case PROP_CHECKSUM:
+        g_value_set_enum(value, self->checksum);
+        break;
+    case PROP_MEMORY_LIMIT:
+        g_value_set_uint(value, self->memory_limit);
+        break;
+    case PROP_ENGINE:
+        g_value_set_enum(value, self->engine_type);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -320,19 +877,39 @@ GstSctpAssociation *gst_sctp_association_get(guint32 association_id)
 }
 
 gboolean gst_sctp_association_start(GstSctpAssociation *self) {
+    const GstSctpEngineFuncs *funcs;
+    GstSctpEngine *engine;
     gchar *thread_name;
 
     g_mutex_lock(&self->association_mutex);
-    if (self->state != GST_SCTP_ASSOCIATION_STATE_READY) {
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_READY || self->engine) {
         g_warning("SCTP association is in wrong state and cannot be started");
         goto configure_required;
     }
 
-    if ((self->sctp_ass_sock = create_sctp_socket(self)) == NULL)
+    self->start_time = g_get_monotonic_time();
+    funcs = self->engine_type == GST_SCTP_ASSOCIATION_ENGINE_LITE ?
+        &gst_sctp_lite_engine_funcs : &gst_sctp_usrsctp_engine_funcs;
+    /* Published before it is opened, the engines drop packets that arrive until then */
+    g_atomic_pointer_set(&self->engine, funcs->create(self));
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Starting the association with the %s engine",
+        funcs->name);
+
+    /* Before connecting, the receive buffer sizes the window announced in the INIT */
+    if (!self->engine->funcs->open(self->engine)
+        || !apply_socket_buffers(self, INITIAL_SOCKET_BUFFER_SIZE, INITIAL_SOCKET_BUFFER_SIZE)) {
+        engine = self->engine;
+        engine->funcs->close(engine);
+        release_socket_buffers(self);
+        /* Unpublished so the association can be started again */
+        g_atomic_pointer_set(&self->engine, NULL);
+        unlock_association(self);
+        engine->funcs->free(engine);
         goto error;
+    }
 
     gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_CONNECTING, FALSE);
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
 
     /* The reason the state is changed twice is that we do not want to change state with
      * notification while the association_mutex is locked. If someone listens
@@ -346,11 +923,10 @@ gboolean gst_sctp_association_start(GstSctpAssociation *self) {
 
     return TRUE;
 error:
-    g_mutex_unlock(&self->association_mutex);
     gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_ERROR, TRUE);
     return FALSE;
 configure_required:
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
     return FALSE;
 }
 
@@ -359,14 +935,15 @@ void gst_sctp_association_set_on_packet_out(GstSctpAssociation *self, GstSctpAss
     g_return_if_fail(GST_SCTP_IS_ASSOCIATION(self));
 
     g_mutex_lock(&self->association_mutex);
-    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW) {
+    /* Clearing is always allowed, so that the owner can free user_data */
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW || !packet_out_cb) {
         self->packet_out_cb = packet_out_cb;
         self->packet_out_user_data = user_data;
     } else {
         /* This is to be thread safe. The Association might try to write to the closure already */
         g_warning("It is not possible to change packet callback in this state");
     }
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
 
     maybe_set_state_to_ready(self);
 }
@@ -376,408 +953,937 @@ void gst_sctp_association_set_on_packet_received(GstSctpAssociation *self, GstSc
     g_return_if_fail(GST_SCTP_IS_ASSOCIATION(self));
 
     g_mutex_lock(&self->association_mutex);
-    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW) {
+    /* Clearing is always allowed, so that the owner can free user_data */
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW || !packet_received_cb) {
         self->packet_received_cb = packet_received_cb;
         self->packet_received_user_data = user_data;
     } else {
         /* This is to be thread safe. The Association might try to write to the closure already */
         g_warning("It is not possible to change receive callback in this state");
     }
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
 
     maybe_set_state_to_ready(self);
 }
 
-void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length)
+void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length,
+    guint8 ecn_bits)
 {
-    usrsctp_conninput((void *) self, (const void *)buf, (size_t)length, 0);
+    GstSctpEngine *engine;
+
+    g_mutex_lock(&self->stats_mutex);
+    self->stats.packets_received++;
+    g_mutex_unlock(&self->stats_mutex);
+
+    if (self->capture_packets)
+        capture_packet(self, FALSE, buf, length);
+
+    /* Nothing to hand the packet to before the association is started */
+    engine = g_atomic_pointer_get(&self->engine);
+    if (!engine)
+        return;
+
+    if (engine->funcs->external_checksum
+        && self->checksum != GST_SCTP_ASSOCIATION_CHECKSUM_NONE
+        && !gst_sctp_checksum_verify(buf, length,
+            self->checksum == GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED)) {
+        g_mutex_lock(&self->stats_mutex);
+        self->stats.checksum_errors++;
+        g_mutex_unlock(&self->stats_mutex);
+        return;
+    }
+
+    engine->funcs->incoming_packet(engine, buf, length, ecn_bits);
 }
 
 gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, guint32 length,
     guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
-    guint32 reliability_param)
+    guint32 reliability_param, GstSctpAssociationSendFlags flags, guint32 context)
 {
-    struct sctp_sendv_spa spa;
-    gint32 bytes_sent;
     gboolean result = FALSE;
-    struct sockaddr_conn remote_addr;
+    gboolean woke_up = FALSE;
 
     g_mutex_lock(&self->association_mutex);
-    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+    switch (self->state) {
+    case GST_SCTP_ASSOCIATION_STATE_NEW:
+    case GST_SCTP_ASSOCIATION_STATE_READY:
+    case GST_SCTP_ASSOCIATION_STATE_CONNECTING:
+        /* Held until SCTP_COMM_UP, the caller retries once there is room again */
+        if (self->held_bytes + DATA_CHUNK_SIZE(length) <= self->preconnect_buffer_size) {
+            hold_message(self, buf, length, stream_id, ppid, ordered, pr, reliability_param, flags,
+                context);
+            result = TRUE;
+        }
         goto end;
+    case GST_SCTP_ASSOCIATION_STATE_CONNECTED:
+        break;
+    default:
+        goto end;
+    }
 
-    memset(&spa, 0, sizeof(spa));
-
-    spa.sendv_sndinfo.snd_ppid = g_htonl(ppid);
-    spa.sendv_sndinfo.snd_sid = stream_id;
-    spa.sendv_sndinfo.snd_flags = ordered ? 0 : SCTP_UNORDERED;
-    spa.sendv_sndinfo.snd_context = 0;
-    spa.sendv_sndinfo.snd_assoc_id = 0;
-    spa.sendv_flags = SCTP_SEND_SNDINFO_VALID;
-    if (pr != GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE) {
-        spa.sendv_flags |= SCTP_SEND_PRINFO_VALID;
-        spa.sendv_prinfo.pr_value = g_htonl(reliability_param);
-        if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL)
-            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_TTL;
-        else if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX)
-            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_RTX;
-        else if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_BUF)
-            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_BUF;
-    }
-
-    remote_addr = get_sctp_socket_address(self, self->remote_port);
-    bytes_sent = usrsctp_sendv(self->sctp_ass_sock, buf, length, (struct sockaddr *)&remote_addr, 1, (void *)&spa, (socklen_t)sizeof(struct sctp_sendv_spa), SCTP_SENDV_SPA, 0);
-    if (bytes_sent < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            /* Resending this buffer is taken care of by the gstsctpenc */
-            goto end;
-        } else {
-            g_warning("Error sending data on stream %u: (%u) %s", stream_id, errno, strerror(errno));
+    woke_up = note_activity(self);
+
+    if (self->bundling_policy == GST_SCTP_ASSOCIATION_BUNDLING_POLICY_ADAPTIVE) {
+        if (!(flags & GST_SCTP_ASSOCIATION_SEND_FLAG_URGENT) && self->bundling_max_delay > 0
+            && self->held_bytes + DATA_CHUNK_SIZE(length) < BUNDLING_PACKET_CAPACITY(self)) {
+            if (g_queue_is_empty(&self->held_messages)) {
+                g_source_set_ready_time(self->bundling_timer,
+                    g_get_monotonic_time() + self->bundling_max_delay);
+            }
+            hold_message(self, buf, length, stream_id, ppid, ordered, pr, reliability_param, flags,
+                context);
+
+            result = TRUE;
             goto end;
         }
     }
 
-    result = TRUE;
+    /* Messages held earlier, for bundling or because they were sent before the association was
+     * up, must go out first to keep them in order. This message then completes the packet they
+     * are bundled in. */
+    if (!flush_held_messages(self, TRUE))
+        goto end;
+
+    result = send_message(self, buf, length, stream_id, ppid, ordered, pr, reliability_param, flags,
+        context);
 end:
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
+    if (woke_up)
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_IDLE]);
     return result;
 }
 
 
 void gst_sctp_association_reset_stream(GstSctpAssociation *self, guint16 stream_id)
 {
-    struct sctp_reset_streams *srs;
-    socklen_t length;
-
-    length = (socklen_t)(sizeof(struct sctp_reset_streams) + sizeof(guint16));
-    srs = (struct sctp_reset_streams *) g_malloc0(length);
-    srs->srs_flags = SCTP_STREAM_RESET_OUTGOING;
-    srs->srs_number_streams = 1;
-    srs->srs_stream_list[0] = stream_id;
+    g_mutex_lock(&self->association_mutex);
+    if (self->engine)
+        self->engine->funcs->reset_stream(self->engine, stream_id);
+    unlock_association(self);
+}
 
+void gst_sctp_association_force_close(GstSctpAssociation *self)
+{
     g_mutex_lock(&self->association_mutex);
-    usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_RESET_STREAMS, srs, length);
-    g_mutex_unlock(&self->association_mutex);
+    drop_held_messages(self);
+    if (self->engine)
+        self->engine->funcs->close(self->engine);
+    g_source_set_ready_time(self->buffer_timer, -1);
+    release_socket_buffers(self);
+    unlock_association(self);
+}
 
-    g_free(srs);
+void gst_sctp_association_get_stats(GstSctpAssociation *self, GstSctpAssociationStats *stats)
+{
+    GstSctpEngineStatus status;
+    GstSctpEngineCounters counters;
+    GstSctpEngine *engine;
+
+    g_mutex_lock(&self->stats_mutex);
+    *stats = self->stats;
+    g_mutex_unlock(&self->stats_mutex);
+
+    g_mutex_lock(&self->association_mutex);
+    memset(&status, 0, sizeof(GstSctpEngineStatus));
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED
+        && self->engine->funcs->get_status(self->engine, &status)) {
+        stats->srtt = status.srtt;
+        stats->rto = status.rto;
+        stats->cwnd = status.cwnd;
+        stats->peer_rwnd = status.peer_rwnd;
+        stats->unacked_chunks = status.unacked_chunks;
+        stats->pending_chunks = status.pending_chunks;
+        stats->buffered_amount = status.send_buffered;
+        stats->receive_buffered_amount = status.receive_buffered;
+    }
+    stats->buffered_amount += self->held_bytes;
+    stats->send_buffer_size = self->send_buffer_size;
+    stats->receive_buffer_size = self->receive_buffer_size;
+    unlock_association(self);
+
+    G_LOCK(memory_lock);
+    stats->memory_committed = memory_committed;
+    stats->memory_budget = memory_budget;
+    G_UNLOCK(memory_lock);
+
+    engine = g_atomic_pointer_get(&self->engine);
+    if (engine) {
+        memset(&counters, 0, sizeof(GstSctpEngineCounters));
+        engine->funcs->get_counters(engine, &counters);
+        stats->stack_data_chunks_sent = counters.data_chunks_sent;
+        stats->stack_data_chunks_retransmitted = counters.data_chunks_retransmitted;
+        stats->stack_fast_retransmits = counters.fast_retransmits;
+        stats->stack_t3_timeouts = counters.t3_timeouts;
+        stats->stack_init_timeouts = counters.init_timeouts;
+    }
 }
 
-void gst_sctp_association_force_close(GstSctpAssociation *self)
+/* Cheaper than gst_sctp_association_get_stats() for callers polling the congestion state */
+gboolean gst_sctp_association_get_congestion_window(GstSctpAssociation *self, guint32 *cwnd,
+    guint32 *srtt)
 {
+    GstSctpEngineStatus status;
+    gboolean ret = FALSE;
+
     g_mutex_lock(&self->association_mutex);
-    if (self->sctp_ass_sock) {
-        usrsctp_shutdown (self->sctp_ass_sock, SHUT_RDWR);
-        usrsctp_close(self->sctp_ass_sock);
-        self->sctp_ass_sock = NULL;
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED
+        && self->engine->funcs->get_status(self->engine, &status)) {
+        *cwnd = status.cwnd;
+        *srtt = status.srtt;
+        ret = TRUE;
     }
-    g_mutex_unlock(&self->association_mutex);
+    unlock_association(self);
+
+    return ret;
 }
 
-static struct socket * create_sctp_socket(GstSctpAssociation *self)
-{
-    struct socket *sock;
-    struct linger l;
-    struct sctp_event event;
-    struct sctp_assoc_value stream_reset;
-    int value = 1;
-    guint16 event_types[] = {
-        SCTP_ASSOC_CHANGE,
-        SCTP_PEER_ADDR_CHANGE,
-        SCTP_REMOTE_ERROR,
-        SCTP_SEND_FAILED,
-        SCTP_SHUTDOWN_EVENT,
-        SCTP_ADAPTATION_INDICATION,
-        /*SCTP_PARTIAL_DELIVERY_EVENT,*/
-        /*SCTP_AUTHENTICATION_EVENT,*/
-        SCTP_STREAM_RESET_EVENT,
-        /*SCTP_SENDER_DRY_EVENT,*/
-        /*SCTP_NOTIFICATIONS_STOPPED_EVENT,*/
-        /*SCTP_ASSOC_RESET_EVENT,*/
-        SCTP_STREAM_CHANGE_EVENT};
-    guint32 i;
-    guint sock_type = self->use_sock_stream ? SOCK_STREAM : SOCK_SEQPACKET;
-
-    if ((sock = usrsctp_socket(AF_CONN, sock_type, IPPROTO_SCTP, receive_cb, NULL, 0,
-        (void *)self)) == NULL)
-        goto error;
+/* Streams are refused last, once the budget is used up and the association has nothing left to
+ * give back: idle associations have shrunk and this one is down to its minimum */
+gboolean gst_sctp_association_can_open_stream(GstSctpAssociation *self)
+{
+    guint64 held;
+    gboolean ret;
 
-    if (usrsctp_set_non_blocking(sock, 1) < 0) {
-        g_warning("Could not set non-blocking mode on SCTP socket");
-        goto error;
+    g_return_val_if_fail(GST_SCTP_IS_ASSOCIATION(self), FALSE);
+
+    g_mutex_lock(&self->association_mutex);
+    held = (guint64) self->send_buffer_size + self->receive_buffer_size;
+    G_LOCK(memory_lock);
+    if (memory_budget == 0 || held > 2 * MIN_SOCKET_BUFFER_SIZE)
+        ret = TRUE;
+    else if (held == 0)
+        ret = memory_committed + 2 * MIN_SOCKET_BUFFER_SIZE <= memory_budget;
+    else
+        ret = memory_committed < memory_budget;
+    G_UNLOCK(memory_lock);
+    unlock_association(self);
+
+    return ret;
+}
+
+/* The budget covers the socket buffers of all associations in the process. Lowering it takes
+ * effect as the associations take their next measurement. */
+void gst_sctp_association_set_memory_budget(guint64 budget)
+{
+    G_LOCK(memory_lock);
+    memory_budget = budget;
+    G_UNLOCK(memory_lock);
+}
+
+guint64 gst_sctp_association_get_memory_budget(void)
+{
+    guint64 budget;
+
+    G_LOCK(memory_lock);
+    budget = memory_budget;
+    G_UNLOCK(memory_lock);
+
+    return budget;
+}
+
+static gpointer connection_thread_func(GstSctpAssociation *self)
+{
+    g_mutex_lock(&self->association_mutex);
+    /* TODO: Support both server and client role */
+    self->engine->funcs->connect(self->engine);
+    unlock_association(self);
+    return NULL;
+}
+
+/* Callbacks of the engines */
+
+void gst_sctp_association_engine_packet_out(GstSctpAssociation *self, guint8 *data, gsize length,
+    guint8 tos, gboolean set_df)
+{
+    g_mutex_lock(&self->stats_mutex);
+    self->stats.packets_sent++;
+    g_mutex_unlock(&self->stats_mutex);
+
+    if (self->engine->funcs->external_checksum
+        && self->checksum != GST_SCTP_ASSOCIATION_CHECKSUM_NONE) {
+        gst_sctp_checksum_write(data, length,
+            self->checksum == GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED);
     }
 
-    memset(&l, 0, sizeof(l));
-    l.l_onoff = 1;
-    l.l_linger = 0;
-    if (usrsctp_setsockopt(sock, SOL_SOCKET, SO_LINGER, (const void *)&l,
-        (socklen_t) sizeof(struct linger)) < 0) {
-        g_warning("Could not set SO_LINGER on SCTP socket");
-        goto error;
+    if (self->capture_packets)
+        capture_packet(self, TRUE, data, length);
+
+    if (self->packet_out_cb) {
+        self->packet_out_cb(self, data, length, tos, set_df, self->packet_out_user_data);
     }
+}
 
-    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_NODELAY, &value, sizeof(int))) {
-        g_warning("Could not set SCTP_NODELAY");
-        goto error;
+void gst_sctp_association_engine_connected(GstSctpAssociation *self)
+{
+    gboolean change_state = FALSE;
+    GstSctpAssociationState new_state;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTING) {
+        change_state = TRUE;
+        new_state = GST_SCTP_ASSOCIATION_STATE_CONNECTED;
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association connected!");
+        /* Module options can only be set once the association exists */
+        if (self->engine->funcs->apply_congestion_control_options)
+            self->engine->funcs->apply_congestion_control_options(self->engine);
+        self->last_activity = g_get_monotonic_time();
+        g_mutex_lock(&self->stats_mutex);
+        self->stats.time_to_connected = self->last_activity - self->start_time;
+        g_mutex_unlock(&self->stats_mutex);
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Connected after %" G_GINT64_FORMAT " us",
+            self->last_activity - self->start_time);
+        if (self->idle_timeout) {
+            g_source_set_ready_time(self->idle_timer,
+                self->last_activity + (gint64) self->idle_timeout * G_TIME_SPAN_MILLISECOND);
+        }
+        restart_buffer_tuning(self);
+        /* Switch state before releasing the lock so no message is held after the batch below.
+         * The notification follows once the lock is released. */
+        gst_sctp_association_change_state(self, new_state, FALSE);
+        if (!g_queue_is_empty(&self->held_messages)) {
+            g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Sending %u messages held before connecting",
+                g_queue_get_length(&self->held_messages));
+            flush_held_messages(self, FALSE);
+        }
+    } else if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        g_warning("SCTP association already open");
+    } else {
+        g_warning("SCTP association in unexpected state");
     }
+    unlock_association(self);
 
-    memset(&stream_reset, 0, sizeof(stream_reset));
-    stream_reset.assoc_id = SCTP_ALL_ASSOC;
-    stream_reset.assoc_value = 1;
-    if (usrsctp_setsockopt(sock,  IPPROTO_SCTP, SCTP_ENABLE_STREAM_RESET,
-        &stream_reset, sizeof(stream_reset))) {
-        g_warning("Could not set SCTP_ENABLE_STREAM_RESET");
-        goto error;
+    if (change_state)
+        gst_sctp_association_change_state(self, new_state, TRUE);
+}
+
+void gst_sctp_association_engine_disconnected(GstSctpAssociation *self)
+{
+    gboolean change_state = FALSE;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        change_state = TRUE;
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association disconnected");
+        g_source_set_ready_time(self->buffer_timer, -1);
+        g_source_set_ready_time(self->idle_timer, -1);
+        release_socket_buffers(self);
+        gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_DISCONNECTED, FALSE);
     }
+    unlock_association(self);
 
-    memset(&event, 0, sizeof(event));
-    event.se_assoc_id = SCTP_ALL_ASSOC;
-    event.se_on = 1;
-    for (i = 0; i < sizeof(event_types) / sizeof(event_types[0]); i++) {
-        event.se_type = event_types[i];
-        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_EVENT,
-            &event, sizeof(event)) < 0) {
-            g_warning("Failed to register event %u", event_types[i]);
-        }
+    if (change_state)
+        gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_DISCONNECTED, TRUE);
+}
+
+void gst_sctp_association_engine_stream_reset(GstSctpAssociation *self, guint16 stream_id)
+{
+    g_signal_emit(self, signals[SIGNAL_STREAM_RESET], 0, stream_id);
+}
+
+/* usrsctp reports each abandoned chunk with the data it carried, a message sent in fragments
+ * may therefore be reported more than once. Called from within the engine, possibly while a send
+ * holds the association mutex, so the report is queued and signalled by whoever releases it. */
+void gst_sctp_association_engine_send_failed(GstSctpAssociation *self, guint16 stream_id,
+    guint32 ppid, guint32 length, guint32 context, gboolean sent, guint32 error)
+{
+    AbandonedReport *report;
+
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "%s %u bytes on stream %u abandoned (error %u)",
+        sent ? "Sent" : "Unsent", length, stream_id, error);
+
+    report = g_new(AbandonedReport, 1);
+    report->stream_id = stream_id;
+    report->ppid = ppid;
+    report->length = length;
+    report->context = context;
+    report->sent = sent;
+
+    g_mutex_lock(&self->stats_mutex);
+    self->stats.messages_abandoned++;
+    self->stats.bytes_abandoned += length;
+    g_queue_push_tail(&self->abandoned_reports, report);
+    g_atomic_int_set(&self->abandoned_pending, 1);
+    g_mutex_unlock(&self->stats_mutex);
+
+    /* If the lock is held, by this thread or another one, its holder emits on unlock */
+    if (g_mutex_trylock(&self->association_mutex))
+        unlock_association(self);
+}
+
+void gst_sctp_association_engine_message(GstSctpAssociation *self, guint8 *data, gsize datalen,
+    const GstSctpAssociationReceiveInfo *info)
+{
+    gboolean woke_up;
+
+    /* Skip the lock when there is no idle policy, note_activity() checks again */
+    if (self->idle_timeout) {
+        g_mutex_lock(&self->association_mutex);
+        woke_up = note_activity(self);
+        unlock_association(self);
+        if (woke_up)
+            g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_IDLE]);
     }
 
-    return sock;
-error:
-    if (sock) {
-        usrsctp_close(sock);
-        g_warning("Could not create socket. Error: (%u) %s", errno, strerror(errno));
-        errno = 0;
-        sock = NULL;
+    g_mutex_lock(&self->stats_mutex);
+    if (info->last_fragment)
+        self->stats.messages_received++;
+    self->stats.bytes_received += datalen;
+    g_mutex_unlock(&self->stats_mutex);
+
+    if (self->packet_received_cb) {
+        self->packet_received_cb(self, data, datalen, info, self->packet_received_user_data);
     }
+}
+
+static void gst_sctp_association_change_state(GstSctpAssociation *self, GstSctpAssociationState new_state,
+    gboolean notify)
+{
+    self->state = new_state;
+    if (notify)
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STATE]);
+}
+
+static gpointer timer_thread_func(GMainLoop *loop)
+{
+    g_main_loop_run(loop);
     return NULL;
 }
 
-static struct sockaddr_conn get_sctp_socket_address(GstSctpAssociation *gst_sctp_association,
-    guint16 port) {
-    struct sockaddr_conn addr;
+static gboolean timer_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    /* One shot, the owner re-arms it with g_source_set_ready_time() */
+    g_source_set_ready_time(source, -1);
+    return callback(user_data);
+}
 
-    memset((void *)&addr, 0, sizeof(struct sockaddr_conn));
-#ifdef __APPLE__
-    addr.sconn_len = sizeof(struct sockaddr_conn);
-#endif
-    addr.sconn_family = AF_CONN;
-    addr.sconn_port = g_htons(port);
-    addr.sconn_addr = (void *) gst_sctp_association;
+static GSourceFuncs timer_source_funcs = {
+    NULL, NULL, timer_source_dispatch, NULL
+};
 
-    return addr;
+static void free_weak_ref(GWeakRef *ref)
+{
+    g_weak_ref_clear(ref);
+    g_slice_free(GWeakRef, ref);
 }
 
-static gpointer connection_thread_func(GstSctpAssociation *self)
+GSource *gst_sctp_association_create_timer_source(GstSctpAssociation *self, GSourceFunc func)
 {
-    /* TODO: Support both server and client role */
-    client_role_connect(self);
-    return NULL;
+    static gsize timer_thread_started = 0;
+    GSource *source;
+    GWeakRef *ref;
+
+    if (g_once_init_enter(&timer_thread_started)) {
+        GMainLoop *loop;
+
+        timer_context = g_main_context_new();
+        loop = g_main_loop_new(timer_context, FALSE);
+        g_thread_unref(g_thread_new("sctp_timer_thread", (GThreadFunc) timer_thread_func, loop));
+        g_once_init_leave(&timer_thread_started, 1);
+    }
+
+    /* The callbacks only hold a weak reference so an armed timer never keeps the association alive */
+    ref = g_slice_new(GWeakRef);
+    g_weak_ref_init(ref, self);
+
+    source = g_source_new(&timer_source_funcs, sizeof(GSource));
+    g_source_set_callback(source, func, ref, (GDestroyNotify) free_weak_ref);
+    g_source_set_ready_time(source, -1);
+    g_source_attach(source, timer_context);
+
+    return source;
 }
 
-static gboolean client_role_connect(GstSctpAssociation *self) {
-    struct sctp_paddrparams paddrparams;
-    struct sockaddr_conn addr;
-    socklen_t opt_len;
-    gint ret;
+static gboolean on_bundling_timeout(gpointer user_data)
+{
+    GstSctpAssociation *self = g_weak_ref_get((GWeakRef *) user_data);
+
+    if (!self)
+        return G_SOURCE_CONTINUE;
 
     g_mutex_lock(&self->association_mutex);
-    addr = get_sctp_socket_address(self, self->local_port);
-    ret = usrsctp_bind(self->sctp_ass_sock, (struct sockaddr *)&addr, sizeof(struct sockaddr_conn));
-    if (ret < 0) {
-      g_warning("usrsctp_bind() error: (%u) %s", errno, strerror(errno));
-      goto error;
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+        flush_held_messages(self, FALSE);
+    unlock_association(self);
+
+    g_object_unref(self);
+    return G_SOURCE_CONTINUE;
+}
+
+static void set_nodelay(GstSctpAssociation *self, gboolean nodelay)
+{
+    self->engine->funcs->set_nodelay(self->engine, nodelay);
+}
+
+static gboolean send_message(GstSctpAssociation *self, guint8 *buf, guint32 length, guint16 stream_id,
+    guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr, guint32 reliability_param,
+    GstSctpAssociationSendFlags flags, guint32 context)
+{
+    if (!self->engine->funcs->send(self->engine, buf, length, stream_id, ppid, ordered, pr,
+        reliability_param, flags, context))
+        return FALSE;
+
+    g_mutex_lock(&self->stats_mutex);
+    self->stats.messages_sent++;
+    self->stats.bytes_sent += length;
+    g_mutex_unlock(&self->stats_mutex);
+
+    return TRUE;
+}
+
+/* Must be called with the association_mutex locked */
+static void hold_message(GstSctpAssociation *self, guint8 *buf, guint32 length, guint16 stream_id,
+    guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr, guint32 reliability_param,
+    GstSctpAssociationSendFlags flags, guint32 context)
+{
+    HeldMessage *msg = g_slice_new(HeldMessage);
+
+    msg->data = g_memdup(buf, length);
+    msg->length = length;
+    msg->stream_id = stream_id;
+    msg->ppid = ppid;
+    msg->ordered = ordered;
+    msg->pr = pr;
+    msg->reliability_param = reliability_param;
+    msg->flags = flags;
+    msg->context = context;
+
+    g_queue_push_tail(&self->held_messages, msg);
+    self->held_bytes += DATA_CHUNK_SIZE(length);
+}
+
+static void free_held_message(HeldMessage *msg)
+{
+    g_free(msg->data);
+    g_slice_free(HeldMessage, msg);
+}
+
+/* Must be called with the association_mutex locked. Returns TRUE when nothing is held anymore.
+ *
+ * The held messages are handed to the stack with Nagle enabled so they are queued rather than
+ * sent one by one. Switching SCTP_NODELAY back on for the last send of the batch (or for the
+ * message that follows it when more_follows is TRUE) makes the stack output everything queued,
+ * bundled into as few packets as possible. */
+static gboolean flush_held_messages(GstSctpAssociation *self, gboolean more_follows)
+{
+    HeldMessage *msg;
+
+    if (g_queue_is_empty(&self->held_messages))
+        return TRUE;
+
+    g_source_set_ready_time(self->bundling_timer, -1);
+    set_nodelay(self, FALSE);
+    while ((msg = g_queue_peek_head(&self->held_messages))) {
+        if (!more_follows && msg == g_queue_peek_tail(&self->held_messages))
+            set_nodelay(self, TRUE);
+
+        if (!send_message(self, msg->data, msg->length, msg->stream_id, msg->ppid, msg->ordered,
+            msg->pr, msg->reliability_param, msg->flags, msg->context))
+            break;
+
+        g_queue_pop_head(&self->held_messages);
+        self->held_bytes -= DATA_CHUNK_SIZE(msg->length);
+        free_held_message(msg);
     }
+    set_nodelay(self, self->bundling_policy != GST_SCTP_ASSOCIATION_BUNDLING_POLICY_THROUGHPUT);
 
-    addr = get_sctp_socket_address(self, self->remote_port);
-    ret = usrsctp_connect(self->sctp_ass_sock, (struct sockaddr *)&addr, sizeof(struct sockaddr_conn));
-    if (ret < 0 && errno != EINPROGRESS) {
-        g_warning("usrsctp_connect() error: (%u) %s", errno, strerror(errno));
-        goto error;
+    if (!g_queue_is_empty(&self->held_messages)) {
+        /* The send buffer is full, try again later */
+        g_source_set_ready_time(self->bundling_timer,
+            g_get_monotonic_time() + MAX(self->bundling_max_delay, 1000));
+        return FALSE;
     }
 
-    memset(&paddrparams, 0, sizeof(struct sctp_paddrparams));
-    memcpy(&paddrparams.spp_address, &addr, sizeof(struct sockaddr_conn));
+    return TRUE;
+}
 
-    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
-    ret = usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, &opt_len);
-    if (ret < 0) {
-        g_warning("usrsctp_getsockopt() error: (%u) %s", errno, strerror(errno));
-        goto error;
-    }
+static void drop_held_messages(GstSctpAssociation *self)
+{
+    HeldMessage *msg;
 
-    // draft-ietf-rtcweb-data-channel-13 section 5: max initial MTU IPV4 1200, IPV6 1280
-    paddrparams.spp_pathmtu = 1200; // safe for either
-    paddrparams.spp_flags &= ~SPP_PMTUD_ENABLE;
-    paddrparams.spp_flags |= SPP_PMTUD_DISABLE;
-    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
+    while ((msg = g_queue_pop_head(&self->held_messages)))
+        free_held_message(msg);
+    self->held_bytes = 0;
+}
 
-    ret = usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, opt_len);
-    if (ret < 0) {
-        g_warning("usrsctp_setsockopt() error: (%u) %s", errno, strerror(errno));
-        goto error;
-    }
+/* Must be called with the association_mutex locked */
+static void apply_bundling_policy(GstSctpAssociation *self)
+{
+    if (!self->engine)
+        return;
 
-    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "usrsctp: PMTUD disabled, MTU set to %u", paddrparams.spp_pathmtu);
+    if (self->bundling_policy != GST_SCTP_ASSOCIATION_BUNDLING_POLICY_ADAPTIVE)
+        flush_held_messages(self, FALSE);
+    set_nodelay(self, self->bundling_policy != GST_SCTP_ASSOCIATION_BUNDLING_POLICY_THROUGHPUT);
+}
+
+/* Must be called with the association mutex held. Returns TRUE if the association left the idle
+ * state. */
+static gboolean note_activity(GstSctpAssociation *self)
+{
+    if (self->idle_timeout == 0)
+        return FALSE;
+
+    /* The timer is still armed while active and checks last_activity when it fires, so the
+     * common case costs no more than reading the clock */
+    self->last_activity = g_get_monotonic_time();
+    if (!self->idle)
+        return FALSE;
+
+    self->engine->funcs->set_heartbeat_interval(self->engine, self->active_heartbeat_interval);
+    self->idle = FALSE;
+    g_source_set_ready_time(self->idle_timer,
+        self->last_activity + (gint64) self->idle_timeout * G_TIME_SPAN_MILLISECOND);
+    restart_buffer_tuning(self);
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association is active again");
 
-    g_mutex_unlock(&self->association_mutex);
     return TRUE;
-error:
-    g_mutex_unlock(&self->association_mutex);
+}
+
+/* Must be called with the association mutex held after the idle settings or the state changed.
+ * Returns TRUE if the association left the idle state. */
+static gboolean update_idle_timer(GstSctpAssociation *self)
+{
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED || self->idle_timeout == 0) {
+        g_source_set_ready_time(self->idle_timer, -1);
+        if (!self->idle)
+            return FALSE;
+
+        self->engine->funcs->set_heartbeat_interval(self->engine, self->active_heartbeat_interval);
+        self->idle = FALSE;
+        if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+            restart_buffer_tuning(self);
+        return TRUE;
+    }
+
+    if (self->idle)
+        return FALSE;
+
+    if (self->last_activity == 0)
+        self->last_activity = g_get_monotonic_time();
+    g_source_set_ready_time(self->idle_timer,
+        self->last_activity + (gint64) self->idle_timeout * G_TIME_SPAN_MILLISECOND);
+
     return FALSE;
 }
 
-static int sctp_packet_out(void *addr, void* buffer, size_t length, guint8 tos, guint8 set_df)
+static gboolean on_idle_timeout(gpointer user_data)
 {
-    GstSctpAssociation *self = GST_SCTP_ASSOCIATION(addr);
+    GstSctpAssociation *self = g_weak_ref_get((GWeakRef *) user_data);
+    gboolean went_idle = FALSE;
+    gint64 deadline;
 
-    if (self->packet_out_cb) {
-        self->packet_out_cb(self, buffer, length, self->packet_out_user_data);
+    if (!self)
+        return G_SOURCE_CONTINUE;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED || self->idle_timeout == 0
+        || self->idle)
+        goto end;
+
+    deadline = self->last_activity + (gint64) self->idle_timeout * G_TIME_SPAN_MILLISECOND;
+    if (g_get_monotonic_time() < deadline || !g_queue_is_empty(&self->held_messages)) {
+        g_source_set_ready_time(self->idle_timer, deadline);
+        goto end;
+    }
+
+    if (!self->engine->funcs->get_heartbeat_interval(self->engine, &self->active_heartbeat_interval)
+        || !self->engine->funcs->set_heartbeat_interval(self->engine,
+            self->idle_heartbeat_interval)) {
+        g_source_set_ready_time(self->idle_timer,
+            g_get_monotonic_time() + (gint64) self->idle_timeout * G_TIME_SPAN_MILLISECOND);
+        goto end;
     }
 
-    return 0;
+    /* Idle associations are the first to give memory back */
+    apply_socket_buffers(self, MIN_SOCKET_BUFFER_SIZE, MIN_SOCKET_BUFFER_SIZE);
+
+    /* Nothing of ours is armed while idle, the next send or receive wakes the association */
+    self->idle = TRUE;
+    went_idle = TRUE;
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association is idle");
+end:
+    unlock_association(self);
+    if (went_idle)
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_IDLE]);
+
+    g_object_unref(self);
+    return G_SOURCE_CONTINUE;
 }
 
-static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
-    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info)
+/* Takes the buffer sizes out of the memory budget and sets them on the engine. Above its share of
+ * the budget an association only grows into memory nobody else holds, and gives the excess back
+ * while the budget is exceeded. The minimum is granted even over budget. Must be called with the
+ * association mutex held. */
+static gboolean apply_socket_buffers(GstSctpAssociation *self, guint send_size,
+    guint receive_size)
 {
-    GstSctpAssociation *self = GST_SCTP_ASSOCIATION(ulp_info);
+    guint64 held, wanted, granted, available, share;
+
+    held = (guint64) self->send_buffer_size + self->receive_buffer_size;
+    wanted = (guint64) send_size + receive_size;
+
+    G_LOCK(memory_lock);
+    granted = wanted;
+    if (memory_budget) {
+        available = memory_committed - held < memory_budget ?
+            memory_budget - (memory_committed - held) : 0;
+        granted = MIN(granted, available);
+
+        share = memory_budget / (memory_holders + (held == 0));
+        if (memory_committed > memory_budget && granted > share)
+            granted = share;
+        granted = MAX(granted, 2 * MIN_SOCKET_BUFFER_SIZE);
+    }
 
-    if (!data) {
-        /* Not sure if this can happend. */
-        g_warning("Received empty data buffer");
-    } else {
-        if (flags & MSG_NOTIFICATION) {
-            handle_notification(self, (const union sctp_notification *)data, datalen);
-            free(data);
-        } else {
-            handle_message(self, data, datalen, rcv_info.rcv_sid, ntohl(rcv_info.rcv_ppid));
-        }
+    if (granted < wanted) {
+        /* Both directions give up the same fraction of what they asked for */
+        send_size = MAX(MIN_SOCKET_BUFFER_SIZE, (guint) (granted * send_size / wanted));
+        receive_size = MAX(MIN_SOCKET_BUFFER_SIZE, (guint) (granted - send_size));
     }
 
-    return 1;
+    if (held == 0)
+        memory_holders++;
+    memory_committed = memory_committed - held + send_size + receive_size;
+    G_UNLOCK(memory_lock);
+
+    self->send_buffer_size = send_size;
+    self->receive_buffer_size = receive_size;
+
+    return self->engine->funcs->set_buffer_sizes(self->engine, send_size, receive_size);
 }
 
-static void handle_notification(GstSctpAssociation *self, const union sctp_notification *notification,
-    size_t length)
+/* Must be called with the association mutex held, or from finalize */
+static void release_socket_buffers(GstSctpAssociation *self)
 {
-    g_assert(notification->sn_header.sn_length == length);
+    guint64 held = (guint64) self->send_buffer_size + self->receive_buffer_size;
 
-    switch (notification->sn_header.sn_type) {
-    case SCTP_ASSOC_CHANGE:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ASSOC_CHANGE");
-        handle_association_changed(self, &notification->sn_assoc_change);
-        break;
-    case SCTP_PEER_ADDR_CHANGE:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_PEER_ADDR_CHANGE");
-        break;
-    case SCTP_REMOTE_ERROR:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_REMOTE_ERROR");
-        break;
-    case SCTP_SEND_FAILED:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SEND_FAILED");
-        break;
-    case SCTP_SHUTDOWN_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SHUTDOWN_EVENT");
-        break;
-    case SCTP_ADAPTATION_INDICATION:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ADAPTATION_INDICATION");
-        break;
-    case SCTP_PARTIAL_DELIVERY_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_PARTIAL_DELIVERY_EVENT");
-        break;
-    case SCTP_AUTHENTICATION_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_AUTHENTICATION_EVENT");
-        break;
-    case SCTP_STREAM_RESET_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_STREAM_RESET_EVENT");
-        handle_stream_reset_event(self, &notification->sn_strreset_event);
-        break;
-    case SCTP_SENDER_DRY_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SENDER_DRY_EVENT");
-        break;
-    case SCTP_NOTIFICATIONS_STOPPED_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_NOTIFICATIONS_STOPPED_EVENT");
-        break;
-    case SCTP_ASSOC_RESET_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ASSOC_RESET_EVENT");
-        break;
-    case SCTP_STREAM_CHANGE_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_STREAM_CHANGE_EVENT");
-        break;
-    case SCTP_SEND_FAILED_EVENT:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SEND_FAILED_EVENT");
-        break;
-    default:
-        break;
-    }
+    if (held == 0)
+        return;
+
+    G_LOCK(memory_lock);
+    memory_committed -= held;
+    memory_holders--;
+    G_UNLOCK(memory_lock);
+
+    self->send_buffer_size = 0;
+    self->receive_buffer_size = 0;
 }
 
-static void handle_association_changed(GstSctpAssociation *self, const struct sctp_assoc_change *sac)
+/* Twice the bandwidth-delay product measured over the last interval, so the buffer does not
+ * limit the rate while the congestion window probes for more. A buffer that was mostly full is
+ * what held the rate back and doubles instead. Buffers shrink by half the difference per
+ * interval so a short pause does not throw away the window. */
+static guint tuned_buffer_size(guint current, guint64 bytes, gint64 elapsed, guint32 srtt,
+    guint64 used, guint limit)
 {
-    gboolean change_state = FALSE;
-    GstSctpAssociationState new_state;
+    guint64 target;
 
-    switch (sac->sac_state) {
-    case SCTP_COMM_UP:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP_COMM_UP()");
-        g_mutex_lock(&self->association_mutex);
-        if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTING) {
-            change_state = TRUE;
-            new_state = GST_SCTP_ASSOCIATION_STATE_CONNECTED;
-            g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association connected!");
-        } else if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
-            g_warning("SCTP association already open");
-        } else {
-            g_warning("SCTP association in unexpected state");
-        }
-        g_mutex_unlock(&self->association_mutex);
-        break;
-    case SCTP_COMM_LOST:
-        g_warning("SCTP event SCTP_COMM_LOST received");
-        /* TODO: Tear down association and signal that this has happend*/
-        break;
-    case SCTP_RESTART:
-        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP event SCTP_RESTART received");
-        break;
-    case SCTP_SHUTDOWN_COMP:
-        g_warning("SCTP event SCTP_SHUTDOWN_COMP received");
-        /* TODO: Tear down association and signal that this has happend*/
-        break;
-    case SCTP_CANT_STR_ASSOC:
-        g_warning("SCTP event SCTP_CANT_STR_ASSOC received");
-        break;
-    }
+    target = elapsed > 0 ? 2 * bytes * srtt * G_TIME_SPAN_MILLISECOND / elapsed : 0;
+    if (used >= (guint64) current * 3 / 4)
+        target = MAX(target, (guint64) current * 2);
+    if (target < current)
+        target = current - (current - target) / 2;
 
-    if (change_state)
-        gst_sctp_association_change_state(self, new_state, TRUE);
+    return (guint) CLAMP(target, MIN_SOCKET_BUFFER_SIZE, limit);
 }
 
-static void handle_stream_reset_event(GstSctpAssociation *self,
-    const struct sctp_stream_reset_event *sr)
+/* Must be called with the association mutex held when the association comes up or wakes from
+ * idle */
+static void restart_buffer_tuning(GstSctpAssociation *self)
 {
-    guint32 i, n;
-    if (!(sr->strreset_flags & SCTP_STREAM_RESET_DENIED) &&
-        !(sr->strreset_flags & SCTP_STREAM_RESET_FAILED )) {
-        n = (sr->strreset_length - sizeof(struct sctp_stream_reset_event)) / sizeof(uint16_t);
-        for (i = 0; i < n; i++) {
-            if (sr->strreset_flags & SCTP_STREAM_RESET_INCOMING_SSN) {
-                g_signal_emit(self, signals[SIGNAL_STREAM_RESET], 0, sr->strreset_stream_list[i]);
-            }
-        }
-    }
+    g_mutex_lock(&self->stats_mutex);
+    self->tuning_bytes_sent = self->stats.bytes_sent;
+    self->tuning_bytes_received = self->stats.bytes_received;
+    g_mutex_unlock(&self->stats_mutex);
+    self->tuning_time = g_get_monotonic_time();
+    g_source_set_ready_time(self->buffer_timer,
+        self->tuning_time + BUFFER_TUNING_INTERVAL * G_TIME_SPAN_MILLISECOND);
 }
 
-static void handle_message(GstSctpAssociation *self, guint8 *data, guint32 datalen, guint16 stream_id,
-    guint32 ppid)
+static gboolean on_buffer_tuning_timeout(gpointer user_data)
 {
-    if (self->packet_received_cb) {
-        self->packet_received_cb(self, data, datalen, stream_id, ppid, self->packet_received_user_data);
-    }
+    GstSctpAssociation *self = g_weak_ref_get((GWeakRef *) user_data);
+    GstSctpEngineStatus status;
+    guint64 bytes_sent, bytes_received;
+    gint64 now;
+    guint limit;
+
+    if (!self)
+        return G_SOURCE_CONTINUE;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED || self->idle)
+        goto end;
+
+    if (!self->engine->funcs->get_status(self->engine, &status))
+        goto rearm;
+
+    now = g_get_monotonic_time();
+    g_mutex_lock(&self->stats_mutex);
+    bytes_sent = self->stats.bytes_sent;
+    bytes_received = self->stats.bytes_received;
+    g_mutex_unlock(&self->stats_mutex);
+
+    limit = self->memory_limit / 2;
+    apply_socket_buffers(self,
+        tuned_buffer_size(self->send_buffer_size, bytes_sent - self->tuning_bytes_sent,
+            now - self->tuning_time, status.srtt, status.send_buffered + self->held_bytes, limit),
+        tuned_buffer_size(self->receive_buffer_size, bytes_received - self->tuning_bytes_received,
+            now - self->tuning_time, status.srtt, status.receive_buffered, limit));
+
+    self->tuning_bytes_sent = bytes_sent;
+    self->tuning_bytes_received = bytes_received;
+    self->tuning_time = now;
+rearm:
+    g_source_set_ready_time(self->buffer_timer,
+        g_get_monotonic_time() + BUFFER_TUNING_INTERVAL * G_TIME_SPAN_MILLISECOND);
+end:
+    unlock_association(self);
+
+    g_object_unref(self);
+    return G_SOURCE_CONTINUE;
 }
 
-static void gst_sctp_association_change_state(GstSctpAssociation *self, GstSctpAssociationState new_state,
-    gboolean notify)
+static void resize_capture(GstSctpAssociation *self, guint packets, guint snaplen)
 {
-    self->state = new_state;
-    if (notify)
-        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STATE]);
+    g_mutex_lock(&self->capture_mutex);
+    g_free(self->capture_ring);
+    g_free(self->capture_data);
+    self->capture_ring = packets ? g_new0(GstSctpCapturedPacket, packets) : NULL;
+    self->capture_data = packets ? g_malloc((gsize) packets * snaplen) : NULL;
+    self->capture_packets = packets;
+    self->capture_snaplen = snaplen;
+    self->capture_next = 0;
+    self->capture_count = 0;
+    g_mutex_unlock(&self->capture_mutex);
+}
+
+static void capture_packet(GstSctpAssociation *self, gboolean outbound, const guint8 *data,
+    gsize length)
+{
+    GstSctpCapturedPacket *packet;
+
+    g_mutex_lock(&self->capture_mutex);
+    if (!self->capture_packets || self->capture_counter++ % self->capture_sample_interval != 0)
+        goto end;
+
+    packet = &self->capture_ring[self->capture_next];
+    packet->time = g_get_real_time();
+    packet->length = length;
+    packet->captured = MIN(length, self->capture_snaplen);
+    packet->outbound = outbound;
+    memcpy(self->capture_data + (gsize) self->capture_next * self->capture_snaplen, data,
+        packet->captured);
+
+    self->capture_next = (self->capture_next + 1) % self->capture_packets;
+    self->capture_count = MIN(self->capture_count + 1, self->capture_packets);
+end:
+    g_mutex_unlock(&self->capture_mutex);
+}
+
+static void append_uint16(GByteArray *array, guint16 value)
+{
+    g_byte_array_append(array, (const guint8 *) &value, sizeof(value));
+}
+
+static void append_uint32(GByteArray *array, guint32 value)
+{
+    g_byte_array_append(array, (const guint8 *) &value, sizeof(value));
+}
+
+static guint16 ip_checksum(const guint8 *header, gsize length)
+{
+    guint32 sum = 0;
+    gsize i;
+
+    for (i = 0; i < length; i += 2)
+        sum += (header[i] << 8) | header[i + 1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (guint16) ~sum;
+}
+
+static void append_ip_udp_headers(GByteArray *array, gboolean outbound, guint32 sctp_length)
+{
+    guint8 headers[CAPTURE_HEADERS_SIZE];
+    guint8 local[4] = {10, 0, 0, 1}, remote[4] = {10, 0, 0, 2};
+    guint32 ip_length = MIN(CAPTURE_HEADERS_SIZE + sctp_length, G_MAXUINT16);
+    guint16 checksum;
+
+    memset(headers, 0, sizeof(headers));
+    headers[0] = 0x45;
+    headers[2] = ip_length >> 8;
+    headers[3] = ip_length & 0xff;
+    headers[6] = 0x40;
+    headers[8] = 64;
+    headers[9] = CAPTURE_IPPROTO_UDP;
+    memcpy(headers + 12, outbound ? local : remote, 4);
+    memcpy(headers + 16, outbound ? remote : local, 4);
+    checksum = ip_checksum(headers, CAPTURE_IP_HEADER_SIZE);
+    headers[10] = checksum >> 8;
+    headers[11] = checksum & 0xff;
+
+    headers[20] = CAPTURE_UDP_PORT >> 8;
+    headers[21] = CAPTURE_UDP_PORT & 0xff;
+    headers[22] = CAPTURE_UDP_PORT >> 8;
+    headers[23] = CAPTURE_UDP_PORT & 0xff;
+    headers[24] = (ip_length - CAPTURE_IP_HEADER_SIZE) >> 8;
+    headers[25] = (ip_length - CAPTURE_IP_HEADER_SIZE) & 0xff;
+    /* A zero UDP checksum means none was computed */
+
+    g_byte_array_append(array, headers, sizeof(headers));
+}
+
+/* Returns the captured packets, oldest first, as a pcapng file in host byte order */
+GBytes *gst_sctp_association_get_capture(GstSctpAssociation *self)
+{
+    GByteArray *array = g_byte_array_new();
+    static const guint8 padding[4] = {0, 0, 0, 0};
+    guint i;
+
+    /* Section header block */
+    append_uint32(array, 0x0A0D0D0A);
+    append_uint32(array, 28);
+    append_uint32(array, 0x1A2B3C4D);
+    append_uint16(array, 1);
+    append_uint16(array, 0);
+    append_uint32(array, 0xffffffff);
+    append_uint32(array, 0xffffffff);
+    append_uint32(array, 28);
+
+    g_mutex_lock(&self->capture_mutex);
+
+    /* Interface description block, microsecond timestamps by default */
+    append_uint32(array, 0x00000001);
+    append_uint32(array, 20);
+    append_uint16(array, PCAPNG_LINKTYPE_RAW);
+    append_uint16(array, 0);
+    append_uint32(array, CAPTURE_HEADERS_SIZE + self->capture_snaplen);
+    append_uint32(array, 20);
+
+    for (i = 0; i < self->capture_count; i++) {
+        guint slot = (self->capture_next + self->capture_packets - self->capture_count + i)
+            % self->capture_packets;
+        GstSctpCapturedPacket *packet = &self->capture_ring[slot];
+        guint32 captured = CAPTURE_HEADERS_SIZE + packet->captured;
+        guint32 padded = (captured + 3) & ~3;
+
+        /* Enhanced packet block */
+        append_uint32(array, 0x00000006);
+        append_uint32(array, 32 + padded);
+        append_uint32(array, 0);
+        append_uint32(array, (guint64) packet->time >> 32);
+        append_uint32(array, (guint64) packet->time & 0xffffffff);
+        append_uint32(array, captured);
+        append_uint32(array, CAPTURE_HEADERS_SIZE + packet->length);
+        append_ip_udp_headers(array, packet->outbound, packet->length);
+        g_byte_array_append(array, self->capture_data + (gsize) slot * self->capture_snaplen,
+            packet->captured);
+        g_byte_array_append(array, padding, padded - captured);
+        append_uint32(array, 32 + padded);
+    }
+
+    g_mutex_unlock(&self->capture_mutex);
+
+    return g_byte_array_free_to_bytes(array);
 }
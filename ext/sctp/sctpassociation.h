@@ -27,9 +27,6 @@
 #define __GST_SCTP_ASSOCIATION_H__
 
 #include <glib-object.h>
-#define INET
-#define INET6
-#include <usrsctp.h>
 
 /*
  * Type macros.
@@ -41,6 +38,12 @@
 #define GST_SCTP_IS_ASSOCIATION_CLASS(klass)       (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_SCTP_TYPE_ASSOCIATION))
 #define GST_SCTP_ASSOCIATION_GET_CLASS(obj)        (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_SCTP_TYPE_ASSOCIATION, GstSctpAssociationClass))
 
+#define GST_SCTP_TYPE_ASSOCIATION_BUNDLING_POLICY  (gst_sctp_association_bundling_policy_get_type ())
+#define GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL (gst_sctp_association_congestion_control_get_type ())
+#define GST_SCTP_TYPE_ASSOCIATION_SETUP_PROFILE    (gst_sctp_association_setup_profile_get_type ())
+#define GST_SCTP_TYPE_ASSOCIATION_CHECKSUM         (gst_sctp_association_checksum_get_type ())
+#define GST_SCTP_TYPE_ASSOCIATION_ENGINE           (gst_sctp_association_engine_get_type ())
+
 typedef struct _GstSctpAssociation        GstSctpAssociation;
 typedef struct _GstSctpAssociationClass   GstSctpAssociationClass;
 
@@ -61,8 +64,101 @@ typedef enum {
     GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX = 0x0003
 } GstSctpAssociationPartialReliability;
 
-typedef void (*GstSctpAssociationPacketReceivedCb) (GstSctpAssociation *sctp_association, guint8 *data, gsize length, guint16 stream_id, guint ppid, gpointer user_data);
-typedef void (*GstSctpAssociationPacketOutCb) (GstSctpAssociation *sctp_association, const guint8 *data, gsize length, gpointer user_data);
+typedef enum {
+    GST_SCTP_ASSOCIATION_BUNDLING_POLICY_LATENCY,
+    GST_SCTP_ASSOCIATION_BUNDLING_POLICY_THROUGHPUT,
+    GST_SCTP_ASSOCIATION_BUNDLING_POLICY_ADAPTIVE
+} GstSctpAssociationBundlingPolicy;
+
+typedef enum {
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC2581,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC
+} GstSctpAssociationCongestionControl;
+
+typedef enum {
+    GST_SCTP_ASSOCIATION_SETUP_PROFILE_DEFAULT,
+    GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST
+} GstSctpAssociationSetupProfile;
+
+typedef enum {
+    GST_SCTP_ASSOCIATION_CHECKSUM_SOFTWARE,
+    GST_SCTP_ASSOCIATION_CHECKSUM_ACCELERATED,
+    GST_SCTP_ASSOCIATION_CHECKSUM_NONE
+} GstSctpAssociationChecksum;
+
+typedef enum {
+    GST_SCTP_ASSOCIATION_ENGINE_USRSCTP,
+    GST_SCTP_ASSOCIATION_ENGINE_LITE
+} GstSctpAssociationEngine;
+
+typedef enum {
+    GST_SCTP_ASSOCIATION_SEND_FLAG_NONE = 0,
+    /* Never hold the message back for bundling */
+    GST_SCTP_ASSOCIATION_SEND_FLAG_URGENT = (1 << 0),
+    /* Ask the peer to acknowledge the message without delay (the I-bit) */
+    GST_SCTP_ASSOCIATION_SEND_FLAG_SACK_IMMEDIATELY = (1 << 1)
+} GstSctpAssociationSendFlags;
+
+typedef struct {
+    /* Counted by this association */
+    guint64 messages_sent;
+    guint64 bytes_sent;
+    guint64 messages_received;
+    guint64 bytes_received;
+    guint64 packets_sent;
+    guint64 packets_received;
+    /* Received packets dropped because of a wrong CRC32c */
+    guint64 checksum_errors;
+    /* Messages the stack abandoned or failed to send, e.g. expired partially reliable ones */
+    guint64 messages_abandoned;
+    guint64 bytes_abandoned;
+
+    /* From the engine, zero until the association is established */
+    guint32 srtt;
+    guint32 rto;
+    guint32 cwnd;
+    guint32 peer_rwnd;
+    guint32 unacked_chunks;
+    guint32 pending_chunks;
+    /* Bytes queued in the send buffer, including messages held back by the association */
+    guint64 buffered_amount;
+    /* Microseconds from gst_sctp_association_start() to SCTP_COMM_UP, zero until then */
+    guint64 time_to_connected;
+    /* Socket buffer sizes granted from the memory budget and the bytes the receive buffer holds */
+    guint32 send_buffer_size;
+    guint32 receive_buffer_size;
+    guint64 receive_buffered_amount;
+
+    /* Socket buffer memory granted to all associations in the process and the budget they share
+     * (0 = unlimited) */
+    guint64 memory_committed;
+    guint64 memory_budget;
+
+    /* Counted by the engine, by the usrsctp one for all associations in the process */
+    guint64 stack_data_chunks_sent;
+    guint64 stack_data_chunks_retransmitted;
+    guint64 stack_fast_retransmits;
+    guint64 stack_t3_timeouts;
+    guint64 stack_init_timeouts;
+} GstSctpAssociationStats;
+
+typedef struct {
+    guint16 stream_id;
+    guint16 ssn;
+    guint32 tsn;
+    guint32 ppid;
+    gboolean unordered;
+    /* Monotonic time in microseconds, taken when the stack handed over the message */
+    gint64 receive_time;
+    /* Part of a message delivered in pieces by partial delivery */
+    gboolean fragment;
+    gboolean last_fragment;
+} GstSctpAssociationReceiveInfo;
+
+typedef void (*GstSctpAssociationPacketReceivedCb) (GstSctpAssociation *sctp_association, guint8 *data, gsize length, const GstSctpAssociationReceiveInfo *info, gpointer user_data);
+typedef void (*GstSctpAssociationPacketOutCb) (GstSctpAssociation *sctp_association, const guint8 *data, gsize length, guint8 tos, gboolean set_df, gpointer user_data);
 
 struct _GstSctpAssociation
 {
@@ -72,7 +168,21 @@ struct _GstSctpAssociation
     guint16 local_port;
     guint16 remote_port;
     gboolean use_sock_stream;
-    struct socket *sctp_ass_sock;
+    guint mtu;
+    guint sack_delay;
+    guint sack_frequency;
+    GstSctpAssociationCongestionControl congestion_control;
+    guint rtcc_steady_step;
+    gboolean rtcc_use_ecn;
+    gboolean ecn;
+    GstSctpAssociationSetupProfile setup_profile;
+    guint max_init_retransmits;
+    guint max_retransmits;
+    GstSctpAssociationChecksum checksum;
+    GstSctpAssociationEngine engine_type;
+    gint64 start_time;
+    /* Set once started, never changes afterwards */
+    struct _GstSctpEngine *engine;
 
     GMutex association_mutex;
 
@@ -80,6 +190,49 @@ struct _GstSctpAssociation
 
     GThread *connection_thread;
 
+    GstSctpAssociationBundlingPolicy bundling_policy;
+    guint bundling_max_delay;
+    /* Messages held for bundling, or until the association is established */
+    GQueue held_messages;
+    gsize held_bytes;
+    guint preconnect_buffer_size;
+    GSource *bundling_timer;
+
+    guint idle_timeout;
+    guint idle_heartbeat_interval;
+    gboolean idle;
+    gint64 last_activity;
+    guint active_heartbeat_interval;
+    GSource *idle_timer;
+
+    /* Socket buffers, auto-tuned from the bandwidth-delay product within memory_limit and the
+     * global memory budget */
+    guint memory_limit;
+    guint send_buffer_size;
+    guint receive_buffer_size;
+    guint64 tuning_bytes_sent;
+    guint64 tuning_bytes_received;
+    gint64 tuning_time;
+    GSource *buffer_timer;
+
+    GMutex stats_mutex;
+    GstSctpAssociationStats stats;
+    /* Abandoned messages not signalled yet, protected by stats_mutex. They are emitted once the
+     * association_mutex is released */
+    GQueue abandoned_reports;
+    gint abandoned_pending;
+
+    /* Ring of the last capture_packets sampled packets, protected by capture_mutex */
+    GMutex capture_mutex;
+    guint capture_packets;
+    guint capture_snaplen;
+    guint capture_sample_interval;
+    guint capture_counter;
+    struct _GstSctpCapturedPacket *capture_ring;
+    guint8 *capture_data;
+    guint capture_next;
+    guint capture_count;
+
     GstSctpAssociationPacketReceivedCb packet_received_cb;
     gpointer packet_received_user_data;
 
@@ -91,20 +244,36 @@ struct _GstSctpAssociationClass {
     GObjectClass parent_class;
 
     void (*on_sctp_stream_reset)(GstSctpAssociation *sctp_association, guint16 stream_id);
+    void (*on_sctp_send_failed)(GstSctpAssociation *sctp_association, guint stream_id, guint ppid,
+        guint length, guint context, gboolean sent);
 };
 
 GType gst_sctp_association_get_type(void);
+GType gst_sctp_association_bundling_policy_get_type(void);
+GType gst_sctp_association_congestion_control_get_type(void);
+GType gst_sctp_association_setup_profile_get_type(void);
+GType gst_sctp_association_checksum_get_type(void);
+GType gst_sctp_association_engine_get_type(void);
 
 GstSctpAssociation *gst_sctp_association_get(guint32 association_id);
 
 gboolean gst_sctp_association_start(GstSctpAssociation *self);
 void gst_sctp_association_set_on_packet_out(GstSctpAssociation *self, GstSctpAssociationPacketOutCb packet_out_cb, gpointer user_data);
 void gst_sctp_association_set_on_packet_received(GstSctpAssociation *self, GstSctpAssociationPacketReceivedCb packet_received_cb, gpointer user_data);
-void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length);
+void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length,
+    guint8 ecn_bits);
 gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, guint32 length,
     guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
-    guint32 reliability_param);
+    guint32 reliability_param, GstSctpAssociationSendFlags flags, guint32 context);
 void gst_sctp_association_reset_stream(GstSctpAssociation *self, guint16 stream_id);
 void gst_sctp_association_force_close(GstSctpAssociation *self);
+void gst_sctp_association_get_stats(GstSctpAssociation *self, GstSctpAssociationStats *stats);
+gboolean gst_sctp_association_get_congestion_window(GstSctpAssociation *self, guint32 *cwnd,
+    guint32 *srtt);
+GBytes *gst_sctp_association_get_capture(GstSctpAssociation *self);
+gboolean gst_sctp_association_can_open_stream(GstSctpAssociation *self);
+
+void gst_sctp_association_set_memory_budget(guint64 budget);
+guint64 gst_sctp_association_get_memory_budget(void);
 
 #endif /* __GST_SCTP_ASSOCIATION_H__ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "sctpchecksum.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32C_SSE42
+#include <nmmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define HAVE_CRC32C_ARMV8
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+/* Reflected Castagnoli polynomial */
+#define CRC32C_POLYNOMIAL 0x82f63b78
+#define SCTP_COMMON_HEADER_SIZE 12
+#define SCTP_CHECKSUM_OFFSET 8
+
+typedef guint32 (*Crc32cUpdateFunc)(guint32 crc, const guint8 *data, gsize length);
+
+/* Slicing-by-8 tables */
+static guint32 crc32c_table[8][256];
+static Crc32cUpdateFunc accelerated_update = NULL;
+
+static guint32 crc32c_update_software(guint32 crc, const guint8 *data, gsize length)
+{
+    while (length >= 8) {
+        guint32 low = crc ^ GST_READ_UINT32_LE(data);
+        guint32 high = GST_READ_UINT32_LE(data + 4);
+
+        crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff]
+            ^ crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24]
+            ^ crc32c_table[3][high & 0xff] ^ crc32c_table[2][(high >> 8) & 0xff]
+            ^ crc32c_table[1][(high >> 16) & 0xff] ^ crc32c_table[0][high >> 24];
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--)
+        crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static guint32 crc32c_update_sse42(guint32 crc, const guint8 *data, gsize length)
+{
+#ifdef __x86_64__
+    while (length >= 8) {
+        guint64 word;
+
+        memcpy(&word, data, 8);
+        crc = (guint32) _mm_crc32_u64(crc, word);
+        data += 8;
+        length -= 8;
+    }
+#endif
+    while (length >= 4) {
+        guint32 word;
+
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        length -= 4;
+    }
+
+    while (length--)
+        crc = _mm_crc32_u8(crc, *data++);
+
+    return crc;
+}
+#endif
+
+#ifdef HAVE_CRC32C_ARMV8
+static guint32 crc32c_update_armv8(guint32 crc, const guint8 *data, gsize length)
+{
+    while (length >= 8) {
+        guint64 word;
+
+        memcpy(&word, data, 8);
+        __asm__(".arch_extension crc\n\tcrc32cx %w0, %w0, %x1" : "+r" (crc) : "r" (word));
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        guint32 byte = *data++;
+
+        __asm__(".arch_extension crc\n\tcrc32cb %w0, %w0, %w1" : "+r" (crc) : "r" (byte));
+    }
+
+    return crc;
+}
+#endif
+
+/* Called once before the first association is created */
+void gst_sctp_checksum_init(void)
+{
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        guint32 crc;
+        guint i, k;
+
+        for (i = 0; i < 256; i++) {
+            crc = i;
+            for (k = 0; k < 8; k++)
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+            crc32c_table[0][i] = crc;
+        }
+        for (i = 0; i < 256; i++) {
+            for (k = 1; k < 8; k++) {
+                crc = crc32c_table[k - 1][i];
+                crc32c_table[k][i] = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            }
+        }
+
+#if defined(HAVE_CRC32C_SSE42)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2"))
+            accelerated_update = crc32c_update_sse42;
+#elif defined(HAVE_CRC32C_ARMV8)
+        if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+            accelerated_update = crc32c_update_armv8;
+#endif
+
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+gboolean gst_sctp_checksum_is_accelerated(void)
+{
+    return accelerated_update != NULL;
+}
+
+/* The checksum field itself is taken as zero */
+guint32 gst_sctp_checksum_compute(const guint8 *packet, gsize length, gboolean accelerated)
+{
+    static const guint8 zeros[4] = { 0, };
+    Crc32cUpdateFunc update;
+    guint32 crc = 0xffffffff;
+
+    g_return_val_if_fail(length >= SCTP_COMMON_HEADER_SIZE, 0);
+
+    update = accelerated && accelerated_update ? accelerated_update : crc32c_update_software;
+    crc = update(crc, packet, SCTP_CHECKSUM_OFFSET);
+    crc = update(crc, zeros, sizeof(zeros));
+    crc = update(crc, packet + SCTP_COMMON_HEADER_SIZE, length - SCTP_COMMON_HEADER_SIZE);
+
+    return ~crc;
+}
+
+void gst_sctp_checksum_write(guint8 *packet, gsize length, gboolean accelerated)
+{
+    if (length < SCTP_COMMON_HEADER_SIZE)
+        return;
+
+    /* The reflected CRC goes out least significant byte first */
+    GST_WRITE_UINT32_LE(packet + SCTP_CHECKSUM_OFFSET,
+        gst_sctp_checksum_compute(packet, length, accelerated));
+}
+
+gboolean gst_sctp_checksum_verify(const guint8 *packet, gsize length, gboolean accelerated)
+{
+    if (length < SCTP_COMMON_HEADER_SIZE)
+        return FALSE;
+
+    return GST_READ_UINT32_LE(packet + SCTP_CHECKSUM_OFFSET)
+        == gst_sctp_checksum_compute(packet, length, accelerated);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_CHECKSUM_H__
+#define __GST_SCTP_CHECKSUM_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The CRC32c of SCTP packets (RFC 4960 appendix B), for when usrsctp leaves it to us.
+ *
+ * The accelerated variant uses the SSE 4.2 crc32 instruction on x86 and the CRC32 extension
+ * on ARMv8 when the CPU has them, and falls back to the table driven one otherwise.
+ */
+
+void gst_sctp_checksum_init(void);
+gboolean gst_sctp_checksum_is_accelerated(void);
+guint32 gst_sctp_checksum_compute(const guint8 *packet, gsize length, gboolean accelerated);
+void gst_sctp_checksum_write(guint8 *packet, gsize length, gboolean accelerated);
+gboolean gst_sctp_checksum_verify(const guint8 *packet, gsize length, gboolean accelerated);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_CHECKSUM_H__ */
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "sctpcompression.h"
+
+#include <time.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZLIB
+/* Raw deflate, the SCTP CRC32c already covers the data */
+#define DEFLATE_WINDOW_BITS (-15)
+#define DEFLATE_MEM_LEVEL 8
+/* The output buffer starts at this many times the input and doubles as the data comes in */
+#define INFLATE_INITIAL_RATIO 4
+#define INFLATE_MIN_ALLOCATION 4096
+
+struct _GstSctpDeflater {
+    z_stream stream;
+};
+
+struct _GstSctpInflater {
+    z_stream stream;
+};
+
+static guint64 thread_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return (guint64) ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#endif
+    return (guint64) g_get_monotonic_time() * 1000;
+}
+#endif
+
+gboolean gst_sctp_compression_is_available(void)
+{
+#ifdef HAVE_ZLIB
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+GstSctpDeflater *gst_sctp_deflater_new(gint level)
+{
+#ifdef HAVE_ZLIB
+    GstSctpDeflater *deflater = g_slice_new0(GstSctpDeflater);
+
+    if (deflateInit2(&deflater->stream, level, Z_DEFLATED, DEFLATE_WINDOW_BITS, DEFLATE_MEM_LEVEL,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+        g_slice_free(GstSctpDeflater, deflater);
+        return NULL;
+    }
+
+    return deflater;
+#else
+    return NULL;
+#endif
+}
+
+void gst_sctp_deflater_free(GstSctpDeflater *deflater)
+{
+#ifdef HAVE_ZLIB
+    if (!deflater)
+        return;
+
+    deflateEnd(&deflater->stream);
+    g_slice_free(GstSctpDeflater, deflater);
+#endif
+}
+
+/* Returns NULL when the message does not get smaller, it is then sent as it is */
+guint8 *gst_sctp_deflater_compress(GstSctpDeflater *deflater, const guint8 *data, gsize length,
+    guint32 ppid, gsize *compressed_length, GstSctpCompressionStats *stats)
+{
+#ifdef HAVE_ZLIB
+    guint8 *out;
+    gsize bound;
+    guint64 start = thread_cpu_time();
+    int ret;
+
+    if (length <= GST_SCTP_COMPRESSION_HEADER_SIZE + 1 || length > GST_SCTP_COMPRESSION_MAX_MESSAGE_SIZE)
+        return NULL;
+
+    /* The state is reset for every message but its allocations are kept */
+    deflateReset(&deflater->stream);
+    /* Whatever does not fit is not worth it */
+    bound = MIN(deflateBound(&deflater->stream, length), length - GST_SCTP_COMPRESSION_HEADER_SIZE - 1);
+    out = g_malloc(GST_SCTP_COMPRESSION_HEADER_SIZE + bound);
+    GST_WRITE_UINT32_BE(out, ppid);
+    GST_WRITE_UINT32_BE(out + 4, length);
+
+    deflater->stream.next_in = (Bytef *) data;
+    deflater->stream.avail_in = length;
+    deflater->stream.next_out = out + GST_SCTP_COMPRESSION_HEADER_SIZE;
+    deflater->stream.avail_out = bound;
+    ret = deflate(&deflater->stream, Z_FINISH);
+
+    stats->cpu_time += thread_cpu_time() - start;
+    if (ret != Z_STREAM_END) {
+        /* Out of room, compressing does not pay off */
+        g_free(out);
+        return NULL;
+    }
+    if (length > (guint64) deflater->stream.total_out * GST_SCTP_COMPRESSION_MAX_RATIO) {
+        /* The peer would take it for a decompression bomb */
+        g_free(out);
+        return NULL;
+    }
+
+    *compressed_length = GST_SCTP_COMPRESSION_HEADER_SIZE + deflater->stream.total_out;
+    stats->messages++;
+    stats->bytes_in += length;
+    stats->bytes_out += *compressed_length;
+
+    return out;
+#else
+    return NULL;
+#endif
+}
+
+GstSctpInflater *gst_sctp_inflater_new(void)
+{
+#ifdef HAVE_ZLIB
+    GstSctpInflater *inflater = g_slice_new0(GstSctpInflater);
+
+    if (inflateInit2(&inflater->stream, DEFLATE_WINDOW_BITS) != Z_OK) {
+        g_slice_free(GstSctpInflater, inflater);
+        return NULL;
+    }
+
+    return inflater;
+#else
+    return NULL;
+#endif
+}
+
+void gst_sctp_inflater_free(GstSctpInflater *inflater)
+{
+#ifdef HAVE_ZLIB
+    if (!inflater)
+        return;
+
+    inflateEnd(&inflater->stream);
+    g_slice_free(GstSctpInflater, inflater);
+#endif
+}
+
+/* Returns NULL and counts an error when the message is not a valid compressed one. The
+ * announced size is only trusted up to GST_SCTP_COMPRESSION_MAX_RATIO times the compressed size,
+ * and the output buffer grows with the data actually inflated rather than being allocated
+ * upfront. */
+guint8 *gst_sctp_inflater_decompress(GstSctpInflater *inflater, const guint8 *data, gsize length,
+    guint32 *ppid, gsize *decompressed_length, GstSctpCompressionStats *stats)
+{
+#ifdef HAVE_ZLIB
+    z_stream *stream = &inflater->stream;
+    guint8 *out = NULL;
+    gsize allocated = 0, compressed;
+    guint32 size;
+    guint64 start;
+    int ret = Z_OK;
+
+    if (length <= GST_SCTP_COMPRESSION_HEADER_SIZE)
+        goto error;
+
+    compressed = length - GST_SCTP_COMPRESSION_HEADER_SIZE;
+    size = GST_READ_UINT32_BE(data + 4);
+    if (size == 0 || size > GST_SCTP_COMPRESSION_MAX_MESSAGE_SIZE
+        || size > (guint64) compressed * GST_SCTP_COMPRESSION_MAX_RATIO)
+        goto error;
+
+    start = thread_cpu_time();
+    inflateReset(stream);
+    stream->next_in = (Bytef *) data + GST_SCTP_COMPRESSION_HEADER_SIZE;
+    stream->avail_in = compressed;
+    for (;;) {
+        if (stream->total_out == allocated) {
+            /* One byte more than announced to tell a stream that goes on from one that ends */
+            if (allocated > size)
+                break;
+            allocated = allocated ? MIN(2 * allocated, (gsize) size + 1)
+                : MIN(MAX(INFLATE_INITIAL_RATIO * compressed, INFLATE_MIN_ALLOCATION),
+                    (gsize) size + 1);
+            out = g_realloc(out, allocated);
+        }
+        stream->next_out = out + stream->total_out;
+        stream->avail_out = allocated - stream->total_out;
+        ret = inflate(stream, Z_NO_FLUSH);
+        if (ret != Z_OK)
+            break;
+    }
+    stats->cpu_time += thread_cpu_time() - start;
+
+    if (ret != Z_STREAM_END || stream->total_out != size) {
+        g_free(out);
+        goto error;
+    }
+
+    *ppid = GST_READ_UINT32_BE(data);
+    *decompressed_length = size;
+    stats->messages++;
+    stats->bytes_in += size;
+    stats->bytes_out += length;
+
+    return out;
+error:
+    stats->errors++;
+    return NULL;
+#else
+    stats->errors++;
+    return NULL;
+#endif
+}
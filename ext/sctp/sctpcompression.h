@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_COMPRESSION_H__
+#define __GST_SCTP_COMPRESSION_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Transparent per-message compression between sctpenc and sctpdec.
+ *
+ * A compressed message is sent with GST_SCTP_COMPRESSED_PPID. Its payload starts with the PPID
+ * and the size of the original message, both 32 bit big endian, followed by the raw deflate
+ * stream. Every message is compressed on its own, so a message abandoned by partial reliability
+ * does not keep the next ones from being inflated.
+ */
+
+/* Unassigned by IANA, "zlib" in ASCII */
+#define GST_SCTP_COMPRESSED_PPID 0x7a6c6962
+#define GST_SCTP_COMPRESSION_HEADER_SIZE 8
+/* Larger announced sizes are taken for garbage rather than allocated */
+#define GST_SCTP_COMPRESSION_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+/* Messages that would shrink more than this are sent as they are, and the inflater rejects
+ * any that announce more, so a small message cannot make the receiver allocate a large one */
+#define GST_SCTP_COMPRESSION_MAX_RATIO 256
+
+typedef struct {
+    guint64 messages;
+    /* Bytes before and after compression */
+    guint64 bytes_in;
+    guint64 bytes_out;
+    /* Thread CPU time in nanoseconds, including messages that did not compress */
+    guint64 cpu_time;
+    guint64 errors;
+} GstSctpCompressionStats;
+
+typedef struct _GstSctpDeflater GstSctpDeflater;
+typedef struct _GstSctpInflater GstSctpInflater;
+
+gboolean gst_sctp_compression_is_available(void);
+
+/* Both return NULL when the plugin is built without zlib */
+GstSctpDeflater *gst_sctp_deflater_new(gint level);
+void gst_sctp_deflater_free(GstSctpDeflater *deflater);
+guint8 *gst_sctp_deflater_compress(GstSctpDeflater *deflater, const guint8 *data, gsize length,
+    guint32 ppid, gsize *compressed_length, GstSctpCompressionStats *stats);
+
+GstSctpInflater *gst_sctp_inflater_new(void);
+void gst_sctp_inflater_free(GstSctpInflater *inflater);
+guint8 *gst_sctp_inflater_decompress(GstSctpInflater *inflater, const guint8 *data, gsize length,
+    guint32 *ppid, gsize *decompressed_length, GstSctpCompressionStats *stats);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_COMPRESSION_H__ */
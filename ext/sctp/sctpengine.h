@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_ENGINE_H__
+#define __GST_SCTP_ENGINE_H__
+
+#include "sctpassociation.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The SCTP implementation behind a GstSctpAssociation.
+ *
+ * The association keeps what does not depend on the stack: its properties and state, the held
+ * messages, the idle and buffer tuning timers, the stats, the packet capture and, when the engine
+ * leaves it to us, the CRC32c. The engine runs the protocol.
+ *
+ * All functions but create, free and incoming_packet are called with the association mutex held.
+ * From those an engine may only call gst_sctp_association_engine_packet_out() and
+ * gst_sctp_association_engine_send_failed(), the other callbacks take the association mutex.
+ */
+
+/* Timers of the fast setup profile in milliseconds. The RTO.Initial of 3 s from RFC 4960 is
+ * meant for paths of unknown length, a lost INIT then stalls the setup for several seconds. */
+#define FAST_SETUP_RTO_INITIAL 300
+#define FAST_SETUP_RTO_MIN 100
+#define FAST_SETUP_RTO_MAX 10000
+#define FAST_SETUP_MAX_INIT_TIMEOUT 1000
+#define FAST_SETUP_MAX_INIT_ATTEMPTS 16
+
+typedef struct _GstSctpEngine GstSctpEngine;
+
+typedef struct {
+    guint32 srtt;
+    guint32 rto;
+    guint32 cwnd;
+    guint32 peer_rwnd;
+    guint32 unacked_chunks;
+    guint32 pending_chunks;
+    /* Bytes queued in the send buffer and waiting in the receive buffer */
+    guint64 send_buffered;
+    guint64 receive_buffered;
+} GstSctpEngineStatus;
+
+typedef struct {
+    guint64 data_chunks_sent;
+    guint64 data_chunks_retransmitted;
+    guint64 fast_retransmits;
+    guint64 t3_timeouts;
+    guint64 init_timeouts;
+} GstSctpEngineCounters;
+
+typedef struct {
+    const gchar *name;
+    /* The association computes the CRC32c of outgoing packets and verifies incoming ones */
+    gboolean external_checksum;
+
+    GstSctpEngine *(*create)(GstSctpAssociation *association);
+    void (*free)(GstSctpEngine *engine);
+
+    /* Sets up the engine from the association properties, before connect */
+    gboolean (*open)(GstSctpEngine *engine);
+    gboolean (*connect)(GstSctpEngine *engine);
+    /* Aborts the association, nothing is sent or received afterwards */
+    void (*close)(GstSctpEngine *engine);
+
+    void (*incoming_packet)(GstSctpEngine *engine, guint8 *buf, gsize length, guint8 ecn_bits);
+    /* Returns FALSE when the send buffer is full, the caller retries later */
+    gboolean (*send)(GstSctpEngine *engine, guint8 *buf, guint32 length, guint16 stream_id,
+        guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
+        guint32 reliability_param, GstSctpAssociationSendFlags flags, guint32 context);
+    void (*reset_stream)(GstSctpEngine *engine, guint16 stream_id);
+
+    /* Only valid once the association is established */
+    gboolean (*get_status)(GstSctpEngine *engine, GstSctpEngineStatus *status);
+    void (*get_counters)(GstSctpEngine *engine, GstSctpEngineCounters *counters);
+
+    /* With nodelay FALSE small messages wait while data is in flight (Nagle) */
+    void (*set_nodelay)(GstSctpEngine *engine, gboolean nodelay);
+    gboolean (*set_buffer_sizes)(GstSctpEngine *engine, guint send_size, guint receive_size);
+    gboolean (*get_heartbeat_interval)(GstSctpEngine *engine, guint *interval);
+    gboolean (*set_heartbeat_interval)(GstSctpEngine *engine, guint interval);
+
+    /* Called after the matching properties changed, NULL for engines reading them as they go */
+    void (*apply_delayed_sack)(GstSctpEngine *engine);
+    void (*apply_congestion_control)(GstSctpEngine *engine);
+    void (*apply_congestion_control_options)(GstSctpEngine *engine);
+} GstSctpEngineFuncs;
+
+struct _GstSctpEngine {
+    const GstSctpEngineFuncs *funcs;
+    GstSctpAssociation *association;
+};
+
+extern const GstSctpEngineFuncs gst_sctp_usrsctp_engine_funcs;
+extern const GstSctpEngineFuncs gst_sctp_lite_engine_funcs;
+
+/* Callbacks of the engines into the association */
+void gst_sctp_association_engine_packet_out(GstSctpAssociation *self, guint8 *data, gsize length,
+    guint8 tos, gboolean set_df);
+/* Takes ownership of data, which must be freeable with g_free() */
+void gst_sctp_association_engine_message(GstSctpAssociation *self, guint8 *data, gsize length,
+    const GstSctpAssociationReceiveInfo *info);
+void gst_sctp_association_engine_connected(GstSctpAssociation *self);
+/* The peer ended the association or it was lost, not reported for gst_sctp_association_force_close() */
+void gst_sctp_association_engine_disconnected(GstSctpAssociation *self);
+void gst_sctp_association_engine_stream_reset(GstSctpAssociation *self, guint16 stream_id);
+void gst_sctp_association_engine_send_failed(GstSctpAssociation *self, guint16 stream_id,
+    guint32 ppid, guint32 length, guint32 context, gboolean sent, guint32 error);
+
+/* A one-shot timer on the thread shared by all associations, armed with g_source_set_ready_time().
+ * The callback gets a GWeakRef to the association. */
+GSource *gst_sctp_association_create_timer_source(GstSctpAssociation *self, GSourceFunc func);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_ENGINE_H__ */
@@ -0,0 +1,2382 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctpengine.h"
+
+#include <string.h>
+
+/*
+ * A lightweight SCTP engine limited to what WebRTC data channels use: the association setup of
+ * RFC 4960 including simultaneous open, ordered and unordered messages with fragmentation and
+ * partial delivery, SACK with gap blocks and delayed acknowledgement (with the I-bit of RFC 7053),
+ * retransmission with the congestion control of RFC 4960, partial reliability with FORWARD-TSN
+ * (RFC 3758) and outgoing stream resets (RFC 6525).
+ *
+ * Each engine keeps all its state to itself behind its own lock, so associations share nothing
+ * but the timer thread and scale with the cores. Packets and events produced with the lock held
+ * are queued and handed to the association once it is released.
+ *
+ * Not covered: multi-homing, association restart, graceful shutdown initiated by us (closing
+ * aborts, as usrsctp does with SO_LINGER 0), ECN, the congestion control modules, the other
+ * RFC 6525 requests and the BUF policy, which is treated as reliable.
+ */
+
+#define CHUNK_DATA 0
+#define CHUNK_INIT 1
+#define CHUNK_INIT_ACK 2
+#define CHUNK_SACK 3
+#define CHUNK_HEARTBEAT 4
+#define CHUNK_HEARTBEAT_ACK 5
+#define CHUNK_ABORT 6
+#define CHUNK_SHUTDOWN 7
+#define CHUNK_SHUTDOWN_ACK 8
+#define CHUNK_ERROR 9
+#define CHUNK_COOKIE_ECHO 10
+#define CHUNK_COOKIE_ACK 11
+#define CHUNK_SHUTDOWN_COMPLETE 14
+#define CHUNK_RE_CONFIG 130
+#define CHUNK_FORWARD_TSN 192
+
+#define DATA_FLAG_END 0x01
+#define DATA_FLAG_BEGIN 0x02
+#define DATA_FLAG_UNORDERED 0x04
+#define DATA_FLAG_SACK_IMMEDIATELY 0x08
+#define CHUNK_FLAG_T 0x01
+
+#define PARAM_HEARTBEAT_INFO 1
+#define PARAM_STATE_COOKIE 7
+#define PARAM_OUTGOING_RESET_REQUEST 13
+#define PARAM_RECONFIG_RESPONSE 16
+#define PARAM_SUPPORTED_EXTENSIONS 0x8008
+#define PARAM_FORWARD_TSN_SUPPORTED 0xc000
+
+#define CAUSE_INVALID_STREAM 1
+
+#define RECONFIG_RESULT_SUCCESS_NOTHING 0
+#define RECONFIG_RESULT_SUCCESS_PERFORMED 1
+#define RECONFIG_RESULT_DENIED 2
+#define RECONFIG_RESULT_BAD_SEQUENCE 5
+#define RECONFIG_RESULT_IN_PROGRESS 6
+
+#define COMMON_HEADER_SIZE 12
+#define CHUNK_HEADER_SIZE 4
+#define DATA_HEADER_SIZE 12
+#define INIT_SIZE 16
+#define PARAM_HEADER_SIZE 4
+#define PADDED(length) (((length) + 3) & ~3)
+
+#define MAX_STREAMS 65535
+#define FEATURE_FORWARD_TSN (1 << 0)
+#define FEATURE_RECONFIG (1 << 1)
+#define COOKIE_MAGIC 0x4c495445
+/* The state, the time it was made and an HMAC-SHA-256 of both */
+#define COOKIE_STATE_SIZE 36
+#define COOKIE_MAC_SIZE 32
+#define COOKIE_SIZE (COOKIE_STATE_SIZE + COOKIE_MAC_SIZE)
+#define SECRET_SIZE 32
+
+/* RFC 4960 section 15, in milliseconds, and the usrsctp defaults */
+#define RTO_INITIAL 3000
+#define RTO_MIN 1000
+#define RTO_MAX 60000
+#define DEFAULT_MAX_INIT_RETRANSMITS 8
+#define DEFAULT_MAX_RETRANSMITS 10
+#define DEFAULT_HEARTBEAT_INTERVAL 30000
+#define VALID_COOKIE_LIFE 60000
+#define DEFAULT_BUFFER_SIZE (256 * 1024)
+/* Duplicate TSNs reported in one SACK */
+#define MAX_DUP_TSNS 16
+
+/* Serial number arithmetic, RFC 1982 */
+#define TSN_LT(a, b) ((gint32) ((guint32) (a) - (guint32) (b)) < 0)
+#define TSN_LE(a, b) ((gint32) ((guint32) (a) - (guint32) (b)) <= 0)
+#define TSN_GT(a, b) TSN_LT(b, a)
+#define TSN_GE(a, b) TSN_LE(b, a)
+#define SSN_LE(a, b) ((gint16) ((guint16) (a) - (guint16) (b)) <= 0)
+
+typedef enum {
+    LITE_STATE_NEW,
+    /* Opened, answers an INIT from the peer */
+    LITE_STATE_CLOSED,
+    LITE_STATE_COOKIE_WAIT,
+    LITE_STATE_COOKIE_ECHOED,
+    LITE_STATE_ESTABLISHED,
+    /* Aborted, lost or shut down, nothing goes in or out anymore */
+    LITE_STATE_ENDED
+} LiteState;
+
+typedef struct {
+    guint8 *data;
+    guint32 length;
+    guint16 stream_id;
+    guint16 ssn;
+    guint32 ppid;
+    gboolean ordered;
+    GstSctpAssociationPartialReliability pr;
+    guint32 reliability_param;
+    guint32 context;
+    gboolean sack_immediately;
+    /* Monotonic time the TTL policy abandons the message at, 0 = never */
+    gint64 expiry;
+    gboolean sent;
+    gboolean abandoned;
+    /* Chunks alive, the message is freed with the last one */
+    guint refs;
+} OutMessage;
+
+typedef struct {
+    OutMessage *message;
+    guint32 offset;
+    guint32 length;
+    guint32 tsn;
+    guint8 flags;
+    guint transmissions;
+    guint missing_reports;
+    gboolean in_flight;
+    /* Reported in a gap block of a SACK */
+    gboolean acked;
+    gboolean retransmit;
+    gboolean abandoned;
+} OutChunk;
+
+typedef struct {
+    guint8 *data;
+    guint32 length;
+    guint32 tsn;
+    guint16 stream_id;
+    guint16 ssn;
+    guint32 ppid;
+    guint8 flags;
+} InChunk;
+
+typedef struct {
+    guint8 *data;
+    gsize length;
+    gsize size;
+} LitePacket;
+
+typedef enum {
+    EVENT_CONNECTED,
+    EVENT_DISCONNECTED,
+    EVENT_MESSAGE,
+    EVENT_STREAM_RESET,
+    EVENT_SEND_FAILED
+} LiteEventType;
+
+typedef struct {
+    LiteEventType type;
+    guint8 *data;
+    gsize length;
+    GstSctpAssociationReceiveInfo info;
+    guint16 stream_id;
+    guint32 ppid;
+    guint32 context;
+    gboolean sent;
+} LiteEvent;
+
+typedef struct {
+    GstSctpEngine parent;
+
+    GMutex lock;
+    LiteState state;
+    GSource *timer;
+    gint64 timer_armed;
+
+    /* Taken from the association when opened */
+    guint16 local_port;
+    guint16 remote_port;
+    guint mtu;
+    gboolean use_sock_stream;
+    gint64 rto_initial;
+    gint64 rto_min;
+    gint64 rto_max;
+    gint64 max_init_timeout;
+    guint max_init_retransmits;
+    guint max_retransmits;
+    /* Taken from the association when opened and when they change */
+    guint sack_delay;
+    guint sack_frequency;
+
+    /* Setup */
+    guint8 secret[SECRET_SIZE];
+    guint32 local_tag;
+    guint32 peer_tag;
+    guint32 initial_tsn;
+    guint16 out_streams;
+    guint16 in_streams;
+    guint32 peer_features;
+    guint8 *cookie;
+    gsize cookie_length;
+    guint init_retransmits;
+    gint64 t1_rto;
+    gint64 t1_deadline;
+
+    /* Sender */
+    guint32 next_tsn;
+    guint32 cum_acked;
+    guint32 advanced_ack_point;
+    gboolean forward_tsn_needed;
+    /* Messages not cut into chunks yet, the chunks of the one being sent and the chunks sent and
+     * not acknowledged cumulatively, in TSN order */
+    GQueue messages;
+    GQueue pending;
+    GQueue outstanding;
+    GArray *out_ssn;
+    guint32 flight_size;
+    guint32 cwnd;
+    guint32 ssthresh;
+    guint32 partial_bytes_acked;
+    guint32 peer_rwnd;
+    gboolean fast_recovery;
+    guint32 recovery_point;
+    guint64 send_buffered;
+    guint64 unsent_bytes;
+    guint send_buffer_size;
+    gboolean nodelay;
+    /* Chunks marked for retransmission */
+    guint retransmissions;
+    guint error_count;
+    gint64 t3_deadline;
+
+    /* Round trip time in microseconds, measured on one chunk at a time */
+    gint64 srtt;
+    gint64 rttvar;
+    gint64 rto;
+    gboolean rtt_measured;
+    gboolean rtt_pending;
+    guint32 rtt_tsn;
+    gint64 rtt_time;
+
+    guint heartbeat_interval;
+    gint64 heartbeat_deadline;
+    gboolean heartbeat_outstanding;
+
+    /* Receiver */
+    guint32 cum_tsn;
+    /* TSNs received above cum_tsn, sorted */
+    GArray *received;
+    GArray *dup_tsns;
+    /* Chunks not delivered yet, in TSN order */
+    GQueue reassembly;
+    guint64 reassembly_bytes;
+    GArray *in_ssn;
+    guint receive_buffer_size;
+    gboolean pd_active;
+    guint32 pd_next_tsn;
+    gboolean sack_pending;
+    gint64 sack_deadline;
+    guint packets_unacked;
+
+    /* Outgoing stream resets, RFC 6525 */
+    GArray *reset_pending;
+    GArray *reset_in_flight;
+    guint32 reconf_seq;
+    guint32 reconf_last_tsn;
+    gint64 reconf_deadline;
+    guint32 peer_reconf_seq;
+    guint32 peer_reconf_result;
+
+    GstSctpEngineCounters counters;
+
+    /* Produced with the lock held, handed to the association once it is released */
+    GQueue out_packets;
+    GQueue events;
+} GstSctpLiteEngine;
+
+static void transmit(GstSctpLiteEngine *self, gint64 now);
+static void abandon_message(GstSctpLiteEngine *self, OutMessage *message);
+static void maybe_send_reset_request(GstSctpLiteEngine *self, gint64 now);
+
+static inline void put16(guint8 *data, guint16 value)
+{
+    data[0] = value >> 8;
+    data[1] = value & 0xff;
+}
+
+static inline void put32(guint8 *data, guint32 value)
+{
+    data[0] = value >> 24;
+    data[1] = (value >> 16) & 0xff;
+    data[2] = (value >> 8) & 0xff;
+    data[3] = value & 0xff;
+}
+
+static inline guint16 get16(const guint8 *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+static inline guint32 get32(const guint8 *data)
+{
+    return ((guint32) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static guint16 *stream_sequence(GArray *array, guint16 stream_id)
+{
+    if (stream_id >= array->len)
+        g_array_set_size(array, stream_id + 1);
+    return &g_array_index(array, guint16, stream_id);
+}
+
+static gboolean array_contains(GArray *array, guint16 stream_id)
+{
+    guint i;
+
+    for (i = 0; i < array->len; i++) {
+        if (g_array_index(array, guint16, i) == stream_id)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Packets and events */
+
+static void packet_init(GstSctpLiteEngine *self, LitePacket *packet, guint32 vtag)
+{
+    packet->size = self->mtu;
+    packet->data = g_malloc(packet->size);
+    put16(packet->data, self->local_port);
+    put16(packet->data + 2, self->remote_port);
+    put32(packet->data + 4, vtag);
+    /* The association fills in the CRC32c */
+    put32(packet->data + 8, 0);
+    packet->length = COMMON_HEADER_SIZE;
+}
+
+/* Returns where the value of the chunk goes, or NULL when it does not fit in the packet */
+static guint8 *packet_add_chunk(LitePacket *packet, guint8 type, guint8 flags, gsize value_length)
+{
+    gsize length = CHUNK_HEADER_SIZE + value_length;
+    guint8 *chunk;
+
+    if (packet->length + PADDED(length) > packet->size)
+        return NULL;
+
+    chunk = packet->data + packet->length;
+    chunk[0] = type;
+    chunk[1] = flags;
+    put16(chunk + 2, length);
+    memset(chunk + length, 0, PADDED(length) - length);
+    packet->length += PADDED(length);
+
+    return chunk + CHUNK_HEADER_SIZE;
+}
+
+static gboolean packet_is_empty(LitePacket *packet)
+{
+    return packet->length == COMMON_HEADER_SIZE;
+}
+
+static void packet_queue(GstSctpLiteEngine *self, LitePacket *packet)
+{
+    if (packet_is_empty(packet)) {
+        g_free(packet->data);
+    } else {
+        g_queue_push_tail(&self->out_packets, g_slice_dup(LitePacket, packet));
+    }
+    packet->data = NULL;
+}
+
+static void send_single_chunk(GstSctpLiteEngine *self, guint32 vtag, guint8 type, guint8 flags,
+    const guint8 *value, gsize value_length)
+{
+    LitePacket packet;
+    guint8 *data;
+
+    packet_init(self, &packet, vtag);
+    if ((data = packet_add_chunk(&packet, type, flags, value_length)) && value_length)
+        memcpy(data, value, value_length);
+    packet_queue(self, &packet);
+}
+
+static LiteEvent *queue_event(GstSctpLiteEngine *self, LiteEventType type)
+{
+    LiteEvent *event = g_slice_new0(LiteEvent);
+
+    event->type = type;
+    g_queue_push_tail(&self->events, event);
+    return event;
+}
+
+static void update_timer(GstSctpLiteEngine *self)
+{
+    gint64 deadlines[] = {
+        self->t1_deadline, self->t3_deadline, self->sack_deadline, self->reconf_deadline,
+        self->heartbeat_deadline
+    };
+    gint64 deadline = -1;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(deadlines); i++) {
+        if (deadlines[i] >= 0 && (deadline < 0 || deadlines[i] < deadline))
+            deadline = deadlines[i];
+    }
+
+    /* Deadlines moving later leave the timer as it is, it fires early and is re-armed from here.
+     * Most calls then cost nothing on the context shared with the other associations. */
+    if (deadline >= 0 && (self->timer_armed < 0 || deadline < self->timer_armed)) {
+        self->timer_armed = deadline;
+        g_source_set_ready_time(self->timer, deadline);
+    }
+}
+
+static void unlock_and_dispatch(GstSctpLiteEngine *self)
+{
+    GstSctpAssociation *association = self->parent.association;
+    GQueue packets = self->out_packets;
+    GQueue events = self->events;
+    LitePacket *packet;
+    LiteEvent *event;
+
+    update_timer(self);
+    g_queue_init(&self->out_packets);
+    g_queue_init(&self->events);
+    g_mutex_unlock(&self->lock);
+
+    while ((packet = g_queue_pop_head(&packets))) {
+        gst_sctp_association_engine_packet_out(association, packet->data, packet->length, 0, FALSE);
+        g_free(packet->data);
+        g_slice_free(LitePacket, packet);
+    }
+
+    while ((event = g_queue_pop_head(&events))) {
+        switch (event->type) {
+        case EVENT_CONNECTED:
+            gst_sctp_association_engine_connected(association);
+            break;
+        case EVENT_DISCONNECTED:
+            gst_sctp_association_engine_disconnected(association);
+            break;
+        case EVENT_MESSAGE:
+            gst_sctp_association_engine_message(association, event->data, event->length,
+                &event->info);
+            break;
+        case EVENT_STREAM_RESET:
+            gst_sctp_association_engine_stream_reset(association, event->stream_id);
+            break;
+        case EVENT_SEND_FAILED:
+            gst_sctp_association_engine_send_failed(association, event->stream_id, event->ppid,
+                event->length, event->context, event->sent, 0);
+            break;
+        }
+        g_slice_free(LiteEvent, event);
+    }
+}
+
+/* Timers and round trip time */
+
+static void update_rtt(GstSctpLiteEngine *self, gint64 rtt)
+{
+    if (!self->rtt_measured) {
+        self->srtt = rtt;
+        self->rttvar = rtt / 2;
+        self->rtt_measured = TRUE;
+    } else {
+        self->rttvar = (3 * self->rttvar + ABS(self->srtt - rtt)) / 4;
+        self->srtt = (7 * self->srtt + rtt) / 8;
+    }
+    self->rto = CLAMP(self->srtt + 4 * self->rttvar, self->rto_min, self->rto_max);
+}
+
+static void end_association(GstSctpLiteEngine *self)
+{
+    if (self->state == LITE_STATE_ESTABLISHED)
+        queue_event(self, EVENT_DISCONNECTED);
+    self->state = LITE_STATE_ENDED;
+    self->t1_deadline = -1;
+    self->t3_deadline = -1;
+    self->sack_deadline = -1;
+    self->reconf_deadline = -1;
+    self->heartbeat_deadline = -1;
+}
+
+static void fail_association(GstSctpLiteEngine *self, const gchar *reason)
+{
+    g_warning("SCTP association lost: %s", reason);
+    if (self->state == LITE_STATE_COOKIE_ECHOED || self->state == LITE_STATE_ESTABLISHED)
+        send_single_chunk(self, self->peer_tag, CHUNK_ABORT, 0, NULL, 0);
+    end_association(self);
+}
+
+/* Setup */
+
+/* The association may run over plain UDP, so the cookie is signed with a secret of its own */
+static void cookie_mac(GstSctpLiteEngine *self, const guint8 *cookie, guint8 *mac)
+{
+    GHmac *hmac = g_hmac_new(G_CHECKSUM_SHA256, self->secret, SECRET_SIZE);
+    gsize length = COOKIE_MAC_SIZE;
+
+    g_hmac_update(hmac, cookie, COOKIE_STATE_SIZE);
+    g_hmac_get_digest(hmac, mac, &length);
+    g_hmac_unref(hmac);
+}
+
+static gboolean cookie_is_valid(GstSctpLiteEngine *self, const guint8 *cookie, gsize length,
+    gint64 now)
+{
+    guint8 mac[COOKIE_MAC_SIZE], diff = 0;
+    gint64 created;
+    guint i;
+
+    if (length != COOKIE_SIZE || get32(cookie) != COOKIE_MAGIC
+        || get32(cookie + 4) != self->local_tag)
+        return FALSE;
+
+    cookie_mac(self, cookie, mac);
+    for (i = 0; i < COOKIE_MAC_SIZE; i++)
+        diff |= mac[i] ^ cookie[COOKIE_STATE_SIZE + i];
+    if (diff)
+        return FALSE;
+
+    created = (gint64) (((guint64) get32(cookie + 28) << 32) | get32(cookie + 32));
+    if (now < created || now - created > VALID_COOKIE_LIFE * G_TIME_SPAN_MILLISECOND) {
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Ignoring a stale cookie");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static guint32 receive_window(GstSctpLiteEngine *self)
+{
+    return self->receive_buffer_size > self->reassembly_bytes ?
+        (guint32) (self->receive_buffer_size - self->reassembly_bytes) : 0;
+}
+
+static void send_init(GstSctpLiteEngine *self, guint8 type, guint32 vtag, const guint8 *cookie,
+    gsize cookie_length)
+{
+    LitePacket packet;
+    guint8 *value;
+    gsize length = INIT_SIZE + 8 + PARAM_HEADER_SIZE;
+
+    if (cookie)
+        length += PADDED(PARAM_HEADER_SIZE + cookie_length);
+
+    packet_init(self, &packet, vtag);
+    value = packet_add_chunk(&packet, type, 0, length);
+    g_assert(value);
+
+    put32(value, self->local_tag);
+    put32(value + 4, receive_window(self));
+    put16(value + 8, MAX_STREAMS);
+    put16(value + 10, MAX_STREAMS);
+    put32(value + 12, self->initial_tsn);
+    value += INIT_SIZE;
+
+    put16(value, PARAM_SUPPORTED_EXTENSIONS);
+    put16(value + 2, PARAM_HEADER_SIZE + 2);
+    value[4] = CHUNK_RE_CONFIG;
+    value[5] = CHUNK_FORWARD_TSN;
+    value[6] = value[7] = 0;
+    value += 8;
+
+    put16(value, PARAM_FORWARD_TSN_SUPPORTED);
+    put16(value + 2, PARAM_HEADER_SIZE);
+    value += PARAM_HEADER_SIZE;
+
+    if (cookie) {
+        put16(value, PARAM_STATE_COOKIE);
+        put16(value + 2, PARAM_HEADER_SIZE + cookie_length);
+        memcpy(value + PARAM_HEADER_SIZE, cookie, cookie_length);
+    }
+
+    packet_queue(self, &packet);
+}
+
+/* Parses the optional parameters of an INIT or INIT ACK */
+static guint32 parse_init_params(const guint8 *params, gsize length, const guint8 **cookie,
+    gsize *cookie_length)
+{
+    guint32 features = 0;
+    gsize offset, i;
+
+    for (offset = 0; offset + PARAM_HEADER_SIZE <= length; ) {
+        guint16 type = get16(params + offset);
+        guint16 param_length = get16(params + offset + 2);
+
+        if (param_length < PARAM_HEADER_SIZE || offset + param_length > length)
+            break;
+
+        switch (type) {
+        case PARAM_STATE_COOKIE:
+            if (cookie) {
+                *cookie = params + offset + PARAM_HEADER_SIZE;
+                *cookie_length = param_length - PARAM_HEADER_SIZE;
+            }
+            break;
+        case PARAM_FORWARD_TSN_SUPPORTED:
+            features |= FEATURE_FORWARD_TSN;
+            break;
+        case PARAM_SUPPORTED_EXTENSIONS:
+            for (i = PARAM_HEADER_SIZE; i < param_length; i++) {
+                if (params[offset + i] == CHUNK_FORWARD_TSN)
+                    features |= FEATURE_FORWARD_TSN;
+                else if (params[offset + i] == CHUNK_RE_CONFIG)
+                    features |= FEATURE_RECONFIG;
+            }
+            break;
+        default:
+            /* Whatever else the peer supports is not used */
+            break;
+        }
+        offset += PADDED(param_length);
+    }
+
+    return features;
+}
+
+static void set_peer_params(GstSctpLiteEngine *self, guint32 peer_tag, guint32 peer_rwnd,
+    guint16 outbound_streams, guint16 inbound_streams, guint32 peer_tsn, guint32 features)
+{
+    self->peer_tag = peer_tag;
+    self->peer_rwnd = peer_rwnd;
+    self->out_streams = inbound_streams;
+    self->in_streams = outbound_streams;
+    self->cum_tsn = peer_tsn - 1;
+    self->peer_reconf_seq = peer_tsn;
+    self->peer_features = features;
+}
+
+static void set_established(GstSctpLiteEngine *self, gint64 now)
+{
+    self->state = LITE_STATE_ESTABLISHED;
+    self->t1_deadline = -1;
+    g_free(self->cookie);
+    self->cookie = NULL;
+
+    /* RFC 4960 section 7.2.1 */
+    self->cwnd = MIN(4 * self->mtu, MAX(2 * self->mtu, 4380));
+    self->ssthresh = self->peer_rwnd;
+    self->rto = self->rto_initial;
+    if (self->heartbeat_interval) {
+        self->heartbeat_deadline = now + self->rto
+            + (gint64) self->heartbeat_interval * G_TIME_SPAN_MILLISECOND;
+    }
+
+    queue_event(self, EVENT_CONNECTED);
+}
+
+static void handle_init(GstSctpLiteEngine *self, const guint8 *value, gsize length, gint64 now)
+{
+    guint8 cookie[COOKIE_SIZE];
+    guint32 peer_tag;
+
+    if (length < INIT_SIZE || (peer_tag = get32(value)) == 0)
+        return;
+
+    /* Restarts are not supported */
+    if (self->state == LITE_STATE_ESTABLISHED) {
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Ignoring an INIT on an established association");
+        return;
+    }
+
+    /* Answered with the same tag and TSN as our own INIT, which makes a simultaneous open
+     * (RFC 4960 section 5.2.1) end up in one association */
+    put32(cookie, COOKIE_MAGIC);
+    put32(cookie + 4, self->local_tag);
+    put32(cookie + 8, peer_tag);
+    put32(cookie + 12, get32(value + 12));
+    put32(cookie + 16, get32(value + 4));
+    put16(cookie + 20, get16(value + 8));
+    put16(cookie + 22, get16(value + 10));
+    put32(cookie + 24, parse_init_params(value + INIT_SIZE, length - INIT_SIZE, NULL, NULL));
+    put32(cookie + 28, (guint64) now >> 32);
+    put32(cookie + 32, (guint32) now);
+    cookie_mac(self, cookie, cookie + COOKIE_STATE_SIZE);
+
+    send_init(self, CHUNK_INIT_ACK, peer_tag, cookie, COOKIE_SIZE);
+}
+
+static void handle_init_ack(GstSctpLiteEngine *self, const guint8 *value, gsize length,
+    gint64 now)
+{
+    const guint8 *cookie = NULL;
+    gsize cookie_length = 0;
+    guint32 features;
+
+    if (self->state != LITE_STATE_COOKIE_WAIT || length < INIT_SIZE || get32(value) == 0)
+        return;
+
+    features = parse_init_params(value + INIT_SIZE, length - INIT_SIZE, &cookie, &cookie_length);
+    if (!cookie)
+        return;
+
+    set_peer_params(self, get32(value), get32(value + 4), get16(value + 8), get16(value + 10),
+        get32(value + 12), features);
+    self->cookie = g_memdup(cookie, cookie_length);
+    self->cookie_length = cookie_length;
+    self->state = LITE_STATE_COOKIE_ECHOED;
+
+    send_single_chunk(self, self->peer_tag, CHUNK_COOKIE_ECHO, 0, self->cookie,
+        self->cookie_length);
+    self->init_retransmits = 0;
+    self->t1_deadline = now + self->t1_rto;
+}
+
+static void handle_cookie_echo(GstSctpLiteEngine *self, const guint8 *cookie, gsize length,
+    gint64 now)
+{
+    if (!cookie_is_valid(self, cookie, length, now))
+        return;
+
+    if (self->state == LITE_STATE_ESTABLISHED) {
+        /* Our COOKIE ACK got lost */
+        if (get32(cookie + 8) == self->peer_tag)
+            send_single_chunk(self, self->peer_tag, CHUNK_COOKIE_ACK, 0, NULL, 0);
+        return;
+    }
+
+    set_peer_params(self, get32(cookie + 8), get32(cookie + 16), get16(cookie + 20),
+        get16(cookie + 22), get32(cookie + 12), get32(cookie + 24));
+    send_single_chunk(self, self->peer_tag, CHUNK_COOKIE_ACK, 0, NULL, 0);
+    set_established(self, now);
+}
+
+/* Sender */
+
+static void free_out_chunk(GstSctpLiteEngine *self, OutChunk *chunk)
+{
+    OutMessage *message = chunk->message;
+
+    self->send_buffered -= chunk->length;
+    if (--message->refs == 0) {
+        g_free(message->data);
+        g_slice_free(OutMessage, message);
+    }
+    g_slice_free(OutChunk, chunk);
+}
+
+static void report_failed_message(GstSctpLiteEngine *self, OutMessage *message)
+{
+    LiteEvent *event = queue_event(self, EVENT_SEND_FAILED);
+
+    event->stream_id = message->stream_id;
+    event->ppid = message->ppid;
+    event->length = message->length;
+    event->context = message->context;
+    event->sent = message->sent;
+}
+
+/* Cuts the next message into chunks with consecutive TSNs. Messages whose lifetime ran out before
+ * they were sent are dropped on the way, no TSN was spent on them. */
+static gboolean chunk_next_message(GstSctpLiteEngine *self, gint64 now)
+{
+    guint32 max_payload = (self->mtu - COMMON_HEADER_SIZE - CHUNK_HEADER_SIZE - DATA_HEADER_SIZE)
+        & ~3;
+    OutMessage *message;
+    guint32 offset;
+
+    while ((message = g_queue_pop_head(&self->messages))) {
+        if (message->expiry && now >= message->expiry) {
+            report_failed_message(self, message);
+            self->send_buffered -= message->length;
+            self->unsent_bytes -= message->length;
+            g_free(message->data);
+            g_slice_free(OutMessage, message);
+            continue;
+        }
+
+        if (message->ordered)
+            message->ssn = (*stream_sequence(self->out_ssn, message->stream_id))++;
+
+        for (offset = 0; offset < message->length; offset += max_payload) {
+            OutChunk *chunk = g_slice_new0(OutChunk);
+
+            chunk->message = message;
+            chunk->offset = offset;
+            chunk->length = MIN(max_payload, message->length - offset);
+            chunk->tsn = self->next_tsn++;
+            if (offset == 0)
+                chunk->flags |= DATA_FLAG_BEGIN;
+            if (offset + chunk->length == message->length) {
+                chunk->flags |= DATA_FLAG_END;
+                if (message->sack_immediately)
+                    chunk->flags |= DATA_FLAG_SACK_IMMEDIATELY;
+            }
+            if (!message->ordered)
+                chunk->flags |= DATA_FLAG_UNORDERED;
+            message->refs++;
+            g_queue_push_tail(&self->pending, chunk);
+        }
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean is_expired(GstSctpLiteEngine *self, OutChunk *chunk, gint64 now)
+{
+    OutMessage *message = chunk->message;
+
+    /* Without FORWARD-TSN there is no way to tell the peer to skip a chunk */
+    if (!(self->peer_features & FEATURE_FORWARD_TSN))
+        return FALSE;
+
+    switch (message->pr) {
+    case GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL:
+        return message->expiry && now >= message->expiry;
+    case GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX:
+        return chunk->transmissions > message->reliability_param;
+    default:
+        return FALSE;
+    }
+}
+
+static void clear_retransmit(GstSctpLiteEngine *self, OutChunk *chunk)
+{
+    if (chunk->retransmit) {
+        chunk->retransmit = FALSE;
+        self->retransmissions--;
+    }
+}
+
+static void mark_for_retransmission(GstSctpLiteEngine *self, OutChunk *chunk)
+{
+    if (chunk->in_flight) {
+        self->flight_size -= chunk->length;
+        chunk->in_flight = FALSE;
+    }
+    if (self->rtt_pending && self->rtt_tsn == chunk->tsn)
+        self->rtt_pending = FALSE;
+    if (!chunk->retransmit) {
+        chunk->retransmit = TRUE;
+        self->retransmissions++;
+    }
+    chunk->missing_reports = 0;
+}
+
+/* Moves the advanced peer ack point over the abandoned chunks following the cumulative ack,
+ * RFC 3758 section 3.5. Sending it again is up to the SACK and T3 handling. */
+static void update_forward_tsn(GstSctpLiteEngine *self)
+{
+    guint32 point = self->cum_acked;
+    GList *l;
+
+    for (l = self->outstanding.head; l; l = l->next) {
+        OutChunk *chunk = l->data;
+
+        if (!chunk->abandoned)
+            break;
+        point = chunk->tsn;
+    }
+
+    if (TSN_GT(point, self->advanced_ack_point)) {
+        self->advanced_ack_point = point;
+        self->forward_tsn_needed = TRUE;
+    }
+}
+
+static void abandon_message(GstSctpLiteEngine *self, OutMessage *message)
+{
+    OutChunk *chunk;
+    GList *l;
+
+    if (message->abandoned)
+        return;
+    message->abandoned = TRUE;
+
+    for (l = self->outstanding.head; l; l = l->next) {
+        chunk = l->data;
+        if (chunk->message != message || chunk->acked)
+            continue;
+        if (chunk->in_flight) {
+            self->flight_size -= chunk->length;
+            chunk->in_flight = FALSE;
+        }
+        clear_retransmit(self, chunk);
+        chunk->abandoned = TRUE;
+    }
+
+    /* The TSNs of the chunks not sent yet are skipped with the others */
+    while ((chunk = g_queue_peek_head(&self->pending)) && chunk->message == message) {
+        g_queue_pop_head(&self->pending);
+        self->unsent_bytes -= chunk->length;
+        chunk->abandoned = TRUE;
+        g_queue_push_tail(&self->outstanding, chunk);
+    }
+
+    report_failed_message(self, message);
+}
+
+/* Counts, and writes when out is set, the gap blocks for the TSNs received above the cumulative
+ * TSN, as long as their offsets fit in 16 bits */
+static guint write_gap_blocks(GstSctpLiteEngine *self, guint max_gaps, guint8 *out)
+{
+    guint n_gaps = 0, i = 0;
+
+    while (i < self->received->len && n_gaps < max_gaps) {
+        guint32 start = g_array_index(self->received, guint32, i);
+        guint32 end = start;
+
+        for (i++; i < self->received->len && g_array_index(self->received, guint32, i) == end + 1;
+            i++)
+            end++;
+        if (end - self->cum_tsn > G_MAXUINT16)
+            break;
+        if (out) {
+            put16(out, start - self->cum_tsn);
+            put16(out + 2, end - self->cum_tsn);
+            out += 4;
+        }
+        n_gaps++;
+    }
+
+    return n_gaps;
+}
+
+static gboolean add_sack(GstSctpLiteEngine *self, LitePacket *packet)
+{
+    guint n_dups = MIN(self->dup_tsns->len, MAX_DUP_TSNS);
+    guint max_gaps = (self->mtu - COMMON_HEADER_SIZE - CHUNK_HEADER_SIZE - 12) / 4 - n_dups;
+    guint n_gaps = write_gap_blocks(self, max_gaps, NULL), i;
+    guint8 *value;
+
+    value = packet_add_chunk(packet, CHUNK_SACK, 0, 12 + 4 * (n_gaps + n_dups));
+    if (!value)
+        return FALSE;
+
+    put32(value, self->cum_tsn);
+    put32(value + 4, receive_window(self));
+    put16(value + 8, n_gaps);
+    put16(value + 10, n_dups);
+    write_gap_blocks(self, n_gaps, value + 12);
+    value += 12 + 4 * n_gaps;
+    for (i = 0; i < n_dups; i++)
+        put32(value + 4 * i, g_array_index(self->dup_tsns, guint32, i));
+
+    g_array_set_size(self->dup_tsns, 0);
+    self->sack_pending = FALSE;
+    self->sack_deadline = -1;
+    self->packets_unacked = 0;
+    return TRUE;
+}
+
+static gboolean add_forward_tsn(GstSctpLiteEngine *self, LitePacket *packet)
+{
+    guint max_streams = (packet->size - packet->length - CHUNK_HEADER_SIZE - 4) / 4;
+    GArray *streams = g_array_new(FALSE, FALSE, sizeof(guint32));
+    guint8 *value;
+    GList *l;
+    guint i;
+
+    /* The last sequence number skipped on each stream with ordered messages */
+    for (l = self->outstanding.head; l; l = l->next) {
+        OutChunk *chunk = l->data;
+        OutMessage *message = chunk->message;
+
+        if (TSN_GT(chunk->tsn, self->advanced_ack_point))
+            break;
+        if (!message->ordered)
+            continue;
+        for (i = 0; i < streams->len; i++) {
+            if (g_array_index(streams, guint32, i) >> 16 == message->stream_id)
+                break;
+        }
+        if (i == streams->len) {
+            if (streams->len == max_streams)
+                continue;
+            g_array_set_size(streams, i + 1);
+        }
+        g_array_index(streams, guint32, i) = ((guint32) message->stream_id << 16) | message->ssn;
+    }
+
+    value = packet_add_chunk(packet, CHUNK_FORWARD_TSN, 0, 4 + 4 * streams->len);
+    if (value) {
+        put32(value, self->advanced_ack_point);
+        for (i = 0; i < streams->len; i++)
+            put32(value + 4 + 4 * i, g_array_index(streams, guint32, i));
+        self->forward_tsn_needed = FALSE;
+    }
+
+    g_array_free(streams, TRUE);
+    return value != NULL;
+}
+
+static gboolean add_data_chunk(GstSctpLiteEngine *self, LitePacket *packet, OutChunk *chunk,
+    gint64 now)
+{
+    OutMessage *message = chunk->message;
+    guint8 *value;
+
+    value = packet_add_chunk(packet, CHUNK_DATA, chunk->flags, DATA_HEADER_SIZE + chunk->length);
+    if (!value)
+        return FALSE;
+
+    put32(value, chunk->tsn);
+    put16(value + 4, message->stream_id);
+    put16(value + 6, message->ssn);
+    put32(value + 8, message->ppid);
+    memcpy(value + DATA_HEADER_SIZE, message->data + chunk->offset, chunk->length);
+
+    if (chunk->transmissions++ == 0) {
+        self->counters.data_chunks_sent++;
+        /* Karn's algorithm, only chunks sent once are timed */
+        if (!self->rtt_pending) {
+            self->rtt_pending = TRUE;
+            self->rtt_tsn = chunk->tsn;
+            self->rtt_time = now;
+        }
+    } else {
+        self->counters.data_chunks_retransmitted++;
+    }
+
+    chunk->in_flight = TRUE;
+    clear_retransmit(self, chunk);
+    chunk->missing_reports = 0;
+    message->sent = TRUE;
+    self->flight_size += chunk->length;
+    self->peer_rwnd = self->peer_rwnd > chunk->length ? self->peer_rwnd - chunk->length : 0;
+
+    return TRUE;
+}
+
+static gboolean queue_data_chunk(GstSctpLiteEngine *self, LitePacket *packet, OutChunk *chunk,
+    gint64 now)
+{
+    if (add_data_chunk(self, packet, chunk, now))
+        return TRUE;
+    if (packet_is_empty(packet))
+        return FALSE;
+
+    packet_queue(self, packet);
+    packet_init(self, packet, self->peer_tag);
+    return add_data_chunk(self, packet, chunk, now);
+}
+
+/* Sends what is due: control chunks, retransmissions, then new data as far as the congestion and
+ * receive windows allow */
+static void transmit(GstSctpLiteEngine *self, gint64 now)
+{
+    guint32 capacity = self->mtu - COMMON_HEADER_SIZE - CHUNK_HEADER_SIZE - DATA_HEADER_SIZE;
+    LitePacket packet;
+    OutChunk *chunk;
+    GList *l;
+
+    if (self->state != LITE_STATE_ESTABLISHED)
+        return;
+
+    packet_init(self, &packet, self->peer_tag);
+
+    /* A delayed SACK rides along with data when there is some */
+    if (self->sack_pending || (self->sack_deadline >= 0 && (self->unsent_bytes
+        || g_queue_peek_head(&self->outstanding))))
+        add_sack(self, &packet);
+
+    for (l = self->outstanding.head; l && self->retransmissions; l = l->next) {
+        chunk = l->data;
+        if (!chunk->retransmit)
+            continue;
+        if (is_expired(self, chunk, now)) {
+            abandon_message(self, chunk->message);
+            continue;
+        }
+        if (self->flight_size > 0 && self->flight_size + chunk->length > self->cwnd)
+            break;
+        if (!queue_data_chunk(self, &packet, chunk, now))
+            break;
+    }
+
+    while (self->flight_size < self->cwnd) {
+        if (!(chunk = g_queue_peek_head(&self->pending))) {
+            if (!chunk_next_message(self, now))
+                break;
+            continue;
+        }
+        if (is_expired(self, chunk, now)) {
+            abandon_message(self, chunk->message);
+            continue;
+        }
+        /* Probe a closed receive window with one chunk at a time */
+        if (self->peer_rwnd < chunk->length && self->flight_size > 0)
+            break;
+        /* Nagle: small amounts of data wait for what is in flight to be acknowledged */
+        if (!self->nodelay && self->flight_size > 0 && self->unsent_bytes < capacity
+            && packet_is_empty(&packet))
+            break;
+        if (!queue_data_chunk(self, &packet, chunk, now))
+            break;
+        g_queue_pop_head(&self->pending);
+        self->unsent_bytes -= chunk->length;
+        g_queue_push_tail(&self->outstanding, chunk);
+    }
+
+    /* After the data, which may have abandoned messages on the way */
+    update_forward_tsn(self);
+    if (self->forward_tsn_needed && !add_forward_tsn(self, &packet)) {
+        packet_queue(self, &packet);
+        packet_init(self, &packet, self->peer_tag);
+        add_forward_tsn(self, &packet);
+    }
+    packet_queue(self, &packet);
+
+    if (g_queue_peek_head(&self->outstanding) && self->t3_deadline < 0)
+        self->t3_deadline = now + self->rto;
+}
+
+static void chunk_acked(GstSctpLiteEngine *self, OutChunk *chunk, gint64 now)
+{
+    if (self->rtt_pending && self->rtt_tsn == chunk->tsn) {
+        update_rtt(self, now - self->rtt_time);
+        self->rtt_pending = FALSE;
+    }
+    if (chunk->in_flight) {
+        self->flight_size -= chunk->length;
+        chunk->in_flight = FALSE;
+    }
+    clear_retransmit(self, chunk);
+}
+
+static void handle_sack(GstSctpLiteEngine *self, const guint8 *value, gsize length, gint64 now)
+{
+    guint32 flight_before = self->flight_size, bytes_acked = 0, cum_ack, a_rwnd, highest = 0;
+    gboolean cum_advanced, newly_acked = FALSE;
+    guint16 n_gaps;
+    OutChunk *chunk, *last;
+    GList *l;
+    guint i;
+
+    if (length < 12)
+        return;
+    cum_ack = get32(value);
+    a_rwnd = get32(value + 4);
+    n_gaps = get16(value + 8);
+    if (length < 12 + 4u * n_gaps)
+        return;
+
+    last = g_queue_peek_tail(&self->outstanding);
+    if (TSN_LT(cum_ack, self->cum_acked) || (last && TSN_GT(cum_ack, last->tsn))
+        || (!last && cum_ack != self->cum_acked))
+        return;
+
+    while ((chunk = g_queue_peek_head(&self->outstanding)) && TSN_LE(chunk->tsn, cum_ack)) {
+        g_queue_pop_head(&self->outstanding);
+        if (!chunk->acked && !chunk->abandoned) {
+            bytes_acked += chunk->length;
+            highest = chunk->tsn;
+            newly_acked = TRUE;
+        }
+        chunk_acked(self, chunk, now);
+        free_out_chunk(self, chunk);
+    }
+    cum_advanced = TSN_GT(cum_ack, self->cum_acked);
+    if (cum_advanced) {
+        self->cum_acked = cum_ack;
+        self->error_count = 0;
+    }
+
+    l = self->outstanding.head;
+    for (i = 0; i < n_gaps; i++) {
+        guint32 start = cum_ack + get16(value + 12 + 4 * i);
+        guint32 end = cum_ack + get16(value + 14 + 4 * i);
+
+        for (; l && TSN_LT(((OutChunk *) l->data)->tsn, start); l = l->next);
+        for (; l && TSN_LE(((OutChunk *) l->data)->tsn, end); l = l->next) {
+            chunk = l->data;
+            if (chunk->acked || chunk->abandoned)
+                continue;
+            chunk->acked = TRUE;
+            bytes_acked += chunk->length;
+            highest = chunk->tsn;
+            newly_acked = TRUE;
+            chunk_acked(self, chunk, now);
+        }
+    }
+
+    /* Fast retransmit, RFC 4960 section 7.2.4 */
+    for (l = self->outstanding.head; l && newly_acked; l = l->next) {
+        chunk = l->data;
+        if (TSN_GE(chunk->tsn, highest))
+            break;
+        if (chunk->acked || chunk->abandoned || chunk->retransmit || !chunk->in_flight)
+            continue;
+        if (++chunk->missing_reports < 3)
+            continue;
+
+        if (!self->fast_recovery) {
+            self->ssthresh = MAX(self->cwnd / 2, 4 * self->mtu);
+            self->cwnd = self->ssthresh;
+            self->partial_bytes_acked = 0;
+            self->fast_recovery = TRUE;
+            self->recovery_point = ((OutChunk *) g_queue_peek_tail(&self->outstanding))->tsn;
+        }
+        self->counters.fast_retransmits++;
+        if (is_expired(self, chunk, now))
+            abandon_message(self, chunk->message);
+        else
+            mark_for_retransmission(self, chunk);
+    }
+    if (self->fast_recovery && TSN_GE(self->cum_acked, self->recovery_point))
+        self->fast_recovery = FALSE;
+
+    /* RFC 4960 sections 7.2.1 and 7.2.2, the window only grows while it is used */
+    if (cum_advanced && bytes_acked && !self->fast_recovery
+        && flight_before + self->mtu >= self->cwnd) {
+        if (self->cwnd <= self->ssthresh) {
+            self->cwnd += MIN(bytes_acked, self->mtu);
+        } else {
+            self->partial_bytes_acked += bytes_acked;
+            if (self->partial_bytes_acked >= self->cwnd) {
+                self->partial_bytes_acked -= self->cwnd;
+                self->cwnd += self->mtu;
+            }
+        }
+    }
+
+    self->peer_rwnd = a_rwnd > self->flight_size ? a_rwnd - self->flight_size : 0;
+
+    if (!g_queue_peek_head(&self->outstanding))
+        self->t3_deadline = -1;
+    else if (cum_advanced)
+        self->t3_deadline = now + self->rto;
+
+    /* RFC 3758 section 3.5 C3, the FORWARD TSN is sent again until the peer is past it */
+    if (TSN_LT(self->advanced_ack_point, self->cum_acked))
+        self->advanced_ack_point = self->cum_acked;
+    update_forward_tsn(self);
+    if (TSN_GT(self->advanced_ack_point, self->cum_acked))
+        self->forward_tsn_needed = TRUE;
+
+    maybe_send_reset_request(self, now);
+}
+
+static gboolean has_unacked_data(GstSctpLiteEngine *self)
+{
+    GList *l;
+
+    for (l = self->outstanding.head; l; l = l->next) {
+        OutChunk *chunk = l->data;
+
+        if (!chunk->acked)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void on_t3_timeout(GstSctpLiteEngine *self, gint64 now)
+{
+    GList *l;
+
+    self->t3_deadline = -1;
+    if (!has_unacked_data(self))
+        return;
+
+    self->counters.t3_timeouts++;
+    if (++self->error_count > self->max_retransmits) {
+        fail_association(self, "too many retransmissions");
+        return;
+    }
+
+    /* RFC 4960 sections 6.3.3 and 7.2.3 */
+    self->ssthresh = MAX(self->cwnd / 2, 4 * self->mtu);
+    self->cwnd = self->mtu;
+    self->partial_bytes_acked = 0;
+    self->fast_recovery = FALSE;
+    self->rto = MIN(self->rto * 2, self->rto_max);
+    self->rtt_pending = FALSE;
+
+    for (l = self->outstanding.head; l; l = l->next) {
+        OutChunk *chunk = l->data;
+
+        if (chunk->acked || chunk->abandoned || !chunk->transmissions)
+            continue;
+        if (is_expired(self, chunk, now))
+            abandon_message(self, chunk->message);
+        else
+            mark_for_retransmission(self, chunk);
+    }
+
+    update_forward_tsn(self);
+    if (TSN_GT(self->advanced_ack_point, self->cum_acked))
+        self->forward_tsn_needed = TRUE;
+    transmit(self, now);
+}
+
+/* Heartbeats */
+
+static void send_heartbeat(GstSctpLiteEngine *self, gint64 now)
+{
+    guint8 info[PARAM_HEADER_SIZE + 8];
+
+    put16(info, PARAM_HEARTBEAT_INFO);
+    put16(info + 2, sizeof(info));
+    put32(info + 4, (guint64) now >> 32);
+    put32(info + 8, now & 0xffffffff);
+    send_single_chunk(self, self->peer_tag, CHUNK_HEARTBEAT, 0, info, sizeof(info));
+}
+
+static void on_heartbeat_timeout(GstSctpLiteEngine *self, gint64 now)
+{
+    if (self->heartbeat_outstanding && ++self->error_count > self->max_retransmits) {
+        fail_association(self, "heartbeats unanswered");
+        return;
+    }
+
+    send_heartbeat(self, now);
+    self->heartbeat_outstanding = TRUE;
+    self->heartbeat_deadline = now + self->rto
+        + (gint64) self->heartbeat_interval * G_TIME_SPAN_MILLISECOND;
+}
+
+static void handle_heartbeat_ack(GstSctpLiteEngine *self, const guint8 *value, gsize length,
+    gint64 now)
+{
+    gint64 sent;
+
+    if (length < PARAM_HEADER_SIZE + 8 || get16(value) != PARAM_HEARTBEAT_INFO
+        || !self->heartbeat_outstanding)
+        return;
+
+    sent = ((gint64) get32(value + 4) << 32) | get32(value + 8);
+    if (sent <= now)
+        update_rtt(self, now - sent);
+    self->heartbeat_outstanding = FALSE;
+    self->error_count = 0;
+}
+
+/* Stream resets, RFC 6525 */
+
+static void send_reset_request(GstSctpLiteEngine *self, gint64 now)
+{
+    LitePacket packet;
+    guint8 *value;
+    guint i, n_streams = self->reset_in_flight->len;
+
+    packet_init(self, &packet, self->peer_tag);
+    value = packet_add_chunk(&packet, CHUNK_RE_CONFIG, 0, 16 + 2 * n_streams);
+    if (value) {
+        put16(value, PARAM_OUTGOING_RESET_REQUEST);
+        put16(value + 2, 16 + 2 * n_streams);
+        put32(value + 4, self->reconf_seq);
+        put32(value + 8, self->peer_reconf_seq - 1);
+        put32(value + 12, self->reconf_last_tsn);
+        for (i = 0; i < n_streams; i++)
+            put16(value + 16 + 2 * i, g_array_index(self->reset_in_flight, guint16, i));
+    }
+    packet_queue(self, &packet);
+
+    self->reconf_deadline = now + self->rto;
+}
+
+static gboolean has_queued_data(GstSctpLiteEngine *self, GArray *streams)
+{
+    OutChunk *chunk;
+    GList *l;
+
+    for (l = self->messages.head; l; l = l->next) {
+        if (array_contains(streams, ((OutMessage *) l->data)->stream_id))
+            return TRUE;
+    }
+    chunk = g_queue_peek_head(&self->pending);
+    return chunk && array_contains(streams, chunk->message->stream_id);
+}
+
+/* Asks for the pending streams to be reset once all the data queued on them has a TSN, so the
+ * peer resets them after the last message sent with the old sequence numbers */
+static void maybe_send_reset_request(GstSctpLiteEngine *self, gint64 now)
+{
+    GArray *streams;
+
+    if (self->state != LITE_STATE_ESTABLISHED || self->reset_in_flight->len
+        || !self->reset_pending->len || has_queued_data(self, self->reset_pending))
+        return;
+
+    streams = self->reset_in_flight;
+    self->reset_in_flight = self->reset_pending;
+    self->reset_pending = streams;
+    self->reconf_last_tsn = self->next_tsn - 1;
+    send_reset_request(self, now);
+}
+
+static void add_reconfig_response(LitePacket *packet, guint32 seq, guint32 result)
+{
+    guint8 *value = packet_add_chunk(packet, CHUNK_RE_CONFIG, 0, 12);
+
+    if (value) {
+        put16(value, PARAM_RECONFIG_RESPONSE);
+        put16(value + 2, 12);
+        put32(value + 4, seq);
+        put32(value + 8, result);
+    }
+}
+
+static guint32 handle_reset_request(GstSctpLiteEngine *self, const guint8 *param, gsize length)
+{
+    guint32 seq = get32(param + 4), last_tsn = get32(param + 12);
+    guint i, n_streams = (length - 16) / 2;
+
+    if (seq == self->peer_reconf_seq - 1)
+        return self->peer_reconf_result;
+    if (seq != self->peer_reconf_seq)
+        return RECONFIG_RESULT_BAD_SEQUENCE;
+    /* Data sent before the request is still on its way, the peer asks again */
+    if (TSN_GT(last_tsn, self->cum_tsn))
+        return RECONFIG_RESULT_IN_PROGRESS;
+
+    for (i = 0; i < n_streams; i++) {
+        guint16 stream_id = get16(param + 16 + 2 * i);
+
+        *stream_sequence(self->in_ssn, stream_id) = 0;
+        queue_event(self, EVENT_STREAM_RESET)->stream_id = stream_id;
+    }
+    /* No stream listed means all of them */
+    if (n_streams == 0) {
+        for (i = 0; i < self->in_ssn->len; i++) {
+            g_array_index(self->in_ssn, guint16, i) = 0;
+            queue_event(self, EVENT_STREAM_RESET)->stream_id = i;
+        }
+    }
+
+    self->peer_reconf_seq++;
+    self->peer_reconf_result = RECONFIG_RESULT_SUCCESS_PERFORMED;
+    return self->peer_reconf_result;
+}
+
+static void handle_reset_response(GstSctpLiteEngine *self, guint32 seq, guint32 result,
+    gint64 now)
+{
+    guint i;
+
+    if (!self->reset_in_flight->len || seq != self->reconf_seq)
+        return;
+
+    if (result == RECONFIG_RESULT_IN_PROGRESS) {
+        self->reconf_deadline = now + self->rto;
+        return;
+    }
+
+    if (result == RECONFIG_RESULT_SUCCESS_PERFORMED || result == RECONFIG_RESULT_SUCCESS_NOTHING) {
+        for (i = 0; i < self->reset_in_flight->len; i++)
+            *stream_sequence(self->out_ssn, g_array_index(self->reset_in_flight, guint16, i)) = 0;
+    } else {
+        g_warning("Peer refused to reset %u SCTP streams (%u)", self->reset_in_flight->len,
+            result);
+    }
+
+    g_array_set_size(self->reset_in_flight, 0);
+    self->reconf_seq++;
+    self->reconf_deadline = -1;
+    maybe_send_reset_request(self, now);
+}
+
+static void handle_reconfig(GstSctpLiteEngine *self, const guint8 *value, gsize length,
+    gint64 now)
+{
+    LitePacket packet;
+    gsize offset;
+
+    packet_init(self, &packet, self->peer_tag);
+
+    for (offset = 0; offset + PARAM_HEADER_SIZE <= length; ) {
+        const guint8 *param = value + offset;
+        guint16 type = get16(param), param_length = get16(param + 2);
+
+        if (param_length < 8 || offset + param_length > length)
+            break;
+
+        if (type == PARAM_OUTGOING_RESET_REQUEST && param_length >= 16) {
+            add_reconfig_response(&packet, get32(param + 4),
+                handle_reset_request(self, param, param_length));
+        } else if (type == PARAM_RECONFIG_RESPONSE && param_length >= 12) {
+            handle_reset_response(self, get32(param + 4), get32(param + 8), now);
+        } else if (type != PARAM_RECONFIG_RESPONSE) {
+            /* Incoming resets, TSN resets and added streams are not supported */
+            add_reconfig_response(&packet, get32(param + 4), RECONFIG_RESULT_DENIED);
+        }
+        offset += PADDED(param_length);
+    }
+
+    packet_queue(self, &packet);
+}
+
+/* Receiver */
+
+static void free_in_chunk(InChunk *chunk)
+{
+    g_free(chunk->data);
+    g_slice_free(InChunk, chunk);
+}
+
+/* Returns FALSE for a TSN received before */
+static gboolean record_tsn(GstSctpLiteEngine *self, guint32 tsn)
+{
+    guint lo = 0, hi = self->received->len;
+
+    if (TSN_LE(tsn, self->cum_tsn))
+        return FALSE;
+
+    if (tsn == self->cum_tsn + 1) {
+        self->cum_tsn = tsn;
+        while (self->received->len
+            && g_array_index(self->received, guint32, 0) == self->cum_tsn + 1) {
+            self->cum_tsn++;
+            g_array_remove_index(self->received, 0);
+        }
+        return TRUE;
+    }
+
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        guint32 value = g_array_index(self->received, guint32, mid);
+
+        if (value == tsn)
+            return FALSE;
+        if (TSN_LT(value, tsn))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    g_array_insert_val(self->received, lo, tsn);
+    return TRUE;
+}
+
+static void queue_message(GstSctpLiteEngine *self, InChunk *first, guint8 *data, gsize length,
+    gboolean fragment, gboolean last_fragment, gint64 now)
+{
+    LiteEvent *event = queue_event(self, EVENT_MESSAGE);
+
+    event->data = data;
+    event->length = length;
+    event->info.stream_id = first->stream_id;
+    event->info.ssn = first->ssn;
+    event->info.tsn = first->tsn;
+    event->info.ppid = first->ppid;
+    event->info.unordered = (first->flags & DATA_FLAG_UNORDERED) != 0;
+    event->info.fragment = fragment;
+    event->info.last_fragment = last_fragment;
+    event->info.receive_time = now;
+}
+
+/* Hands over n chunks starting at link and takes them out of the reassembly queue */
+static void deliver_chunks(GstSctpLiteEngine *self, GList *link, guint n, gboolean fragment,
+    gint64 now)
+{
+    InChunk *first = link->data, *last = first;
+    gsize length = 0, offset = 0;
+    guint8 *data;
+    GList *l;
+    guint i;
+
+    for (l = link, i = 0; i < n; l = l->next, i++) {
+        last = l->data;
+        length += last->length;
+    }
+
+    if (n == 1) {
+        data = first->data;
+        first->data = NULL;
+    } else {
+        data = g_malloc(length);
+        for (l = link, i = 0; i < n; l = l->next, i++) {
+            InChunk *chunk = l->data;
+
+            memcpy(data + offset, chunk->data, chunk->length);
+            offset += chunk->length;
+        }
+    }
+
+    queue_message(self, first, data, length, fragment, (last->flags & DATA_FLAG_END) != 0, now);
+    if (!(first->flags & DATA_FLAG_UNORDERED) && (last->flags & DATA_FLAG_END))
+        (*stream_sequence(self->in_ssn, first->stream_id))++;
+
+    if (fragment)
+        self->pd_next_tsn = last->tsn + 1;
+    self->reassembly_bytes -= length;
+    for (i = 0; i < n; i++) {
+        l = link->next;
+        free_in_chunk(link->data);
+        g_queue_delete_link(&self->reassembly, link);
+        link = l;
+    }
+}
+
+/* Counts the chunks with consecutive TSNs following link that belong to its message, and whether
+ * they reach its end */
+static guint count_fragments(GList *link, gboolean *complete)
+{
+    InChunk *chunk = link->data;
+    guint n = 1;
+
+    while (!(chunk->flags & DATA_FLAG_END)) {
+        InChunk *next;
+
+        if (!link->next || (next = link->next->data)->tsn != chunk->tsn + 1
+            || (next->flags & DATA_FLAG_BEGIN)) {
+            *complete = FALSE;
+            return n;
+        }
+        link = link->next;
+        chunk = next;
+        n++;
+    }
+
+    *complete = TRUE;
+    return n;
+}
+
+static gboolean is_next_in_stream(GstSctpLiteEngine *self, InChunk *chunk)
+{
+    return (chunk->flags & DATA_FLAG_UNORDERED)
+        || chunk->ssn == *stream_sequence(self->in_ssn, chunk->stream_id);
+}
+
+static void deliver_messages(GstSctpLiteEngine *self, gint64 now)
+{
+    gboolean complete;
+    GList *l, *next;
+    guint n;
+
+    /* A partially delivered message goes on before anything else */
+    if (self->pd_active) {
+        for (l = self->reassembly.head; l; l = l->next) {
+            if (((InChunk *) l->data)->tsn == self->pd_next_tsn)
+                break;
+        }
+        if (!l)
+            return;
+        n = count_fragments(l, &complete);
+        deliver_chunks(self, l, n, TRUE, now);
+        if (!complete)
+            return;
+        self->pd_active = FALSE;
+    }
+
+    /* Ordered messages of a stream come in TSN order, one pass finds all that can go */
+    for (l = self->reassembly.head; l; l = next) {
+        InChunk *chunk = l->data;
+
+        next = l->next;
+        if (!(chunk->flags & DATA_FLAG_BEGIN) || !is_next_in_stream(self, chunk))
+            continue;
+        n = count_fragments(l, &complete);
+        if (!complete)
+            continue;
+        next = g_list_nth(l, n);
+        deliver_chunks(self, l, n, FALSE, now);
+    }
+
+    /* Start handing over the first message that can go in pieces before it fills the receive
+     * buffer, which would stall the association */
+    if (self->reassembly_bytes < self->receive_buffer_size / 2)
+        return;
+    for (l = self->reassembly.head; l; l = l->next) {
+        InChunk *chunk = l->data;
+
+        if (!(chunk->flags & DATA_FLAG_BEGIN) || !is_next_in_stream(self, chunk))
+            continue;
+        n = count_fragments(l, &complete);
+        self->pd_active = TRUE;
+        deliver_chunks(self, l, n, TRUE, now);
+        break;
+    }
+}
+
+static void handle_data(GstSctpLiteEngine *self, guint8 flags, const guint8 *value, gsize length,
+    gint64 now)
+{
+    guint8 cause[8];
+    guint32 tsn;
+    InChunk *chunk;
+    GList *l;
+
+    if (length <= DATA_HEADER_SIZE)
+        return;
+    tsn = get32(value);
+
+    /* Past the receive buffer only the chunk the cumulative TSN waits for is taken */
+    if (self->reassembly_bytes >= self->receive_buffer_size && tsn != self->cum_tsn + 1)
+        return;
+
+    if (!record_tsn(self, tsn)) {
+        if (self->dup_tsns->len < MAX_DUP_TSNS)
+            g_array_append_val(self->dup_tsns, tsn);
+        self->sack_pending = TRUE;
+        return;
+    }
+    if (flags & DATA_FLAG_SACK_IMMEDIATELY)
+        self->sack_pending = TRUE;
+
+    /* RFC 4960 section 6.5, the TSN is acknowledged but the data dropped */
+    if (get16(value + 4) >= self->in_streams) {
+        put16(cause, CAUSE_INVALID_STREAM);
+        put16(cause + 2, sizeof(cause));
+        put16(cause + 4, get16(value + 4));
+        put16(cause + 6, 0);
+        send_single_chunk(self, self->peer_tag, CHUNK_ERROR, 0, cause, sizeof(cause));
+        return;
+    }
+
+    chunk = g_slice_new(InChunk);
+    chunk->tsn = tsn;
+    chunk->stream_id = get16(value + 4);
+    chunk->ssn = get16(value + 6);
+    chunk->ppid = get32(value + 8);
+    chunk->flags = flags;
+    chunk->length = length - DATA_HEADER_SIZE;
+    chunk->data = g_memdup(value + DATA_HEADER_SIZE, chunk->length);
+
+    /* The common case of a whole message arriving in order goes straight through */
+    if ((flags & (DATA_FLAG_BEGIN | DATA_FLAG_END)) == (DATA_FLAG_BEGIN | DATA_FLAG_END)
+        && !self->pd_active && is_next_in_stream(self, chunk)
+        && !g_queue_peek_head(&self->reassembly)) {
+        queue_message(self, chunk, chunk->data, chunk->length, FALSE, TRUE, now);
+        if (!(flags & DATA_FLAG_UNORDERED))
+            (*stream_sequence(self->in_ssn, chunk->stream_id))++;
+        g_slice_free(InChunk, chunk);
+        return;
+    }
+
+    for (l = self->reassembly.tail; l; l = l->prev) {
+        if (TSN_LT(((InChunk *) l->data)->tsn, tsn))
+            break;
+    }
+    if (l)
+        g_queue_insert_after(&self->reassembly, l, chunk);
+    else
+        g_queue_push_head(&self->reassembly, chunk);
+    self->reassembly_bytes += chunk->length;
+
+    deliver_messages(self, now);
+}
+
+static void handle_forward_tsn(GstSctpLiteEngine *self, const guint8 *value, gsize length,
+    gint64 now)
+{
+    guint32 new_cum;
+    gboolean complete;
+    GList *l, *next;
+    gsize offset;
+    guint i, n;
+
+    if (length < 4)
+        return;
+    new_cum = get32(value);
+    self->sack_pending = TRUE;
+    if (TSN_LE(new_cum, self->cum_tsn))
+        return;
+
+    self->cum_tsn = new_cum;
+    for (i = 0; i < self->received->len
+        && TSN_LE(g_array_index(self->received, guint32, i), new_cum); i++);
+    g_array_remove_range(self->received, 0, i);
+    while (self->received->len
+        && g_array_index(self->received, guint32, 0) == self->cum_tsn + 1) {
+        self->cum_tsn++;
+        g_array_remove_index(self->received, 0);
+    }
+
+    /* Pieces of the skipped messages never complete */
+    for (l = self->reassembly.head; l && TSN_LE(((InChunk *) l->data)->tsn, new_cum); l = next) {
+        InChunk *chunk = l->data;
+
+        complete = FALSE;
+        n = (chunk->flags & DATA_FLAG_BEGIN) ? count_fragments(l, &complete) : 1;
+        next = g_list_nth(l, n);
+        if (complete)
+            continue;
+        for (i = 0; i < n; i++) {
+            GList *link = l;
+
+            l = l->next;
+            self->reassembly_bytes -= ((InChunk *) link->data)->length;
+            free_in_chunk(link->data);
+            g_queue_delete_link(&self->reassembly, link);
+        }
+    }
+    if (self->pd_active && TSN_LE(self->pd_next_tsn, new_cum))
+        self->pd_active = FALSE;
+
+    /* Messages held back on the streams skip ahead, RFC 3758 section 3.6 */
+    for (offset = 4; offset + 4 <= length; offset += 4) {
+        guint16 stream_id = get16(value + offset), ssn = get16(value + offset + 2);
+        guint16 *expected = stream_sequence(self->in_ssn, stream_id);
+
+        for (l = self->reassembly.head; l && SSN_LE(*expected, ssn); l = next) {
+            InChunk *chunk = l->data;
+
+            next = l->next;
+            if (chunk->stream_id != stream_id || (chunk->flags & DATA_FLAG_UNORDERED)
+                || !(chunk->flags & DATA_FLAG_BEGIN) || !SSN_LE(chunk->ssn, ssn))
+                continue;
+            n = count_fragments(l, &complete);
+            if (!complete)
+                continue;
+            next = g_list_nth(l, n);
+            *expected = chunk->ssn;
+            deliver_chunks(self, l, n, FALSE, now);
+        }
+        if (SSN_LE(*expected, ssn))
+            *expected = ssn + 1;
+    }
+
+    deliver_messages(self, now);
+}
+
+static void process_packet(GstSctpLiteEngine *self, const guint8 *buf, gsize length, gint64 now)
+{
+    gboolean had_data = FALSE;
+    guint32 vtag;
+    gsize offset;
+
+    if (length < COMMON_HEADER_SIZE + CHUNK_HEADER_SIZE || get16(buf) != self->remote_port
+        || get16(buf + 2) != self->local_port)
+        return;
+
+    vtag = get32(buf + 4);
+    if (buf[COMMON_HEADER_SIZE] == CHUNK_INIT) {
+        if (vtag != 0)
+            return;
+    } else if ((buf[COMMON_HEADER_SIZE] == CHUNK_ABORT
+        || buf[COMMON_HEADER_SIZE] == CHUNK_SHUTDOWN_COMPLETE)
+        && (buf[COMMON_HEADER_SIZE + 1] & CHUNK_FLAG_T)) {
+        if (vtag != self->peer_tag)
+            return;
+    } else if (vtag != self->local_tag) {
+        return;
+    }
+
+    for (offset = COMMON_HEADER_SIZE; offset + CHUNK_HEADER_SIZE <= length; ) {
+        guint8 type = buf[offset], flags = buf[offset + 1];
+        guint16 chunk_length = get16(buf + offset + 2);
+        const guint8 *value = buf + offset + CHUNK_HEADER_SIZE;
+        gsize value_length = chunk_length - CHUNK_HEADER_SIZE;
+
+        if (chunk_length < CHUNK_HEADER_SIZE || offset + chunk_length > length)
+            break;
+        offset += PADDED(chunk_length);
+
+        switch (type) {
+        case CHUNK_DATA:
+            if (self->state == LITE_STATE_ESTABLISHED) {
+                handle_data(self, flags, value, value_length, now);
+                had_data = TRUE;
+            }
+            break;
+        case CHUNK_INIT:
+            handle_init(self, value, value_length, now);
+            /* Nothing may be bundled with an INIT */
+            return;
+        case CHUNK_INIT_ACK:
+            handle_init_ack(self, value, value_length, now);
+            return;
+        case CHUNK_SACK:
+            if (self->state == LITE_STATE_ESTABLISHED)
+                handle_sack(self, value, value_length, now);
+            break;
+        case CHUNK_HEARTBEAT:
+            send_single_chunk(self, self->peer_tag, CHUNK_HEARTBEAT_ACK, 0, value,
+                value_length);
+            break;
+        case CHUNK_HEARTBEAT_ACK:
+            handle_heartbeat_ack(self, value, value_length, now);
+            break;
+        case CHUNK_ABORT:
+            g_warning("SCTP association aborted by the peer");
+            end_association(self);
+            return;
+        case CHUNK_SHUTDOWN:
+            g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association shut down by the peer");
+            send_single_chunk(self, self->peer_tag, CHUNK_SHUTDOWN_ACK, 0, NULL, 0);
+            end_association(self);
+            return;
+        case CHUNK_SHUTDOWN_ACK:
+            send_single_chunk(self, self->peer_tag, CHUNK_SHUTDOWN_COMPLETE, 0, NULL, 0);
+            end_association(self);
+            return;
+        case CHUNK_SHUTDOWN_COMPLETE:
+            end_association(self);
+            return;
+        case CHUNK_ERROR:
+            g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP operation error received (%u)",
+                value_length >= PARAM_HEADER_SIZE ? get16(value) : 0);
+            break;
+        case CHUNK_COOKIE_ECHO:
+            handle_cookie_echo(self, value, value_length, now);
+            break;
+        case CHUNK_COOKIE_ACK:
+            if (self->state == LITE_STATE_COOKIE_ECHOED)
+                set_established(self, now);
+            break;
+        case CHUNK_RE_CONFIG:
+            if (self->state == LITE_STATE_ESTABLISHED)
+                handle_reconfig(self, value, value_length, now);
+            break;
+        case CHUNK_FORWARD_TSN:
+            if (self->state == LITE_STATE_ESTABLISHED) {
+                handle_forward_tsn(self, value, value_length, now);
+                had_data = TRUE;
+            }
+            break;
+        default:
+            /* RFC 4960 section 3.2, the two upper bits tell whether to go on */
+            if (!(type & 0x80))
+                goto out;
+            break;
+        }
+    }
+
+out:
+    if (had_data) {
+        /* RFC 4960 section 6.2, gaps are reported right away */
+        if (self->received->len || self->sack_delay == 0
+            || ++self->packets_unacked >= self->sack_frequency)
+            self->sack_pending = TRUE;
+        else if (self->sack_deadline < 0)
+            self->sack_deadline = now + (gint64) self->sack_delay * G_TIME_SPAN_MILLISECOND;
+    }
+
+    transmit(self, now);
+}
+
+static void on_t1_timeout(GstSctpLiteEngine *self, gint64 now)
+{
+    self->t1_deadline = -1;
+    self->counters.init_timeouts++;
+    if (++self->init_retransmits > self->max_init_retransmits) {
+        g_warning("Could not set up the SCTP association, no answer after %u attempts",
+            self->init_retransmits);
+        end_association(self);
+        return;
+    }
+
+    self->t1_rto = MIN(self->t1_rto * 2, self->max_init_timeout);
+    if (self->state == LITE_STATE_COOKIE_WAIT)
+        send_init(self, CHUNK_INIT, 0, NULL, 0);
+    else
+        send_single_chunk(self, self->peer_tag, CHUNK_COOKIE_ECHO, 0, self->cookie,
+            self->cookie_length);
+    self->t1_deadline = now + self->t1_rto;
+}
+
+static gboolean on_timeout(gpointer user_data)
+{
+    GstSctpAssociation *association = g_weak_ref_get((GWeakRef *) user_data);
+    GstSctpLiteEngine *self;
+    gint64 now;
+
+    if (!association)
+        return G_SOURCE_CONTINUE;
+
+    self = (GstSctpLiteEngine *) g_atomic_pointer_get(&association->engine);
+    g_mutex_lock(&self->lock);
+    self->timer_armed = -1;
+    now = g_get_monotonic_time();
+
+    if (self->t1_deadline >= 0 && now >= self->t1_deadline)
+        on_t1_timeout(self, now);
+    if (self->t3_deadline >= 0 && now >= self->t3_deadline)
+        on_t3_timeout(self, now);
+    if (self->heartbeat_deadline >= 0 && now >= self->heartbeat_deadline)
+        on_heartbeat_timeout(self, now);
+    if (self->reconf_deadline >= 0 && now >= self->reconf_deadline)
+        send_reset_request(self, now);
+    if (self->sack_deadline >= 0 && now >= self->sack_deadline) {
+        self->sack_pending = TRUE;
+        self->sack_deadline = -1;
+    }
+    if (self->sack_pending)
+        transmit(self, now);
+
+    unlock_and_dispatch(self);
+    g_object_unref(association);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Engine functions */
+
+static GstSctpEngine *lite_engine_create(GstSctpAssociation *association)
+{
+    GstSctpLiteEngine *self = g_slice_new0(GstSctpLiteEngine);
+    guint i;
+
+    self->parent.funcs = &gst_sctp_lite_engine_funcs;
+    self->parent.association = association;
+    g_mutex_init(&self->lock);
+    self->state = LITE_STATE_NEW;
+    self->timer = gst_sctp_association_create_timer_source(association, on_timeout);
+    self->timer_armed = -1;
+
+    g_queue_init(&self->messages);
+    g_queue_init(&self->pending);
+    g_queue_init(&self->outstanding);
+    g_queue_init(&self->reassembly);
+    g_queue_init(&self->out_packets);
+    g_queue_init(&self->events);
+    self->out_ssn = g_array_new(FALSE, TRUE, sizeof(guint16));
+    self->in_ssn = g_array_new(FALSE, TRUE, sizeof(guint16));
+    self->received = g_array_new(FALSE, FALSE, sizeof(guint32));
+    self->dup_tsns = g_array_new(FALSE, FALSE, sizeof(guint32));
+    self->reset_pending = g_array_new(FALSE, FALSE, sizeof(guint16));
+    self->reset_in_flight = g_array_new(FALSE, FALSE, sizeof(guint16));
+
+    for (i = 0; i < SECRET_SIZE; i += 4)
+        put32(self->secret + i, g_random_int());
+    do {
+        self->local_tag = g_random_int();
+    } while (self->local_tag == 0);
+    self->initial_tsn = g_random_int();
+    self->next_tsn = self->initial_tsn;
+    self->cum_acked = self->initial_tsn - 1;
+    self->advanced_ack_point = self->cum_acked;
+    self->reconf_seq = self->initial_tsn;
+
+    self->t1_deadline = -1;
+    self->t3_deadline = -1;
+    self->sack_deadline = -1;
+    self->reconf_deadline = -1;
+    self->heartbeat_deadline = -1;
+    self->heartbeat_interval = DEFAULT_HEARTBEAT_INTERVAL;
+    self->nodelay = TRUE;
+    /* Until the association sets its own, an INIT may come in before */
+    self->send_buffer_size = DEFAULT_BUFFER_SIZE;
+    self->receive_buffer_size = DEFAULT_BUFFER_SIZE;
+
+    return &self->parent;
+}
+
+static void free_messages(GQueue *queue)
+{
+    OutMessage *message;
+
+    while ((message = g_queue_pop_head(queue))) {
+        g_free(message->data);
+        g_slice_free(OutMessage, message);
+    }
+}
+
+static void free_chunks(GstSctpLiteEngine *self, GQueue *queue)
+{
+    OutChunk *chunk;
+
+    while ((chunk = g_queue_pop_head(queue)))
+        free_out_chunk(self, chunk);
+}
+
+static void lite_engine_free(GstSctpEngine *engine)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+    LitePacket *packet;
+    LiteEvent *event;
+    InChunk *chunk;
+
+    g_source_destroy(self->timer);
+    g_source_unref(self->timer);
+
+    free_messages(&self->messages);
+    free_chunks(self, &self->pending);
+    free_chunks(self, &self->outstanding);
+    while ((chunk = g_queue_pop_head(&self->reassembly)))
+        free_in_chunk(chunk);
+    while ((packet = g_queue_pop_head(&self->out_packets))) {
+        g_free(packet->data);
+        g_slice_free(LitePacket, packet);
+    }
+    while ((event = g_queue_pop_head(&self->events))) {
+        g_free(event->data);
+        g_slice_free(LiteEvent, event);
+    }
+
+    g_array_free(self->out_ssn, TRUE);
+    g_array_free(self->in_ssn, TRUE);
+    g_array_free(self->received, TRUE);
+    g_array_free(self->dup_tsns, TRUE);
+    g_array_free(self->reset_pending, TRUE);
+    g_array_free(self->reset_in_flight, TRUE);
+    g_free(self->cookie);
+    g_mutex_clear(&self->lock);
+    g_slice_free(GstSctpLiteEngine, self);
+}
+
+static gboolean lite_engine_open(GstSctpEngine *engine)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+    GstSctpAssociation *association = engine->association;
+    gboolean fast = association->setup_profile == GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST;
+
+    g_mutex_lock(&self->lock);
+
+    self->local_port = association->local_port;
+    self->remote_port = association->remote_port;
+    self->mtu = association->mtu;
+    self->use_sock_stream = association->use_sock_stream;
+    self->rto_initial = (fast ? FAST_SETUP_RTO_INITIAL : RTO_INITIAL) * G_TIME_SPAN_MILLISECOND;
+    self->rto_min = (fast ? FAST_SETUP_RTO_MIN : RTO_MIN) * G_TIME_SPAN_MILLISECOND;
+    self->rto_max = (fast ? FAST_SETUP_RTO_MAX : RTO_MAX) * G_TIME_SPAN_MILLISECOND;
+    self->max_init_timeout = fast ? FAST_SETUP_MAX_INIT_TIMEOUT * G_TIME_SPAN_MILLISECOND
+        : self->rto_max;
+    if (association->max_init_retransmits)
+        self->max_init_retransmits = association->max_init_retransmits;
+    else
+        self->max_init_retransmits = fast ? FAST_SETUP_MAX_INIT_ATTEMPTS - 1
+            : DEFAULT_MAX_INIT_RETRANSMITS;
+    self->max_retransmits = association->max_retransmits ? association->max_retransmits
+        : DEFAULT_MAX_RETRANSMITS;
+    self->sack_delay = association->sack_delay;
+    self->sack_frequency = association->sack_frequency;
+    self->t1_rto = self->rto_initial;
+    self->rto = self->rto_initial;
+    self->state = LITE_STATE_CLOSED;
+
+    g_mutex_unlock(&self->lock);
+
+    return TRUE;
+}
+
+static gboolean lite_engine_connect(GstSctpEngine *engine)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    /* The peer may have been faster */
+    if (self->state == LITE_STATE_CLOSED) {
+        self->state = LITE_STATE_COOKIE_WAIT;
+        self->init_retransmits = 0;
+        send_init(self, CHUNK_INIT, 0, NULL, 0);
+        self->t1_deadline = g_get_monotonic_time() + self->t1_rto;
+    }
+    unlock_and_dispatch(self);
+
+    return TRUE;
+}
+
+static void lite_engine_close(GstSctpEngine *engine)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    if (self->state == LITE_STATE_COOKIE_ECHOED || self->state == LITE_STATE_ESTABLISHED)
+        send_single_chunk(self, self->peer_tag, CHUNK_ABORT, 0, NULL, 0);
+    /* Called with the association mutex held, the association knows it is closing */
+    self->state = LITE_STATE_ENDED;
+    end_association(self);
+    unlock_and_dispatch(self);
+}
+
+static void lite_engine_incoming_packet(GstSctpEngine *engine, guint8 *buf, gsize length,
+    guint8 ecn_bits)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    if (self->state != LITE_STATE_NEW && self->state != LITE_STATE_ENDED)
+        process_packet(self, buf, length, g_get_monotonic_time());
+    unlock_and_dispatch(self);
+}
+
+static gboolean lite_engine_send(GstSctpEngine *engine, guint8 *buf, guint32 length,
+    guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
+    guint32 reliability_param, GstSctpAssociationSendFlags flags, guint32 context)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+    OutMessage *message;
+    gint64 now;
+    gboolean ret = FALSE;
+
+    g_mutex_lock(&self->lock);
+
+    if (self->state != LITE_STATE_ESTABLISHED)
+        goto end;
+    if (length == 0 || stream_id >= self->out_streams) {
+        g_warning("Invalid SCTP message, %u bytes on stream %u of %u", length, stream_id,
+            self->out_streams);
+        goto end;
+    }
+    /* Until the peer confirmed the reset */
+    if (array_contains(self->reset_pending, stream_id)
+        || array_contains(self->reset_in_flight, stream_id))
+        goto end;
+    if (self->send_buffered && self->send_buffered + length > self->send_buffer_size)
+        goto end;
+
+    now = g_get_monotonic_time();
+    message = g_slice_new0(OutMessage);
+    message->data = g_memdup(buf, length);
+    message->length = length;
+    message->stream_id = stream_id;
+    message->ppid = ppid;
+    message->ordered = ordered;
+    message->pr = self->use_sock_stream ? GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE : pr;
+    message->reliability_param = reliability_param;
+    message->context = context;
+    message->sack_immediately = (flags & GST_SCTP_ASSOCIATION_SEND_FLAG_SACK_IMMEDIATELY) != 0;
+    if (message->pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL)
+        message->expiry = now + (gint64) reliability_param * G_TIME_SPAN_MILLISECOND;
+
+    g_queue_push_tail(&self->messages, message);
+    self->send_buffered += length;
+    self->unsent_bytes += length;
+    transmit(self, now);
+    ret = TRUE;
+
+end:
+    unlock_and_dispatch(self);
+    return ret;
+}
+
+static void lite_engine_reset_stream(GstSctpEngine *engine, guint16 stream_id)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    if (self->state == LITE_STATE_ESTABLISHED && (self->peer_features & FEATURE_RECONFIG)
+        && !array_contains(self->reset_pending, stream_id)
+        && !array_contains(self->reset_in_flight, stream_id)) {
+        g_array_append_val(self->reset_pending, stream_id);
+        maybe_send_reset_request(self, g_get_monotonic_time());
+    }
+    unlock_and_dispatch(self);
+}
+
+static gboolean lite_engine_get_status(GstSctpEngine *engine, GstSctpEngineStatus *status)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+    gboolean ret;
+    GList *l;
+
+    g_mutex_lock(&self->lock);
+    ret = self->state == LITE_STATE_ESTABLISHED;
+    if (ret) {
+        status->srtt = self->srtt / G_TIME_SPAN_MILLISECOND;
+        status->rto = self->rto / G_TIME_SPAN_MILLISECOND;
+        status->cwnd = self->cwnd;
+        status->peer_rwnd = self->peer_rwnd;
+        status->unacked_chunks = 0;
+        for (l = self->outstanding.head; l; l = l->next) {
+            if (!((OutChunk *) l->data)->acked)
+                status->unacked_chunks++;
+        }
+        status->pending_chunks = self->pending.length + self->messages.length;
+        status->send_buffered = self->send_buffered;
+        status->receive_buffered = self->reassembly_bytes;
+    }
+    g_mutex_unlock(&self->lock);
+
+    return ret;
+}
+
+static void lite_engine_get_counters(GstSctpEngine *engine, GstSctpEngineCounters *counters)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    *counters = self->counters;
+    g_mutex_unlock(&self->lock);
+}
+
+static void lite_engine_apply_delayed_sack(GstSctpEngine *engine)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+    GstSctpAssociation *association = engine->association;
+
+    g_mutex_lock(&self->lock);
+    self->sack_delay = association->sack_delay;
+    self->sack_frequency = association->sack_frequency;
+    /* What was held back under the old settings goes now rather than waiting for them */
+    if (self->sack_deadline >= 0 && (self->sack_delay == 0
+        || self->packets_unacked >= self->sack_frequency)) {
+        self->sack_pending = TRUE;
+        transmit(self, g_get_monotonic_time());
+    }
+    unlock_and_dispatch(self);
+}
+
+static void lite_engine_set_nodelay(GstSctpEngine *engine, gboolean nodelay)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    self->nodelay = nodelay;
+    /* Whatever Nagle held back goes now */
+    if (nodelay && self->unsent_bytes)
+        transmit(self, g_get_monotonic_time());
+    unlock_and_dispatch(self);
+}
+
+static gboolean lite_engine_set_buffer_sizes(GstSctpEngine *engine, guint send_size,
+    guint receive_size)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    self->send_buffer_size = send_size;
+    self->receive_buffer_size = receive_size;
+    g_mutex_unlock(&self->lock);
+
+    return TRUE;
+}
+
+static gboolean lite_engine_get_heartbeat_interval(GstSctpEngine *engine, guint *interval)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    *interval = self->heartbeat_interval;
+    g_mutex_unlock(&self->lock);
+
+    return TRUE;
+}
+
+static gboolean lite_engine_set_heartbeat_interval(GstSctpEngine *engine, guint interval)
+{
+    GstSctpLiteEngine *self = (GstSctpLiteEngine *) engine;
+
+    g_mutex_lock(&self->lock);
+    self->heartbeat_interval = interval;
+    if (self->state == LITE_STATE_ESTABLISHED) {
+        self->heartbeat_deadline = interval ? g_get_monotonic_time() + self->rto
+            + (gint64) interval * G_TIME_SPAN_MILLISECOND : -1;
+    }
+    unlock_and_dispatch(self);
+
+    return TRUE;
+}
+
+const GstSctpEngineFuncs gst_sctp_lite_engine_funcs = {
+    "lite",
+    TRUE,
+    lite_engine_create,
+    lite_engine_free,
+    lite_engine_open,
+    lite_engine_connect,
+    lite_engine_close,
+    lite_engine_incoming_packet,
+    lite_engine_send,
+    lite_engine_reset_stream,
+    lite_engine_get_status,
+    lite_engine_get_counters,
+    lite_engine_set_nodelay,
+    lite_engine_set_buffer_sizes,
+    lite_engine_get_heartbeat_interval,
+    lite_engine_set_heartbeat_interval,
+    lite_engine_apply_delayed_sack,
+    /* There are no congestion control modules to pick */
+    NULL,
+    NULL
+};
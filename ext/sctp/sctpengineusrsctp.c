@@ -0,0 +1,831 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctpengine.h"
+
+#define INET
+#define INET6
+#include <usrsctp.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+
+/*
+ * The usrsctp engine. The stack is shared by all associations in the process: it is initialized
+ * with the first engine and runs its own timer thread until the last one is freed.
+ */
+
+#define DEFAULT_NUMBER_OF_SCTP_STREAMS 10
+
+typedef struct {
+    GstSctpEngine parent;
+
+    struct socket *sock;
+    sctp_assoc_t assoc_id;
+
+    /* Only touched from the receive callback */
+    gboolean receiving_partial;
+} GstSctpUsrsctpEngine;
+
+G_LOCK_DEFINE_STATIC(usrsctp_lock);
+static guint number_of_engines = 0;
+
+static struct sockaddr_conn get_sctp_socket_address(GstSctpUsrsctpEngine *self, guint16 port);
+static int sctp_packet_out(void *addr, void *buffer, size_t length, guint8 tos, guint8 set_df);
+static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
+    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info);
+static void handle_notification(GstSctpUsrsctpEngine *self,
+    const union sctp_notification *notification, size_t length);
+static void handle_association_changed(GstSctpUsrsctpEngine *self,
+    const struct sctp_assoc_change *sac);
+static void handle_stream_reset_event(GstSctpUsrsctpEngine *self,
+    const struct sctp_stream_reset_event *ssr);
+static gboolean apply_delayed_sack(GstSctpUsrsctpEngine *self, struct socket *sock);
+static guint32 to_usrsctp_congestion_control(GstSctpAssociationCongestionControl congestion_control);
+static gboolean apply_congestion_control(GstSctpUsrsctpEngine *self, struct socket *sock);
+static gboolean apply_setup_profile(GstSctpUsrsctpEngine *self, struct socket *sock);
+static void apply_congestion_control_options(GstSctpUsrsctpEngine *self, sctp_assoc_t assoc_id);
+
+static GstSctpEngine *usrsctp_engine_create(GstSctpAssociation *association)
+{
+    GstSctpUsrsctpEngine *self = g_slice_new0(GstSctpUsrsctpEngine);
+
+    self->parent.funcs = &gst_sctp_usrsctp_engine_funcs;
+    self->parent.association = association;
+
+    G_LOCK(usrsctp_lock);
+    if (number_of_engines == 0) {
+        usrsctp_init(0, sctp_packet_out, g_print);
+
+        /* With CRC32c offload the association computes and verifies the checksums as it is
+         * configured */
+#ifdef HAVE_USRSCTP_CRC32C_OFFLOAD
+        usrsctp_enable_crc32c_offload();
+#endif
+
+        usrsctp_sysctl_set_sctp_blackhole(2);
+
+        /* Explicit Congestion Notification, enabled per association by the ecn property */
+        usrsctp_sysctl_set_sctp_ecn_enable(0);
+
+        usrsctp_sysctl_set_sctp_nr_outgoing_streams_default(DEFAULT_NUMBER_OF_SCTP_STREAMS);
+    }
+    number_of_engines++;
+    usrsctp_register_address((void *) self);
+    G_UNLOCK(usrsctp_lock);
+
+    return &self->parent;
+}
+
+static void usrsctp_engine_close(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+
+    if (self->sock) {
+        usrsctp_shutdown(self->sock, SHUT_RDWR);
+        usrsctp_close(self->sock);
+        self->sock = NULL;
+    }
+}
+
+static void usrsctp_engine_free(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+
+    usrsctp_engine_close(engine);
+
+    G_LOCK(usrsctp_lock);
+    usrsctp_deregister_address((void *) self);
+    number_of_engines--;
+    if (number_of_engines == 0) {
+        usrsctp_finish();
+    }
+    G_UNLOCK(usrsctp_lock);
+
+    g_slice_free(GstSctpUsrsctpEngine, self);
+}
+
+static gboolean usrsctp_engine_open(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    GstSctpAssociation *association = engine->association;
+    struct socket *sock;
+    struct linger l;
+    struct sctp_event event;
+    struct sctp_assoc_value stream_reset;
+    struct sctp_assoc_value ecn;
+    int value = association->bundling_policy != GST_SCTP_ASSOCIATION_BUNDLING_POLICY_THROUGHPUT;
+    guint16 event_types[] = {
+        SCTP_ASSOC_CHANGE,
+        SCTP_PEER_ADDR_CHANGE,
+        SCTP_REMOTE_ERROR,
+        SCTP_SEND_FAILED_EVENT,
+        SCTP_SHUTDOWN_EVENT,
+        SCTP_ADAPTATION_INDICATION,
+        /*SCTP_PARTIAL_DELIVERY_EVENT,*/
+        /*SCTP_AUTHENTICATION_EVENT,*/
+        SCTP_STREAM_RESET_EVENT,
+        /*SCTP_SENDER_DRY_EVENT,*/
+        /*SCTP_NOTIFICATIONS_STOPPED_EVENT,*/
+        /*SCTP_ASSOC_RESET_EVENT,*/
+        SCTP_STREAM_CHANGE_EVENT};
+    guint32 i;
+    guint sock_type = association->use_sock_stream ? SOCK_STREAM : SOCK_SEQPACKET;
+
+    if ((sock = usrsctp_socket(AF_CONN, sock_type, IPPROTO_SCTP, receive_cb, NULL, 0,
+        (void *)self)) == NULL)
+        goto error;
+
+    if (usrsctp_set_non_blocking(sock, 1) < 0) {
+        g_warning("Could not set non-blocking mode on SCTP socket");
+        goto error;
+    }
+
+    memset(&l, 0, sizeof(l));
+    l.l_onoff = 1;
+    l.l_linger = 0;
+    if (usrsctp_setsockopt(sock, SOL_SOCKET, SO_LINGER, (const void *)&l,
+        (socklen_t) sizeof(struct linger)) < 0) {
+        g_warning("Could not set SO_LINGER on SCTP socket");
+        goto error;
+    }
+
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_NODELAY, &value, sizeof(int))) {
+        g_warning("Could not set SCTP_NODELAY");
+        goto error;
+    }
+
+    memset(&stream_reset, 0, sizeof(stream_reset));
+    stream_reset.assoc_id = SCTP_ALL_ASSOC;
+    stream_reset.assoc_value = 1;
+    if (usrsctp_setsockopt(sock,  IPPROTO_SCTP, SCTP_ENABLE_STREAM_RESET,
+        &stream_reset, sizeof(stream_reset))) {
+        g_warning("Could not set SCTP_ENABLE_STREAM_RESET");
+        goto error;
+    }
+
+    if (!apply_delayed_sack(self, sock))
+        goto error;
+
+    if (!apply_congestion_control(self, sock))
+        goto error;
+
+    if (!apply_setup_profile(self, sock))
+        goto error;
+
+    memset(&ecn, 0, sizeof(ecn));
+    ecn.assoc_id = SCTP_FUTURE_ASSOC;
+    ecn.assoc_value = association->ecn;
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_ECN_SUPPORTED, &ecn, sizeof(ecn))) {
+        g_warning("Could not set SCTP_ECN_SUPPORTED");
+        goto error;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.se_assoc_id = SCTP_ALL_ASSOC;
+    event.se_on = 1;
+    for (i = 0; i < sizeof(event_types) / sizeof(event_types[0]); i++) {
+        event.se_type = event_types[i];
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_EVENT,
+            &event, sizeof(event)) < 0) {
+            g_warning("Failed to register event %u", event_types[i]);
+        }
+    }
+
+    self->sock = sock;
+    return TRUE;
+error:
+    if (sock) {
+        usrsctp_close(sock);
+        g_warning("Could not create socket. Error: (%u) %s", errno, strerror(errno));
+        errno = 0;
+    }
+    return FALSE;
+}
+
+static struct sockaddr_conn get_sctp_socket_address(GstSctpUsrsctpEngine *self, guint16 port)
+{
+    struct sockaddr_conn addr;
+
+    memset((void *)&addr, 0, sizeof(struct sockaddr_conn));
+#ifdef __APPLE__
+    addr.sconn_len = sizeof(struct sockaddr_conn);
+#endif
+    addr.sconn_family = AF_CONN;
+    addr.sconn_port = g_htons(port);
+    addr.sconn_addr = (void *) self;
+
+    return addr;
+}
+
+static gboolean usrsctp_engine_connect(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    GstSctpAssociation *association = engine->association;
+    struct sctp_paddrparams paddrparams;
+    struct sockaddr_conn addr;
+    socklen_t opt_len;
+    gint ret;
+
+    if (!self->sock)
+        return FALSE;
+
+    addr = get_sctp_socket_address(self, association->local_port);
+    ret = usrsctp_bind(self->sock, (struct sockaddr *)&addr, sizeof(struct sockaddr_conn));
+    if (ret < 0) {
+        g_warning("usrsctp_bind() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    addr = get_sctp_socket_address(self, association->remote_port);
+    ret = usrsctp_connect(self->sock, (struct sockaddr *)&addr, sizeof(struct sockaddr_conn));
+    if (ret < 0 && errno != EINPROGRESS) {
+        g_warning("usrsctp_connect() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    memset(&paddrparams, 0, sizeof(struct sctp_paddrparams));
+    memcpy(&paddrparams.spp_address, &addr, sizeof(struct sockaddr_conn));
+
+    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
+    ret = usrsctp_getsockopt(self->sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, &opt_len);
+    if (ret < 0) {
+        g_warning("usrsctp_getsockopt() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    paddrparams.spp_pathmtu = association->mtu;
+    paddrparams.spp_flags &= ~SPP_PMTUD_ENABLE;
+    paddrparams.spp_flags |= SPP_PMTUD_DISABLE;
+    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
+
+    ret = usrsctp_setsockopt(self->sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, opt_len);
+    if (ret < 0) {
+        g_warning("usrsctp_setsockopt() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "usrsctp: PMTUD disabled, MTU set to %u", paddrparams.spp_pathmtu);
+
+    return TRUE;
+}
+
+static void usrsctp_engine_incoming_packet(GstSctpEngine *engine, guint8 *buf, gsize length,
+    guint8 ecn_bits)
+{
+    usrsctp_conninput((void *) engine, (const void *)buf, (size_t)length, ecn_bits);
+}
+
+static gboolean usrsctp_engine_send(GstSctpEngine *engine, guint8 *buf, guint32 length,
+    guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
+    guint32 reliability_param, GstSctpAssociationSendFlags flags, guint32 context)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    struct sctp_sendv_spa spa;
+    gint32 bytes_sent;
+    struct sockaddr_conn remote_addr;
+
+    if (!self->sock)
+        return FALSE;
+
+    memset(&spa, 0, sizeof(spa));
+
+    spa.sendv_sndinfo.snd_ppid = g_htonl(ppid);
+    spa.sendv_sndinfo.snd_sid = stream_id;
+    spa.sendv_sndinfo.snd_flags = ordered ? 0 : SCTP_UNORDERED;
+    if (flags & GST_SCTP_ASSOCIATION_SEND_FLAG_SACK_IMMEDIATELY)
+        spa.sendv_sndinfo.snd_flags |= SCTP_SACK_IMMEDIATELY;
+    spa.sendv_sndinfo.snd_context = context;
+    spa.sendv_sndinfo.snd_assoc_id = 0;
+    spa.sendv_flags = SCTP_SEND_SNDINFO_VALID;
+    if (pr != GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE) {
+        spa.sendv_flags |= SCTP_SEND_PRINFO_VALID;
+        spa.sendv_prinfo.pr_value = g_htonl(reliability_param);
+        if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_TTL)
+            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_TTL;
+        else if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX)
+            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_RTX;
+        else if (pr == GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_BUF)
+            spa.sendv_prinfo.pr_policy = SCTP_PR_SCTP_BUF;
+    }
+
+    remote_addr = get_sctp_socket_address(self, engine->association->remote_port);
+    bytes_sent = usrsctp_sendv(self->sock, buf, length, (struct sockaddr *)&remote_addr, 1, (void *)&spa, (socklen_t)sizeof(struct sctp_sendv_spa), SCTP_SENDV_SPA, 0);
+    if (bytes_sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            /* Resending this buffer is taken care of by the gstsctpenc */
+            return FALSE;
+        } else {
+            g_warning("Error sending data on stream %u: (%u) %s", stream_id, errno, strerror(errno));
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void usrsctp_engine_reset_stream(GstSctpEngine *engine, guint16 stream_id)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    struct sctp_reset_streams *srs;
+    socklen_t length;
+
+    if (!self->sock)
+        return;
+
+    length = (socklen_t)(sizeof(struct sctp_reset_streams) + sizeof(guint16));
+    srs = (struct sctp_reset_streams *) g_malloc0(length);
+    srs->srs_flags = SCTP_STREAM_RESET_OUTGOING;
+    srs->srs_number_streams = 1;
+    srs->srs_stream_list[0] = stream_id;
+
+    usrsctp_setsockopt(self->sock, IPPROTO_SCTP, SCTP_RESET_STREAMS, srs, length);
+
+    g_free(srs);
+}
+
+static gboolean usrsctp_engine_get_status(GstSctpEngine *engine, GstSctpEngineStatus *status)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    struct sctp_status sctp_status;
+    struct sctp_sockstat sockstat;
+    socklen_t opt_len;
+
+    if (!self->sock)
+        return FALSE;
+
+    memset(&sctp_status, 0, sizeof(struct sctp_status));
+    sctp_status.sstat_assoc_id = self->assoc_id;
+    opt_len = (socklen_t)sizeof(struct sctp_status);
+    if (usrsctp_getsockopt(self->sock, IPPROTO_SCTP, SCTP_STATUS, &sctp_status, &opt_len))
+        return FALSE;
+
+    status->srtt = sctp_status.sstat_primary.spinfo_srtt;
+    status->rto = sctp_status.sstat_primary.spinfo_rto;
+    status->cwnd = sctp_status.sstat_primary.spinfo_cwnd;
+    status->peer_rwnd = sctp_status.sstat_rwnd;
+    status->unacked_chunks = sctp_status.sstat_unackdata;
+    status->pending_chunks = sctp_status.sstat_penddata;
+
+    memset(&sockstat, 0, sizeof(struct sctp_sockstat));
+    sockstat.ss_assoc_id = self->assoc_id;
+    opt_len = (socklen_t)sizeof(struct sctp_sockstat);
+    if (usrsctp_getsockopt(self->sock, IPPROTO_SCTP, SCTP_GET_SNDBUF_USE, &sockstat, &opt_len))
+        return FALSE;
+
+    status->send_buffered = sockstat.ss_total_sndbuf;
+    status->receive_buffered = sockstat.ss_total_recv_buf;
+
+    return TRUE;
+}
+
+/* usrsctp only keeps retransmission counters for the whole stack */
+static void usrsctp_engine_get_counters(GstSctpEngine *engine, GstSctpEngineCounters *counters)
+{
+    struct sctpstat stack_stats;
+
+    memset(&stack_stats, 0, sizeof(struct sctpstat));
+    usrsctp_get_stat(&stack_stats);
+    counters->data_chunks_sent = stack_stats.sctps_senddata;
+    counters->data_chunks_retransmitted = stack_stats.sctps_sendretransdata;
+    counters->fast_retransmits = stack_stats.sctps_sendfastretrans;
+    counters->t3_timeouts = stack_stats.sctps_timoutdata;
+    counters->init_timeouts = stack_stats.sctps_timoinit;
+}
+
+static void usrsctp_engine_set_nodelay(GstSctpEngine *engine, gboolean nodelay)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    int value = nodelay;
+
+    if (!self->sock)
+        return;
+
+    if (usrsctp_setsockopt(self->sock, IPPROTO_SCTP, SCTP_NODELAY, &value, sizeof(int)))
+        g_warning("Could not set SCTP_NODELAY");
+}
+
+/* Before connecting, the receive buffer sizes the window announced in the INIT */
+static gboolean usrsctp_engine_set_buffer_sizes(GstSctpEngine *engine, guint send_size,
+    guint receive_size)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    int value;
+
+    if (!self->sock)
+        return FALSE;
+
+    value = (int) send_size;
+    if (usrsctp_setsockopt(self->sock, SOL_SOCKET, SO_SNDBUF, &value, sizeof(int))) {
+        g_warning("Could not set SO_SNDBUF: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    value = (int) receive_size;
+    if (usrsctp_setsockopt(self->sock, SOL_SOCKET, SO_RCVBUF, &value, sizeof(int))) {
+        g_warning("Could not set SO_RCVBUF: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean usrsctp_engine_set_heartbeat_interval(GstSctpEngine *engine, guint interval)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    struct sctp_paddrparams params;
+
+    if (!self->sock)
+        return FALSE;
+
+    /* A wildcard address applies the parameters to every path of the association */
+    memset(&params, 0, sizeof(params));
+    params.spp_assoc_id = self->assoc_id;
+    params.spp_hbinterval = interval;
+    params.spp_flags = interval ? SPP_HB_ENABLE : SPP_HB_DISABLE;
+    if (usrsctp_setsockopt(self->sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &params,
+        sizeof(params))) {
+        g_warning("Could not set SCTP_PEER_ADDR_PARAMS");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean usrsctp_engine_get_heartbeat_interval(GstSctpEngine *engine, guint *interval)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+    struct sctp_paddrparams params;
+    socklen_t length = sizeof(params);
+
+    if (!self->sock)
+        return FALSE;
+
+    memset(&params, 0, sizeof(params));
+    params.spp_assoc_id = self->assoc_id;
+    if (usrsctp_getsockopt(self->sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &params,
+        &length)) {
+        g_warning("Could not get SCTP_PEER_ADDR_PARAMS");
+        return FALSE;
+    }
+
+    *interval = (params.spp_flags & SPP_HB_DISABLE) ? 0 : params.spp_hbinterval;
+    return TRUE;
+}
+
+static void usrsctp_engine_apply_delayed_sack(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+
+    if (self->sock)
+        apply_delayed_sack(self, self->sock);
+}
+
+static void usrsctp_engine_apply_congestion_control(GstSctpEngine *engine)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) engine;
+
+    if (self->sock)
+        apply_congestion_control(self, self->sock);
+}
+
+/* Module options can only be set once the association exists */
+static void usrsctp_engine_apply_congestion_control_options(GstSctpEngine *engine)
+{
+    apply_congestion_control_options((GstSctpUsrsctpEngine *) engine, SCTP_CURRENT_ASSOC);
+}
+
+static int sctp_packet_out(void *addr, void *buffer, size_t length, guint8 tos, guint8 set_df)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) addr;
+
+    gst_sctp_association_engine_packet_out(self->parent.association, buffer, length, tos,
+        set_df != 0);
+
+    return 0;
+}
+
+static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
+    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info)
+{
+    GstSctpUsrsctpEngine *self = (GstSctpUsrsctpEngine *) ulp_info;
+
+    if (!data) {
+        /* Not sure if this can happend. */
+        g_warning("Received empty data buffer");
+    } else {
+        if (flags & MSG_NOTIFICATION) {
+            handle_notification(self, (const union sctp_notification *)data, datalen);
+            free(data);
+        } else {
+            GstSctpAssociationReceiveInfo info;
+
+            info.receive_time = g_get_monotonic_time();
+            info.stream_id = rcv_info.rcv_sid;
+            info.ssn = rcv_info.rcv_ssn;
+            info.tsn = rcv_info.rcv_tsn;
+            info.ppid = ntohl(rcv_info.rcv_ppid);
+            info.unordered = (rcv_info.rcv_flags & SCTP_UNORDERED) != 0;
+            /* Without MSG_EOR more of the message follows in the next callback */
+            info.last_fragment = (flags & MSG_EOR) != 0;
+            info.fragment = self->receiving_partial || !info.last_fragment;
+            self->receiving_partial = !info.last_fragment;
+
+            gst_sctp_association_engine_message(self->parent.association, data, datalen, &info);
+        }
+    }
+
+    return 1;
+}
+
+static void handle_notification(GstSctpUsrsctpEngine *self,
+    const union sctp_notification *notification, size_t length)
+{
+    GstSctpAssociation *association = self->parent.association;
+
+    g_assert(notification->sn_header.sn_length == length);
+
+    switch (notification->sn_header.sn_type) {
+    case SCTP_ASSOC_CHANGE:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ASSOC_CHANGE");
+        handle_association_changed(self, &notification->sn_assoc_change);
+        break;
+    case SCTP_PEER_ADDR_CHANGE:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_PEER_ADDR_CHANGE");
+        break;
+    case SCTP_REMOTE_ERROR:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_REMOTE_ERROR");
+        break;
+    case SCTP_SEND_FAILED:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SEND_FAILED");
+        gst_sctp_association_engine_send_failed(association,
+            notification->sn_send_failed.ssf_info.sinfo_stream,
+            g_ntohl(notification->sn_send_failed.ssf_info.sinfo_ppid),
+            notification->sn_send_failed.ssf_length - sizeof(struct sctp_send_failed),
+            notification->sn_send_failed.ssf_info.sinfo_context,
+            notification->sn_send_failed.ssf_flags & SCTP_DATA_SENT,
+            notification->sn_send_failed.ssf_error);
+        break;
+    case SCTP_SHUTDOWN_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SHUTDOWN_EVENT");
+        break;
+    case SCTP_ADAPTATION_INDICATION:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ADAPTATION_INDICATION");
+        break;
+    case SCTP_PARTIAL_DELIVERY_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_PARTIAL_DELIVERY_EVENT");
+        break;
+    case SCTP_AUTHENTICATION_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_AUTHENTICATION_EVENT");
+        break;
+    case SCTP_STREAM_RESET_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_STREAM_RESET_EVENT");
+        handle_stream_reset_event(self, &notification->sn_strreset_event);
+        break;
+    case SCTP_SENDER_DRY_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SENDER_DRY_EVENT");
+        break;
+    case SCTP_NOTIFICATIONS_STOPPED_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_NOTIFICATIONS_STOPPED_EVENT");
+        break;
+    case SCTP_ASSOC_RESET_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_ASSOC_RESET_EVENT");
+        break;
+    case SCTP_STREAM_CHANGE_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_STREAM_CHANGE_EVENT");
+        break;
+    case SCTP_SEND_FAILED_EVENT:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SEND_FAILED_EVENT");
+        gst_sctp_association_engine_send_failed(association,
+            notification->sn_send_failed_event.ssfe_info.snd_sid,
+            g_ntohl(notification->sn_send_failed_event.ssfe_info.snd_ppid),
+            notification->sn_send_failed_event.ssfe_length - sizeof(struct sctp_send_failed_event),
+            notification->sn_send_failed_event.ssfe_info.snd_context,
+            notification->sn_send_failed_event.ssfe_flags & SCTP_DATA_SENT,
+            notification->sn_send_failed_event.ssfe_error);
+        break;
+    default:
+        break;
+    }
+}
+
+static void handle_association_changed(GstSctpUsrsctpEngine *self,
+    const struct sctp_assoc_change *sac)
+{
+    switch (sac->sac_state) {
+    case SCTP_COMM_UP:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP_COMM_UP()");
+        self->assoc_id = sac->sac_assoc_id;
+        gst_sctp_association_engine_connected(self->parent.association);
+        break;
+    case SCTP_COMM_LOST:
+        g_warning("SCTP event SCTP_COMM_LOST received");
+        /* TODO: Tear down association and signal that this has happend*/
+        break;
+    case SCTP_RESTART:
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP event SCTP_RESTART received");
+        break;
+    case SCTP_SHUTDOWN_COMP:
+        g_warning("SCTP event SCTP_SHUTDOWN_COMP received");
+        /* TODO: Tear down association and signal that this has happend*/
+        break;
+    case SCTP_CANT_STR_ASSOC:
+        g_warning("SCTP event SCTP_CANT_STR_ASSOC received");
+        break;
+    }
+}
+
+static void handle_stream_reset_event(GstSctpUsrsctpEngine *self,
+    const struct sctp_stream_reset_event *sr)
+{
+    guint32 i, n;
+    if (!(sr->strreset_flags & SCTP_STREAM_RESET_DENIED) &&
+        !(sr->strreset_flags & SCTP_STREAM_RESET_FAILED )) {
+        n = (sr->strreset_length - sizeof(struct sctp_stream_reset_event)) / sizeof(uint16_t);
+        for (i = 0; i < n; i++) {
+            if (sr->strreset_flags & SCTP_STREAM_RESET_INCOMING_SSN) {
+                gst_sctp_association_engine_stream_reset(self->parent.association,
+                    sr->strreset_stream_list[i]);
+            }
+        }
+    }
+}
+
+static gboolean apply_delayed_sack(GstSctpUsrsctpEngine *self, struct socket *sock)
+{
+    GstSctpAssociation *association = self->parent.association;
+    struct sctp_sack_info sack_info;
+
+    memset(&sack_info, 0, sizeof(sack_info));
+    sack_info.sack_assoc_id = SCTP_ALL_ASSOC;
+    sack_info.sack_delay = association->sack_delay;
+    /* A delay of 0 means acknowledging every packet */
+    sack_info.sack_freq = association->sack_delay ? association->sack_frequency : 1;
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_DELAYED_SACK, &sack_info, sizeof(sack_info))) {
+        g_warning("Could not set SCTP_DELAYED_SACK");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Must be applied before connecting, the INIT timers are taken from the socket defaults */
+static gboolean apply_setup_profile(GstSctpUsrsctpEngine *self, struct socket *sock)
+{
+    GstSctpAssociation *association = self->parent.association;
+    struct sctp_rtoinfo rtoinfo;
+    struct sctp_initmsg initmsg;
+    struct sctp_assocparams assocparams;
+
+    if (association->setup_profile == GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST) {
+        memset(&rtoinfo, 0, sizeof(rtoinfo));
+        rtoinfo.srto_assoc_id = SCTP_FUTURE_ASSOC;
+        rtoinfo.srto_initial = FAST_SETUP_RTO_INITIAL;
+        rtoinfo.srto_min = FAST_SETUP_RTO_MIN;
+        rtoinfo.srto_max = FAST_SETUP_RTO_MAX;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_RTOINFO, &rtoinfo, sizeof(rtoinfo))) {
+            g_warning("Could not set SCTP_RTOINFO");
+            return FALSE;
+        }
+    }
+
+    if (association->setup_profile == GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST
+        || association->max_init_retransmits) {
+        /* Zero leaves the stream counts and the other timer as they are */
+        memset(&initmsg, 0, sizeof(initmsg));
+        if (association->setup_profile == GST_SCTP_ASSOCIATION_SETUP_PROFILE_FAST) {
+            initmsg.sinit_max_attempts = FAST_SETUP_MAX_INIT_ATTEMPTS;
+            initmsg.sinit_max_init_timeo = FAST_SETUP_MAX_INIT_TIMEOUT;
+        }
+        if (association->max_init_retransmits)
+            initmsg.sinit_max_attempts = association->max_init_retransmits + 1;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_INITMSG, &initmsg, sizeof(initmsg))) {
+            g_warning("Could not set SCTP_INITMSG");
+            return FALSE;
+        }
+    }
+
+    if (association->max_retransmits) {
+        memset(&assocparams, 0, sizeof(assocparams));
+        assocparams.sasoc_assoc_id = SCTP_FUTURE_ASSOC;
+        assocparams.sasoc_asocmaxrxt = association->max_retransmits;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_ASSOCINFO, &assocparams,
+            sizeof(assocparams))) {
+            g_warning("Could not set SCTP_ASSOCINFO");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static guint32 to_usrsctp_congestion_control(GstSctpAssociationCongestionControl congestion_control)
+{
+    switch (congestion_control) {
+    case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP:
+        return SCTP_CC_HSTCP;
+    case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP:
+        return SCTP_CC_HTCP;
+    case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC:
+        return SCTP_CC_RTCC;
+    case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC2581:
+    default:
+        return SCTP_CC_RFC2581;
+    }
+}
+
+static gboolean apply_congestion_control(GstSctpUsrsctpEngine *self, struct socket *sock)
+{
+    struct sctp_assoc_value cc;
+
+    memset(&cc, 0, sizeof(cc));
+    cc.assoc_id = SCTP_ALL_ASSOC;
+    cc.assoc_value = to_usrsctp_congestion_control(self->parent.association->congestion_control);
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_PLUGGABLE_CC, &cc, sizeof(cc))) {
+        g_warning("Could not set SCTP_PLUGGABLE_CC");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void set_congestion_control_option(GstSctpUsrsctpEngine *self, sctp_assoc_t assoc_id,
+    int option, guint32 value)
+{
+    struct sctp_cc_option cc_option;
+
+    memset(&cc_option, 0, sizeof(cc_option));
+    cc_option.option = option;
+    cc_option.aid_value.assoc_id = assoc_id;
+    cc_option.aid_value.assoc_value = value;
+    if (usrsctp_setsockopt(self->sock, IPPROTO_SCTP, SCTP_CC_OPTION, &cc_option,
+        sizeof(cc_option)))
+        g_warning("Could not set SCTP_CC_OPTION %d", option);
+}
+
+static void apply_congestion_control_options(GstSctpUsrsctpEngine *self, sctp_assoc_t assoc_id)
+{
+    GstSctpAssociation *association = self->parent.association;
+
+    /* Only the rtcc module has tunables */
+    if (!self->sock
+        || association->congestion_control != GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC)
+        return;
+
+    set_congestion_control_option(self, assoc_id, SCTP_CC_OPT_STEADY_STEP,
+        association->rtcc_steady_step);
+    set_congestion_control_option(self, assoc_id, SCTP_CC_OPT_USE_DCCC_ECN,
+        association->rtcc_use_ecn);
+}
+
+const GstSctpEngineFuncs gst_sctp_usrsctp_engine_funcs = {
+    "usrsctp",
+#ifdef HAVE_USRSCTP_CRC32C_OFFLOAD
+    TRUE,
+#else
+    FALSE,
+#endif
+    usrsctp_engine_create,
+    usrsctp_engine_free,
+    usrsctp_engine_open,
+    usrsctp_engine_connect,
+    usrsctp_engine_close,
+    usrsctp_engine_incoming_packet,
+    usrsctp_engine_send,
+    usrsctp_engine_reset_stream,
+    usrsctp_engine_get_status,
+    usrsctp_engine_get_counters,
+    usrsctp_engine_set_nodelay,
+    usrsctp_engine_set_buffer_sizes,
+    usrsctp_engine_get_heartbeat_interval,
+    usrsctp_engine_set_heartbeat_interval,
+    usrsctp_engine_apply_delayed_sack,
+    usrsctp_engine_apply_congestion_control,
+    usrsctp_engine_apply_congestion_control_options
+};
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_PACKET_META_H__
+#define __GST_SCTP_PACKET_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_SCTP_PACKET_META_API_TYPE (gst_sctp_packet_meta_api_get_type())
+#define GST_SCTP_PACKET_META_INFO (gst_sctp_packet_meta_get_info())
+typedef struct _GstSctpPacketMeta GstSctpPacketMeta;
+
+/* ECN codepoints, the two low bits of the IP tos / traffic class byte (RFC 3168) */
+typedef enum {
+    GST_SCTP_PACKET_ECN_NOT_ECT = 0x00,
+    GST_SCTP_PACKET_ECN_ECT1 = 0x01,
+    GST_SCTP_PACKET_ECN_ECT0 = 0x02,
+    GST_SCTP_PACKET_ECN_CE = 0x03
+} GstSctpPacketEcn;
+
+/*
+ * Network level information for an SCTP packet. sctpenc attaches it to every outgoing packet
+ * with the values chosen by the SCTP stack, and sctpdec passes the ECN bits of incoming
+ * packets carrying it on to the stack.
+ */
+struct _GstSctpPacketMeta {
+  GstMeta meta;
+
+  guint8 tos;
+  gboolean dont_fragment;
+};
+
+#define GST_SCTP_PACKET_META_DSCP(meta) ((meta)->tos >> 2)
+#define GST_SCTP_PACKET_META_ECN(meta) ((GstSctpPacketEcn)((meta)->tos & 0x03))
+
+GType gst_sctp_packet_meta_api_get_type(void);
+const GstMetaInfo * gst_sctp_packet_meta_get_info(void);
+GstSctpPacketMeta * gst_sctp_buffer_add_packet_meta(GstBuffer *buffer, guint8 tos,
+    gboolean dont_fragment);
+
+#define gst_sctp_buffer_get_packet_meta(b) ((GstSctpPacketMeta *)gst_buffer_get_meta((b), GST_SCTP_PACKET_META_API_TYPE))
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_PACKET_META_H__ */
@@ -60,6 +60,14 @@ static gboolean gst_sctp_receive_meta_init(GstMeta *meta, gpointer params, GstBu
 {
     GstSctpReceiveMeta *gst_sctp_receive_meta = (GstSctpReceiveMeta *)meta;
     gst_sctp_receive_meta->ppid = 0;
+    gst_sctp_receive_meta->stream_id = 0;
+    gst_sctp_receive_meta->ssn = 0;
+    gst_sctp_receive_meta->tsn = 0;
+    gst_sctp_receive_meta->unordered = FALSE;
+    gst_sctp_receive_meta->receive_time = GST_CLOCK_TIME_NONE;
+    gst_sctp_receive_meta->fragment = FALSE;
+    gst_sctp_receive_meta->last_fragment = TRUE;
+    gst_sctp_receive_meta->association_id = 0;
     return TRUE;
 }
 
@@ -67,7 +75,17 @@ static gboolean gst_sctp_receive_meta_transform(GstBuffer *transbuf, GstMeta *me
     GQuark type, gpointer data)
 {
     GstSctpReceiveMeta *gst_sctp_receive_meta = (GstSctpReceiveMeta *)meta;
-    gst_sctp_buffer_add_receive_meta(transbuf, gst_sctp_receive_meta->ppid);
+    GstSctpReceiveMeta *trans_meta;
+
+    trans_meta = gst_sctp_buffer_add_receive_meta(transbuf, gst_sctp_receive_meta->ppid);
+    trans_meta->stream_id = gst_sctp_receive_meta->stream_id;
+    trans_meta->ssn = gst_sctp_receive_meta->ssn;
+    trans_meta->tsn = gst_sctp_receive_meta->tsn;
+    trans_meta->unordered = gst_sctp_receive_meta->unordered;
+    trans_meta->receive_time = gst_sctp_receive_meta->receive_time;
+    trans_meta->fragment = gst_sctp_receive_meta->fragment;
+    trans_meta->last_fragment = gst_sctp_receive_meta->last_fragment;
+    trans_meta->association_id = gst_sctp_receive_meta->association_id;
     return TRUE;
 }
 
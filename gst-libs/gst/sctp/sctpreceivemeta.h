@@ -38,13 +38,24 @@ struct _GstSctpReceiveMeta {
   GstMeta meta;
 
   guint32 ppid;
+  guint16 stream_id;
+  guint16 ssn;
+  guint32 tsn;
+  gboolean unordered;
+  /* When the SCTP stack handed over the message, comparable with gst_util_get_timestamp() */
+  GstClockTime receive_time;
+  /* Set on every part of a message that was delivered in pieces, last_fragment on the last */
+  gboolean fragment;
+  gboolean last_fragment;
+  /* The sctp-association-id of the element, or the association the message arrived on in sctpmux */
+  guint32 association_id;
 };
 
 GType gst_sctp_receive_meta_api_get_type(void);
 const GstMetaInfo * gst_sctp_receive_meta_get_info(void);
 GstSctpReceiveMeta * gst_sctp_buffer_add_receive_meta(GstBuffer *buffer, guint32 ppid);
 
-#define gst_sctp_buffer_get_receive_meta(b) ((GstSctpReceiveMeta *)gst_buffer_get_meta((b), GST_SCTP_RECEIVE_META_TYPE))
+#define gst_sctp_buffer_get_receive_meta(b) ((GstSctpReceiveMeta *)gst_buffer_get_meta((b), GST_SCTP_RECEIVE_META_API_TYPE))
 
 G_END_DECLS
 
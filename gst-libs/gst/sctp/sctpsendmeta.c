@@ -63,6 +63,10 @@ static gboolean gst_sctp_send_meta_init(GstMeta *meta, gpointer params, GstBuffe
     gst_sctp_send_meta->ordered = TRUE;
     gst_sctp_send_meta->pr = GST_SCTP_SEND_META_PARTIAL_RELIABILITY_NONE;
     gst_sctp_send_meta->pr_param = 0;
+    gst_sctp_send_meta->flags = GST_SCTP_SEND_META_FLAG_NONE;
+    gst_sctp_send_meta->priority = GST_SCTP_SEND_META_PRIORITY_LOW;
+    gst_sctp_send_meta->deadline = GST_CLOCK_TIME_NONE;
+    gst_sctp_send_meta->context = 0;
     return TRUE;
 }
 
@@ -70,8 +74,14 @@ static gboolean gst_sctp_send_meta_transform(GstBuffer *transbuf, GstMeta *meta,
     GQuark type, gpointer data)
 {
     GstSctpSendMeta *gst_sctp_send_meta = (GstSctpSendMeta *)meta;
-    gst_sctp_buffer_add_send_meta(transbuf, gst_sctp_send_meta->ppid, gst_sctp_send_meta->ordered, gst_sctp_send_meta->pr,
-        gst_sctp_send_meta->pr_param);
+    GstSctpSendMeta *trans_meta;
+
+    trans_meta = gst_sctp_buffer_add_send_meta(transbuf, gst_sctp_send_meta->ppid, gst_sctp_send_meta->ordered,
+        gst_sctp_send_meta->pr, gst_sctp_send_meta->pr_param);
+    trans_meta->flags = gst_sctp_send_meta->flags;
+    trans_meta->priority = gst_sctp_send_meta->priority;
+    trans_meta->deadline = gst_sctp_send_meta->deadline;
+    trans_meta->context = gst_sctp_send_meta->context;
     return TRUE;
 }
 
@@ -38,6 +38,22 @@ typedef enum {
 
 } GstSctpSendMetaPartiallyReliability;
 
+typedef enum {
+    GST_SCTP_SEND_META_FLAG_NONE = 0,
+    /* Send at once, never hold the message back for bundling with others */
+    GST_SCTP_SEND_META_FLAG_URGENT = (1 << 0),
+    /* Ask the receiver to acknowledge at once, e.g. for the last message of a burst */
+    GST_SCTP_SEND_META_FLAG_SACK_IMMEDIATELY = (1 << 1)
+} GstSctpSendMetaFlags;
+
+/* Same classes as the WebRTC data channel priority */
+typedef enum {
+    GST_SCTP_SEND_META_PRIORITY_VERY_LOW,
+    GST_SCTP_SEND_META_PRIORITY_LOW,
+    GST_SCTP_SEND_META_PRIORITY_MEDIUM,
+    GST_SCTP_SEND_META_PRIORITY_HIGH
+} GstSctpSendMetaPriority;
+
 #define GST_SCTP_SEND_META_API_TYPE (gst_sctp_send_meta_api_get_type())
 #define GST_SCTP_SEND_META_INFO (gst_sctp_send_meta_get_info())
 typedef struct _GstSctpSendMeta GstSctpSendMeta;
@@ -49,6 +65,12 @@ struct _GstSctpSendMeta {
   gboolean ordered;
   GstSctpSendMetaPartiallyReliability pr;
   guint32 pr_param;
+  GstSctpSendMetaFlags flags;
+  GstSctpSendMetaPriority priority;
+  /* Running time after which the message is worthless, GST_CLOCK_TIME_NONE for none */
+  GstClockTime deadline;
+  /* Opaque to SCTP, handed back if the message is abandoned or cannot be sent */
+  guint32 context;
 };
 
 GType gst_sctp_send_meta_api_get_type(void);
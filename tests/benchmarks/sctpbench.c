@@ -0,0 +1,965 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * Loopback benchmark for sctpenc and sctpdec.
+ *
+ * Two associations are wired back to back in one process:
+ *
+ *   appsrc ! sctpenc (a) ! sctpimpair ! sctpdec (b) ! appsink
+ *   appsrc ! sctpenc (b) ! sctpimpair ! sctpdec (a) ! appsink
+ *
+ * with one appsrc and appsink per stream. sctpimpair emulates the network path, by default a
+ * perfect one. Every message carries its send time, so the receiving side can measure the one-way
+ * latency. The run is repeated for every combination of the message sizes, stream counts,
+ * orderings, partial reliability policies, congestion control modules, MTUs, checksum modes,
+ * engines and numbers of association pairs given on the command line. Pairs run side by side in
+ * the same pipeline, which shows how an engine scales over the cores. An engine given as a:b runs
+ * association a on engine a and association b on engine b, to test them against each other.
+ *
+ * With --check a run fails when the associations do not come up, a reliable run loses messages,
+ * lost packets are never retransmitted or the peer of a closed association does not notice.
+ */
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+#include <gst/sctp/sctpsendmeta.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define LOCAL_PORT_A 5000
+#define LOCAL_PORT_B 5001
+#define BINARY_PPID 53
+/* Send timestamp and sequence number */
+#define MESSAGE_HEADER_SIZE 12
+/* Long enough for a few lost INITs with the default 3 s initial RTO */
+#define CONNECT_TIMEOUT (30 * G_TIME_SPAN_SECOND)
+#define DRAIN_TIMEOUT (2 * G_TIME_SPAN_SECOND)
+/* The ABORT or SHUTDOWN goes out right away, this only covers a slow machine */
+#define SHUTDOWN_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+#define APPSRC_MAX_BYTES (1024 * 1024)
+
+typedef enum {
+    OUTPUT_FORMAT_TEXT,
+    OUTPUT_FORMAT_JSON,
+    OUTPUT_FORMAT_CSV
+} OutputFormat;
+
+typedef struct {
+    guint message_size;
+    guint streams;
+    gboolean ordered;
+    GstSctpSendMetaPartiallyReliability pr;
+    const gchar *congestion_control;
+    guint mtu;
+    const gchar *checksum;
+    const gchar *engine;
+    guint pairs;
+} BenchConfig;
+
+typedef struct {
+    BenchConfig config;
+    guint64 messages_sent;
+    guint64 messages_received;
+    guint64 bytes_received;
+    guint64 wire_bytes;
+    guint64 packets;
+    guint64 packets_dropped;
+    guint64 data_chunks_sent;
+    guint64 data_chunks_retransmitted;
+    gdouble seconds;
+    guint64 time_to_connected;
+    gint64 p50, p99, p999;
+    gdouble cpu_ns_per_message;
+    gdouble cpu_ns_per_packet;
+    glong peak_rss_kb;
+} BenchResult;
+
+typedef struct _BenchRun BenchRun;
+
+typedef struct {
+    BenchRun *run;
+    const gchar *engine;
+    GstElement *enc;
+    GstElement *impair;
+    GstElement *dec;
+    GPtrArray *sources;
+} BenchPeer;
+
+struct _BenchRun {
+    BenchConfig config;
+    GstElement *pipeline;
+    /* Two per pair, each sending to the other one of its pair */
+    BenchPeer *peers;
+    guint n_peers;
+    /* One engine for all associations, or one for a and one for b */
+    gchar **engines;
+
+    GMutex lock;
+    GCond cond;
+    guint established;
+    guint disconnected;
+    guint64 messages_sent;
+    guint64 messages_received;
+    guint64 bytes_received;
+    gint64 last_receive;
+    GArray *latencies;
+};
+
+static guint messages = 10000;
+static guint pr_param = 100;
+static gboolean bidirectional = FALSE;
+static gboolean check = FALSE;
+static gchar *sizes_option = NULL;
+static gchar *streams_option = NULL;
+static gchar *ordering_option = NULL;
+static gchar *pr_option = NULL;
+static gchar *cc_option = NULL;
+static gchar *setup_profile_option = NULL;
+static gchar *format_option = NULL;
+static gchar *output_option = NULL;
+static gchar *plugin_path = NULL;
+static gchar *mtu_option = NULL;
+static gchar *checksum_option = NULL;
+static gchar *engine_option = NULL;
+static gchar *pairs_option = NULL;
+static gdouble loss_good = 0.0;
+static gdouble loss_bad = 1.0;
+static gdouble good_to_bad = 0.0;
+static gdouble bad_to_good = 1.0;
+static guint delay = 0;
+static guint jitter = 0;
+static gint64 rate = 0;
+static gdouble reorder = 0.0;
+static gdouble duplicate = 0.0;
+static guint seed = 0;
+static guint next_association_id = 1;
+
+static GOptionEntry entries[] = {
+    {"messages", 'n', 0, G_OPTION_ARG_INT, &messages, "Messages sent per stream (default 10000)",
+        "N"},
+    {"sizes", 's', 0, G_OPTION_ARG_STRING, &sizes_option,
+        "Comma separated message sizes in bytes (default 64,1024,16384)", "LIST"},
+    {"streams", 0, 0, G_OPTION_ARG_STRING, &streams_option,
+        "Comma separated stream counts (default 1,4,16)", "LIST"},
+    {"ordering", 0, 0, G_OPTION_ARG_STRING, &ordering_option,
+        "Comma separated list of ordered, unordered (default both)", "LIST"},
+    {"pr", 0, 0, G_OPTION_ARG_STRING, &pr_option,
+        "Comma separated partial reliability policies: none, ttl, rtx, buf (default all)", "LIST"},
+    {"pr-param", 0, 0, G_OPTION_ARG_INT, &pr_param,
+        "Partial reliability parameter: ttl in ms, retransmissions or bytes (default 100)", "N"},
+    {"congestion-control", 0, 0, G_OPTION_ARG_STRING, &cc_option,
+        "Comma separated congestion control modules (default rfc2581)", "LIST"},
+    {"setup-profile", 0, 0, G_OPTION_ARG_STRING, &setup_profile_option,
+        "Association setup profile: default or fast (default: default)", "PROFILE"},
+    {"mtu", 0, 0, G_OPTION_ARG_STRING, &mtu_option,
+        "Comma separated path MTUs in bytes (default 1200)", "LIST"},
+    {"checksum", 0, 0, G_OPTION_ARG_STRING, &checksum_option,
+        "Comma separated CRC32c modes: software, accelerated, none (default accelerated)", "LIST"},
+    {"engine", 0, 0, G_OPTION_ARG_STRING, &engine_option,
+        "Comma separated SCTP engines: usrsctp, lite, or a:b for different engines on the two "
+        "associations of a pair (default usrsctp, with --check lite,usrsctp:lite,lite:usrsctp)",
+        "LIST"},
+    {"pairs", 0, 0, G_OPTION_ARG_STRING, &pairs_option,
+        "Comma separated numbers of association pairs running at the same time (default 1)",
+        "LIST"},
+    {"loss", 0, 0, G_OPTION_ARG_DOUBLE, &loss_good,
+        "Packet loss probability in the good state of the loss model (default 0)", "P"},
+    {"loss-bad", 0, 0, G_OPTION_ARG_DOUBLE, &loss_bad,
+        "Packet loss probability in the bad state of the loss model (default 1)", "P"},
+    {"good-to-bad", 0, 0, G_OPTION_ARG_DOUBLE, &good_to_bad,
+        "Probability per packet of entering the bad state, 0 disables bursts (default 0)", "P"},
+    {"bad-to-good", 0, 0, G_OPTION_ARG_DOUBLE, &bad_to_good,
+        "Probability per packet of leaving the bad state (default 1)", "P"},
+    {"delay", 0, 0, G_OPTION_ARG_INT, &delay, "One-way delay in ms (default 0)", "MS"},
+    {"jitter", 0, 0, G_OPTION_ARG_INT, &jitter, "Delay variation in ms (default 0)", "MS"},
+    {"rate", 0, 0, G_OPTION_ARG_INT64, &rate,
+        "Path bandwidth in bits per second, 0 is unlimited (default 0)", "BPS"},
+    {"reorder", 0, 0, G_OPTION_ARG_DOUBLE, &reorder,
+        "Probability that a packet overtakes the ones before it (default 0)", "P"},
+    {"duplicate", 0, 0, G_OPTION_ARG_DOUBLE, &duplicate,
+        "Probability that a packet is delivered twice (default 0)", "P"},
+    {"seed", 0, 0, G_OPTION_ARG_INT, &seed, "Seed of the path impairments (default 0)", "N"},
+    {"bidirectional", 'b', 0, G_OPTION_ARG_NONE, &bidirectional,
+        "Send in both directions at the same time", NULL},
+    {"check", 'c', 0, G_OPTION_ARG_NONE, &check,
+        "Fail on a lost message of a reliable run, lost packets that are never retransmitted or "
+        "a closed association its peer does not notice", NULL},
+    {"format", 'f', 0, G_OPTION_ARG_STRING, &format_option, "Output format: text, json or csv",
+        "FORMAT"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_option, "Write the results to FILE",
+        "FILE"},
+    {"plugin-path", 0, 0, G_OPTION_ARG_FILENAME, &plugin_path,
+        "Directory to load the sctp plugin from", "DIR"},
+    {NULL}
+};
+
+static const gchar *pr_names[] = {"none", "ttl", "buf", "rtx"};
+
+static GArray *parse_uint_list(const gchar *option, const gchar *fallback)
+{
+    GArray *values = g_array_new(FALSE, FALSE, sizeof(guint));
+    gchar **tokens = g_strsplit(option ? option : fallback, ",", -1);
+    guint i;
+
+    for (i = 0; tokens[i]; i++) {
+        guint value = (guint) g_ascii_strtoull(tokens[i], NULL, 10);
+        if (value > 0)
+            g_array_append_val(values, value);
+    }
+    g_strfreev(tokens);
+
+    return values;
+}
+
+static gboolean parse_pr(const gchar *name, GstSctpSendMetaPartiallyReliability *pr)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(pr_names); i++) {
+        if (!g_strcmp0(name, pr_names[i])) {
+            *pr = (GstSctpSendMetaPartiallyReliability) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void on_association_established(GstElement *enc, gboolean established, BenchRun *run)
+{
+    g_mutex_lock(&run->lock);
+    if (established)
+        run->established++;
+    else
+        run->disconnected++;
+    g_cond_broadcast(&run->cond);
+    g_mutex_unlock(&run->lock);
+}
+
+static GstFlowReturn on_new_sample(GstAppSink *appsink, BenchRun *run)
+{
+    GstSample *sample;
+    GstBuffer *buffer;
+    GstMapInfo map;
+    GstClockTime now;
+    gint64 latency;
+
+    sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_EOS;
+
+    now = gst_util_get_timestamp();
+    buffer = gst_sample_get_buffer(sample);
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        if (map.size >= MESSAGE_HEADER_SIZE) {
+            latency = (gint64) (now - GST_READ_UINT64_LE(map.data));
+
+            g_mutex_lock(&run->lock);
+            g_array_append_val(run->latencies, latency);
+            run->messages_received++;
+            run->bytes_received += map.size;
+            run->last_receive = g_get_monotonic_time();
+            g_cond_broadcast(&run->cond);
+            g_mutex_unlock(&run->lock);
+        }
+        gst_buffer_unmap(buffer, &map);
+    }
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+static void on_pad_added(GstElement *dec, GstPad *pad, BenchPeer *peer)
+{
+    GstAppSinkCallbacks callbacks = {NULL, NULL, (GstFlowReturn (*)(GstAppSink *, gpointer)) on_new_sample};
+    GstElement *appsink;
+    GstPad *sinkpad;
+
+    appsink = gst_element_factory_make("appsink", NULL);
+    g_object_set(appsink, "sync", FALSE, "async", FALSE, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, peer->run, NULL);
+
+    gst_bin_add(GST_BIN(peer->run->pipeline), appsink);
+    sinkpad = gst_element_get_static_pad(appsink, "sink");
+    if (gst_pad_link(pad, sinkpad) != GST_PAD_LINK_OK)
+        g_printerr("Could not link %s to an appsink\n", GST_PAD_NAME(pad));
+    gst_object_unref(sinkpad);
+    gst_element_sync_state_with_parent(appsink);
+}
+
+static gboolean add_sources(BenchPeer *peer)
+{
+    guint i;
+
+    for (i = 0; i < peer->run->config.streams; i++) {
+        GstElement *appsrc;
+        GstPad *srcpad, *sinkpad;
+        gchar *pad_name;
+
+        appsrc = gst_element_factory_make("appsrc", NULL);
+        g_object_set(appsrc, "block", TRUE, "max-bytes", (guint64) APPSRC_MAX_BYTES,
+            "format", GST_FORMAT_BYTES, NULL);
+        gst_bin_add(GST_BIN(peer->run->pipeline), appsrc);
+
+        pad_name = g_strdup_printf("sink_%u", i);
+        sinkpad = gst_element_get_request_pad(peer->enc, pad_name);
+        g_free(pad_name);
+        if (!sinkpad) {
+            g_printerr("Could not request a sink pad for stream %u\n", i);
+            return FALSE;
+        }
+
+        srcpad = gst_element_get_static_pad(appsrc, "src");
+        gst_pad_link(srcpad, sinkpad);
+        gst_object_unref(srcpad);
+        gst_object_unref(sinkpad);
+
+        gst_element_sync_state_with_parent(appsrc);
+        g_ptr_array_add(peer->sources, appsrc);
+    }
+
+    return TRUE;
+}
+
+static gboolean build_pipeline(BenchRun *run)
+{
+    guint local_ports[2] = {LOCAL_PORT_A, LOCAL_PORT_B};
+    guint i;
+
+    run->pipeline = gst_pipeline_new("sctpbench");
+
+    for (i = 0; i < run->n_peers; i++) {
+        BenchPeer *peer = &run->peers[i];
+        guint association_id = next_association_id++;
+
+        peer->run = run;
+        peer->engine = run->engines[run->engines[1] ? i % 2 : 0];
+        peer->sources = g_ptr_array_new();
+        peer->enc = gst_element_factory_make("sctpenc", NULL);
+        peer->impair = gst_element_factory_make("sctpimpair", NULL);
+        peer->dec = gst_element_factory_make("sctpdec", NULL);
+        if (!peer->enc || !peer->impair || !peer->dec) {
+            g_printerr("Could not create the sctp elements, is the sctp plugin in the registry?\n");
+            return FALSE;
+        }
+
+        gst_util_set_object_arg(G_OBJECT(peer->enc), "congestion-control",
+            run->config.congestion_control);
+        gst_util_set_object_arg(G_OBJECT(peer->enc), "setup-profile",
+            setup_profile_option ? setup_profile_option : "default");
+        gst_util_set_object_arg(G_OBJECT(peer->enc), "checksum", run->config.checksum);
+        gst_util_set_object_arg(G_OBJECT(peer->enc), "engine", peer->engine);
+        g_object_set(peer->enc, "sctp-association-id", association_id,
+            "remote-sctp-port", local_ports[1 - i % 2], "mtu", run->config.mtu, NULL);
+        /* Different seeds so both directions do not lose the same packets */
+        g_object_set(peer->impair, "seed", seed + i, "loss-good", loss_good, "loss-bad", loss_bad,
+            "good-to-bad", good_to_bad, "bad-to-good", bad_to_good, "delay", delay,
+            "jitter", jitter, "rate", (guint64) rate, "reorder", reorder, "duplicate", duplicate,
+            NULL);
+        g_object_set(peer->dec, "sctp-association-id", association_id,
+            "local-sctp-port", local_ports[i % 2], NULL);
+
+        g_signal_connect(peer->enc, "sctp-association-established",
+            G_CALLBACK(on_association_established), run);
+        g_signal_connect(peer->dec, "pad-added", G_CALLBACK(on_pad_added), peer);
+
+        gst_bin_add_many(GST_BIN(run->pipeline), peer->enc, peer->impair, peer->dec, NULL);
+    }
+
+    /* Each encoder feeds the decoder of the other association of its pair */
+    for (i = 0; i < run->n_peers; i++) {
+        BenchPeer *peer = &run->peers[i], *other = &run->peers[i ^ 1];
+
+        if (!gst_element_link_many(peer->enc, peer->impair, other->dec, NULL)) {
+            g_printerr("Could not link the associations\n");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean check_bus(BenchRun *run)
+{
+    GstMessage *message;
+    gboolean ok = TRUE;
+
+    while ((message = gst_bus_pop_filtered(GST_ELEMENT_BUS(run->pipeline), GST_MESSAGE_ERROR))) {
+        GError *error = NULL;
+
+        gst_message_parse_error(message, &error, NULL);
+        g_printerr("Error from %s: %s\n", GST_OBJECT_NAME(GST_MESSAGE_SRC(message)),
+            error->message);
+        g_error_free(error);
+        gst_message_unref(message);
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+static gboolean wait_until_established(BenchRun *run)
+{
+    gint64 deadline = g_get_monotonic_time() + CONNECT_TIMEOUT;
+    gboolean established;
+
+    g_mutex_lock(&run->lock);
+    while (run->established < run->n_peers && g_get_monotonic_time() < deadline) {
+        g_mutex_unlock(&run->lock);
+        if (!check_bus(run))
+            return FALSE;
+        g_mutex_lock(&run->lock);
+        g_cond_wait_until(&run->cond, &run->lock,
+            MIN(deadline, g_get_monotonic_time() + 100 * G_TIME_SPAN_MILLISECOND));
+    }
+    established = run->established == run->n_peers;
+    g_mutex_unlock(&run->lock);
+
+    if (!established)
+        g_printerr("Timed out waiting for the associations to connect\n");
+    return established;
+}
+
+static void send_messages(BenchRun *run)
+{
+    guint32 sequence, p, i;
+
+    for (sequence = 0; sequence < messages; sequence++) {
+        for (p = 0; p < run->n_peers; p++) {
+            BenchPeer *peer = &run->peers[p];
+
+            for (i = 0; i < peer->sources->len; i++) {
+                GstBuffer *buffer;
+                GstMapInfo map;
+
+                buffer = gst_buffer_new_allocate(NULL, run->config.message_size, NULL);
+                gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+                memset(map.data, 0, map.size);
+                GST_WRITE_UINT32_LE(map.data + 8, sequence);
+                /* Stamped last so allocation is not counted as latency */
+                GST_WRITE_UINT64_LE(map.data, gst_util_get_timestamp());
+                gst_buffer_unmap(buffer, &map);
+
+                gst_sctp_buffer_add_send_meta(buffer, BINARY_PPID, run->config.ordered,
+                    run->config.pr, pr_param);
+
+                if (gst_app_src_push_buffer(GST_APP_SRC(g_ptr_array_index(peer->sources, i)),
+                    buffer) != GST_FLOW_OK)
+                    return;
+
+                g_mutex_lock(&run->lock);
+                run->messages_sent++;
+                g_mutex_unlock(&run->lock);
+            }
+        }
+    }
+}
+
+static void wait_until_drained(BenchRun *run)
+{
+    g_mutex_lock(&run->lock);
+    run->last_receive = g_get_monotonic_time();
+    /* With partial reliability messages may be abandoned, so stop once nothing arrives anymore */
+    while (run->messages_received < run->messages_sent
+        && g_get_monotonic_time() < run->last_receive + DRAIN_TIMEOUT) {
+        g_cond_wait_until(&run->cond, &run->lock, run->last_receive + DRAIN_TIMEOUT);
+    }
+    g_mutex_unlock(&run->lock);
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+    gint64 la = *(const gint64 *) a, lb = *(const gint64 *) b;
+    return la < lb ? -1 : la > lb;
+}
+
+static gint64 percentile(GArray *sorted, gdouble fraction)
+{
+    guint index;
+
+    if (sorted->len == 0)
+        return 0;
+    index = MIN((guint) (fraction * sorted->len), sorted->len - 1);
+    return g_array_index(sorted, gint64, index);
+}
+
+static gint64 timeval_to_ns(const struct timeval *tv)
+{
+    return (gint64) tv->tv_sec * GST_SECOND + (gint64) tv->tv_usec * GST_USECOND;
+}
+
+static guint64 get_uint64_stat(GstElement *element, const gchar *field)
+{
+    GstStructure *stats = NULL;
+    guint64 value = 0;
+
+    g_object_get(element, "stats", &stats, NULL);
+    if (stats) {
+        gst_structure_get_uint64(stats, field, &value);
+        gst_structure_free(stats);
+    }
+    return value;
+}
+
+/* The usrsctp engine counts for all associations in the process, the lite one for each */
+static guint64 get_stack_stat(BenchRun *run, const gchar *field)
+{
+    gboolean usrsctp_counted = FALSE;
+    guint64 value = 0;
+    guint i;
+
+    for (i = 0; i < run->n_peers; i++) {
+        if (!g_strcmp0(run->peers[i].engine, "lite")) {
+            value += get_uint64_stat(run->peers[i].enc, field);
+        } else if (!usrsctp_counted) {
+            value += get_uint64_stat(run->peers[i].enc, field);
+            usrsctp_counted = TRUE;
+        }
+    }
+    return value;
+}
+
+static gboolean check_result(BenchRun *run, const BenchResult *result)
+{
+    guint64 dropped = 0;
+    gboolean ok = TRUE;
+    guint i;
+
+    if (result->config.pr != GST_SCTP_SEND_META_PARTIAL_RELIABILITY_NONE)
+        return TRUE;
+
+    if (result->messages_received != result->messages_sent) {
+        g_printerr("Check failed: %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+            " messages arrived\n", result->messages_received, result->messages_sent);
+        ok = FALSE;
+    }
+
+    /* Only the packets of the sending side carry data, the others are mostly SACKs that a later
+     * one makes up for */
+    for (i = 0; i < run->n_peers; i++) {
+        if (run->peers[i].sources->len) {
+            dropped += get_uint64_stat(run->peers[i].impair, "dropped-loss")
+                + get_uint64_stat(run->peers[i].impair, "dropped-queue");
+        }
+    }
+    if (dropped && !result->data_chunks_retransmitted) {
+        g_printerr("Check failed: %" G_GUINT64_FORMAT " data packets lost and nothing "
+            "retransmitted\n", dropped);
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+/* Closes one association of every pair and waits for the other one to report it. Only the lite
+ * engine reports an association the peer ended, so its side is the one that stays open. */
+static gboolean check_shutdown(BenchRun *run)
+{
+    gint64 deadline = g_get_monotonic_time() + SHUTDOWN_TIMEOUT;
+    guint expected = 0, i;
+    gboolean ok;
+
+    for (i = 0; i < run->n_peers; i += 2) {
+        BenchPeer *closing;
+
+        if (!g_strcmp0(run->peers[i + 1].engine, "lite"))
+            closing = &run->peers[i];
+        else if (!g_strcmp0(run->peers[i].engine, "lite"))
+            closing = &run->peers[i + 1];
+        else
+            continue;
+
+        /* The peer would otherwise be left to its heartbeats */
+        g_object_set(closing->impair, "loss-good", 0.0, "loss-bad", 0.0, NULL);
+        if (gst_element_set_state(closing->enc, GST_STATE_NULL) == GST_STATE_CHANGE_FAILURE) {
+            g_printerr("Check failed: could not close an association\n");
+            return FALSE;
+        }
+        expected++;
+    }
+
+    g_mutex_lock(&run->lock);
+    while (run->disconnected < expected && g_get_monotonic_time() < deadline)
+        g_cond_wait_until(&run->cond, &run->lock, deadline);
+    ok = run->disconnected >= expected;
+    g_mutex_unlock(&run->lock);
+
+    if (!ok) {
+        g_printerr("Check failed: %u of %u closed associations noticed by the peer\n",
+            run->disconnected, expected);
+    }
+    return ok;
+}
+
+static gboolean run_benchmark(const BenchConfig *config, BenchResult *result)
+{
+    BenchRun run;
+    struct rusage usage_start, usage_end;
+    gint64 start, cpu_ns;
+    guint64 chunks_sent, chunks_retransmitted, *packets_sent;
+    gboolean ok = FALSE;
+    guint i;
+
+    memset(&run, 0, sizeof(run));
+    run.config = *config;
+    run.n_peers = 2 * config->pairs;
+    run.peers = g_new0(BenchPeer, run.n_peers);
+    run.engines = g_strsplit(config->engine, ":", -1);
+    packets_sent = g_new0(guint64, run.n_peers);
+    g_mutex_init(&run.lock);
+    g_cond_init(&run.cond);
+    run.latencies = g_array_sized_new(FALSE, FALSE, sizeof(gint64),
+        messages * config->streams * config->pairs * (bidirectional ? 2 : 1));
+
+    if (g_strv_length(run.engines) > 2) {
+        g_printerr("Engines are given as one engine or a:b, not %s\n", config->engine);
+        goto done;
+    }
+
+    if (!build_pipeline(&run))
+        goto done;
+
+    if (gst_element_set_state(run.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        g_printerr("Could not start the pipeline\n");
+        goto done;
+    }
+
+    if (!wait_until_established(&run))
+        goto done;
+
+    /* Streams can only be added once the associations are up */
+    for (i = 0; i < run.n_peers; i++) {
+        if ((i % 2 == 0 || bidirectional) && !add_sources(&run.peers[i]))
+            goto done;
+    }
+
+    chunks_sent = get_stack_stat(&run, "stack-data-chunks-sent");
+    chunks_retransmitted = get_stack_stat(&run, "stack-data-chunks-retransmitted");
+    for (i = 0; i < run.n_peers; i++)
+        packets_sent[i] = get_uint64_stat(run.peers[i].enc, "packets-sent");
+
+    getrusage(RUSAGE_SELF, &usage_start);
+    start = g_get_monotonic_time();
+    send_messages(&run);
+    wait_until_drained(&run);
+    getrusage(RUSAGE_SELF, &usage_end);
+    ok = check_bus(&run);
+
+    g_array_sort(run.latencies, compare_latency);
+    cpu_ns = timeval_to_ns(&usage_end.ru_utime) - timeval_to_ns(&usage_start.ru_utime)
+        + timeval_to_ns(&usage_end.ru_stime) - timeval_to_ns(&usage_start.ru_stime);
+
+    memset(result, 0, sizeof(*result));
+    result->config = *config;
+    result->messages_sent = run.messages_sent;
+    result->messages_received = run.messages_received;
+    result->bytes_received = run.bytes_received;
+    for (i = 0; i < run.n_peers; i++) {
+        result->wire_bytes += get_uint64_stat(run.peers[i].impair, "bytes-out");
+        result->packets_dropped += get_uint64_stat(run.peers[i].impair, "dropped-loss")
+            + get_uint64_stat(run.peers[i].impair, "dropped-queue");
+        result->packets += get_uint64_stat(run.peers[i].enc, "packets-sent") - packets_sent[i];
+    }
+    result->data_chunks_sent = get_stack_stat(&run, "stack-data-chunks-sent") - chunks_sent;
+    result->data_chunks_retransmitted = get_stack_stat(&run, "stack-data-chunks-retransmitted")
+        - chunks_retransmitted;
+    result->seconds = (gdouble) (run.last_receive - start) / G_TIME_SPAN_SECOND;
+    /* Both sides connect at the same time, a pair is usable once both are up */
+    for (i = 0; i < run.n_peers; i++) {
+        result->time_to_connected = MAX(result->time_to_connected,
+            get_uint64_stat(run.peers[i].enc, "time-to-connected"));
+    }
+    result->p50 = percentile(run.latencies, 0.5);
+    result->p99 = percentile(run.latencies, 0.99);
+    result->p999 = percentile(run.latencies, 0.999);
+    result->cpu_ns_per_message = run.messages_received ?
+        (gdouble) cpu_ns / run.messages_received : 0;
+    /* Compare the checksum modes on this one, every packet is summed once on each side */
+    result->cpu_ns_per_packet = result->packets ? (gdouble) cpu_ns / result->packets : 0;
+    /* Kilobytes on Linux, the peak of the whole process so far */
+    result->peak_rss_kb = usage_end.ru_maxrss;
+
+    /* Last, it takes associations down */
+    if (check && ok)
+        ok = check_result(&run, result) && check_shutdown(&run);
+
+done:
+    if (run.pipeline) {
+        for (i = 0; i < run.n_peers; i++) {
+            guint j;
+            for (j = 0; run.peers[i].sources && j < run.peers[i].sources->len; j++)
+                gst_app_src_end_of_stream(GST_APP_SRC(g_ptr_array_index(run.peers[i].sources, j)));
+        }
+        gst_element_set_state(run.pipeline, GST_STATE_NULL);
+        gst_object_unref(run.pipeline);
+    }
+    for (i = 0; i < run.n_peers; i++) {
+        if (run.peers[i].sources)
+            g_ptr_array_free(run.peers[i].sources, TRUE);
+    }
+    g_free(run.peers);
+    g_strfreev(run.engines);
+    g_free(packets_sent);
+    g_array_free(run.latencies, TRUE);
+    g_cond_clear(&run.cond);
+    g_mutex_clear(&run.lock);
+
+    return ok;
+}
+
+static gdouble messages_per_second(const BenchResult *result)
+{
+    return result->seconds > 0 ? result->messages_received / result->seconds : 0;
+}
+
+static gdouble megabytes_per_second(const BenchResult *result)
+{
+    return result->seconds > 0 ? result->bytes_received / result->seconds / 1e6 : 0;
+}
+
+static gdouble wire_megabytes_per_second(const BenchResult *result)
+{
+    return result->seconds > 0 ? result->wire_bytes / result->seconds / 1e6 : 0;
+}
+
+static gdouble retransmission_rate(const BenchResult *result)
+{
+    return result->data_chunks_sent ?
+        (gdouble) result->data_chunks_retransmitted / result->data_chunks_sent : 0;
+}
+
+static void print_header(FILE *out, OutputFormat format)
+{
+    switch (format) {
+    case OUTPUT_FORMAT_TEXT:
+        fprintf(out, "%7s %7s %9s %4s %8s %5s %11s %12s %5s %10s %10s %12s %9s %9s %7s %10s %9s "
+            "%9s %10s %9s %10s\n",
+            "size", "streams", "ordering", "pr", "cc", "mtu", "checksum", "engine", "pairs",
+            "sent", "received",
+            "msgs/s", "good MB/s", "wire MB/s", "rtx %", "connect ms", "p50 us", "p99 us",
+            "p999 us", "cpu ns", "cpu ns/pkt");
+        break;
+    case OUTPUT_FORMAT_JSON:
+        fprintf(out, "[\n");
+        break;
+    case OUTPUT_FORMAT_CSV:
+        fprintf(out, "message_size,streams,ordered,pr,pr_param,congestion_control,mtu,checksum,"
+            "engine,pairs,bidirectional,messages_sent,messages_received,seconds,messages_per_second,"
+            "mb_per_second,wire_mb_per_second,packets_dropped,data_chunks_sent,"
+            "data_chunks_retransmitted,retransmission_rate,time_to_connected_us,"
+            "latency_p50_ns,latency_p99_ns,"
+            "latency_p999_ns,cpu_ns_per_message,packets,cpu_ns_per_packet,peak_rss_kb\n");
+        break;
+    }
+}
+
+static void print_result(FILE *out, OutputFormat format, const BenchResult *result, gboolean first)
+{
+    const BenchConfig *config = &result->config;
+
+    switch (format) {
+    case OUTPUT_FORMAT_TEXT:
+        fprintf(out, "%7u %7u %9s %4s %8s %5u %11s %12s %5u %10" G_GUINT64_FORMAT " %10"
+            G_GUINT64_FORMAT " %12.0f %9.2f %9.2f %7.2f %10.1f %9.1f %9.1f %10.1f %9.0f %10.0f\n",
+            config->message_size, config->streams, config->ordered ? "ordered" : "unordered",
+            pr_names[config->pr], config->congestion_control, config->mtu, config->checksum,
+            config->engine, config->pairs, result->messages_sent, result->messages_received, messages_per_second(result),
+            megabytes_per_second(result), wire_megabytes_per_second(result),
+            retransmission_rate(result) * 100, result->time_to_connected / 1e3, result->p50 / 1e3,
+            result->p99 / 1e3, result->p999 / 1e3, result->cpu_ns_per_message,
+            result->cpu_ns_per_packet);
+        break;
+    case OUTPUT_FORMAT_JSON:
+        fprintf(out, "%s  {\"message_size\": %u, \"streams\": %u, \"ordered\": %s, \"pr\": \"%s\", "
+            "\"pr_param\": %u, \"congestion_control\": \"%s\", \"mtu\": %u, \"checksum\": \"%s\", "
+            "\"engine\": \"%s\", \"pairs\": %u, \"bidirectional\": %s, "
+            "\"messages_sent\": %" G_GUINT64_FORMAT ", \"messages_received\": %" G_GUINT64_FORMAT
+            ", \"seconds\": %.6f, \"messages_per_second\": %.1f, \"mb_per_second\": %.3f, "
+            "\"wire_mb_per_second\": %.3f, \"packets_dropped\": %" G_GUINT64_FORMAT
+            ", \"data_chunks_sent\": %" G_GUINT64_FORMAT ", \"data_chunks_retransmitted\": %"
+            G_GUINT64_FORMAT ", \"retransmission_rate\": %.6f, "
+            "\"time_to_connected_us\": %" G_GUINT64_FORMAT ", \"latency_p50_ns\": %"
+            G_GINT64_FORMAT ", \"latency_p99_ns\": %" G_GINT64_FORMAT ", \"latency_p999_ns\": %"
+            G_GINT64_FORMAT ", \"cpu_ns_per_message\": %.1f, \"packets\": %" G_GUINT64_FORMAT
+            ", \"cpu_ns_per_packet\": %.1f, \"peak_rss_kb\": %ld}",
+            first ? "" : ",\n", config->message_size, config->streams,
+            config->ordered ? "true" : "false", pr_names[config->pr], pr_param,
+            config->congestion_control, config->mtu, config->checksum, config->engine,
+            config->pairs, bidirectional ? "true" : "false",
+            result->messages_sent, result->messages_received, result->seconds,
+            messages_per_second(result), megabytes_per_second(result),
+            wire_megabytes_per_second(result), result->packets_dropped, result->data_chunks_sent,
+            result->data_chunks_retransmitted, retransmission_rate(result),
+            result->time_to_connected, result->p50, result->p99, result->p999,
+            result->cpu_ns_per_message, result->packets, result->cpu_ns_per_packet,
+            result->peak_rss_kb);
+        break;
+    case OUTPUT_FORMAT_CSV:
+        fprintf(out, "%u,%u,%d,%s,%u,%s,%u,%s,%s,%u,%d,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
+            ",%.6f,%.1f,%.3f,%.3f,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
+            ",%.6f,%" G_GUINT64_FORMAT ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",%"
+            G_GINT64_FORMAT ",%.1f,%" G_GUINT64_FORMAT ",%.1f,%ld\n",
+            config->message_size, config->streams, config->ordered, pr_names[config->pr], pr_param,
+            config->congestion_control, config->mtu, config->checksum, config->engine,
+            config->pairs, bidirectional,
+            result->messages_sent,
+            result->messages_received, result->seconds, messages_per_second(result),
+            megabytes_per_second(result), wire_megabytes_per_second(result),
+            result->packets_dropped, result->data_chunks_sent, result->data_chunks_retransmitted,
+            retransmission_rate(result), result->time_to_connected, result->p50, result->p99,
+            result->p999, result->cpu_ns_per_message, result->packets, result->cpu_ns_per_packet,
+            result->peak_rss_kb);
+        break;
+    }
+    fflush(out);
+}
+
+static void print_footer(FILE *out, OutputFormat format)
+{
+    if (format == OUTPUT_FORMAT_JSON)
+        fprintf(out, "\n]\n");
+}
+
+int main(int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    GArray *sizes, *stream_counts, *mtus, *pair_counts;
+    gchar **orderings, **prs, **ccs, **checksums, **engines;
+    OutputFormat format = OUTPUT_FORMAT_TEXT;
+    FILE *out = stdout;
+    guint s, n, o, p, c, m, k, e, a;
+    gboolean first = TRUE;
+    int ret = 0;
+
+    context = g_option_context_new("- sctpenc/sctpdec loopback benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (!g_strcmp0(format_option, "json"))
+        format = OUTPUT_FORMAT_JSON;
+    else if (!g_strcmp0(format_option, "csv"))
+        format = OUTPUT_FORMAT_CSV;
+    else if (format_option && g_strcmp0(format_option, "text")) {
+        g_printerr("Unknown output format %s\n", format_option);
+        return 1;
+    }
+
+    if (output_option && !(out = fopen(output_option, "w"))) {
+        g_printerr("Could not open %s\n", output_option);
+        return 1;
+    }
+
+    if (!plugin_path)
+        plugin_path = g_strdup(g_getenv("SCTPBENCH_PLUGIN_PATH"));
+#ifdef SCTPBENCH_PLUGIN_PATH
+    if (!plugin_path)
+        plugin_path = g_strdup(SCTPBENCH_PLUGIN_PATH);
+#endif
+    if (plugin_path)
+        gst_registry_scan_path(gst_registry_get(), plugin_path);
+
+    sizes = parse_uint_list(sizes_option, "64,1024,16384");
+    stream_counts = parse_uint_list(streams_option, "1,4,16");
+    orderings = g_strsplit(ordering_option ? ordering_option : "ordered,unordered", ",", -1);
+    prs = g_strsplit(pr_option ? pr_option : "none,ttl,rtx,buf", ",", -1);
+    ccs = g_strsplit(cc_option ? cc_option : "rfc2581", ",", -1);
+    mtus = parse_uint_list(mtu_option, "1200");
+    checksums = g_strsplit(checksum_option ? checksum_option : "accelerated", ",", -1);
+    engines = g_strsplit(engine_option ? engine_option
+        : check ? "lite,usrsctp:lite,lite:usrsctp" : "usrsctp", ",", -1);
+    pair_counts = parse_uint_list(pairs_option, "1");
+
+    print_header(out, format);
+    for (s = 0; s < sizes->len; s++) {
+        for (n = 0; n < stream_counts->len; n++) {
+            for (o = 0; orderings[o]; o++) {
+                for (p = 0; prs[p]; p++) {
+                    for (c = 0; ccs[c]; c++) {
+                        for (m = 0; m < mtus->len; m++) {
+                            for (k = 0; checksums[k]; k++) {
+                                for (e = 0; engines[e]; e++) {
+                                    for (a = 0; a < pair_counts->len; a++) {
+                                        BenchConfig config;
+                                        BenchResult result;
+
+                                        config.message_size = MAX(g_array_index(sizes, guint, s),
+                                            MESSAGE_HEADER_SIZE);
+                                        config.streams = g_array_index(stream_counts, guint, n);
+                                        config.ordered = g_strcmp0(orderings[o], "unordered") != 0;
+                                        config.congestion_control = ccs[c];
+                                        config.mtu = g_array_index(mtus, guint, m);
+                                        config.checksum = checksums[k];
+                                        config.engine = engines[e];
+                                        config.pairs = g_array_index(pair_counts, guint, a);
+                                        if (!parse_pr(prs[p], &config.pr)) {
+                                            g_printerr("Unknown partial reliability policy %s\n",
+                                                prs[p]);
+                                            ret = 1;
+                                            goto done;
+                                        }
+
+                                        if (!run_benchmark(&config, &result)) {
+                                            ret = 1;
+                                            continue;
+                                        }
+                                        print_result(out, format, &result, first);
+                                        first = FALSE;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    print_footer(out, format);
+
+done:
+    g_array_free(pair_counts, TRUE);
+    g_strfreev(engines);
+    g_strfreev(checksums);
+    g_array_free(mtus, TRUE);
+    g_strfreev(ccs);
+    g_strfreev(prs);
+    g_strfreev(orderings);
+    g_array_free(stream_counts, TRUE);
+    g_array_free(sizes, TRUE);
+    if (out != stdout)
+        fclose(out);
+    g_free(plugin_path);
+
+    return ret;
+}